@@ -200,6 +200,15 @@ static void zsv_2json_row(void *ctx) {
       jsonwriter_end_array(data->jsw);
     if (obj)
       jsonwriter_end_object(data->jsw);
+    if (!data->rows_processed && data->schema == ZSV_JSON_SCHEMA_OBJECT) {
+      // data cells without a header are not output, so the parser can skip them
+      unsigned char *bitmap = malloc(cols / 8 + 1);
+      if (bitmap) {
+        memset(bitmap, 0xFF, cols / 8 + 1);
+        zsv_set_column_filter(data->parser, bitmap, cols);
+        free(bitmap);
+      }
+    }
     data->rows_processed++;
   }
   data->current_header = data->headers;
@@ -41,7 +41,10 @@ static int main_help(int argc, const char *argv[]) {
     "  -r,--max-row-size <n>    : set the minimum supported maximum row size. defaults to 64k",
     "  -B,--buff-size <n>       : set internal buffer size. defaults to 256k",
     "  -t,--tab-delim           : set column delimiter to tab",
-    "  -O,--other-delim <char>  : set column delimiter to specified character",
+    "  -O,--other-delim <delim> : set column delimiter to specified char(s), up to 8 bytes",
+    "  -E,--row-terminator <str>: end rows with specified string (up to 8 bytes) instead of a newline",
+    "  -Q,--quote-char <char>   : set quote char (default: dbl-quote)",
+    "  -X,--escape-char <char>  : treat the char after the specified char (e.g. '\\') as content",
     "  -q,--no-quote            : turn off quote handling",
     "  -R,--skip-head <n>       : skip specified number of initial rows",
     "  -d,--header-row-span <n> : apply header depth (rowspan) of n",
@@ -51,6 +54,7 @@ static int main_help(int argc, const char *argv[]) {
     "  -0,--header-row <header> : insert the provided CSV as the first row (in position 0)",
     "                             e.g. --header-row 'col1,col2,\"my col 3\"'",
     "  -v,--verbose             : verbose output",
+    "  --stats                  : print parser statistics (rows, cells, time reading vs scanning etc) to stderr",
     "",
     "Commands that parse CSV or other tabular data:",
     "  select   : extract rows/columns by name or position and perform other basic and 'cleanup' operations",
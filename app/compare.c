@@ -96,9 +96,18 @@ static void zsv_compare_header_str(struct zsv_compare_data *data, const unsigned
     zsv_compare_output_str(data, s, new_row, quoted);
   else {
     // we will output as JSON objects, so save the property names for later use
-    if (data->writer.properties.used + 1 < data->writer.properties.allocated)
-      data->writer.properties.names[data->writer.properties.used++] = strdup(s ? (const char *)s : "");
-    else
+    if (data->writer.properties.used + 1 < data->writer.properties.allocated) {
+      if (!data->arenas.names && !(data->arenas.names = zsv_arena_new(0)))
+        data->status = zsv_compare_status_memory;
+      else {
+        size_t len = s ? strlen((const char *)s) : 0;
+        char *name = (char *)zsv_arena_memdup(data->arenas.names, s, len);
+        if (!name)
+          data->status = zsv_compare_status_memory;
+        else
+          data->writer.properties.names[data->writer.properties.used++] = name;
+      }
+    } else
       fprintf(stderr, "zsv_compare_header_str: insufficient header names allocation adding %s!\n", s);
   }
 }
@@ -206,11 +215,17 @@ static void zsv_compare_print_row(struct zsv_compare_data *data,
   // for now, output format is simple: for each value,
   // output a single scalar if the values are the same,
   // and a tuple if they differ
-  struct zsv_cell *values = calloc(data->input_count, sizeof(*values));
+  if (!data->arenas.row && !(data->arenas.row = zsv_arena_new(0))) {
+    data->status = zsv_compare_status_memory;
+    return;
+  }
+  zsv_arena_reset(data->arenas.row);
+  struct zsv_cell *values = zsv_arena_alloc(data->arenas.row, data->input_count * sizeof(*values));
   if (!values) {
     data->status = zsv_compare_status_memory;
     return;
   }
+  memset(values, 0, data->input_count * sizeof(*values));
 
 #define ZSV_COMPARE_MISSING "Missing"
 
@@ -284,7 +299,6 @@ static void zsv_compare_print_row(struct zsv_compare_data *data,
         data->diff_count++;
     }
   }
-  free(values);
 }
 
 static void zsv_compare_input_free(struct zsv_compare_input *input) {
@@ -468,9 +482,9 @@ static void zsv_compare_data_free(struct zsv_compare_data *data) {
   free(data->inputs);
   free(data->combined_key_names);
   free(data->inputs_to_sort);
-  for (unsigned i = 0; i < data->writer.properties.used; i++)
-    free(data->writer.properties.names[i]);
   free(data->writer.properties.names);
+  zsv_arena_delete(data->arenas.names);
+  zsv_arena_delete(data->arenas.row);
 
   if (data->sort) {
     if (data->sort_db)
@@ -105,6 +105,11 @@ struct zsv_compare_data {
 
   sqlite3 *sort_db; // used when --sort option was specified
 
+  struct {
+    struct zsv_arena *names; // JSON property names, freed with the compare handle
+    struct zsv_arena *row;   // reset for each output row
+  } arenas;
+
   struct {
     double value;
 #define ZSV_COMPARE_MAX_NUMBER_BUFF_LEN 128
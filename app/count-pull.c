@@ -62,15 +62,22 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
 
   if (!err) {
     zsv_parser parser;
+    opts->mmap = 1;
     if (zsv_new_with_properties(opts, custom_prop_handler, input_path, opts_used, &parser) != zsv_status_ok) {
       fprintf(stderr, "Unable to initialize parser\n");
       err = 1;
     } else {
       size_t count = 0;
-      while (zsv_next_row(parser) == zsv_status_row)
-        count++;
+      struct zsv_row_batch batch = {0};
+      batch.max_rows = 1024; // no cells are needed
+      enum zsv_status status;
+      while ((status = zsv_next_batch(parser, &batch)) == zsv_status_row)
+        count += batch.rows;
       zsv_delete(parser);
-      printf("%zu\n", count > 0 ? count - 1 : 0);
+      if (status == zsv_status_error) // e.g. truncated compressed input, which has been reported
+        err = 1;
+      else
+        printf("%zu\n", count > 0 ? count - 1 : 0);
     }
   }
 
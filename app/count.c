@@ -12,6 +12,7 @@
 
 #define ZSV_COMMAND count
 #include "zsv_command.h"
+#include <zsv/utils/decompress.h>
 
 struct data {
   zsv_parser parser;
@@ -22,12 +23,40 @@ static void row(void *ctx) {
   ((struct data *)ctx)->rows++;
 }
 
+static int count_parallel_header(void *ctx, zsv_parser parser) {
+  (void)(ctx);
+  (void)(parser);
+  return 0;
+}
+
+static void *count_parallel_chunk_start(void *ctx, zsv_parser parser, size_t chunk_ix) {
+  (void)(ctx);
+  (void)(chunk_ix);
+  struct data *chunk_data = calloc(1, sizeof(*chunk_data));
+  if (!chunk_data)
+    zsv_abort(parser);
+  return chunk_data;
+}
+
+static enum zsv_status count_parallel_chunk_end(void *ctx, void *chunk_ctx, size_t chunk_ix, enum zsv_status stat) {
+  (void)(chunk_ix);
+  struct data *data = ctx;
+  struct data *chunk_data = chunk_ctx;
+  if (stat == zsv_status_ok && chunk_data)
+    data->rows += chunk_data->rows;
+  free(chunk_data);
+  return zsv_status_ok;
+}
+
 static int count_usage() {
   static const char *usage = "Usage: count [options]\n"
                              "\n"
                              "Options:\n"
                              "  -h,--help             : show usage\n"
-                             "  -i,--input <filename> : use specified file input\n";
+                             "  -i,--input <filename> : use specified file input\n"
+                             "  -j,--jobs <n>         : count a file input using n parallel threads (default:\n"
+                             "                          number of processors)\n"
+                             "  --chunk-size <n>      : with -j, approximate bytes per parallel chunk\n";
   printf("%s\n", usage);
   return 0;
 }
@@ -36,6 +65,8 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
                                struct zsv_prop_handler *custom_prop_handler, const char *opts_used) {
   struct data data = {0};
   const char *input_path = NULL;
+  struct zsv_parallel_opts popts = {0};
+  char parallel = 0;
   int err = 0;
   for (int i = 1; !err && i < argc; i++) {
     const char *arg = argv[i];
@@ -43,7 +74,17 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       count_usage();
       goto count_done;
     }
-    if (!strcmp(arg, "-i") || !strcmp(arg, "--input") || *arg != '-') {
+    if (!strcmp(arg, "-j") || !strcmp(arg, "--jobs") || !strcmp(arg, "--chunk-size")) {
+      if (++i >= argc || atol(argv[i]) < 0) {
+        fprintf(stderr, "%s option requires a non-negative integer value\n", arg);
+        err = 1;
+      } else if (!strcmp(arg, "--chunk-size"))
+        popts.chunk_size = (size_t)atol(argv[i]);
+      else {
+        popts.threads = (unsigned)atoi(argv[i]);
+        parallel = 1;
+      }
+    } else if (!strcmp(arg, "-i") || !strcmp(arg, "--input") || *arg != '-') {
       err = 1;
       if ((!strcmp(arg, "-i") || !strcmp(arg, "--input")) && ++i >= argc)
         fprintf(stderr, "%s option requires a filename\n", arg);
@@ -70,9 +111,40 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
   }
 #endif
 
+  if (!err && input_path && zsv_file_compression(input_path) == zsv_compression_none
+#ifdef ZSV_EXTRAS
+      && !opts->max_rows
+#endif
+  ) {
+    struct zsv_file_properties fp = zsv_cache_load_props(input_path, opts, custom_prop_handler, opts_used);
+    enum zsv_status status = fp.stat;
+    if (status == zsv_status_ok) {
+      // count row ends without parsing cells, if possible
+      status = zsv_count_rows(input_path, opts, &popts, &data.rows);
+      if (status == zsv_status_invalid_option && parallel) {
+        opts->row_handler = row;
+        popts.header = count_parallel_header;
+        popts.chunk_start = count_parallel_chunk_start;
+        popts.chunk_end = count_parallel_chunk_end;
+        popts.ctx = &data;
+        status = zsv_parse_parallel(input_path, opts, &popts);
+      }
+    }
+    if (status == zsv_status_ok) {
+      printf("%zu\n", data.rows);
+      goto count_done;
+    }
+    if (status != zsv_status_invalid_option) {
+      fprintf(stderr, "Unable to count %s: %s\n", input_path, zsv_parse_status_desc(status));
+      err = 1;
+    }
+    // else e.g. not a regular file: count serially
+  }
+
   if (!err) {
     opts->row_handler = row;
     opts->ctx = &data;
+    opts->mmap = 1;
     if (zsv_new_with_properties(opts, custom_prop_handler, input_path, opts_used, &data.parser) != zsv_status_ok) {
       fprintf(stderr, "Unable to initialize parser\n");
       err = 1;
@@ -80,9 +152,13 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       enum zsv_status status;
       while ((status = zsv_parse_more(data.parser)) == zsv_status_ok)
         ;
-      zsv_finish(data.parser);
+      if (status == zsv_status_error) // e.g. truncated compressed input, which has been reported
+        err = 1;
+      else {
+        zsv_finish(data.parser);
+        printf("%zu\n", data.rows > 0 ? data.rows - 1 : 0);
+      }
       zsv_delete(data.parser);
-      printf("%zu\n", data.rows > 0 ? data.rows - 1 : 0);
     }
   }
 
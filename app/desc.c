@@ -51,7 +51,8 @@ void zsv_desc_string_list_free(struct zsv_desc_string_list *e) {
 typedef struct zsv_desc_unique_key {
   unsigned char color : 1;
   unsigned char _ : 7;
-  unsigned char *value;
+  const unsigned char *value;
+  size_t len;
   struct zsv_desc_unique_key *left;
   struct zsv_desc_unique_key *right;
 } zsv_desc_unique_key;
@@ -64,25 +65,11 @@ struct zsv_desc_unique_key_container {
   unsigned char dummy : 7;
 };
 
-static struct zsv_desc_unique_key *zsv_desc_unique_key_new(const unsigned char *value, size_t len) {
-  zsv_desc_unique_key *key = calloc(1, sizeof(*key));
-  if (!key || !(key->value = malloc(len + 1)))
-    ; // handle out-of-memory error!
-  else {
-    memcpy(key->value, value, len);
-    key->value[len] = '\0';
-  }
-  return key;
-}
-
-static void zsv_desc_unique_key_delete(zsv_desc_unique_key *e) {
-  if (e)
-    free(e->value);
-  free(e);
-}
-
 static int zsv_desc_unique_key_cmp(zsv_desc_unique_key *x, zsv_desc_unique_key *y) {
-  return strcmp((const char *)x->value, (const char *)y->value);
+  int cmp = memcmp(x->value, y->value, x->len < y->len ? x->len : y->len);
+  if (cmp)
+    return cmp;
+  return x->len < y->len ? -1 : x->len > y->len;
 }
 
 SGLIB_DEFINE_RBTREE_PROTOTYPES(zsv_desc_unique_key, left, right, color, zsv_desc_unique_key_cmp);
@@ -118,14 +105,9 @@ static void zsv_desc_column_data_finalize(struct zsv_desc_column_data *col, unsi
   col->position = i;
 }
 
+// keys are allocated from the parser's arena (see zsv_desc_column_update_unique()), which frees them
 static void zsv_desc_column_unique_values_delete(zsv_desc_unique_key **tree) {
-  if (tree && *tree) {
-    struct sglib_zsv_desc_unique_key_iterator it;
-    struct zsv_desc_unique_key *e;
-    for (e = sglib_zsv_desc_unique_key_it_init(&it, *tree); e; e = sglib_zsv_desc_unique_key_it_next(&it))
-      zsv_desc_unique_key_delete(e);
-    *tree = NULL;
-  }
+  *tree = NULL;
 }
 
 static void zsv_desc_column_data_free(struct zsv_desc_column_data *e) {
@@ -285,21 +267,33 @@ static void zsv_desc_set_err(struct zsv_desc_data *data, enum zsv_desc_status er
 }
 
 // zsv_desc_column_update_unique(): return 1 if unique, 0 if dupe
-static int zsv_desc_column_update_unique(struct zsv_desc_unique_key_container *key_container,
+// a value is only copied if it is not already in the tree, and the copy is
+// allocated from the parser's arena, so that a column with many distinct
+// values does not make an allocation per row
+static int zsv_desc_column_update_unique(struct zsv_desc_data *data,
+                                         struct zsv_desc_unique_key_container *key_container,
                                          const unsigned char *utf8_value, size_t len) {
-  zsv_desc_unique_key *key = zsv_desc_unique_key_new(utf8_value, len);
-  if (sglib_zsv_desc_unique_key_find_member(key_container->key, key)) { // not unique
+  zsv_desc_unique_key node = {0};
+  node.value = utf8_value;
+  node.len = len;
+  if (sglib_zsv_desc_unique_key_find_member(key_container->key, &node)) { // not unique
     if (key_container->count > key_container->max_count) {
       zsv_desc_column_unique_values_delete(&key_container->key);
       key_container->not_enum = 1;
     }
-    zsv_desc_unique_key_delete(key);
     return 0;
-  } else {
-    sglib_zsv_desc_unique_key_add(&key_container->key, key);
-    key_container->count++;
+  }
+
+  struct zsv_arena *arena = zsv_parser_arena(data->parser, zsv_arena_scope_parse);
+  zsv_desc_unique_key *key = arena ? zsv_arena_alloc(arena, sizeof(*key)) : NULL;
+  if (!key || !(node.value = zsv_arena_memdup(arena, utf8_value, len))) {
+    zsv_desc_set_err(data, zsv_desc_status_memory, NULL);
     return 1;
   }
+  *key = node;
+  sglib_zsv_desc_unique_key_add(&key_container->key, key);
+  key_container->count++;
+  return 1;
 }
 
 static void zsv_desc_cell(void *ctx, unsigned char *restrict utf8_value, size_t len) {
@@ -356,7 +350,7 @@ static void zsv_desc_cell(void *ctx, unsigned char *restrict utf8_value, size_t
 
           if (data->flags & ZSV_DESC_FLAG_UNIQUE) {
             if (!col->not_unique)
-              if (!zsv_desc_column_update_unique(&col->unique_values, utf8_value, len)) // dupe
+              if (!zsv_desc_column_update_unique(data, &col->unique_values, utf8_value, len)) // dupe
                 col->not_unique = 1;
           }
 
@@ -366,7 +360,7 @@ static void zsv_desc_cell(void *ctx, unsigned char *restrict utf8_value, size_t
             ) {
               unsigned char *lc = zsv_strtolowercase(utf8_value, &len);
               if (lc) {
-                if (!zsv_desc_column_update_unique(&col->unique_values_ci, lc, len))
+                if (!zsv_desc_column_update_unique(data, &col->unique_values_ci, lc, len))
                   col->not_unique_ci = 1;
                 free(lc);
               }
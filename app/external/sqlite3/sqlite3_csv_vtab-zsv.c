@@ -100,8 +100,13 @@ typedef struct zsvTable {
   enum zsv_status parser_status;
   zsv_parser parser;
   sqlite_int64 rowCount;
+  size_t nCol;                    /* Number of columns in the header row */
+  struct zsv_row_batch batch;     /* Rows fetched by zsv_next_batch() */
+  size_t batchRow;                /* Current row within batch */
 } zsvTable;
 
+#define ZSVTAB_BATCH_ROWS 256
+
 struct zsvTable *zsvTable_new() {
   struct zsvTable *z = sqlite3_malloc(sizeof(*z));
   if(z) {
@@ -145,6 +150,7 @@ static void zsvTable_free(struct zsvTable *z) {
 static void zsvTable_delete(struct zsvTable *z) {
   if(z) {
     zsvTable_free(z);
+    sqlite3_free(z->batch.cells);
     sqlite3_free(z->zFilename);
     sqlite3_free(z->opts_used);
     sqlite3_free(z);
@@ -247,7 +253,8 @@ static int zsvtabConnect(
   sqlite3_str_appendf(pStr, "CREATE TABLE x(");
 
   // for each column, add a spec to CREATE TABLE
-  for(size_t i = 0, j = zsv_cell_count(pNew->parser); i < j; i++) {
+  pNew->nCol = zsv_cell_count(pNew->parser);
+  for(size_t i = 0, j = pNew->nCol; i < j; i++) {
     struct zsv_cell cell = zsv_get_cell(pNew->parser, i);
     size_t len = cell.len;
     unsigned char *utf8_value = (unsigned char *)zsv_strtrim(cell.str, &len);
@@ -327,6 +334,9 @@ static int zsvtabBestIndex(
 ){
   (void)(tab);
   pIdxInfo->estimatedCost = 1000000;
+  /* pass the columns used by this plan to xFilter, so the parser can skip the others */
+  pIdxInfo->idxStr = sqlite3_mprintf("%llx", (unsigned long long)pIdxInfo->colUsed);
+  pIdxInfo->needToFreeIdxStr = 1;
   return SQLITE_OK;
 }
 
@@ -369,7 +379,6 @@ static int zsvtabFilter(
   int argc, sqlite3_value **argv
 ){
   (void)(idxNum);
-  (void)(idxStr);
   (void)(argc);
   (void)(argv);
   zsvTable *pTab = (zsvTable*)pVtabCursor->pVtab;
@@ -377,12 +386,36 @@ static int zsvtabFilter(
   zsvTable_free(pTab);
   fseek(pTab->parser_opts.stream, 0, SEEK_SET);
 
-  // reload and advance header, then first data row
+  // reload and advance header, then first batch of data rows
+  pTab->batch.max_rows = 1;
+  pTab->batch.max_columns = 0;
   if(zsv_new_with_properties(&pTab->parser_opts, &pTab->custom_prop_handler, pTab->zFilename, pTab->opts_used,
                              &pTab->parser) != zsv_status_ok
-     || (pTab->parser_status = zsv_next_row(pTab->parser)) != zsv_status_row)
+     || (pTab->parser_status = zsv_next_batch(pTab->parser, &pTab->batch)) != zsv_status_row)
     return SQLITE_ERROR;
-  pTab->parser_status = zsv_next_row(pTab->parser);
+
+  /* only fetch columns up to the last one used. colUsed bit n is set if column n
+     is used, and bit 63 if any column from 63 on is used */
+  sqlite3_uint64 colUsed = idxStr ? strtoull(idxStr, NULL, 16) : ~(sqlite3_uint64)0;
+  size_t nCol = pTab->nCol;
+  if(!(colUsed & ((sqlite3_uint64)1 << 63))) {
+    nCol = 0;
+    for(size_t i = 0; i < 63; i++)
+      if(colUsed & ((sqlite3_uint64)1 << i))
+        nCol = i + 1;
+  }
+  if(nCol > pTab->nCol)
+    nCol = pTab->nCol;
+  if(nCol) {
+    struct zsv_cell *cells = sqlite3_realloc64(pTab->batch.cells, ZSVTAB_BATCH_ROWS * nCol * sizeof(*cells));
+    if(!cells)
+      return SQLITE_NOMEM;
+    pTab->batch.cells = cells;
+  }
+  pTab->batch.max_rows = ZSVTAB_BATCH_ROWS;
+  pTab->batch.max_columns = nCol;
+  pTab->parser_status = zsv_next_batch(pTab->parser, &pTab->batch);
+  pTab->batchRow = 0;
   pTab->rowCount = 1;
   return SQLITE_OK;
 }
@@ -394,7 +427,10 @@ static int zsvtabFilter(
 */
 static int zsvtabNext(sqlite3_vtab_cursor *cur){
   zsvTable *pTab = (zsvTable*)cur->pVtab;
-  pTab->parser_status = zsv_next_row(pTab->parser);
+  if(++pTab->batchRow >= pTab->batch.rows) {
+    pTab->parser_status = zsv_next_batch(pTab->parser, &pTab->batch);
+    pTab->batchRow = 0;
+  }
   pTab->rowCount++;
   return SQLITE_OK;
 }
@@ -418,7 +454,9 @@ static int zsvtabColumn(
   int i                       /* Which column to return */
 ){
   zsvTable *pTab = (zsvTable*)cur->pVtab;
-  struct zsv_cell c = zsv_get_cell(pTab->parser, i);
+  struct zsv_cell c = {0};
+  if((size_t)i < pTab->batch.max_columns)
+    c = pTab->batch.cells[pTab->batchRow * pTab->batch.max_columns + i];
   sqlite3_result_text(ctx, (char *)c.str, c.len, SQLITE_STATIC);
   return SQLITE_OK;
 }
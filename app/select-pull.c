@@ -7,9 +7,6 @@
 
 #include <stdio.h>
 #include <assert.h>
-#ifdef _WIN32
-#define _CRT_RAND_S // for random number generator, used when sampling. must come before including stdlib.h
-#endif
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -25,6 +22,15 @@
 #include <zsv/utils/string.h>
 #include <zsv/utils/mem.h>
 #include <zsv/utils/arg.h>
+#include <zsv/utils/cache.h>
+#include <zsv/utils/dedupe.h>
+#include <zsv/utils/random.h>
+#include <zsv/utils/regex.h>
+#include <zsv/utils/sample.h>
+#include <zsv/utils/search.h>
+#include <zsv/utils/where.h>
+
+#define ZSV_SELECT_DEDUPE_MEMORY_DEFAULT ((size_t)1024 * 1024 * 1024)
 
 struct zsv_select_search_str {
   struct zsv_select_search_str *next;
@@ -39,6 +45,22 @@ static void zsv_select_search_str_delete(struct zsv_select_search_str *ss) {
   }
 }
 
+struct zsv_select_regex {
+  struct zsv_select_regex *next;
+  char *col_name;   // --regex-col; NULL for --regex, which any cell may match
+  unsigned int col; // index of col_name, once the header is read
+  struct zsv_regex *re;
+};
+
+static void zsv_select_regex_delete(struct zsv_select_regex *r) {
+  for (struct zsv_select_regex *next; r; r = next) {
+    next = r->next;
+    free(r->col_name);
+    zsv_regex_delete(r->re);
+    free(r);
+  }
+}
+
 struct zsv_select_uint_list {
   struct zsv_select_uint_list *next;
   unsigned int value;
@@ -50,6 +72,7 @@ struct zsv_select_data {
   size_t data_row_count;
 
   struct zsv_opts *opts;
+  zsv_parser parser;
   unsigned int errcount;
 
   unsigned int output_col_index; // num of cols printed in current row
@@ -60,8 +83,9 @@ struct zsv_select_data {
   char *cols_to_print; // better: bitfield
 
   struct {
-    unsigned int ix; // index of the input column to be output
-    struct {         // merge data: only used with --merge
+    unsigned int ix;           // index of the input column to be output
+    struct zsv_regex *capture; // --regex-col with a group: output the first group instead of the value
+    struct {                   // merge data: only used with --merge
       struct zsv_select_uint_list *indexes, **last_index;
     } merge;
   } *out2in; // array of .output_cols_count length; out2in[x] = y where x = output ix, y = input info
@@ -83,23 +107,64 @@ struct zsv_select_data {
 
   double sample_pct;
 
-  unsigned char sample_every_n;
+  unsigned sample_every_n;
+
+  struct {
+    struct zsv_random random; // --sample-pct
+    uint64_t seed;            // --seed
+    size_t next;              // --sample-every and --sample-pct: number of the next data row to output
+    size_t n;                 // --sample-n
+    const char *by;           // --sample-by
+    unsigned int by_ix;       // index of the --sample-by column
+    struct zsv_sample *rows;  // --sample-n: rows kept so far, as they are output
+    unsigned char seeded : 1;
+    unsigned char _ : 7;
+  } sample;
+
+  struct {
+    struct zsv_dedupe *set;      // --dedupe
+    struct zsv_dedupe_opts opts; // --dedupe-memory and --dedupe-bloom
+    const char **key_names;      // --key, in the order given
+    unsigned int *key_ix;        // index of each --key column
+    unsigned int key_count;
+    unsigned char *key; // the current row's --key values, each after its length
+    size_t key_used;
+    size_t key_size;
+    unsigned char on : 1; // --dedupe
+    unsigned char _ : 7;
+  } dedupe;
+
+  struct { // the current row, as it would be output, for --sample-n and --dedupe (see zsv_select_render_row())
+    zsv_csv_writer writer;
+    unsigned char *buff;
+    size_t used;
+    size_t size;
+    char error; // out of memory
+  } rendered;
 
   size_t data_rows_limit;
   size_t skip_data_rows;
+  size_t skipped_rows; // rows after the current one that the parser skips (see zsv_select_skip_rows())
 
   struct zsv_select_search_str *search_strings;
+  unsigned search_flags;         // ZSV_SEARCH_XXX
+  struct zsv_search *search;     // search_strings, compiled
+  struct zsv_cell *search_cells; // the current row's cells, for zsv_search_cells()
+
+  struct zsv_where *where; // --where
+
+  struct zsv_select_regex *regexes; // --regex and --regex-col, in the order given
 
   zsv_csv_writer csv_writer;
 
   size_t overflow_size;
 
-  /*
   struct {
     size_t *offsets;
     size_t count;
+    size_t record_length;
   } fixed;
-  */
+
   unsigned char whitespace_clean_flags;
 
   unsigned char print_all_cols : 1;
@@ -117,7 +182,8 @@ struct zsv_select_data {
                               // non-null value)
 
   unsigned char no_header : 1;
-  unsigned char _ : 4;
+  unsigned char use_row_index : 1;
+  unsigned char _ : 3;
 };
 
 enum zsv_select_column_index_selection_type {
@@ -284,6 +350,32 @@ static void zsv_select_add_search(struct zsv_select_data *data, const char *valu
   data->search_strings = ss;
 }
 
+// zsv_select_add_regex(): add a --regex <pattern> or, if col is set, a --regex-col <col>=<pattern>
+static enum zsv_status zsv_select_add_regex(struct zsv_select_data *data, const char *arg, char col) {
+  const char *pattern = arg;
+  if (col) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq == arg)
+      return zsv_printerr(1, "--regex-col requires a value of the form <column>=<pattern>: %s", arg);
+    pattern = eq + 1;
+  }
+  struct zsv_select_regex *r = calloc(1, sizeof(*r));
+  if (!r || (col && !(r->col_name = zsv_memdup((const unsigned char *)arg, (size_t)(pattern - 1 - arg))))) {
+    zsv_select_regex_delete(r);
+    return zsv_printerr(1, "Out of memory!\n");
+  }
+  enum zsv_status stat = zsv_regex_new(pattern, 0, &r->re);
+  if (stat != zsv_status_ok) {
+    zsv_select_regex_delete(r);
+    return stat;
+  }
+  struct zsv_select_regex **last = &data->regexes;
+  while (*last)
+    last = &(*last)->next;
+  *last = r;
+  return zsv_status_ok;
+}
+
 #ifndef NDEBUG
 __attribute__((always_inline)) static inline
 #endif
@@ -322,20 +414,109 @@ __attribute__((always_inline)) static inline
   return utf8_value;
 }
 
-static inline char zsv_select_row_search_hit(struct zsv_select_data *data, zsv_parser p) {
+/**
+ * A data row: either one row of a zsv_next_batch() batch or, if cells is NULL,
+ * the parser's current row
+ */
+struct zsv_select_row {
+  zsv_parser parser;
+  const struct zsv_cell *cells;
+  size_t width; // number of cells in the batch row
+  size_t count; // number of cells in the input row
+};
+
+static inline struct zsv_cell zsv_select_get_cell(const struct zsv_select_row *row, size_t ix) {
+  if (!row->cells)
+    return zsv_get_cell(row->parser, ix);
+  if (ix < row->width)
+    return row->cells[ix];
+  struct zsv_cell c = {0};
+  return c;
+}
+
+static enum zsv_status zsv_select_search_init(struct zsv_select_data *data) {
   if (!data->search_strings)
+    return zsv_status_ok;
+  if (!(data->search = zsv_search_new(data->search_flags)) ||
+      !(data->search_cells = calloc(data->opts->max_columns, sizeof(*data->search_cells))))
+    return zsv_status_memory;
+  for (struct zsv_select_search_str *ss = data->search_strings; ss; ss = ss->next) {
+    enum zsv_status stat = zsv_search_add(data->search, (const unsigned char *)ss->value, ss->len);
+    if (stat != zsv_status_ok)
+      return stat;
+  }
+  return zsv_search_compile(data->search);
+}
+
+static inline char zsv_select_row_search_hit(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  if (!data->search)
     return 1;
 
-  unsigned int j = zsv_cell_count(p);
-  for (unsigned int i = 0; i < j; i++) {
-    struct zsv_cell cell = zsv_get_cell(p, i);
-    if (UNLIKELY(data->any_clean != 0))
+  unsigned int j = row->count;
+  if (UNLIKELY(data->clean_white || data->embedded_lineend)) {
+    // these modify the value, so clean and search one cell at a time
+    for (unsigned int i = 0; i < j; i++) {
+      struct zsv_cell cell = zsv_select_get_cell(row, i);
       cell.str = zsv_select_cell_clean(data, cell.str, cell.quoted, &cell.len);
-    if (cell.len) {
-      for (struct zsv_select_search_str *ss = data->search_strings; ss; ss = ss->next)
-        if (ss->value && *ss->value && memmem(cell.str, cell.len, ss->value, ss->len))
-          return 1;
+      if (zsv_search_cell(data->search, cell.str, cell.len))
+        return 1;
     }
+    return 0;
+  }
+
+  // search the whole row in one pass; trimming only narrows each cell
+  if (j > data->opts->max_columns)
+    j = data->opts->max_columns;
+  for (unsigned int i = 0; i < j; i++) {
+    struct zsv_cell cell = zsv_select_get_cell(row, i);
+    if (!data->no_trim_whitespace)
+      cell.str = (unsigned char *)zsv_strtrim(cell.str, &cell.len);
+    data->search_cells[i] = cell;
+  }
+  return zsv_search_cells(data->search, data->search_cells, j, NULL);
+}
+
+struct zsv_select_where_ctx {
+  struct zsv_select_data *data;
+  const struct zsv_select_row *row;
+};
+
+// zsv_select_where_cell(): fetch a cell for zsv_where_eval() or --regex, cleaned as it will be output
+static struct zsv_cell zsv_select_where_cell(void *ctx, size_t ix) {
+  struct zsv_select_where_ctx *w = ctx;
+  struct zsv_cell cell = zsv_select_get_cell(w->row, ix);
+  if (UNLIKELY(w->data->any_clean != 0))
+    cell.str = zsv_select_cell_clean(w->data, cell.str, cell.quoted, &cell.len);
+  return cell;
+}
+
+static inline char zsv_select_row_where(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  struct zsv_select_where_ctx ctx = {data, row};
+  return !data->where || zsv_where_eval(data->where, zsv_select_where_cell, &ctx);
+}
+
+// zsv_select_row_regex_hit(): check that every --regex-col matches its column and,
+// if there is any --regex, that any cell matches one
+static inline char zsv_select_row_regex_hit(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  if (!data->regexes)
+    return 1;
+  struct zsv_select_where_ctx ctx = {data, row};
+  char any = 0;
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) {
+    if (r->col_name) {
+      struct zsv_cell cell = zsv_select_where_cell(&ctx, r->col);
+      if (!zsv_regex_match(r->re, cell.str, cell.len))
+        return 0;
+    } else
+      any = 1;
+  }
+  if (!any)
+    return 1;
+  for (unsigned int i = 0; i < row->count; i++) {
+    struct zsv_cell cell = zsv_select_where_cell(&ctx, i);
+    for (struct zsv_select_regex *r = data->regexes; r; r = r->next)
+      if (!r->col_name && zsv_regex_match(r->re, cell.str, cell.len))
+        return 1;
   }
   return 0;
 }
@@ -383,29 +564,8 @@ static int zsv_select_check_exclusions_are_indexes(struct zsv_select_data *data)
   return err;
 }
 
-// demo_random_bw_1_and_100(): this is a poor random number generator. you probably
-// will want to use a better one
-static double demo_random_bw_1_and_100() {
-#ifdef HAVE_ARC4RANDOM_UNIFORM
-  return (long double)(arc4random_uniform(1000000)) / 10000;
-#else
-  double max = 100.0;
-  unsigned int n;
-#ifdef HAVE_RAND_S
-  unsigned int tries = 0;
-  while (rand_s(&n) && tries++ < 10)
-    ;
-  return (double)n / ((double)UINT_MAX + 1) * max;
-#else
-  unsigned int umax = ~0;
-  n = rand();
-  return (double)n / ((double)(umax) + 1) * max;
-#endif
-#endif
-}
-
 // zsv_select_output_row(): output row data
-static void zsv_select_output_data_row(struct zsv_select_data *data, zsv_parser p) {
+static void zsv_select_output_data_row(struct zsv_select_data *data, const struct zsv_select_row *row) {
   unsigned int cnt = data->output_cols_count;
   char first = 1;
   if (data->prepend_line_number) {
@@ -416,14 +576,22 @@ static void zsv_select_output_data_row(struct zsv_select_data *data, zsv_parser
   /* print data row */
   for (unsigned int i = 0; i < cnt; i++) { // for each output column
     unsigned int in_ix = data->out2in[i].ix;
-    struct zsv_cell cell = zsv_get_cell(p, in_ix);
+    struct zsv_cell cell = zsv_select_get_cell(row, in_ix);
     if (UNLIKELY(data->any_clean != 0))
       cell.str = zsv_select_cell_clean(data, cell.str, cell.quoted, &cell.len);
+    if (UNLIKELY(data->out2in[i].capture != NULL)) {
+      struct zsv_regex_group groups[2];
+      if (zsv_regex_capture(data->out2in[i].capture, cell.str, cell.len, groups, 2) && groups[1].str) {
+        cell.str = (unsigned char *)groups[1].str;
+        cell.len = groups[1].len;
+      } else
+        cell.len = 0;
+    }
     if (VERY_UNLIKELY(data->distinct == ZSV_SELECT_DISTINCT_MERGE)) {
       if (UNLIKELY(cell.len == 0)) {
         for (struct zsv_select_uint_list *ix = data->out2in[i].merge.indexes; ix; ix = ix->next) {
           unsigned int m_ix = ix->value;
-          cell = zsv_get_cell(p, m_ix);
+          cell = zsv_select_get_cell(row, m_ix);
           if (cell.len) {
             if (UNLIKELY(data->any_clean != 0))
               cell.str = zsv_select_cell_clean(data, cell.str, cell.quoted, &cell.len);
@@ -438,10 +606,232 @@ static void zsv_select_output_data_row(struct zsv_select_data *data, zsv_parser
   }
 }
 
-static void zsv_select_data_row(struct zsv_select_data *data, zsv_parser p) {
-  data->data_row_count++;
+// zsv_select_skip_rows(): let the parser skip the next n rows, which are still
+// counted in data_row_count. Fixed-width rows are not skipped, but are passed over
+// as they are pulled
+static void zsv_select_skip_rows(struct zsv_select_data *data, size_t n) {
+  if (!data->fixed.count) {
+    zsv_skip_rows(data->parser, n);
+    data->skipped_rows = n;
+  }
+}
+
+// zsv_select_sample_gap(): get the number of rows after the given data row until
+// the next one that --sample-every or --sample-pct picks
+static size_t zsv_select_sample_gap(struct zsv_select_data *data, size_t row) {
+  size_t gap = SIZE_MAX / 2;
+  if (data->sample_every_n) // rows 1, n + 1, 2n + 1, ...
+    gap = row ? data->sample_every_n - 1 - (row - 1) % data->sample_every_n : 0;
+  if (data->sample_pct) {
+    size_t g = zsv_random_geometric(&data->sample.random, data->sample_pct / 100);
+    if (g < gap)
+      gap = g;
+  }
+  return gap;
+}
+
+// zsv_select_sample_pick(): check whether --sample-every or --sample-pct picks the
+// current row, and skip the rows after it that neither picks
+static char zsv_select_sample_pick(struct zsv_select_data *data) {
+  size_t row = data->data_row_count;
+  if (row > data->sample.next) // the first row, or one after a picked row that was blank
+    data->sample.next = row + zsv_select_sample_gap(data, row - 1);
+  if (row < data->sample.next) {
+    zsv_select_skip_rows(data, data->sample.next - row - 1);
+    return 0;
+  }
+  size_t gap = zsv_select_sample_gap(data, row);
+  data->sample.next = row + 1 + gap;
+  zsv_select_skip_rows(data, gap);
+  return 1;
+}
+
+static size_t zsv_select_render_write(const void *restrict s, size_t size, size_t nitems, void *restrict ctx) {
+  struct zsv_select_data *data = ctx;
+  size_t n = size * nitems;
+  if (data->rendered.used + n > data->rendered.size) {
+    size_t buff_size = (data->rendered.used + n) * 2;
+    unsigned char *buff = realloc(data->rendered.buff, buff_size);
+    if (!buff) {
+      data->rendered.error = 1;
+      return 0;
+    }
+    data->rendered.buff = buff;
+    data->rendered.size = buff_size;
+  }
+  memcpy(data->rendered.buff + data->rendered.used, s, n);
+  data->rendered.used += n;
+  return nitems;
+}
+
+// zsv_select_render_row(): write the given row, as it would be output but
+// without its row end, to data->rendered.buff; return err
+static int zsv_select_render_row(struct zsv_select_data *data, const struct zsv_select_row *row, char line_number,
+                                 const unsigned char **s, size_t *len) {
+  zsv_csv_writer out = data->csv_writer;
+  unsigned char prepend_line_number = data->prepend_line_number;
+  data->csv_writer = data->rendered.writer;
+  data->prepend_line_number = line_number && prepend_line_number;
+  data->rendered.used = 0;
+  zsv_select_output_data_row(data, row);
+  zsv_writer_flush(data->csv_writer);
+  data->csv_writer = out;
+  data->prepend_line_number = prepend_line_number;
+  *s = data->rendered.buff;
+  *len = data->rendered.used;
+  if (*len && **s == '\n') { // each row after the first that the writer writes starts with a row end
+    (*s)++;
+    (*len)--;
+  }
+  return data->rendered.error;
+}
 
-  if (UNLIKELY(zsv_cell_count(p) == 0 || data->cancelled))
+// zsv_select_render_init(): set up the writer of zsv_select_render_row(), if needed
+static enum zsv_status zsv_select_render_init(struct zsv_select_data *data) {
+  if (!data->sample.n && !data->dedupe.on)
+    return zsv_status_ok;
+  struct zsv_csv_writer_options writer_opts = {0};
+  writer_opts.write = zsv_select_render_write;
+  writer_opts.stream = data;
+  return (data->rendered.writer = zsv_writer_new(&writer_opts)) ? zsv_status_ok : zsv_status_memory;
+}
+
+// zsv_select_sample_keep(): offer the current row, which has passed any filter, to
+// the --sample-n sample and, if it is kept, store it as it would be output
+static void zsv_select_sample_keep(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  if (UNLIKELY(data->data_rows_limit > 0) && data->data_row_count >= data->data_rows_limit) {
+    data->cancelled = 1;
+    return;
+  }
+  char keep;
+  if (data->sample.by) {
+    struct zsv_select_where_ctx ctx = {data, row};
+    struct zsv_cell key = zsv_select_where_cell(&ctx, data->sample.by_ix);
+    keep = zsv_sample_offer(data->sample.rows, key.str ? key.str : (const unsigned char *)"", key.len);
+  } else {
+    keep = zsv_sample_offer(data->sample.rows, NULL, 0);
+    if (!data->where && !data->search_strings && !data->regexes && !data->fixed.count)
+      // every row is offered, so skip those passed over
+      zsv_select_skip_rows(data, zsv_sample_gap(data->sample.rows));
+  }
+  if (!keep)
+    return;
+
+  const unsigned char *s;
+  size_t len;
+  if (zsv_select_render_row(data, row, 1, &s, &len) ||
+      zsv_sample_keep(data->sample.rows, data->data_row_count, s, len) != zsv_status_ok) {
+    zsv_printerr(zsv_status_memory, "Out of memory!");
+    data->cancelled = 1;
+  }
+}
+
+// zsv_select_sample_init(): set up --sample-n
+static enum zsv_status zsv_select_sample_init(struct zsv_select_data *data) {
+  if (!data->sample.n)
+    return zsv_status_ok;
+  return zsv_sample_new(data->sample.n, data->sample.seed, &data->sample.rows);
+}
+
+static int zsv_select_sample_output_row(void *ctx, size_t row_number, const unsigned char *s, size_t len) {
+  struct zsv_select_data *data = ctx;
+  (void)(row_number);
+  zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, s, len);
+  return 0;
+}
+
+// zsv_select_dedupe_init(): set up --dedupe
+static enum zsv_status zsv_select_dedupe_init(struct zsv_select_data *data) {
+  if (!data->dedupe.on)
+    return zsv_status_ok;
+  if (!data->dedupe.opts.max_memory)
+    data->dedupe.opts.max_memory = ZSV_SELECT_DEDUPE_MEMORY_DEFAULT;
+  if (data->dedupe.key_count && !(data->dedupe.key_ix = calloc(data->dedupe.key_count, sizeof(*data->dedupe.key_ix))))
+    return zsv_status_memory;
+  return zsv_dedupe_new(&data->dedupe.opts, &data->dedupe.set);
+}
+
+// zsv_select_dedupe_key(): get the given row's --key values, each after its length; return err
+static int zsv_select_dedupe_key(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  struct zsv_select_where_ctx ctx = {data, row};
+  data->dedupe.key_used = 0;
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) {
+    struct zsv_cell cell = zsv_select_where_cell(&ctx, data->dedupe.key_ix[i]);
+    size_t n = data->dedupe.key_used + sizeof(cell.len) + cell.len;
+    if (n > data->dedupe.key_size) {
+      unsigned char *key = realloc(data->dedupe.key, n * 2);
+      if (!key)
+        return 1;
+      data->dedupe.key = key;
+      data->dedupe.key_size = n * 2;
+    }
+    memcpy(data->dedupe.key + data->dedupe.key_used, &cell.len, sizeof(cell.len));
+    if (cell.len)
+      memcpy(data->dedupe.key + data->dedupe.key_used + sizeof(cell.len), cell.str, cell.len);
+    data->dedupe.key_used = n;
+  }
+  return 0;
+}
+
+static int zsv_select_dedupe_output_row(void *ctx, size_t row_number, const unsigned char *s, size_t len) {
+  struct zsv_select_data *data = ctx;
+  if (data->prepend_line_number) {
+    zsv_writer_cell_zu(data->csv_writer, ZSV_WRITER_NEW_ROW, row_number);
+    if (data->output_cols_count)
+      zsv_writer_raw(data->csv_writer, ZSV_WRITER_SAME_ROW, (const unsigned char *)",", 1);
+    zsv_writer_raw(data->csv_writer, ZSV_WRITER_SAME_ROW, s, len);
+  } else
+    zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, s, len);
+  return 0;
+}
+
+// zsv_select_dedupe_row(): output the given row, which has passed any filter, unless
+// an earlier row had the same key: its --key values or, without --key, the row as output
+static void zsv_select_dedupe_row(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  const unsigned char *s = NULL, *key;
+  size_t len = 0, key_len;
+  if (data->dedupe.key_count) {
+    if (zsv_select_dedupe_key(data, row))
+      goto out_of_memory;
+    key = data->dedupe.key;
+    key_len = data->dedupe.key_used;
+  } else {
+    if (zsv_select_render_row(data, row, 0, &s, &len))
+      goto out_of_memory;
+    key = s;
+    key_len = len;
+  }
+
+  switch (zsv_dedupe_offer(data->dedupe.set, key, key_len)) {
+  case zsv_dedupe_duplicate:
+    break;
+  case zsv_dedupe_first:
+    if (s && !data->prepend_line_number)
+      zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, s, len);
+    else
+      zsv_select_output_data_row(data, row);
+    break;
+  case zsv_dedupe_deferred:
+    if (!s && zsv_select_render_row(data, row, 0, &s, &len))
+      goto out_of_memory;
+    if (zsv_dedupe_defer(data->dedupe.set, key, key_len, data->data_row_count, s, len) != zsv_status_ok) {
+      zsv_printerr(zsv_status_error, "Unable to write to a temporary file");
+      data->cancelled = 1;
+    }
+    break;
+  }
+  return;
+
+out_of_memory:
+  zsv_printerr(zsv_status_memory, "Out of memory!");
+  data->cancelled = 1;
+}
+
+static void zsv_select_data_row(struct zsv_select_data *data, const struct zsv_select_row *row) {
+  data->data_row_count += 1 + data->skipped_rows;
+  data->skipped_rows = 0;
+
+  if (UNLIKELY(row->count == 0 || data->cancelled))
     return;
 
   // check if we should skip this row
@@ -449,22 +839,22 @@ static void zsv_select_data_row(struct zsv_select_data *data, zsv_parser p) {
   if (UNLIKELY(data->skip_data_rows)) {
     data->skip_data_rows--;
     data->skip_this_row = 1;
-  } else if (UNLIKELY(data->sample_every_n || data->sample_pct)) {
-    data->skip_this_row = 1;
-    if (data->sample_every_n && data->data_row_count % data->sample_every_n == 1)
-      data->skip_this_row = 0;
-    if (data->sample_pct && demo_random_bw_1_and_100() <= data->sample_pct)
-      data->skip_this_row = 0;
-  }
+  } else if (UNLIKELY(data->sample_every_n || data->sample_pct))
+    data->skip_this_row = !zsv_select_sample_pick(data);
 
   if (LIKELY(!data->skip_this_row)) {
-    // if we have a search filter, check that
-    char skip = 0;
-    skip = !zsv_select_row_search_hit(data, p);
-    if (!skip) {
+    // if we have a --where, search or regex filter, check that
+    char skip = !zsv_select_row_where(data, row) || !zsv_select_row_search_hit(data, row) ||
+                !zsv_select_row_regex_hit(data, row);
+    if (!skip && UNLIKELY(data->sample.rows != NULL))
+      zsv_select_sample_keep(data, row);
+    else if (!skip) {
 
       // print the data row
-      zsv_select_output_data_row(data, p);
+      if (UNLIKELY(data->dedupe.set != NULL))
+        zsv_select_dedupe_row(data, row);
+      else
+        zsv_select_output_data_row(data, row);
       if (UNLIKELY(data->data_rows_limit > 0))
         if (data->data_row_count + 1 >= data->data_rows_limit)
           data->cancelled = 1;
@@ -487,8 +877,91 @@ static void zsv_select_print_header_row(struct zsv_select_data *data) {
   zsv_writer_cell_prepend(data->csv_writer, NULL);
 }
 
+// zsv_select_regex_bind(): find the column of each --regex-col, and let any that
+// has a group extract the output value of its column
+static int zsv_select_regex_bind(struct zsv_select_data *data) {
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) {
+    if (!r->col_name)
+      continue;
+    unsigned int ix = str_array_ifind((const unsigned char *)r->col_name, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", r->col_name);
+      return 1;
+    }
+    r->col = ix - 1;
+    if (zsv_regex_group_count(r->re))
+      for (unsigned int i = 0; i < data->output_cols_count; i++)
+        if (data->out2in[i].ix == r->col && !data->out2in[i].capture)
+          data->out2in[i].capture = r->re;
+  }
+  return 0;
+}
+
+// zsv_select_sample_bind(): find the --sample-by column
+static int zsv_select_sample_bind(struct zsv_select_data *data) {
+  if (data->sample.by) {
+    unsigned int ix = str_array_ifind((const unsigned char *)data->sample.by, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", data->sample.by);
+      return 1;
+    }
+    data->sample.by_ix = ix - 1;
+  }
+  return 0;
+}
+
+// zsv_select_dedupe_bind(): find the --key columns
+static int zsv_select_dedupe_bind(struct zsv_select_data *data) {
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) {
+    const char *name = data->dedupe.key_names[i];
+    unsigned int ix = str_array_ifind((const unsigned char *)name, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", name);
+      return 1;
+    }
+    data->dedupe.key_ix[i] = ix - 1;
+  }
+  return 0;
+}
+
+// zsv_select_regex_any(): check whether there is any --regex, which needs every cell
+static char zsv_select_regex_any(struct zsv_select_data *data) {
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next)
+    if (!r->col_name)
+      return 1;
+  return 0;
+}
+
+// zsv_select_max_input_column(): return 1 + the highest input column index to output or test
+static size_t zsv_select_max_input_column(struct zsv_select_data *data) {
+  size_t max = 0;
+  for (unsigned int i = 0; i < data->output_cols_count; i++) {
+    if (data->out2in[i].ix >= max)
+      max = data->out2in[i].ix + 1;
+    for (struct zsv_select_uint_list *ix = data->out2in[i].merge.indexes; ix; ix = ix->next)
+      if (ix->value >= max)
+        max = ix->value + 1;
+  }
+  size_t where_count = 0;
+  const size_t *where_cols = data->where ? zsv_where_columns(data->where, &where_count) : NULL;
+  for (size_t i = 0; i < where_count; i++) // columns that --where tests
+    if (where_cols[i] >= max)
+      max = where_cols[i] + 1;
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) // columns that --regex-col tests
+    if (r->col >= max)
+      max = r->col + 1;
+  if (data->sample.by && data->sample.by_ix >= max) // --sample-by column
+    max = data->sample.by_ix + 1;
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) // --key columns
+    if (data->dedupe.key_ix[i] >= max)
+      max = data->dedupe.key_ix[i] + 1;
+  return max;
+}
+
 static void zsv_select_header_finish(struct zsv_select_data *data) {
-  if (zsv_select_set_output_columns(data))
+  if (zsv_select_set_output_columns(data) || zsv_select_regex_bind(data) || zsv_select_sample_bind(data) ||
+      zsv_select_dedupe_bind(data) ||
+      (data->where && zsv_where_bind(data->where, data->header_names, data->header_name_count) != zsv_status_ok))
     data->cancelled = 1;
   else
     zsv_select_print_header_row(data);
@@ -537,19 +1010,56 @@ const char *zsv_select_usage_msg[] = {
   "",
   "Options:",
   "  -b,--with-bom                : output with BOM",
-// "  --fixed <offset1,offset2,offset3>: parse as fixed-width text; use given comma-separated list of positive integers
-// for cell end indexes",
+  "  --fixed <offset1,offset2,..> : parse as fixed-width text; use given CSV list of positive integers for",
+  "                                 cell and indexes. Requires --fixed-record-length",
+  "  --fixed-record-length <n>    : with --fixed, input is a sequence of n-byte records without row ends",
 #ifndef ZSV_CLI
   "  -v, --verbose                : verbose output",
 #endif
   "  -H,--head <n>                : (head) only process the first n rows of input data (including header)",
+  "  -D,--skip-data <n>           : skip the first n rows of input data",
+  "  --row-index                  : with -D and a file input, seek directly to the first row to output, using a",
+  "                                 row index that is cached in " ZSV_CACHE_DIR " (and built if it is missing or stale)",
   "  --no-header                  : do not output header row",
   "  --prepend-header <value>     : prepend each column header with the given text <value>",
   "  -s, --search <value>         : only output rows with at least one cell containing <value>",
-  // TO DO: " -s, --search /<pattern>/modifiers: search on regex pattern; modifiers include 'g' (global) and 'i'
-  // (case-insensitive)",
+  "                                 can be specified more than once, to search for any of several values",
+  "  --search-ignore-case         : with -s, ignore the case of ASCII letters",
+  "  --search-whole-cell          : with -s, only match cells whose entire value is a search value",
+  "  --where <expression>         : only output rows that satisfy the expression, for example:",
+  "                                 \"amount > 1000 AND region = 'EU'\". Conditions:",
+  "                                   <col> = | != | < | <= | > | >= <value>",
+  "                                   <col> [NOT] BETWEEN <value> AND <value>",
+  "                                   <col> [NOT] LIKE '<pattern>'    (% and _ wildcards; ignores ASCII case)",
+  "                                   <col> [NOT] IN (<value>, ...)",
+  "                                   <col> [NOT] REGEXP '<pattern>'  (regular expression, as for --regex)",
+  "                                   <col> IS [NOT] NULL             (empty)",
+  "                                 combined with AND, OR, NOT and parentheses. A value is a string in single quotes,",
+  "                                 or a number, which compares numerically and is false for a value that is not a",
+  "                                 number (including with !=, but not with NOT, which negates the outcome). Use double",
+  "                                 quotes around a column name that has spaces",
+  "  --regex <pattern>            : only output rows with at least one cell that matches the regular expression",
+  "                                 <pattern>; can be specified more than once, to match any of several patterns.",
+  "                                 Supports . [] [^] \\d \\w \\s ^ $ () (?:) | * + ? {n,m} and, at the start, (?i)",
+  "                                 to ignore the case of ASCII letters; matches without backtracking",
+  "  --regex-col <col>=<pattern>  : only output rows in which column <col> matches <pattern>. If <pattern> has a",
+  "                                 group, e.g. \"id=([0-9]+)\", output the part of <col> that the first group matches",
+  "                                 instead of its whole value. Can be specified more than once; all must match",
   "  --sample-every <num_of_rows> : output a sample consisting of the first row, then every nth row",
-  "  --sample-pct <percentage>    : output a randomly-selected sample (32 bits of randomness) of n%% of input rows",
+  "  --sample-pct <percentage>    : output a randomly-selected sample of n%% of input rows",
+  "  --sample-n <n>               : output a randomly-selected sample of exactly n rows (or all rows, if fewer)",
+  "                                 of those that pass any filter, in input order",
+  "  --sample-by <col>            : with --sample-n, output a sample of n rows for each distinct value of <col>",
+  "  --seed <n>                   : seed for --sample-pct and --sample-n, to take the same sample on each run",
+  "                                 Rows that a sample passes over are skipped without being parsed, where possible",
+  "  --dedupe                     : only output the first of any rows that are identical as output (after cleaning",
+  "                                 and column selection), or that have the same --key values",
+  "  --key <col>                  : with --dedupe, compare rows by the value of <col> (after cleaning) instead.",
+  "                                 Can be specified more than once, to compare rows by several columns",
+  "  --dedupe-memory <n>          : with --dedupe, maximum bytes of memory for the rows seen so far (default: 1GB),",
+  "                                 beyond which further rows are partitioned into temporary files to deduplicate",
+  "  --dedupe-bloom               : with --dedupe, once its memory is full, check new rows against a bloom filter",
+  "                                 first, which is faster when most rows are unique",
   "  -d,--header-row-span <n>     : apply header depth (rowspan) of n",
   "  --distinct                   : skip subsequent occurrences of columns with the same name",
   "  --merge                      : merge subsequent occurrences of columns with the same name",
@@ -592,6 +1102,17 @@ static void zsv_select_cleanup(struct zsv_select_data *data) {
 
   zsv_writer_delete(data->csv_writer);
   zsv_select_search_str_delete(data->search_strings);
+  zsv_search_delete(data->search);
+  free(data->search_cells);
+  zsv_where_delete(data->where);
+  zsv_select_regex_delete(data->regexes);
+  zsv_sample_delete(data->sample.rows);
+  zsv_dedupe_delete(data->dedupe.set);
+  free(data->dedupe.key_names);
+  free(data->dedupe.key_ix);
+  free(data->dedupe.key);
+  zsv_writer_delete(data->rendered.writer);
+  free(data->rendered.buff);
 
   if (data->distinct == ZSV_SELECT_DISTINCT_MERGE) {
     for (unsigned int i = 0; i < data->output_cols_count; i++) {
@@ -607,7 +1128,7 @@ static void zsv_select_cleanup(struct zsv_select_data *data) {
     free(data->header_names[i]);
   free(data->header_names);
 
-  // free(data->fixed.offsets);
+  free(data->fixed.offsets);
 }
 
 int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *opts,
@@ -631,35 +1152,44 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
     }
     if (!strcmp(argv[arg_i], "-b") || !strcmp(argv[arg_i], "--with-bom"))
       writer_opts.with_bom = 1;
-    /*
-    else if(!strcmp(argv[arg_i], "--fixed")) {
-      if(++arg_i >= argc)
-        stat = zsv_printerr(1, "%s option requires parameter", argv[arg_i-1]);
+    else if (!strcmp(argv[arg_i], "--fixed")) {
+      if (++arg_i >= argc)
+        stat = zsv_printerr(1, "%s option requires parameter", argv[arg_i - 1]);
       else { // parse offsets
         data.fixed.count = 1;
-        for(const char *s = argv[arg_i]; *s; s++)
-          if(*s == ',')
+        for (const char *s = argv[arg_i]; *s; s++)
+          if (*s == ',')
             data.fixed.count++;
         free(data.fixed.offsets);
-        data.fixed.offsets = malloc(data.fixed.count * sizeof(*data.fixed.offsets));
+        data.fixed.offsets = NULL; // unnecessary line to silence codeQL false positive
+        data.fixed.offsets = calloc(data.fixed.count, sizeof(*data.fixed.offsets));
+        if (!data.fixed.offsets) {
+          stat = zsv_printerr(1, "Out of memory!\n");
+          break;
+        }
         size_t count = 0;
         const char *start = argv[arg_i];
-        for(const char *end = argv[arg_i]; ; end++) {
-          if(*end == ',' || *end == '\0') {
-            if(!sscanf(start, "%zu,", &data.fixed.offsets[count++])) {
-              stat = zsv_printerr(1, "Invalid offset: %s.*\n", end - start, start);
+        for (const char *end = argv[arg_i];; end++) {
+          if (*end == ',' || *end == '\0') {
+            if (sscanf(start, "%zu,", &data.fixed.offsets[count++]) != 1) {
+              stat = zsv_printerr(1, "Invalid offset: %.*s\n", end - start, start);
               break;
-            } else if(*end == '\0')
+            } else if (*end == '\0')
               break;
             else {
               start = end + 1;
-              if(*start == '\0')
+              if (*start == '\0')
                 break;
             }
           }
         }
       }
-    } */
+    } else if (!strcmp(argv[arg_i], "--fixed-record-length")) {
+      if (++arg_i >= argc)
+        stat = zsv_printerr(1, "%s option requires parameter", argv[arg_i - 1]);
+      else if (sscanf(argv[arg_i], "%zu", &data.fixed.record_length) != 1 || !data.fixed.record_length)
+        stat = zsv_printerr(1, "Invalid record length: %s", argv[arg_i]);
+    }
     else if (!strcmp(argv[arg_i], "--distinct"))
       data.distinct = 1;
     else if (!strcmp(argv[arg_i], "--merge"))
@@ -683,6 +1213,22 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
         zsv_select_add_search(&data, argv[arg_i]);
       else
         stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+    } else if (!strcmp(argv[arg_i], "--where")) {
+      if (++arg_i >= argc)
+        stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+      else if (data.where)
+        stat = zsv_printerr(1, "--where may only be specified once; combine conditions with AND");
+      else if (zsv_where_new(argv[arg_i], &data.where) != zsv_status_ok)
+        stat = zsv_status_invalid_option;
+    } else if (!strcmp(argv[arg_i], "--search-ignore-case")) {
+      data.search_flags |= ZSV_SEARCH_ICASE;
+    } else if (!strcmp(argv[arg_i], "--search-whole-cell")) {
+      data.search_flags |= ZSV_SEARCH_WHOLE_CELL;
+    } else if (!strcmp(argv[arg_i], "--regex") || !strcmp(argv[arg_i], "--regex-col")) {
+      if (++arg_i >= argc || !*argv[arg_i])
+        stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+      else
+        stat = zsv_select_add_regex(&data, argv[arg_i], !strcmp(argv[arg_i - 1], "--regex-col"));
     } else if (!strcmp(argv[arg_i], "-v") || !strcmp(argv[arg_i], "--verbose")) {
       data.verbose = 1;
     } else if (!strcmp(argv[arg_i], "-w") || !strcmp(argv[arg_i], "--whitespace-clean"))
@@ -705,12 +1251,52 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       double d;
       if (!(arg_i < argc))
         stat = zsv_printerr(1, "--sample-pct option requires a value");
-      else if (!(d = atof(argv[arg_i])) && d > 0 && d < 100)
+      else if (!((d = atof(argv[arg_i])) > 0 && d <= 100))
         stat = zsv_printerr(
-          -1, "--sample-pct value should be a number between 0 and 100 (e.g. 1.5 for a sample of 1.5%% of the data");
+          -1, "--sample-pct value should be a number between 0 and 100 (e.g. 1.5 for a sample of 1.5%% of the data)");
       else
         data.sample_pct = d;
-    } else if (!strcmp(argv[arg_i], "--prepend-header"))
+    } else if (!strcmp(argv[arg_i], "--sample-n")) {
+      arg_i++;
+      if (!(arg_i < argc && atol(argv[arg_i]) > 0))
+        stat = zsv_printerr(1, "--sample-n value should be an integer > 0");
+      else
+        data.sample.n = (size_t)atol(argv[arg_i]);
+    } else if (!strcmp(argv[arg_i], "--sample-by")) {
+      arg_i++;
+      if (!(arg_i < argc))
+        stat = zsv_printerr(1, "--sample-by option requires a column name");
+      else
+        data.sample.by = argv[arg_i];
+    } else if (!strcmp(argv[arg_i], "--seed")) {
+      arg_i++;
+      char *end = NULL;
+      if (arg_i < argc)
+        data.sample.seed = strtoull(argv[arg_i], &end, 10);
+      if (!(arg_i < argc && *argv[arg_i] && *argv[arg_i] != '-' && end && !*end))
+        stat = zsv_printerr(1, "--seed value should be a non-negative integer");
+      else
+        data.sample.seeded = 1;
+    } else if (!strcmp(argv[arg_i], "--dedupe"))
+      data.dedupe.on = 1;
+    else if (!strcmp(argv[arg_i], "--key")) {
+      const char **key_names;
+      if (!(++arg_i < argc && *argv[arg_i]))
+        stat = zsv_printerr(1, "--key option requires a column name");
+      else if (!(key_names = realloc(data.dedupe.key_names, (data.dedupe.key_count + 1) * sizeof(*key_names))))
+        stat = zsv_printerr(zsv_status_memory, "Out of memory!");
+      else {
+        data.dedupe.key_names = key_names;
+        data.dedupe.key_names[data.dedupe.key_count++] = argv[arg_i];
+      }
+    } else if (!strcmp(argv[arg_i], "--dedupe-memory")) {
+      if (!(++arg_i < argc && atol(argv[arg_i]) > 0))
+        stat = zsv_printerr(1, "--dedupe-memory value should be an integer > 0");
+      else
+        data.dedupe.opts.max_memory = (size_t)atol(argv[arg_i]);
+    } else if (!strcmp(argv[arg_i], "--dedupe-bloom"))
+      data.dedupe.opts.bloom = 1;
+    else if (!strcmp(argv[arg_i], "--prepend-header"))
       data.prepend_header = zsv_next_arg(++arg_i, argc, argv, &err);
     else if (!strcmp(argv[arg_i], "--no-header"))
       data.no_header = 1;
@@ -720,7 +1306,9 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
                             arg_i + 1 < argc ? argv[arg_i + 1] : "");
       else
         data.data_rows_limit = atoi(argv[++arg_i]) + 1;
-    } else if (!strcmp(argv[arg_i], "-D") || !strcmp(argv[arg_i], "--skip-data")) {
+    } else if (!strcmp(argv[arg_i], "--row-index"))
+      data.use_row_index = 1;
+    else if (!strcmp(argv[arg_i], "-D") || !strcmp(argv[arg_i], "--skip-data")) {
       ++arg_i;
       if (!(arg_i < argc && atoi(argv[arg_i]) >= 0))
         stat = zsv_printerr(1, "%s option value invalid: should be positive integer", argv[arg_i - 1]);
@@ -752,12 +1340,25 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       input_path = argv[arg_i];
   }
 
-  if (data.sample_pct)
-    srand(time(0));
+  if (stat == zsv_status_ok && data.sample.n && (data.sample_every_n || data.sample_pct))
+    stat = zsv_printerr(1, "--sample-n cannot be used with --sample-every or --sample-pct");
+  else if (stat == zsv_status_ok && data.sample.by && !data.sample.n)
+    stat = zsv_printerr(1, "--sample-by requires --sample-n");
+  else if (stat == zsv_status_ok && data.dedupe.on && data.sample.n)
+    stat = zsv_printerr(1, "--dedupe cannot be used with --sample-n");
+  else if (stat == zsv_status_ok && (data.dedupe.key_count || data.dedupe.opts.max_memory || data.dedupe.opts.bloom) &&
+           !data.dedupe.on)
+    stat = zsv_printerr(1, "--key, --dedupe-memory and --dedupe-bloom require --dedupe");
+  if (!data.sample.seeded)
+    data.sample.seed = zsv_random_default_seed();
+  zsv_random_seed(&data.sample.random, data.sample.seed);
 
   if (data.use_header_indexes && stat == zsv_status_ok)
     stat = zsv_select_check_exclusions_are_indexes(&data);
 
+  if (stat == zsv_status_ok && !data.fixed.count != !data.fixed.record_length)
+    stat = zsv_printerr(1, "--fixed and --fixed-record-length must be specified together");
+
   if (!data.opts->stream) {
 #ifdef NO_STDIN
     stat = zsv_printerr(1, "Please specify an input file");
@@ -774,21 +1375,29 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       data.col_argc = argc - col_index_arg_i;
     }
 
+    // output cells can keep their escaped dbl-quotes as-is, unless they are searched or tested
+    data.opts->lazy_unescape = !data.search_strings && !data.where && !data.regexes;
     data.header_names = calloc(data.opts->max_columns, sizeof(*data.header_names));
     assert(data.opts->max_columns > 0);
     data.out2in = calloc(data.opts->max_columns, sizeof(*data.out2in));
     data.csv_writer = zsv_writer_new(&writer_opts);
-    if (!(data.header_names && data.csv_writer))
+    if (!(data.header_names && data.csv_writer) || zsv_select_search_init(&data) != zsv_status_ok ||
+        zsv_select_sample_init(&data) != zsv_status_ok || zsv_select_dedupe_init(&data) != zsv_status_ok ||
+        zsv_select_render_init(&data) != zsv_status_ok)
       stat = zsv_status_memory;
     else {
       zsv_parser parser;
+      data.opts->mmap = 1;
       if (zsv_new_with_properties(data.opts, custom_prop_handler, input_path, opts_used, &parser) == zsv_status_ok) {
+        data.parser = parser;
         // all done with
         data.any_clean = !data.no_trim_whitespace || data.clean_white || data.embedded_lineend;
 
-        // TO DO: support fixed input
-        // if (data.fixed.count && zsv_set_fixed_offsets(parser, data.fixed.count, data.fixed.offsets) != zsv_status_ok)
-        //   data.cancelled = 1;
+        // fixed-width input is pulled a buffer of records at a time
+        if (data.fixed.count &&
+            (zsv_set_fixed_offsets(parser, data.fixed.count, data.fixed.offsets) != zsv_status_ok ||
+             zsv_set_fixed_record_length(parser, data.fixed.record_length) != zsv_status_ok))
+          data.cancelled = 1;
 
         // create a local csv writer buff quoted values
         unsigned char writer_buff[512];
@@ -796,12 +1405,65 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
 
         // process the input data
         zsv_handle_ctrl_c_signal();
-        enum zsv_status status = zsv_next_row(parser);
+        struct zsv_row_batch batch = {0};
+        batch.max_rows = 1;
+        enum zsv_status status = data.cancelled ? zsv_status_cancelled : zsv_next_batch(parser, &batch); // header row
         if (status == zsv_status_row)
           zsv_select_header_row(&data, parser);
-        while ((status = zsv_next_row(parser)) == zsv_status_row)
-          zsv_select_data_row(&data, parser);
+
+        // jump to the first row to output, instead of parsing the skipped rows
+        struct zsv_row_index *row_index = NULL;
+        if (data.use_row_index && data.skip_data_rows && !data.cancelled) {
+          if (!input_path || data.fixed.count)
+            fprintf(stderr, "Warning: --row-index requires a file input that is not fixed-width; ignoring\n");
+          else if (zsv_cache_row_index(input_path, data.opts, parser, &row_index) != zsv_status_ok ||
+                   zsv_seek_row(parser, data.skip_data_rows) != zsv_status_ok)
+            fprintf(stderr, "Warning: unable to use a row index for %s; skipping rows instead\n", input_path);
+          else {
+            data.data_row_count = data.skip_data_rows;
+            data.skip_data_rows = 0;
+          }
+        }
+
+        struct zsv_select_row row = {0};
+        row.parser = parser;
+        if (data.search_strings || zsv_select_regex_any(&data) || data.sample_every_n || data.sample_pct ||
+            data.sample.n) { // search all cells of each row, or skip rows that are not sampled
+          while (!data.cancelled && (status = zsv_next_row(parser)) == zsv_status_row) {
+            row.count = zsv_cell_count(parser);
+            zsv_select_data_row(&data, &row);
+          }
+        } else { // fetch only the output columns, many rows at a time
+          batch.max_columns = zsv_select_max_input_column(&data);
+          batch.max_rows = 256;
+          if (batch.max_columns > 256) // limit the batch to 64k cells
+            batch.max_rows = 65536 / batch.max_columns;
+          batch.cells = calloc(batch.max_rows * batch.max_columns + 1, sizeof(*batch.cells));
+          batch.cell_counts = calloc(batch.max_rows, sizeof(*batch.cell_counts));
+          if (!(batch.cells && batch.cell_counts))
+            stat = zsv_status_memory;
+          else {
+            row.width = batch.max_columns;
+            while (!data.cancelled && (status = zsv_next_batch(parser, &batch)) == zsv_status_row) {
+              for (size_t r = 0; r < batch.rows; r++) {
+                row.cells = batch.cells + r * batch.max_columns;
+                row.count = batch.cell_counts[r];
+                zsv_select_data_row(&data, &row);
+              }
+            }
+          }
+          free(batch.cells);
+          free(batch.cell_counts);
+        }
+        if (status == zsv_status_error) // e.g. truncated compressed input, which has been reported
+          stat = status;
+        if (data.sample.rows)
+          zsv_sample_rows(data.sample.rows, zsv_select_sample_output_row, &data);
+        if (data.dedupe.set && !data.cancelled &&
+            zsv_dedupe_rows(data.dedupe.set, zsv_select_dedupe_output_row, &data) != zsv_status_ok)
+          stat = zsv_printerr(zsv_status_error, "Unable to deduplicate the rows in temporary files");
         zsv_delete(parser);
+        zsv_row_index_delete(row_index);
       }
     }
   }
@@ -7,9 +7,6 @@
 
 #include <stdio.h>
 #include <assert.h>
-#ifdef _WIN32
-#define _CRT_RAND_S /* for random number generator, used when sampling. must come before including stdlib.h */
-#endif
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -25,6 +22,16 @@
 #include <zsv/utils/string.h>
 #include <zsv/utils/mem.h>
 #include <zsv/utils/arg.h>
+#include <zsv/utils/cache.h>
+#include <zsv/utils/decompress.h>
+#include <zsv/utils/dedupe.h>
+#include <zsv/utils/random.h>
+#include <zsv/utils/regex.h>
+#include <zsv/utils/sample.h>
+#include <zsv/utils/search.h>
+#include <zsv/utils/where.h>
+
+#define ZSV_SELECT_DEDUPE_MEMORY_DEFAULT ((size_t)1024 * 1024 * 1024)
 
 struct zsv_select_search_str {
   struct zsv_select_search_str *next;
@@ -39,6 +46,22 @@ static void zsv_select_search_str_delete(struct zsv_select_search_str *ss) {
   }
 }
 
+struct zsv_select_regex {
+  struct zsv_select_regex *next;
+  char *col_name;   // --regex-col; NULL for --regex, which any cell may match
+  unsigned int col; // index of col_name, once the header is read
+  struct zsv_regex *re;
+};
+
+static void zsv_select_regex_delete(struct zsv_select_regex *r) {
+  for (struct zsv_select_regex *next; r; r = next) {
+    next = r->next;
+    free(r->col_name);
+    zsv_regex_delete(r->re);
+    free(r);
+  }
+}
+
 struct zsv_select_uint_list {
   struct zsv_select_uint_list *next;
   unsigned int value;
@@ -47,6 +70,7 @@ struct zsv_select_uint_list {
 struct fixed {
   size_t *offsets;
   size_t count;
+  size_t record_length;
 };
 
 struct zsv_select_data {
@@ -66,8 +90,9 @@ struct zsv_select_data {
   char *cols_to_print; // better: bitfield
 
   struct {
-    unsigned int ix; // index of the input column to be output
-    struct {         // merge data: only used with --merge
+    unsigned int ix;           // index of the input column to be output
+    struct zsv_regex *capture; // --regex-col with a group: output the first group instead of the value
+    struct {                   // merge data: only used with --merge
       struct zsv_select_uint_list *indexes, **last_index;
     } merge;
   } *out2in; // array of .output_cols_count length; out2in[x] = y where x = output ix, y = input info
@@ -91,10 +116,51 @@ struct zsv_select_data {
 
   unsigned sample_every_n;
 
+  struct {
+    struct zsv_random random; // --sample-pct
+    uint64_t seed;            // --seed
+    size_t next;              // --sample-every and --sample-pct: number of the next data row to output
+    size_t n;                 // --sample-n
+    const char *by;           // --sample-by
+    unsigned int by_ix;       // index of the --sample-by column
+    struct zsv_sample *rows;  // --sample-n: rows kept so far, as they are output
+    unsigned char seeded : 1;
+    unsigned char _ : 7;
+  } sample;
+
+  struct {
+    struct zsv_dedupe *set;      // --dedupe
+    struct zsv_dedupe_opts opts; // --dedupe-memory and --dedupe-bloom
+    const char **key_names;      // --key, in the order given
+    unsigned int *key_ix;        // index of each --key column
+    unsigned int key_count;
+    unsigned char *key; // the current row's --key values, each after its length
+    size_t key_used;
+    size_t key_size;
+    unsigned char on : 1; // --dedupe
+    unsigned char _ : 7;
+  } dedupe;
+
+  struct { // the current row, as it would be output, for --sample-n and --dedupe (see zsv_select_render_row())
+    zsv_csv_writer writer;
+    unsigned char *buff;
+    size_t used;
+    size_t size;
+    char error; // out of memory
+  } rendered;
+
   size_t data_rows_limit;
   size_t skip_data_rows;
+  size_t skipped_rows; // rows after the current one that the parser skips (see zsv_select_skip_rows())
 
   struct zsv_select_search_str *search_strings;
+  unsigned search_flags;         // ZSV_SEARCH_XXX
+  struct zsv_search *search;     // search_strings, compiled
+  struct zsv_cell *search_cells; // the current row's cells, for zsv_search_cells()
+
+  struct zsv_where *where; // --where
+
+  struct zsv_select_regex *regexes; // --regex and --regex-col, in the order given
 
   zsv_csv_writer csv_writer;
 
@@ -118,8 +184,9 @@ struct zsv_select_data {
   unsigned char distinct : 2; // 1 = ignore subsequent cols, ZSV_SELECT_DISTINCT_MERGE = merge subsequent cols (first
                               // non-null value)
   unsigned char unescape : 1;
-  unsigned char no_header : 1; // --no-header
-  unsigned char _ : 3;
+  unsigned char no_header : 1;     // --no-header
+  unsigned char use_row_index : 1; // --row-index
+  unsigned char _ : 2;
 };
 
 enum zsv_select_column_index_selection_type {
@@ -286,6 +353,32 @@ static void zsv_select_add_search(struct zsv_select_data *data, const char *valu
   data->search_strings = ss;
 }
 
+// zsv_select_add_regex(): add a --regex <pattern> or, if col is set, a --regex-col <col>=<pattern>
+static enum zsv_status zsv_select_add_regex(struct zsv_select_data *data, const char *arg, char col) {
+  const char *pattern = arg;
+  if (col) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq == arg)
+      return zsv_printerr(1, "--regex-col requires a value of the form <column>=<pattern>: %s", arg);
+    pattern = eq + 1;
+  }
+  struct zsv_select_regex *r = calloc(1, sizeof(*r));
+  if (!r || (col && !(r->col_name = zsv_memdup((const unsigned char *)arg, (size_t)(pattern - 1 - arg))))) {
+    zsv_select_regex_delete(r);
+    return zsv_printerr(1, "Out of memory!\n");
+  }
+  enum zsv_status stat = zsv_regex_new(pattern, 0, &r->re);
+  if (stat != zsv_status_ok) {
+    zsv_select_regex_delete(r);
+    return stat;
+  }
+  struct zsv_select_regex **last = &data->regexes;
+  while (*last)
+    last = &(*last)->next;
+  *last = r;
+  return zsv_status_ok;
+}
+
 #ifndef NDEBUG
 __attribute__((always_inline)) static inline
 #endif
@@ -332,20 +425,79 @@ __attribute__((always_inline)) static inline
   return utf8_value;
 }
 
-static inline char zsv_select_row_search_hit(struct zsv_select_data *data) {
+static enum zsv_status zsv_select_search_init(struct zsv_select_data *data) {
   if (!data->search_strings)
+    return zsv_status_ok;
+  if (!(data->search = zsv_search_new(data->search_flags)) ||
+      !(data->search_cells = calloc(data->opts->max_columns, sizeof(*data->search_cells))))
+    return zsv_status_memory;
+  for (struct zsv_select_search_str *ss = data->search_strings; ss; ss = ss->next) {
+    enum zsv_status stat = zsv_search_add(data->search, (const unsigned char *)ss->value, ss->len);
+    if (stat != zsv_status_ok)
+      return stat;
+  }
+  return zsv_search_compile(data->search);
+}
+
+static inline char zsv_select_row_search_hit(struct zsv_select_data *data) {
+  if (!data->search)
     return 1;
 
   unsigned int j = zsv_cell_count(data->parser);
-  for (unsigned int i = 0; i < j; i++) {
-    struct zsv_cell cell = zsv_get_cell(data->parser, i);
-    if (UNLIKELY(data->any_clean != 0))
+  if (UNLIKELY(data->unescape || data->clean_white || data->embedded_lineend)) {
+    // these modify the value, so clean and search one cell at a time
+    for (unsigned int i = 0; i < j; i++) {
+      struct zsv_cell cell = zsv_get_cell(data->parser, i);
       cell.str = zsv_select_cell_clean(data, cell.str, &cell.quoted, &cell.len);
-    if (cell.len) {
-      for (struct zsv_select_search_str *ss = data->search_strings; ss; ss = ss->next)
-        if (ss->value && *ss->value && memmem(cell.str, cell.len, ss->value, ss->len))
-          return 1;
+      if (zsv_search_cell(data->search, cell.str, cell.len))
+        return 1;
     }
+    return 0;
+  }
+
+  // search the whole row in one pass; trimming only narrows each cell
+  if (j > data->opts->max_columns)
+    j = data->opts->max_columns;
+  for (unsigned int i = 0; i < j; i++) {
+    struct zsv_cell cell = zsv_get_cell(data->parser, i);
+    if (!data->no_trim_whitespace)
+      cell.str = (unsigned char *)zsv_strtrim(cell.str, &cell.len);
+    data->search_cells[i] = cell;
+  }
+  return zsv_search_cells(data->search, data->search_cells, j, NULL);
+}
+
+// zsv_select_where_cell(): fetch a cell for zsv_where_eval() or --regex, cleaned as it will be output
+static struct zsv_cell zsv_select_where_cell(void *ctx, size_t ix) {
+  struct zsv_select_data *data = ctx;
+  struct zsv_cell cell = zsv_get_cell(data->parser, ix);
+  if (UNLIKELY(data->any_clean != 0))
+    cell.str = zsv_select_cell_clean(data, cell.str, &cell.quoted, &cell.len);
+  return cell;
+}
+
+// zsv_select_row_regex_hit(): check that every --regex-col matches its column and,
+// if there is any --regex, that any cell matches one
+static inline char zsv_select_row_regex_hit(struct zsv_select_data *data) {
+  if (!data->regexes)
+    return 1;
+  char any = 0;
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) {
+    if (r->col_name) {
+      struct zsv_cell cell = zsv_select_where_cell(data, r->col);
+      if (!zsv_regex_match(r->re, cell.str, cell.len))
+        return 0;
+    } else
+      any = 1;
+  }
+  if (!any)
+    return 1;
+  unsigned int j = zsv_cell_count(data->parser);
+  for (unsigned int i = 0; i < j; i++) {
+    struct zsv_cell cell = zsv_select_where_cell(data, i);
+    for (struct zsv_select_regex *r = data->regexes; r; r = r->next)
+      if (!r->col_name && zsv_regex_match(r->re, cell.str, cell.len))
+        return 1;
   }
   return 0;
 }
@@ -394,27 +546,6 @@ static int zsv_select_check_exclusions_are_indexes(struct zsv_select_data *data)
   return err;
 }
 
-// demo_random_bw_1_and_100(): this is a poor random number generator. you probably
-// will want to use a better one
-static double demo_random_bw_1_and_100() {
-#ifdef HAVE_ARC4RANDOM_UNIFORM
-  return (long double)(arc4random_uniform(1000000)) / 10000;
-#else
-  double max = 100.0;
-  unsigned int n;
-#ifdef HAVE_RAND_S
-  unsigned int tries = 0;
-  while (rand_s(&n) && tries++ < 10)
-    ;
-  return (double)n / ((double)UINT_MAX + 1) * max;
-#else
-  unsigned int umax = ~0;
-  n = rand();
-  return (double)n / ((double)(umax) + 1) * max;
-#endif
-#endif
-}
-
 // zsv_select_output_row(): output row data
 static void zsv_select_output_data_row(struct zsv_select_data *data) {
   unsigned int cnt = data->output_cols_count;
@@ -430,6 +561,14 @@ static void zsv_select_output_data_row(struct zsv_select_data *data) {
     struct zsv_cell cell = zsv_get_cell(data->parser, in_ix);
     if (UNLIKELY(data->any_clean != 0))
       cell.str = zsv_select_cell_clean(data, cell.str, &cell.quoted, &cell.len);
+    if (UNLIKELY(data->out2in[i].capture != NULL)) {
+      struct zsv_regex_group groups[2];
+      if (zsv_regex_capture(data->out2in[i].capture, cell.str, cell.len, groups, 2) && groups[1].str) {
+        cell.str = (unsigned char *)groups[1].str;
+        cell.len = groups[1].len;
+      } else
+        cell.len = 0;
+    }
     if (VERY_UNLIKELY(data->distinct == ZSV_SELECT_DISTINCT_MERGE)) {
       if (UNLIKELY(cell.len == 0)) {
         for (struct zsv_select_uint_list *ix = data->out2in[i].merge.indexes; ix; ix = ix->next) {
@@ -449,9 +588,225 @@ static void zsv_select_output_data_row(struct zsv_select_data *data) {
   }
 }
 
+// zsv_select_skip_rows(): let the parser skip the next n rows, which are still
+// counted in data_row_count
+static void zsv_select_skip_rows(struct zsv_select_data *data, size_t n) {
+  zsv_skip_rows(data->parser, n);
+  data->skipped_rows = n;
+}
+
+// zsv_select_sample_gap(): get the number of rows after the given data row until
+// the next one that --sample-every or --sample-pct picks
+static size_t zsv_select_sample_gap(struct zsv_select_data *data, size_t row) {
+  size_t gap = SIZE_MAX / 2;
+  if (data->sample_every_n) // rows 1, n + 1, 2n + 1, ...
+    gap = row ? data->sample_every_n - 1 - (row - 1) % data->sample_every_n : 0;
+  if (data->sample_pct) {
+    size_t g = zsv_random_geometric(&data->sample.random, data->sample_pct / 100);
+    if (g < gap)
+      gap = g;
+  }
+  return gap;
+}
+
+// zsv_select_sample_pick(): check whether --sample-every or --sample-pct picks the
+// current row, and skip the rows after it that neither picks
+static char zsv_select_sample_pick(struct zsv_select_data *data) {
+  size_t row = data->data_row_count;
+  if (row > data->sample.next) // the first row, or one after a picked row that was blank
+    data->sample.next = row + zsv_select_sample_gap(data, row - 1);
+  if (row < data->sample.next) {
+    zsv_select_skip_rows(data, data->sample.next - row - 1);
+    return 0;
+  }
+  size_t gap = zsv_select_sample_gap(data, row);
+  data->sample.next = row + 1 + gap;
+  zsv_select_skip_rows(data, gap);
+  return 1;
+}
+
+static size_t zsv_select_render_write(const void *restrict s, size_t size, size_t nitems, void *restrict ctx) {
+  struct zsv_select_data *data = ctx;
+  size_t n = size * nitems;
+  if (data->rendered.used + n > data->rendered.size) {
+    size_t buff_size = (data->rendered.used + n) * 2;
+    unsigned char *buff = realloc(data->rendered.buff, buff_size);
+    if (!buff) {
+      data->rendered.error = 1;
+      return 0;
+    }
+    data->rendered.buff = buff;
+    data->rendered.size = buff_size;
+  }
+  memcpy(data->rendered.buff + data->rendered.used, s, n);
+  data->rendered.used += n;
+  return nitems;
+}
+
+// zsv_select_render_row(): write the current row, as it would be output but
+// without its row end, to data->rendered.buff; return err
+static int zsv_select_render_row(struct zsv_select_data *data, char line_number, const unsigned char **s,
+                                 size_t *len) {
+  zsv_csv_writer out = data->csv_writer;
+  unsigned char prepend_line_number = data->prepend_line_number;
+  data->csv_writer = data->rendered.writer;
+  data->prepend_line_number = line_number && prepend_line_number;
+  data->rendered.used = 0;
+  zsv_select_output_data_row(data);
+  zsv_writer_flush(data->csv_writer);
+  data->csv_writer = out;
+  data->prepend_line_number = prepend_line_number;
+  *s = data->rendered.buff;
+  *len = data->rendered.used;
+  if (*len && **s == '\n') { // each row after the first that the writer writes starts with a row end
+    (*s)++;
+    (*len)--;
+  }
+  return data->rendered.error;
+}
+
+// zsv_select_render_init(): set up the writer of zsv_select_render_row(), if needed
+static enum zsv_status zsv_select_render_init(struct zsv_select_data *data) {
+  if (!data->sample.n && !data->dedupe.on)
+    return zsv_status_ok;
+  struct zsv_csv_writer_options writer_opts = {0};
+  writer_opts.write = zsv_select_render_write;
+  writer_opts.stream = data;
+  return (data->rendered.writer = zsv_writer_new(&writer_opts)) ? zsv_status_ok : zsv_status_memory;
+}
+
+// zsv_select_sample_keep(): offer the current row, which has passed any filter, to
+// the --sample-n sample and, if it is kept, store it as it would be output
+static void zsv_select_sample_keep(struct zsv_select_data *data) {
+  if (UNLIKELY(data->data_rows_limit > 0) && data->data_row_count >= data->data_rows_limit) {
+    data->cancelled = 1;
+    return;
+  }
+  char keep;
+  if (data->sample.by) {
+    struct zsv_cell key = zsv_select_where_cell(data, data->sample.by_ix);
+    keep = zsv_sample_offer(data->sample.rows, key.str ? key.str : (const unsigned char *)"", key.len);
+  } else {
+    keep = zsv_sample_offer(data->sample.rows, NULL, 0);
+    if (!data->where && !data->search_strings && !data->regexes) // every row is offered, so skip those passed over
+      zsv_select_skip_rows(data, zsv_sample_gap(data->sample.rows));
+  }
+  if (!keep)
+    return;
+
+  const unsigned char *s;
+  size_t len;
+  if (zsv_select_render_row(data, 1, &s, &len) ||
+      zsv_sample_keep(data->sample.rows, data->data_row_count, s, len) != zsv_status_ok) {
+    zsv_printerr(zsv_status_memory, "Out of memory!");
+    data->cancelled = 1;
+  }
+}
+
+// zsv_select_sample_init(): set up --sample-n
+static enum zsv_status zsv_select_sample_init(struct zsv_select_data *data) {
+  if (!data->sample.n)
+    return zsv_status_ok;
+  return zsv_sample_new(data->sample.n, data->sample.seed, &data->sample.rows);
+}
+
+static int zsv_select_sample_output_row(void *ctx, size_t row_number, const unsigned char *s, size_t len) {
+  struct zsv_select_data *data = ctx;
+  (void)(row_number);
+  zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, s, len);
+  return 0;
+}
+
+// zsv_select_dedupe_init(): set up --dedupe
+static enum zsv_status zsv_select_dedupe_init(struct zsv_select_data *data) {
+  if (!data->dedupe.on)
+    return zsv_status_ok;
+  if (!data->dedupe.opts.max_memory)
+    data->dedupe.opts.max_memory = ZSV_SELECT_DEDUPE_MEMORY_DEFAULT;
+  if (data->dedupe.key_count && !(data->dedupe.key_ix = calloc(data->dedupe.key_count, sizeof(*data->dedupe.key_ix))))
+    return zsv_status_memory;
+  return zsv_dedupe_new(&data->dedupe.opts, &data->dedupe.set);
+}
+
+// zsv_select_dedupe_key(): get the current row's --key values, each after its length; return err
+static int zsv_select_dedupe_key(struct zsv_select_data *data) {
+  data->dedupe.key_used = 0;
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) {
+    struct zsv_cell cell = zsv_select_where_cell(data, data->dedupe.key_ix[i]);
+    size_t n = data->dedupe.key_used + sizeof(cell.len) + cell.len;
+    if (n > data->dedupe.key_size) {
+      unsigned char *key = realloc(data->dedupe.key, n * 2);
+      if (!key)
+        return 1;
+      data->dedupe.key = key;
+      data->dedupe.key_size = n * 2;
+    }
+    memcpy(data->dedupe.key + data->dedupe.key_used, &cell.len, sizeof(cell.len));
+    if (cell.len)
+      memcpy(data->dedupe.key + data->dedupe.key_used + sizeof(cell.len), cell.str, cell.len);
+    data->dedupe.key_used = n;
+  }
+  return 0;
+}
+
+static int zsv_select_dedupe_output_row(void *ctx, size_t row_number, const unsigned char *s, size_t len) {
+  struct zsv_select_data *data = ctx;
+  if (data->prepend_line_number) {
+    zsv_writer_cell_zu(data->csv_writer, ZSV_WRITER_NEW_ROW, row_number);
+    if (data->output_cols_count)
+      zsv_writer_raw(data->csv_writer, ZSV_WRITER_SAME_ROW, (const unsigned char *)",", 1);
+    zsv_writer_raw(data->csv_writer, ZSV_WRITER_SAME_ROW, s, len);
+  } else
+    zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, s, len);
+  return 0;
+}
+
+// zsv_select_dedupe_row(): output the current row, which has passed any filter, unless
+// an earlier row had the same key: its --key values or, without --key, the row as output
+static void zsv_select_dedupe_row(struct zsv_select_data *data) {
+  const unsigned char *row = NULL, *key;
+  size_t len = 0, key_len;
+  if (data->dedupe.key_count) {
+    if (zsv_select_dedupe_key(data))
+      goto out_of_memory;
+    key = data->dedupe.key;
+    key_len = data->dedupe.key_used;
+  } else {
+    if (zsv_select_render_row(data, 0, &row, &len))
+      goto out_of_memory;
+    key = row;
+    key_len = len;
+  }
+
+  switch (zsv_dedupe_offer(data->dedupe.set, key, key_len)) {
+  case zsv_dedupe_duplicate:
+    break;
+  case zsv_dedupe_first:
+    if (row && !data->prepend_line_number)
+      zsv_writer_raw(data->csv_writer, ZSV_WRITER_NEW_ROW, row, len);
+    else
+      zsv_select_output_data_row(data);
+    break;
+  case zsv_dedupe_deferred:
+    if (!row && zsv_select_render_row(data, 0, &row, &len))
+      goto out_of_memory;
+    if (zsv_dedupe_defer(data->dedupe.set, key, key_len, data->data_row_count, row, len) != zsv_status_ok) {
+      zsv_printerr(zsv_status_error, "Unable to write to a temporary file");
+      data->cancelled = 1;
+    }
+    break;
+  }
+  return;
+
+out_of_memory:
+  zsv_printerr(zsv_status_memory, "Out of memory!");
+  data->cancelled = 1;
+}
+
 static void zsv_select_data_row(void *ctx) {
   struct zsv_select_data *data = ctx;
-  data->data_row_count++;
+  data->data_row_count += 1 + data->skipped_rows;
+  data->skipped_rows = 0;
 
   if (UNLIKELY(zsv_cell_count(data->parser) == 0 || data->cancelled))
     return;
@@ -461,22 +816,22 @@ static void zsv_select_data_row(void *ctx) {
   if (UNLIKELY(data->skip_data_rows)) {
     data->skip_data_rows--;
     data->skip_this_row = 1;
-  } else if (UNLIKELY(data->sample_every_n || data->sample_pct)) {
-    data->skip_this_row = 1;
-    if (data->sample_every_n && data->data_row_count % data->sample_every_n == 1)
-      data->skip_this_row = 0;
-    if (data->sample_pct && demo_random_bw_1_and_100() <= data->sample_pct)
-      data->skip_this_row = 0;
-  }
+  } else if (UNLIKELY(data->sample_every_n || data->sample_pct))
+    data->skip_this_row = !zsv_select_sample_pick(data);
 
   if (LIKELY(!data->skip_this_row)) {
-    // if we have a search filter, check that
-    char skip = 0;
-    skip = !zsv_select_row_search_hit(data);
-    if (!skip) {
+    // if we have a --where, search or regex filter, check that
+    char skip = (data->where && !zsv_where_eval(data->where, zsv_select_where_cell, data)) ||
+                !zsv_select_row_search_hit(data) || !zsv_select_row_regex_hit(data);
+    if (!skip && UNLIKELY(data->sample.rows != NULL))
+      zsv_select_sample_keep(data);
+    else if (!skip) {
 
       // print the data row
-      zsv_select_output_data_row(data);
+      if (UNLIKELY(data->dedupe.set != NULL))
+        zsv_select_dedupe_row(data);
+      else
+        zsv_select_output_data_row(data);
       if (UNLIKELY(data->data_rows_limit > 0))
         if (data->data_row_count + 1 >= data->data_rows_limit)
           data->cancelled = 1;
@@ -486,6 +841,76 @@ static void zsv_select_data_row(void *ctx) {
     fprintf(stderr, "Processed %zu rows\n", data->data_row_count);
 }
 
+static void zsv_select_header_row(void *ctx);
+static void zsv_select_set_column_filter(struct zsv_select_data *data, zsv_parser parser);
+
+struct zsv_select_chunk {
+  struct zsv_select_data data; // must be first
+  FILE *tmp;
+  unsigned char writer_buff[512];
+};
+
+static int zsv_select_parallel_header(void *ctx, zsv_parser parser) {
+  struct zsv_select_data *data = ctx;
+  data->parser = parser;
+  zsv_select_header_row(data);
+  return data->cancelled;
+}
+
+static void *zsv_select_parallel_chunk_start(void *ctx, zsv_parser parser, size_t chunk_ix) {
+  (void)(chunk_ix);
+  struct zsv_select_data *data = ctx;
+  struct zsv_select_chunk *chunk = calloc(1, sizeof(*chunk));
+  if (chunk) {
+    // each chunk writes its output to a temp file, which is copied to our output when the chunk ends
+    struct zsv_csv_writer_options writer_opts = {0};
+    chunk->data = *data;
+    chunk->data.parser = parser;
+    chunk->data.data_row_count = 0;
+    chunk->data.csv_writer = NULL;
+    chunk->data.search_cells = NULL;
+    if ((!data->search ||
+         (chunk->data.search_cells = calloc(data->opts->max_columns, sizeof(*chunk->data.search_cells)))) &&
+        (writer_opts.stream = chunk->tmp = tmpfile()) && (chunk->data.csv_writer = zsv_writer_new(&writer_opts)))
+      zsv_writer_set_temp_buff(chunk->data.csv_writer, chunk->writer_buff, sizeof(chunk->writer_buff));
+  }
+  if (!(chunk && chunk->data.csv_writer)) {
+    zsv_printerr(1, "Unable to create temporary output");
+    zsv_abort(parser);
+  }
+  zsv_select_set_column_filter(data, parser);
+  zsv_set_row_handler(parser, zsv_select_data_row);
+  return chunk;
+}
+
+static enum zsv_status zsv_select_parallel_chunk_end(void *ctx, void *chunk_ctx, size_t chunk_ix,
+                                                     enum zsv_status stat) {
+  (void)(chunk_ix);
+  struct zsv_select_data *data = ctx;
+  struct zsv_select_chunk *chunk = chunk_ctx;
+  if (!chunk)
+    return zsv_status_memory;
+  if (chunk->data.csv_writer) {
+    zsv_writer_flush(chunk->data.csv_writer);
+    if (stat == zsv_status_ok && ftell(chunk->tmp) > 0) {
+      unsigned char buff[65536];
+      size_t n;
+      char new_row = ZSV_WRITER_NEW_ROW;
+      rewind(chunk->tmp);
+      while ((n = fread(buff, 1, sizeof(buff), chunk->tmp)) > 0) {
+        zsv_writer_raw(data->csv_writer, new_row, buff, n);
+        new_row = ZSV_WRITER_SAME_ROW;
+      }
+    }
+    zsv_writer_delete(chunk->data.csv_writer);
+  }
+  if (chunk->tmp)
+    fclose(chunk->tmp);
+  free(chunk->data.search_cells);
+  free(chunk);
+  return zsv_status_ok;
+}
+
 static void zsv_select_print_header_row(struct zsv_select_data *data) {
   if (data->no_header)
     return;
@@ -499,10 +924,131 @@ static void zsv_select_print_header_row(struct zsv_select_data *data) {
   zsv_writer_cell_prepend(data->csv_writer, NULL);
 }
 
+// zsv_select_regex_bind(): find the column of each --regex-col, and let any that
+// has a group extract the output value of its column
+static int zsv_select_regex_bind(struct zsv_select_data *data) {
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) {
+    if (!r->col_name)
+      continue;
+    unsigned int ix = str_array_ifind((const unsigned char *)r->col_name, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", r->col_name);
+      return 1;
+    }
+    r->col = ix - 1;
+    if (zsv_regex_group_count(r->re))
+      for (unsigned int i = 0; i < data->output_cols_count; i++)
+        if (data->out2in[i].ix == r->col && !data->out2in[i].capture)
+          data->out2in[i].capture = r->re;
+  }
+  return 0;
+}
+
+// zsv_select_sample_bind(): find the --sample-by column
+static int zsv_select_sample_bind(struct zsv_select_data *data) {
+  if (data->sample.by) {
+    unsigned int ix = str_array_ifind((const unsigned char *)data->sample.by, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", data->sample.by);
+      return 1;
+    }
+    data->sample.by_ix = ix - 1;
+  }
+  return 0;
+}
+
+// zsv_select_dedupe_bind(): find the --key columns
+static int zsv_select_dedupe_bind(struct zsv_select_data *data) {
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) {
+    const char *name = data->dedupe.key_names[i];
+    unsigned int ix = str_array_ifind((const unsigned char *)name, data->header_names, data->header_name_count);
+    if (!ix) {
+      fprintf(stderr, "Column %s not found\n", name);
+      return 1;
+    }
+    data->dedupe.key_ix[i] = ix - 1;
+  }
+  return 0;
+}
+
+// zsv_select_regex_any(): check whether there is any --regex, which needs every cell
+static char zsv_select_regex_any(struct zsv_select_data *data) {
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next)
+    if (!r->col_name)
+      return 1;
+  return 0;
+}
+
+// zsv_select_set_column_filter(): let the parser skip the cells of any input
+// columns that will not be output
+static void zsv_select_set_column_filter(struct zsv_select_data *data, zsv_parser parser) {
+  if (data->search_strings || zsv_select_regex_any(data) || !data->output_cols_count)
+    return; // search and --regex need every cell
+
+  size_t where_count = 0;
+  const size_t *where_cols = data->where ? zsv_where_columns(data->where, &where_count) : NULL;
+  unsigned int count = data->header_name_count;
+  for (unsigned int i = 0; i < data->output_cols_count; i++) {
+    if (data->out2in[i].ix >= count)
+      count = data->out2in[i].ix + 1;
+    for (struct zsv_select_uint_list *ix = data->out2in[i].merge.indexes; ix; ix = ix->next)
+      if (ix->value >= count)
+        count = ix->value + 1;
+  }
+  for (size_t i = 0; i < where_count; i++)
+    if (where_cols[i] >= count)
+      count = where_cols[i] + 1;
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next)
+    if (r->col >= count)
+      count = r->col + 1;
+  if (data->sample.by && data->sample.by_ix >= count)
+    count = data->sample.by_ix + 1;
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++)
+    if (data->dedupe.key_ix[i] >= count)
+      count = data->dedupe.key_ix[i] + 1;
+
+  unsigned char *bitmap = calloc(count / 8 + 1, 1);
+  if (!bitmap)
+    return;
+  unsigned int selected = 0;
+  for (unsigned int i = 0; i < data->output_cols_count; i++) {
+    unsigned int in_ix = data->out2in[i].ix;
+    selected += !(bitmap[in_ix / 8] & (1 << (in_ix % 8)));
+    bitmap[in_ix / 8] |= 1 << (in_ix % 8);
+    for (struct zsv_select_uint_list *ix = data->out2in[i].merge.indexes; ix; ix = ix->next) {
+      selected += !(bitmap[ix->value / 8] & (1 << (ix->value % 8)));
+      bitmap[ix->value / 8] |= 1 << (ix->value % 8);
+    }
+  }
+  for (size_t i = 0; i < where_count; i++) { // columns that --where tests
+    selected += !(bitmap[where_cols[i] / 8] & (1 << (where_cols[i] % 8)));
+    bitmap[where_cols[i] / 8] |= 1 << (where_cols[i] % 8);
+  }
+  for (struct zsv_select_regex *r = data->regexes; r; r = r->next) { // columns that --regex-col tests
+    selected += !(bitmap[r->col / 8] & (1 << (r->col % 8)));
+    bitmap[r->col / 8] |= 1 << (r->col % 8);
+  }
+  if (data->sample.by) { // --sample-by column
+    selected += !(bitmap[data->sample.by_ix / 8] & (1 << (data->sample.by_ix % 8)));
+    bitmap[data->sample.by_ix / 8] |= 1 << (data->sample.by_ix % 8);
+  }
+  for (unsigned int i = 0; i < data->dedupe.key_count; i++) { // --key columns
+    unsigned int ix = data->dedupe.key_ix[i];
+    selected += !(bitmap[ix / 8] & (1 << (ix % 8)));
+    bitmap[ix / 8] |= 1 << (ix % 8);
+  }
+  if (selected < count) // else all columns are output
+    zsv_set_column_filter(parser, bitmap, count);
+  free(bitmap);
+}
+
 static void zsv_select_header_finish(struct zsv_select_data *data) {
-  if (zsv_select_set_output_columns(data))
+  if (zsv_select_set_output_columns(data) || zsv_select_regex_bind(data) || zsv_select_sample_bind(data) ||
+      zsv_select_dedupe_bind(data) ||
+      (data->where && zsv_where_bind(data->where, data->header_names, data->header_name_count) != zsv_status_ok))
     data->cancelled = 1;
   else {
+    zsv_select_set_column_filter(data, data->parser);
     zsv_select_print_header_row(data);
     zsv_set_row_handler(data->parser, zsv_select_data_row);
   }
@@ -557,17 +1103,54 @@ const char *zsv_select_usage_msg[] = {
   "                                 cell and indexes",
   "  --fixed-auto                 : parse as fixed-width text; derive widths from first row in input data (max 1MB)",
   "                                 assumes ASCII whitespace; multi-byte whitespace is not counted as whitespace",
+  "  --fixed-record-length <n>    : with --fixed, input is a sequence of n-byte records without row ends",
 #ifndef ZSV_CLI
   "  -v,--verbose                 : verbose output",
 #endif
   "  -H,--head <n>                : (head) only process the first n rows of input data (including header)",
+  "  -D,--skip-data <n>           : skip the first n rows of input data",
+  "  --row-index                  : with -D and a file input, seek directly to the first row to output, using a",
+  "                                 row index that is cached in " ZSV_CACHE_DIR " (and built if it is missing or stale)",
   "  --no-header                  : do not output header row",
   "  --prepend-header <value>     : prepend each column header with the given text <value>",
   "  -s,--search <value>          : only output rows with at least one cell containing <value>",
-  // TO DO: " -s,--search /<pattern>/modifiers: search on regex pattern; modifiers include 'g' (global) and 'i'
-  // (case-insensitive)",
+  "                                 can be specified more than once, to search for any of several values",
+  "  --search-ignore-case         : with -s, ignore the case of ASCII letters",
+  "  --search-whole-cell          : with -s, only match cells whose entire value is a search value",
+  "  --where <expression>         : only output rows that satisfy the expression, for example:",
+  "                                 \"amount > 1000 AND region = 'EU'\". Conditions:",
+  "                                   <col> = | != | < | <= | > | >= <value>",
+  "                                   <col> [NOT] BETWEEN <value> AND <value>",
+  "                                   <col> [NOT] LIKE '<pattern>'    (% and _ wildcards; ignores ASCII case)",
+  "                                   <col> [NOT] IN (<value>, ...)",
+  "                                   <col> [NOT] REGEXP '<pattern>'  (regular expression, as for --regex)",
+  "                                   <col> IS [NOT] NULL             (empty)",
+  "                                 combined with AND, OR, NOT and parentheses. A value is a string in single quotes,",
+  "                                 or a number, which compares numerically and is false for a value that is not a",
+  "                                 number (including with !=, but not with NOT, which negates the outcome). Use double",
+  "                                 quotes around a column name that has spaces",
+  "  --regex <pattern>            : only output rows with at least one cell that matches the regular expression",
+  "                                 <pattern>; can be specified more than once, to match any of several patterns.",
+  "                                 Supports . [] [^] \\d \\w \\s ^ $ () (?:) | * + ? {n,m} and, at the start, (?i)",
+  "                                 to ignore the case of ASCII letters; matches without backtracking",
+  "  --regex-col <col>=<pattern>  : only output rows in which column <col> matches <pattern>. If <pattern> has a",
+  "                                 group, e.g. \"id=([0-9]+)\", output the part of <col> that the first group matches",
+  "                                 instead of its whole value. Can be specified more than once; all must match",
   "  --sample-every <num_of_rows> : output a sample consisting of the first row, then every nth row",
-  "  --sample-pct <percentage>    : output a randomly-selected sample (32 bits of randomness) of n%% of input rows",
+  "  --sample-pct <percentage>    : output a randomly-selected sample of n%% of input rows",
+  "  --sample-n <n>               : output a randomly-selected sample of exactly n rows (or all rows, if fewer)",
+  "                                 of those that pass any filter, in input order",
+  "  --sample-by <col>            : with --sample-n, output a sample of n rows for each distinct value of <col>",
+  "  --seed <n>                   : seed for --sample-pct and --sample-n, to take the same sample on each run",
+  "                                 Rows that a sample passes over are skipped without being parsed, where possible",
+  "  --dedupe                     : only output the first of any rows that are identical as output (after cleaning",
+  "                                 and column selection), or that have the same --key values",
+  "  --key <col>                  : with --dedupe, compare rows by the value of <col> (after cleaning) instead.",
+  "                                 Can be specified more than once, to compare rows by several columns",
+  "  --dedupe-memory <n>          : with --dedupe, maximum bytes of memory for the rows seen so far (default: 1GB),",
+  "                                 beyond which further rows are partitioned into temporary files to deduplicate",
+  "  --dedupe-bloom               : with --dedupe, once its memory is full, check new rows against a bloom filter",
+  "                                 first, which is faster when most rows are unique",
   "  --distinct                   : skip subsequent occurrences of columns with the same name",
   "  --merge                      : merge subsequent occurrences of columns with the same name",
   "                                 outputting first non-null value",
@@ -596,6 +1179,9 @@ const char *zsv_select_usage_msg[] = {
   "                                 Default: " ZSV_ROW_MAX_SIZE_MIN_S " (min), " ZSV_ROW_MAX_SIZE_DEFAULT_S " (max)",
 #endif
   "  -o <filename>                : filename to save output to",
+  "  -j,--jobs <n>                : process a file input using n parallel threads. Not supported with -H, -D, -N,",
+  "                                 sampling, fixed-width or compressed input",
+  "  --chunk-size <n>             : with -j, approximate bytes per parallel chunk",
   NULL,
 };
 
@@ -610,6 +1196,17 @@ static void zsv_select_cleanup(struct zsv_select_data *data) {
 
   zsv_writer_delete(data->csv_writer);
   zsv_select_search_str_delete(data->search_strings);
+  zsv_search_delete(data->search);
+  free(data->search_cells);
+  zsv_where_delete(data->where);
+  zsv_select_regex_delete(data->regexes);
+  zsv_sample_delete(data->sample.rows);
+  zsv_dedupe_delete(data->dedupe.set);
+  free(data->dedupe.key_names);
+  free(data->dedupe.key_ix);
+  free(data->dedupe.key);
+  zsv_writer_delete(data->rendered.writer);
+  free(data->rendered.buff);
 
   if (data->distinct == ZSV_SELECT_DISTINCT_MERGE) {
     for (unsigned int i = 0; i < data->output_cols_count; i++) {
@@ -767,6 +1364,8 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
   int col_index_arg_i = 0;
   unsigned char *preview_buff = NULL;
   size_t preview_buff_len = 0;
+  struct zsv_parallel_opts popts = {0};
+  char parallel = 0;
 
   enum zsv_status stat = zsv_status_ok;
   for (int arg_i = 1; stat == zsv_status_ok && arg_i < argc; arg_i++) {
@@ -810,6 +1409,11 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
           }
         }
       }
+    } else if (!strcmp(argv[arg_i], "--fixed-record-length")) {
+      if (++arg_i >= argc)
+        stat = zsv_printerr(1, "%s option requires parameter", argv[arg_i - 1]);
+      else if (sscanf(argv[arg_i], "%zu", &data.fixed.record_length) != 1 || !data.fixed.record_length)
+        stat = zsv_printerr(1, "Invalid record length: %s", argv[arg_i]);
     } else if (!strcmp(argv[arg_i], "--distinct"))
       data.distinct = 1;
     else if (!strcmp(argv[arg_i], "--merge"))
@@ -833,6 +1437,22 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
         zsv_select_add_search(&data, argv[arg_i]);
       else
         stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+    } else if (!strcmp(argv[arg_i], "--where")) {
+      if (++arg_i >= argc)
+        stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+      else if (data.where)
+        stat = zsv_printerr(1, "--where may only be specified once; combine conditions with AND");
+      else if (zsv_where_new(argv[arg_i], &data.where) != zsv_status_ok)
+        stat = zsv_status_invalid_option;
+    } else if (!strcmp(argv[arg_i], "--search-ignore-case")) {
+      data.search_flags |= ZSV_SEARCH_ICASE;
+    } else if (!strcmp(argv[arg_i], "--search-whole-cell")) {
+      data.search_flags |= ZSV_SEARCH_WHOLE_CELL;
+    } else if (!strcmp(argv[arg_i], "--regex") || !strcmp(argv[arg_i], "--regex-col")) {
+      if (++arg_i >= argc || !*argv[arg_i])
+        stat = zsv_printerr(1, "%s option requires a value", argv[arg_i - 1]);
+      else
+        stat = zsv_select_add_regex(&data, argv[arg_i], !strcmp(argv[arg_i - 1], "--regex-col"));
     } else if (!strcmp(argv[arg_i], "-v") || !strcmp(argv[arg_i], "--verbose")) {
       data.verbose = 1;
     } else if (!strcmp(argv[arg_i], "--unescape")) {
@@ -857,12 +1477,52 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       double d;
       if (!(arg_i < argc))
         stat = zsv_printerr(1, "--sample-pct option requires a value");
-      else if (!(d = atof(argv[arg_i])) && d > 0 && d < 100)
+      else if (!((d = atof(argv[arg_i])) > 0 && d <= 100))
         stat = zsv_printerr(
-          -1, "--sample-pct value should be a number between 0 and 100 (e.g. 1.5 for a sample of 1.5%% of the data");
+          -1, "--sample-pct value should be a number between 0 and 100 (e.g. 1.5 for a sample of 1.5%% of the data)");
       else
         data.sample_pct = d;
-    } else if (!strcmp(argv[arg_i], "--prepend-header")) {
+    } else if (!strcmp(argv[arg_i], "--sample-n")) {
+      arg_i++;
+      if (!(arg_i < argc && atol(argv[arg_i]) > 0))
+        stat = zsv_printerr(1, "--sample-n value should be an integer > 0");
+      else
+        data.sample.n = (size_t)atol(argv[arg_i]);
+    } else if (!strcmp(argv[arg_i], "--sample-by")) {
+      arg_i++;
+      if (!(arg_i < argc))
+        stat = zsv_printerr(1, "--sample-by option requires a column name");
+      else
+        data.sample.by = argv[arg_i];
+    } else if (!strcmp(argv[arg_i], "--seed")) {
+      arg_i++;
+      char *end = NULL;
+      if (arg_i < argc)
+        data.sample.seed = strtoull(argv[arg_i], &end, 10);
+      if (!(arg_i < argc && *argv[arg_i] && *argv[arg_i] != '-' && end && !*end))
+        stat = zsv_printerr(1, "--seed value should be a non-negative integer");
+      else
+        data.sample.seeded = 1;
+    } else if (!strcmp(argv[arg_i], "--dedupe"))
+      data.dedupe.on = 1;
+    else if (!strcmp(argv[arg_i], "--key")) {
+      const char **key_names;
+      if (!(++arg_i < argc && *argv[arg_i]))
+        stat = zsv_printerr(1, "--key option requires a column name");
+      else if (!(key_names = realloc(data.dedupe.key_names, (data.dedupe.key_count + 1) * sizeof(*key_names))))
+        stat = zsv_printerr(zsv_status_memory, "Out of memory!");
+      else {
+        data.dedupe.key_names = key_names;
+        data.dedupe.key_names[data.dedupe.key_count++] = argv[arg_i];
+      }
+    } else if (!strcmp(argv[arg_i], "--dedupe-memory")) {
+      if (!(++arg_i < argc && atol(argv[arg_i]) > 0))
+        stat = zsv_printerr(1, "--dedupe-memory value should be an integer > 0");
+      else
+        data.dedupe.opts.max_memory = (size_t)atol(argv[arg_i]);
+    } else if (!strcmp(argv[arg_i], "--dedupe-bloom"))
+      data.dedupe.opts.bloom = 1;
+    else if (!strcmp(argv[arg_i], "--prepend-header")) {
       int err = 0;
       data.prepend_header = zsv_next_arg(++arg_i, argc, argv, &err);
       if (err)
@@ -875,7 +1535,9 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
                             arg_i + 1 < argc ? argv[arg_i + 1] : "");
       else
         data.data_rows_limit = atoi(argv[++arg_i]) + 1;
-    } else if (!strcmp(argv[arg_i], "-D") || !strcmp(argv[arg_i], "--skip-data")) {
+    } else if (!strcmp(argv[arg_i], "--row-index"))
+      data.use_row_index = 1;
+    else if (!strcmp(argv[arg_i], "-D") || !strcmp(argv[arg_i], "--skip-data")) {
       ++arg_i;
       if (!(arg_i < argc && atoi(argv[arg_i]) >= 0))
         stat = zsv_printerr(1, "%s option value invalid: should be positive integer", argv[arg_i - 1]);
@@ -891,6 +1553,20 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
         data.embedded_lineend = *argv[arg_i];
       else
         stat = zsv_printerr(1, "-e option requires a value");
+    } else if (!strcmp(argv[arg_i], "-j") || !strcmp(argv[arg_i], "--jobs")) {
+      ++arg_i;
+      if (!(arg_i < argc && atoi(argv[arg_i]) >= 0))
+        stat = zsv_printerr(1, "%s option value invalid: should be non-negative integer", argv[arg_i - 1]);
+      else {
+        popts.threads = atoi(argv[arg_i]);
+        parallel = 1;
+      }
+    } else if (!strcmp(argv[arg_i], "--chunk-size")) {
+      ++arg_i;
+      if (!(arg_i < argc && atol(argv[arg_i]) >= 0))
+        stat = zsv_printerr(1, "%s option value invalid: should be non-negative integer", argv[arg_i - 1]);
+      else
+        popts.chunk_size = (size_t)atol(argv[arg_i]);
     } else if (!strcmp(argv[arg_i], "-x")) {
       arg_i++;
       if (!(arg_i < argc))
@@ -908,8 +1584,17 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
   }
 
   if (stat == zsv_status_ok) {
-    if (data.sample_pct)
-      srand(time(0));
+    if (data.sample.n && (data.sample_every_n || data.sample_pct))
+      stat = zsv_printerr(1, "--sample-n cannot be used with --sample-every or --sample-pct");
+    else if (data.sample.by && !data.sample.n)
+      stat = zsv_printerr(1, "--sample-by requires --sample-n");
+    else if (data.dedupe.on && data.sample.n)
+      stat = zsv_printerr(1, "--dedupe cannot be used with --sample-n");
+    else if ((data.dedupe.key_count || data.dedupe.opts.max_memory || data.dedupe.opts.bloom) && !data.dedupe.on)
+      stat = zsv_printerr(1, "--key, --dedupe-memory and --dedupe-bloom require --dedupe");
+    if (!data.sample.seeded)
+      data.sample.seed = zsv_random_default_seed();
+    zsv_random_seed(&data.sample.random, data.sample.seed);
 
     if (data.use_header_indexes && stat == zsv_status_ok)
       stat = zsv_select_check_exclusions_are_indexes(&data);
@@ -929,6 +1614,8 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
         stat = zsv_printerr(zsv_status_error, "Please specify either --fixed-auto or --fixed, but not both");
       else if (data.opts->insert_header_row)
         stat = zsv_printerr(zsv_status_error, "--fixed-auto can not be specified together with --header-row");
+      else if (data.fixed.record_length)
+        stat = zsv_printerr(zsv_status_error, "--fixed-auto can not be specified together with --fixed-record-length");
       else {
         size_t buffsize = 1024 * 256; // read the first
         preview_buff = calloc(buffsize, sizeof(*preview_buff));
@@ -938,7 +1625,8 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
           stat = auto_detect_fixed_column_sizes(&data.fixed, data.opts, preview_buff, buffsize, &preview_buff_len,
                                                 opts->verbose);
       }
-    }
+    } else if (stat == zsv_status_ok && data.fixed.record_length && !data.fixed.count)
+      stat = zsv_printerr(zsv_status_error, "--fixed-record-length requires --fixed");
   }
 
   if (stat == zsv_status_ok) {
@@ -949,15 +1637,49 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
       data.col_argc = argc - col_index_arg_i;
     }
 
+    if (parallel && (!input_path || data.data_rows_limit || data.skip_data_rows || data.prepend_line_number ||
+                     data.sample_every_n || data.sample_pct || data.sample.n || data.dedupe.on || data.fixed.count ||
+                     zsv_file_compression(input_path) != zsv_compression_none)) {
+      if (input_path)
+        fprintf(stderr, "Warning: --jobs is not supported with -H, -D, -N, sampling, --dedupe, fixed-width or "
+                        "compressed input; processing serially\n");
+      parallel = 0;
+    }
+
+    // output cells can keep their escaped dbl-quotes as-is, unless they are searched, tested or unescaped
+    data.opts->lazy_unescape = !data.search_strings && !data.where && !data.regexes && !data.unescape;
     data.header_names = calloc(data.opts->max_columns, sizeof(*data.header_names));
     assert(data.opts->max_columns > 0);
     data.out2in = calloc(data.opts->max_columns, sizeof(*data.out2in));
     data.csv_writer = zsv_writer_new(&writer_opts);
-    if (!(data.header_names && data.csv_writer))
+    if (!(data.header_names && data.csv_writer) || zsv_select_search_init(&data) != zsv_status_ok ||
+        zsv_select_sample_init(&data) != zsv_status_ok || zsv_select_dedupe_init(&data) != zsv_status_ok ||
+        zsv_select_render_init(&data) != zsv_status_ok)
       stat = zsv_status_memory;
-    else {
+    else if (parallel) {
+      struct zsv_file_properties fp = zsv_cache_load_props(input_path, data.opts, custom_prop_handler, opts_used);
+      stat = fp.stat;
+      if (stat == zsv_status_ok) {
+        data.any_clean = !data.no_trim_whitespace || data.clean_white || data.embedded_lineend || data.unescape;
+        unsigned char writer_buff[512];
+        zsv_writer_set_temp_buff(data.csv_writer, writer_buff, sizeof(writer_buff));
+        zsv_handle_ctrl_c_signal();
+        data.opts->row_handler = zsv_select_data_row;
+        popts.header = zsv_select_parallel_header;
+        popts.chunk_start = zsv_select_parallel_chunk_start;
+        popts.chunk_end = zsv_select_parallel_chunk_end;
+        popts.ctx = &data;
+        enum zsv_status status = zsv_parse_parallel(input_path, data.opts, &popts);
+        if (status == zsv_status_invalid_option) // not a regular file
+          parallel = 0;
+        else if (status != zsv_status_ok && status != zsv_status_cancelled)
+          stat = zsv_printerr(status, "Unable to process %s: %s", input_path, zsv_parse_status_desc(status));
+      }
+    }
+    if (stat == zsv_status_ok && !parallel) {
       data.opts->row_handler = zsv_select_header_row;
       data.opts->ctx = &data;
+      data.opts->mmap = 1;
       if (zsv_new_with_properties(data.opts, custom_prop_handler, input_path, opts_used, &data.parser) ==
           zsv_status_ok) {
         // all done with
@@ -968,6 +1690,23 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
         if (data.fixed.count &&
             zsv_set_fixed_offsets(data.parser, data.fixed.count, data.fixed.offsets) != zsv_status_ok)
           data.cancelled = 1;
+        else if (data.fixed.record_length &&
+                 zsv_set_fixed_record_length(data.parser, data.fixed.record_length) != zsv_status_ok)
+          data.cancelled = 1;
+
+        // jump to the first row to output, instead of parsing the skipped rows
+        struct zsv_row_index *row_index = NULL;
+        if (data.use_row_index && data.skip_data_rows && !data.cancelled) {
+          if (!input_path || data.fixed.count)
+            fprintf(stderr, "Warning: --row-index requires a file input that is not fixed-width; ignoring\n");
+          else if (zsv_cache_row_index(input_path, data.opts, data.parser, &row_index) != zsv_status_ok ||
+                   zsv_seek_row(data.parser, data.skip_data_rows) != zsv_status_ok)
+            fprintf(stderr, "Warning: unable to use a row index for %s; skipping rows instead\n", input_path);
+          else {
+            data.data_row_count = data.skip_data_rows;
+            data.skip_data_rows = 0;
+          }
+        }
 
         // create a local csv writer buff quoted values
         unsigned char writer_buff[512];
@@ -983,7 +1722,15 @@ int ZSV_MAIN_FUNC(ZSV_COMMAND)(int argc, const char *argv[], struct zsv_opts *op
           status = zsv_parse_more(data.parser);
         if (status == zsv_status_no_more_input)
           status = zsv_finish(data.parser);
+        else if (status == zsv_status_error) // e.g. truncated compressed input, which has been reported
+          stat = status;
+        if (data.sample.rows)
+          zsv_sample_rows(data.sample.rows, zsv_select_sample_output_row, &data);
+        if (data.dedupe.set && !data.cancelled &&
+            zsv_dedupe_rows(data.dedupe.set, zsv_select_dedupe_output_row, &data) != zsv_status_ok)
+          stat = zsv_printerr(zsv_status_error, "Unable to deduplicate the rows in temporary files");
         zsv_delete(data.parser);
+        zsv_row_index_delete(row_index);
       }
     }
   }
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/**
+ * Test driver for libzsv options and functions that the zsv commands use in
+ * ways that do not show in their output (e.g. memory-mapped input)
+ *
+ * Parses a file (or stdin) with the given options, and prints each row as its
+ * row number followed by its cells, each within brackets, e.g.
+ *   2: [a] [b""c]
+ * with newlines and other control chars printed as escapes, so that the output
+ * of different ways of parsing the same input can be compared
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <zsv.h>
+
+struct api_test {
+  zsv_parser parser;
+  size_t row_number;
+  FILE *in;
+  size_t read_size; // if non-zero, read at most this many bytes at a time (see api_test_read())
+  unsigned char *unescape_buff; // if non-NULL, get cells with zsv_get_cell_unescaped()
+  size_t unescape_buffsize;
+  unsigned char column_filter[32]; // see zsv_set_column_filter(), which is called after the header row
+  size_t column_filter_count;      // (or, if column_filter_at_start is set, before parsing starts)
+  char column_filter_at_start;
+  unsigned char print_columns[32]; // if print_columns_count is non-zero, print only these columns
+  size_t print_columns_count;
+
+  // if persist is set, each row's cell in persist_column is kept with
+  // zsv_cell_persist() in arena (or, if NULL, the parser's arena), and all of
+  // them are printed after the parse
+  struct zsv_arena *arena;
+  struct zsv_cell *persisted;
+  size_t persisted_count;
+  size_t persisted_allocated;
+  size_t persist_column;
+  char persist;
+};
+
+/**
+ * Parse a comma-separated list of 0-based column indexes into a bitmap
+ * @return number of columns (bits) in the bitmap, or 0 if the list is invalid
+ */
+static size_t parse_columns(const char *list, unsigned char *bitmap, size_t bitmap_size) {
+  size_t count = 0;
+  memset(bitmap, 0, bitmap_size);
+  while (*list) {
+    char *end;
+    unsigned long ix = strtoul(list, &end, 10);
+    if (end == list || ix >= bitmap_size * 8 || (*end && *end != ','))
+      return 0;
+    bitmap[ix / 8] |= (unsigned char)(1 << (ix % 8));
+    if (ix + 1 > count)
+      count = ix + 1;
+    list = *end ? end + 1 : end;
+  }
+  return count;
+}
+
+/**
+ * Read in small pieces, as e.g. from a slow network source
+ */
+static size_t api_test_read(void *restrict buff, size_t n, size_t size, void *restrict ctx) {
+  struct api_test *data = ctx;
+  if (n * size > data->read_size)
+    size = data->read_size / n;
+  return fread(buff, n, size, data->in);
+}
+
+static void print_cell(struct zsv_cell c) {
+  putchar('[');
+  for (size_t i = 0; i < c.len; i++) {
+    unsigned char ch = c.str[i];
+    if (ch == '\n')
+      printf("\\n");
+    else if (ch == '\r')
+      printf("\\r");
+    else if (ch < 32 || ch == '\\' || ch == ']')
+      printf("\\x%02x", ch);
+    else
+      putchar(ch);
+  }
+  putchar(']');
+}
+
+/**
+ * Print a row's cells. A cell that still has escaped dbl-quotes (see
+ * zsv_opts.lazy_unescape) is preceded by E, and a cell that could not be
+ * unescaped into the buffer is printed as the size that was needed
+ */
+static void print_row(struct api_test *data) {
+  if (data->persist) {
+    if (data->persisted_count == data->persisted_allocated) {
+      size_t n = data->persisted_allocated ? data->persisted_allocated * 2 : 256;
+      struct zsv_cell *persisted = realloc(data->persisted, n * sizeof(*persisted));
+      if (!persisted) {
+        fprintf(stderr, "Out of memory!\n");
+        zsv_abort(data->parser);
+        return;
+      }
+      data->persisted = persisted;
+      data->persisted_allocated = n;
+    }
+    struct zsv_cell c = zsv_get_cell(data->parser, data->persist_column);
+    data->persisted[data->persisted_count++] = zsv_cell_persist(data->parser, data->arena, c);
+    data->row_number++;
+    return;
+  }
+
+  size_t cell_count = zsv_cell_count(data->parser);
+  printf("%zu:", data->row_number++);
+  if (data->print_columns_count)
+    cell_count = data->print_columns_count;
+  for (size_t i = 0; i < cell_count; i++) {
+    if (data->print_columns_count && !(data->print_columns[i / 8] & (1 << (i % 8))))
+      continue;
+    struct zsv_cell c = data->unescape_buff
+                          ? zsv_get_cell_unescaped(data->parser, i, data->unescape_buff, data->unescape_buffsize)
+                          : zsv_get_cell(data->parser, i);
+    putchar(' ');
+    if (!c.str && c.len)
+      printf("(%zu)", c.len);
+    else {
+      if (c.quoted & ZSV_PARSER_QUOTE_ESCAPED)
+        putchar('E');
+      print_cell(c);
+    }
+  }
+  putchar('\n');
+  if (data->row_number == 1 && data->column_filter_count && !data->column_filter_at_start)
+    zsv_set_column_filter(data->parser, data->column_filter, data->column_filter_count);
+}
+
+static void api_test_row(void *ctx) {
+  print_row(ctx);
+}
+
+/**
+ * Print the cells that were kept with zsv_cell_persist(), in the same format as
+ * print_row() with --print-columns, after checking that each is null-terminated
+ */
+static int print_persisted(struct api_test *data) {
+  for (size_t i = 0; i < data->persisted_count; i++) {
+    struct zsv_cell c = data->persisted[i];
+    if (!c.str || c.str[c.len]) {
+      fprintf(stderr, "Error: persisted cell %zu is not null-terminated\n", i);
+      return 1;
+    }
+    printf("%zu: ", i);
+    print_cell(c);
+    putchar('\n');
+  }
+  return 0;
+}
+
+static int usage(void) {
+  fprintf(stderr, "Usage: api [options] <filename or dash(-) for stdin>\n"
+                  "Options:\n"
+                  "  -B <size>                     : parser buffer size\n"
+                  "  -r <size>                     : maximum row size\n"
+                  "  --pull                        : parse with zsv_next_row() instead of a row handler\n"
+                  "  --mmap                        : memory-map the input if it is a regular file\n"
+                  "  --set-read-after <n>          : with --pull, call zsv_set_read() after row n\n"
+                  "  --read-size <n>               : read at most n bytes at a time\n"
+                  "  --read-ahead <n>              : read ahead into a queue of n buffers\n"
+                  "  --read-ahead-buffsize <size>  : size of each read-ahead buffer\n"
+                  "  --malformed-utf8-replace <c>  : replace malformed UTF8 with the given char\n"
+                  "  --lazy-unescape               : leave escaped dbl-quotes in data cells\n"
+                  "  --get-cell-unescaped          : get cells with zsv_get_cell_unescaped()\n"
+                  "  --unescape-buffsize <size>    : buffer size for --get-cell-unescaped\n"
+                  "  --column-filter <i,j,...>     : after the header row, store only these (0-based) columns\n"
+                  "  --column-filter-at-start      : with --column-filter, set the filter before parsing starts\n"
+                  "  --print-columns <i,j,...>     : print only these columns\n"
+                  "  --persist <i>                 : keep column i of each row, and print them after the parse\n"
+                  "  --arena-block-size <size>     : with --persist, keep cells in a new arena with this block size\n");
+  return 1;
+}
+
+int main(int argc, const char *argv[]) {
+  struct zsv_opts opts = {0};
+  struct api_test data = {0};
+  const char *path = NULL;
+  char pull = 0;
+  char get_cell_unescaped = 0;
+  size_t arena_block_size = 0;
+  size_t set_read_after = 0;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strcmp(arg, "-B") && i + 1 < argc)
+      opts.buffsize = (size_t)atol(argv[++i]);
+    else if (!strcmp(arg, "-r") && i + 1 < argc)
+      opts.max_row_size = (unsigned)atol(argv[++i]);
+    else if (!strcmp(arg, "--pull"))
+      pull = 1;
+    else if (!strcmp(arg, "--mmap"))
+      opts.mmap = 1;
+    else if (!strcmp(arg, "--set-read-after") && i + 1 < argc)
+      set_read_after = (size_t)atol(argv[++i]);
+    else if (!strcmp(arg, "--read-size") && i + 1 < argc)
+      data.read_size = (size_t)atol(argv[++i]);
+    else if (!strcmp(arg, "--read-ahead") && i + 1 < argc)
+      opts.read_ahead.queue_depth = (unsigned)atol(argv[++i]);
+    else if (!strcmp(arg, "--read-ahead-buffsize") && i + 1 < argc)
+      opts.read_ahead.buffsize = (size_t)atol(argv[++i]);
+    else if (!strcmp(arg, "--malformed-utf8-replace") && i + 1 < argc)
+      opts.malformed_utf8_replace = argv[++i][0];
+    else if (!strcmp(arg, "--lazy-unescape"))
+      opts.lazy_unescape = 1;
+    else if (!strcmp(arg, "--get-cell-unescaped"))
+      get_cell_unescaped = 1;
+    else if (!strcmp(arg, "--unescape-buffsize") && i + 1 < argc)
+      data.unescape_buffsize = (size_t)atol(argv[++i]);
+    else if (!strcmp(arg, "--column-filter") && i + 1 < argc) {
+      if (!(data.column_filter_count = parse_columns(argv[++i], data.column_filter, sizeof(data.column_filter))))
+        return usage();
+    } else if (!strcmp(arg, "--column-filter-at-start"))
+      data.column_filter_at_start = 1;
+    else if (!strcmp(arg, "--print-columns") && i + 1 < argc) {
+      if (!(data.print_columns_count = parse_columns(argv[++i], data.print_columns, sizeof(data.print_columns))))
+        return usage();
+    } else if (!strcmp(arg, "--persist") && i + 1 < argc) {
+      data.persist = 1;
+      data.persist_column = (size_t)atol(argv[++i]);
+    } else if (!strcmp(arg, "--arena-block-size") && i + 1 < argc)
+      arena_block_size = (size_t)atol(argv[++i]);
+    else if (*arg != '-' || !strcmp(arg, "-"))
+      path = arg;
+    else
+      return usage();
+  }
+  if (!path)
+    return usage();
+
+  FILE *f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  opts.stream = data.in = f;
+  if (data.read_size) {
+    opts.read = api_test_read;
+    opts.stream = &data;
+  }
+  if (!pull) {
+    opts.row_handler = api_test_row;
+    opts.ctx = &data;
+  }
+  if (get_cell_unescaped && !data.unescape_buffsize)
+    data.unescape_buffsize = ZSV_ROW_MAX_SIZE_DEFAULT;
+
+  enum zsv_status stat = zsv_status_memory;
+  if ((arena_block_size && !(data.arena = zsv_arena_new(arena_block_size))) ||
+      (get_cell_unescaped && !(data.unescape_buff = malloc(data.unescape_buffsize))))
+    fprintf(stderr, "Out of memory!\n");
+  else if (!(data.parser = zsv_new(&opts)))
+    fprintf(stderr, "Could not allocate parser!\n");
+  else if (data.column_filter_at_start && data.column_filter_count &&
+           (stat = zsv_set_column_filter(data.parser, data.column_filter, data.column_filter_count)) != zsv_status_ok)
+    ;
+  else if (pull) {
+    while ((stat = zsv_next_row(data.parser)) == zsv_status_row) {
+      print_row(&data);
+      if (set_read_after && data.row_number == set_read_after + 1)
+        // e.g. from memory-mapped to buffered input, or redirect the read-ahead thread
+        zsv_set_read(data.parser, opts.read ? opts.read : (zsv_generic_read)fread);
+    }
+  } else {
+    while ((stat = zsv_parse_more(data.parser)) == zsv_status_ok)
+      ;
+    if (stat == zsv_status_no_more_input)
+      stat = zsv_finish(data.parser);
+  }
+  if (stat == zsv_status_no_more_input || stat == zsv_status_done)
+    stat = zsv_status_ok;
+  if (data.parser && stat != zsv_status_ok)
+    fprintf(stderr, "Error: %s\n", zsv_parse_status_desc(stat));
+
+  int err = stat != zsv_status_ok;
+  if (!err && data.persist)
+    err = print_persisted(&data); // before zsv_delete(), which frees the parser's arena
+
+  zsv_delete(data.parser);
+  if (f != stdin)
+    fclose(f);
+  zsv_arena_delete(data.arena);
+  free(data.persisted);
+  free(data.unescape_buff);
+  return err;
+}
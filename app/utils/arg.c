@@ -116,7 +116,10 @@ void zsv_set_default_completed_callback(zsv_completed_callback cb, void *ctx) {
  *     -c,--max-column-count <N>
  *     -r,--max-row-size <N>
  *     -t,--tab-delim
- *     -O,--other-delim <C>
+ *     -O,--other-delim <C>: column delimiter of up to ZSV_DELIMITER_MAX bytes
+ *     -E,--row-terminator <string>: end rows with this string instead of a newline
+ *     -Q,--quote-char <C>: quote char, if not dbl-quote
+ *     -X,--escape-char <C>: escape char e.g. '\\'
  *     -q,--no-quote
  *     -R,--skip-head <n>: skip specified number of initial rows
  *     -d,--header-row-span <n> : apply header depth (rowspan) of n
@@ -124,6 +127,7 @@ void zsv_set_default_completed_callback(zsv_completed_callback cb, void *ctx) {
  * input (default for "desc" command is '?') -S,--keep-blank-headers  : disable default behavior of ignoring leading
  * blank rows -0,--header-row <header> : insert the provided CSV as the first row (in position 0) e.g. --header-row
  * 'col1,col2,\"my col 3\"'", -v,--verbose
+ *     --stats: print parser statistics to stderr when done (see zsv_get_stats())
  *
  * @param  argc      count of args to process
  * @param  argv      args to process
@@ -142,9 +146,9 @@ ZSV_EXPORT
 enum zsv_status zsv_args_to_opts(int argc, const char *argv[], int *argc_out, const char **argv_out,
                                  struct zsv_opts *opts_out, char *opts_used) {
 #ifdef ZSV_EXTRAS
-  static const char *short_args = "BcrtOqvRdSu0L";
+  static const char *short_args = "BcrtOqvRdSu0EQXL";
 #else
-  static const char *short_args = "BcrtOqvRdSu0";
+  static const char *short_args = "BcrtOqvRdSu0EQX";
 #endif
   assert(strlen(short_args) < ZSV_OPTS_SIZE_MAX);
 
@@ -161,6 +165,9 @@ enum zsv_status zsv_args_to_opts(int argc, const char *argv[], int *argc_out, co
     "keep-blank-headers",
     "malformed-utf8-replacement",
     "header-row",
+    "row-terminator",
+    "quote-char",
+    "escape-char",
 #ifdef ZSV_EXTRAS
     "limit-rows",
 #endif
@@ -184,6 +191,10 @@ enum zsv_status zsv_args_to_opts(int argc, const char *argv[], int *argc_out, co
       argv_out[new_argc++] = argv[i];
       continue;
     }
+    if (!strcmp(argv[i], "--stats")) { /* long-only, so that no command loses a short option */
+      opts_out->stats = 1;
+      continue;
+    }
     unsigned found_ix = 0;
     if (argv[i][1] != '-') {
       char *strchr_result;
@@ -221,17 +232,39 @@ enum zsv_status zsv_args_to_opts(int argc, const char *argv[], int *argc_out, co
     case 'd':
     case 'u':
     case '0':
+    case 'E':
+    case 'Q':
+    case 'X':
       if (++i >= argc)
         err = fprintf(stderr, "Error: option %s requires a value\n", argv[i - 1]);
       else {
         const char *val = argv[i];
         if (arg == 'O') {
-          if (strlen(val) != 1 || *val == 0)
-            err = fprintf(stderr, "Error: delimiter '%s' may only be a single ascii character", val);
-          else if (strchr("\n\r\"", *val))
-            err = fprintf(stderr, "Error: column delimiter may not be '\\n', '\\r' or '\"'\n");
+          if (*val == 0 || strlen(val) > ZSV_DELIMITER_MAX)
+            err = fprintf(stderr, "Error: delimiter '%s' must be between 1 and %i bytes\n", val, ZSV_DELIMITER_MAX);
+          else if (strpbrk(val, "\n\r\""))
+            err = fprintf(stderr, "Error: column delimiter may not contain '\\n', '\\r' or '\"'\n");
+          else if (val[1])
+            opts_out->delimiter_string = val;
           else
             opts_out->delimiter = *val;
+        } else if (arg == 'E') {
+          if (*val == 0 || strlen(val) > ZSV_DELIMITER_MAX)
+            err =
+              fprintf(stderr, "Error: row terminator '%s' must be between 1 and %i bytes\n", val, ZSV_DELIMITER_MAX);
+          else if (strchr(val, '"'))
+            err = fprintf(stderr, "Error: row terminator may not contain '\"'\n");
+          else
+            opts_out->row_terminator = val;
+        } else if (arg == 'Q' || arg == 'X') {
+          if (strlen(val) != 1 || *val < 0)
+            err = fprintf(stderr, "Error: %s value must be a single ascii char\n", argv[i - 1]);
+          else if (strchr("\n\r", *val))
+            err = fprintf(stderr, "Error: %s value may not be '\\n' or '\\r'\n", argv[i - 1]);
+          else if (arg == 'Q')
+            opts_out->quote_char = *val;
+          else
+            opts_out->escape_char = *val;
         } else if (arg == 'u') {
           if (!strcmp(val, "none"))
             opts_out->malformed_utf8_replace = ZSV_MALFORMED_UTF8_DO_NOT_REPLACE;
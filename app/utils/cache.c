@@ -4,6 +4,7 @@
 #include <unistd.h> // unlink()
 
 #include <errno.h>
+#include <zsv.h>
 #include <zsv/utils/cache.h>
 #include <zsv/utils/jq.h>
 
@@ -15,6 +16,7 @@
 #include <zsv/utils/err.h>
 #include <zsv/utils/dirs.h>
 #include <zsv/utils/file.h>
+#include <zsv/utils/decompress.h>
 
 static const char *zsv_cache_type_name(enum zsv_cache_type t) {
   switch (t) {
@@ -22,11 +24,17 @@ static const char *zsv_cache_type_name(enum zsv_cache_type t) {
     return ZSV_CACHE_PROPERTIES_NAME;
   case zsv_cache_type_tag:
     return "tag";
+  case zsv_cache_type_row_index:
+    return ZSV_CACHE_ROW_INDEX_NAME;
   default:
     return NULL;
   }
 }
 
+static const char *zsv_cache_type_ext(enum zsv_cache_type t) {
+  return t == zsv_cache_type_row_index ? ".idx" : ".json";
+}
+
 unsigned char *zsv_cache_filepath(const unsigned char *data_filepath, enum zsv_cache_type type, char create_dir,
                                   char temp_file) {
   if (!data_filepath || !*data_filepath)
@@ -39,7 +47,8 @@ unsigned char *zsv_cache_filepath(const unsigned char *data_filepath, enum zsv_c
   }
 
   unsigned char *cache_filename;
-  asprintf((char **)&cache_filename, "%s.json%s", cache_filename_base, temp_file ? ZSV_TEMPFILE_SUFFIX : "");
+  asprintf((char **)&cache_filename, "%s%s%s", cache_filename_base, zsv_cache_type_ext(type),
+           temp_file ? ZSV_TEMPFILE_SUFFIX : "");
 
   unsigned char *s = cache_filename ? zsv_cache_path(data_filepath, cache_filename, 0) : NULL;
   if (s && create_dir) {
@@ -113,6 +122,40 @@ int zsv_cache_remove(const unsigned char *filepath, enum zsv_cache_type ctype) {
   return err;
 }
 
+enum zsv_status zsv_cache_row_index(const char *data_filepath, struct zsv_opts *opts, zsv_parser parser,
+                                    struct zsv_row_index **index) {
+  if (zsv_file_compression(data_filepath) != zsv_compression_none)
+    return zsv_status_invalid_option; // offsets of decompressed rows cannot be sought
+  unsigned char *fn = zsv_cache_filepath((const unsigned char *)data_filepath, zsv_cache_type_row_index, 0, 0);
+  if (!fn)
+    return zsv_status_memory;
+
+  enum zsv_status stat = zsv_row_index_load((const char *)fn, data_filepath, index);
+  if (stat == zsv_status_ok && (stat = zsv_set_row_index(parser, *index)) != zsv_status_ok) {
+    // e.g. the index was built with other options
+    zsv_row_index_delete(*index);
+    *index = NULL;
+  }
+  if (stat != zsv_status_ok) {
+    if (opts->verbose)
+      fprintf(stderr, "Indexing rows of %s\n", data_filepath);
+    if ((stat = zsv_index_rows(data_filepath, opts, 0, index)) == zsv_status_ok &&
+        (stat = zsv_set_row_index(parser, *index)) == zsv_status_ok) {
+      // the index is only a cache: if it cannot be saved, it is rebuilt next time
+      unsigned char *tmp_fn = zsv_cache_filepath((const unsigned char *)data_filepath, zsv_cache_type_row_index, 1, 1);
+      if (!tmp_fn || zsv_row_index_save(*index, (const char *)tmp_fn) != zsv_status_ok ||
+          zsv_replace_file(tmp_fn, fn))
+        fprintf(stderr, "Warning: unable to save %s\n", fn);
+      free(tmp_fn);
+    } else {
+      zsv_row_index_delete(*index);
+      *index = NULL;
+    }
+  }
+  free(fn);
+  return stat;
+}
+
 /*
  * modify a JSON cache file, write to tmp file, then replace the cache file
  */
@@ -0,0 +1,667 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Decompressing reader (see zsv_decompressor_new())
+ *
+ * Compressed input is read in chunks into an input buffer, and decoded with
+ * zlib (gzip), libbz2 (bzip2) or libzstd (zstd), whichever of them this build
+ * was configured with (HAVE_ZLIB_H, HAVE_BZLIB_H, HAVE_ZSTD_H), directly into
+ * the buffer that is passed to zsv_decompress_read(). Concatenated gzip members
+ * and bzip2 streams are decoded as a single input, as with gunzip and bunzip2
+ *
+ * A zstd input that consists of several frames (e.g. as written by pzstd, or
+ * by concatenating .zst files) is instead decoded by a pool of threads: whole
+ * frames are batched into jobs of at least ZSV_ZSTD_JOB_MIN compressed bytes,
+ * each job is decoded into its own output buffer on the next free thread, and
+ * the output of each job is handed over in order. If a frame does not end
+ * within ZSV_ZSTD_FRAME_MAX bytes (e.g. a single-frame file), the rest of the
+ * input is decoded by the calling thread instead
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zsv/utils/decompress.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZLIB_H
+#include <bzlib.h>
+#endif
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#ifndef NO_THREADING
+#include <pthread.h>
+#define ZSV_ZSTD_PARALLEL
+#endif
+#endif
+
+#if defined(HAVE_ZLIB_H) || defined(HAVE_BZLIB_H) || defined(HAVE_ZSTD_H)
+#define ZSV_HAVE_DECOMPRESSION
+#endif
+
+#define ZSV_DECOMPRESS_IN_SIZE (128 * 1024)
+#define ZSV_ZSTD_JOB_MIN (1024 * 1024)
+#define ZSV_ZSTD_FRAME_MAX (8 * 1024 * 1024)
+
+#ifdef ZSV_ZSTD_PARALLEL
+struct zsv_zstd_job {
+  unsigned char *src; // compressed frames
+  size_t src_len;
+  size_t src_size;
+  unsigned char *out; // decompressed data
+  size_t out_len;
+  size_t out_size;
+  size_t out_pos; // number of bytes of out that have been read
+  char done;      // set by the decoding thread while it holds the mutex
+  char error;     // set by the decoding thread before done
+};
+
+struct zsv_zstd_pool {
+  pthread_t *threads;
+  unsigned thread_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  struct zsv_zstd_job *jobs;
+  unsigned job_count;
+  size_t submitted; // number of jobs queued so far
+  size_t taken;     // number of jobs picked up by a thread so far
+  size_t consumed;  // number of jobs whose output has been read so far
+  char stop;
+  char streaming; // the rest of the input is decoded without the pool (only used by the reading thread)
+};
+#endif
+
+struct zsv_decompressor {
+  FILE *f;
+  enum zsv_compression type;
+
+  unsigned char *in; // buffered input that has been read but not yet decoded
+  size_t in_size;
+  size_t in_start;
+  size_t in_end;
+
+  union {
+#ifdef HAVE_ZLIB_H
+    z_stream gz;
+#endif
+#ifdef HAVE_BZLIB_H
+    bz_stream bz;
+#endif
+#ifdef HAVE_ZSTD_H
+    ZSTD_DCtx *zstd;
+#endif
+    char none;
+  } s;
+#ifdef ZSV_ZSTD_PARALLEL
+  struct zsv_zstd_pool *pool;
+#endif
+  size_t zstd_pending; // last value returned by ZSTD_decompressStream()
+
+  unsigned char initialized : 1; // s has been initialized
+  unsigned char eof : 1;         // f has no more input
+  unsigned char done : 1;        // no more output
+  unsigned char error : 1;       // the input is corrupt or truncated
+  unsigned char _ : 4;
+};
+
+enum zsv_compression zsv_compression_detect(const unsigned char *buff, size_t len) {
+  if (len >= 2 && buff[0] == 0x1f && buff[1] == 0x8b)
+    return zsv_compression_gzip;
+  if (len >= 4 && buff[0] == 0x28 && buff[1] == 0xb5 && buff[2] == 0x2f && buff[3] == 0xfd)
+    return zsv_compression_zstd;
+  // a zstd skippable frame, which may precede the first zstd frame
+  if (len >= 4 && (buff[0] & 0xf0) == 0x50 && buff[1] == 0x2a && buff[2] == 0x4d && buff[3] == 0x18)
+    return zsv_compression_zstd;
+  if (len >= 4 && buff[0] == 'B' && buff[1] == 'Z' && buff[2] == 'h' && buff[3] >= '1' && buff[3] <= '9')
+    return zsv_compression_bzip2;
+  return zsv_compression_none;
+}
+
+enum zsv_compression zsv_file_compression(const char *filepath) {
+  enum zsv_compression compression = zsv_compression_none;
+  FILE *f = filepath ? fopen(filepath, "rb") : NULL;
+  if (f) {
+    unsigned char magic[4];
+    compression = zsv_compression_detect(magic, fread(magic, 1, sizeof(magic), f));
+    fclose(f);
+  }
+  return compression;
+}
+
+const char *zsv_compression_name(enum zsv_compression compression) {
+  switch (compression) {
+  case zsv_compression_gzip:
+    return "gzip";
+  case zsv_compression_zstd:
+    return "zstd";
+  case zsv_compression_bzip2:
+    return "bzip2";
+  case zsv_compression_none:
+    break;
+  }
+  return "uncompressed";
+}
+
+char zsv_compression_supported(enum zsv_compression compression) {
+  switch (compression) {
+  case zsv_compression_none:
+    return 1;
+  case zsv_compression_gzip:
+#ifdef HAVE_ZLIB_H
+    return 1;
+#else
+    return 0;
+#endif
+  case zsv_compression_zstd:
+#ifdef HAVE_ZSTD_H
+    return 1;
+#else
+    return 0;
+#endif
+  case zsv_compression_bzip2:
+#ifdef HAVE_BZLIB_H
+    return 1;
+#else
+    return 0;
+#endif
+  }
+  return 0;
+}
+
+#ifdef ZSV_HAVE_DECOMPRESSION
+static void zsv_decompress_error(struct zsv_decompressor *d, const char *msg) {
+  fprintf(stderr, "Error decompressing %s input: %s\n", zsv_compression_name(d->type), msg);
+  d->done = 1;
+  d->error = 1;
+}
+
+/**
+ * Read more input, after any input that has not yet been decoded
+ * @return number of bytes that are available to decode
+ */
+static size_t zsv_decompress_fill(struct zsv_decompressor *d) {
+  if (d->in_start) {
+    memmove(d->in, d->in + d->in_start, d->in_end - d->in_start);
+    d->in_end -= d->in_start;
+    d->in_start = 0;
+  }
+  if (!d->eof && d->in_end < d->in_size) {
+    size_t got = fread(d->in + d->in_end, 1, d->in_size - d->in_end, d->f);
+    if (got == 0)
+      d->eof = 1;
+    d->in_end += got;
+  }
+  return d->in_end - d->in_start;
+}
+
+/**
+ * Get the number of bytes that are available to decode, reading more if none are
+ */
+static size_t zsv_decompress_input(struct zsv_decompressor *d) {
+  if (d->in_start == d->in_end)
+    return zsv_decompress_fill(d);
+  return d->in_end - d->in_start;
+}
+#endif
+
+static size_t zsv_passthrough_read(struct zsv_decompressor *d, unsigned char *buff, size_t len) {
+  size_t n = d->in_end - d->in_start;
+  if (n > len)
+    n = len;
+  memcpy(buff, d->in + d->in_start, n);
+  d->in_start += n;
+  if (n < len && !d->eof)
+    n += fread(buff + n, 1, len - n, d->f);
+  return n;
+}
+
+#ifdef HAVE_ZLIB_H
+static size_t zsv_gzip_read(struct zsv_decompressor *d, unsigned char *buff, size_t len) {
+  z_stream *z = &d->s.gz;
+  z->next_out = buff;
+  z->avail_out = (uInt)(len > UINT32_MAX ? UINT32_MAX : len);
+  while (z->avail_out && !d->done) {
+    size_t avail = zsv_decompress_input(d);
+    uInt avail_out = z->avail_out;
+    z->next_in = d->in + d->in_start;
+    z->avail_in = (uInt)(avail > UINT32_MAX ? UINT32_MAX : avail);
+    int rc = inflate(z, Z_NO_FLUSH);
+    d->in_start = (size_t)(z->next_in - d->in);
+    if (rc == Z_STREAM_END) {
+      // continue with the next gzip member, if any; ignore any other trailing data
+      size_t n = zsv_decompress_input(d);
+      if (n < 2 && !d->eof)
+        n = zsv_decompress_fill(d);
+      if (zsv_compression_detect(d->in + d->in_start, n) == zsv_compression_gzip)
+        inflateReset(z);
+      else
+        d->done = 1;
+    } else if (rc != Z_OK && rc != Z_BUF_ERROR)
+      zsv_decompress_error(d, z->msg ? z->msg : "invalid data");
+    else if (!avail && z->avail_out == avail_out)
+      zsv_decompress_error(d, "unexpected end of input");
+  }
+  return (size_t)(z->next_out - buff);
+}
+#endif
+
+#ifdef HAVE_BZLIB_H
+static size_t zsv_bzip2_read(struct zsv_decompressor *d, unsigned char *buff, size_t len) {
+  bz_stream *bz = &d->s.bz;
+  char *next_out = (char *)buff;
+  unsigned avail_out = (unsigned)(len > UINT32_MAX ? UINT32_MAX : len);
+  while (avail_out && !d->done) {
+    size_t avail = zsv_decompress_input(d);
+    bz->next_out = next_out;
+    bz->avail_out = avail_out;
+    bz->next_in = (char *)d->in + d->in_start;
+    bz->avail_in = (unsigned)(avail > UINT32_MAX ? UINT32_MAX : avail);
+    int rc = BZ2_bzDecompress(bz);
+    d->in_start = (size_t)((unsigned char *)bz->next_in - d->in);
+    char progress = bz->avail_out != avail_out;
+    next_out = bz->next_out;
+    avail_out = bz->avail_out;
+    if (rc == BZ_STREAM_END) {
+      // continue with the next bzip2 stream, if any (e.g. as written by pbzip2)
+      size_t n = zsv_decompress_input(d);
+      if (n < 4 && !d->eof)
+        n = zsv_decompress_fill(d);
+      BZ2_bzDecompressEnd(bz);
+      d->initialized = 0;
+      if (zsv_compression_detect(d->in + d->in_start, n) != zsv_compression_bzip2)
+        d->done = 1;
+      else if (BZ2_bzDecompressInit(bz, 0, 0) != BZ_OK)
+        zsv_decompress_error(d, "out of memory");
+      else
+        d->initialized = 1;
+    } else if (rc != BZ_OK)
+      zsv_decompress_error(d, rc == BZ_MEM_ERROR ? "out of memory" : "invalid data");
+    else if (!avail && !progress)
+      zsv_decompress_error(d, "unexpected end of input");
+  }
+  return (size_t)(next_out - (char *)buff);
+}
+#endif
+
+#ifdef HAVE_ZSTD_H
+static size_t zsv_zstd_stream_read(struct zsv_decompressor *d, unsigned char *buff, size_t len) {
+  ZSTD_outBuffer out = {buff, len, 0};
+  while (out.pos < out.size && !d->done) {
+    size_t avail = zsv_decompress_input(d);
+    if (!avail && !d->zstd_pending) { // the last frame was complete
+      d->done = 1;
+      break;
+    }
+    size_t out_pos = out.pos;
+    ZSTD_inBuffer in = {d->in, d->in_end, d->in_start};
+    size_t rc = ZSTD_decompressStream(d->s.zstd, &out, &in);
+    d->in_start = in.pos;
+    if (ZSTD_isError(rc))
+      zsv_decompress_error(d, ZSTD_getErrorName(rc));
+    else if (!avail && out.pos == out_pos)
+      zsv_decompress_error(d, "unexpected end of input");
+    else
+      d->zstd_pending = rc;
+  }
+  return out.pos;
+}
+
+#ifdef ZSV_ZSTD_PARALLEL
+/**
+ * Decode all of the frames of a job into its output buffer
+ */
+static void zsv_zstd_job_run(ZSTD_DCtx *dctx, struct zsv_zstd_job *job) {
+  ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+  ZSTD_inBuffer in = {job->src, job->src_len, 0};
+  size_t rc = 1;
+  job->out_len = job->out_pos = 0;
+  while (in.pos < in.size || rc) {
+    if (job->out_len == job->out_size) {
+      size_t new_size = job->out_size ? job->out_size * 2 : job->src_len * 4 + ZSTD_DStreamOutSize();
+      unsigned char *out = realloc(job->out, new_size);
+      if (!out) {
+        job->error = 1;
+        return;
+      }
+      job->out = out;
+      job->out_size = new_size;
+    }
+    ZSTD_outBuffer out = {job->out, job->out_size, job->out_len};
+    rc = ZSTD_decompressStream(dctx, &out, &in);
+    job->out_len = out.pos;
+    if (ZSTD_isError(rc) || (rc && in.pos == in.size && out.pos < out.size)) {
+      job->error = 1;
+      return;
+    }
+  }
+}
+
+static void *zsv_zstd_thread(void *arg) {
+  struct zsv_zstd_pool *pool = arg;
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    while (!pool->stop && pool->taken == pool->submitted)
+      pthread_cond_wait(&pool->cond, &pool->mutex);
+    if (pool->stop)
+      break;
+    struct zsv_zstd_job *job = &pool->jobs[pool->taken++ % pool->job_count];
+    pthread_mutex_unlock(&pool->mutex);
+    if (dctx)
+      zsv_zstd_job_run(dctx, job);
+    else
+      job->error = 1;
+    pthread_mutex_lock(&pool->mutex);
+    job->done = 1;
+    pthread_cond_broadcast(&pool->cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  ZSTD_freeDCtx(dctx);
+  return NULL;
+}
+
+static void zsv_zstd_pool_delete(struct zsv_zstd_pool *pool) {
+  if (pool) {
+    if (pool->threads) {
+      pthread_mutex_lock(&pool->mutex);
+      pool->stop = 1;
+      pthread_cond_broadcast(&pool->cond);
+      pthread_mutex_unlock(&pool->mutex);
+      for (unsigned i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+      free(pool->threads);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    for (unsigned i = 0; pool->jobs && i < pool->job_count; i++) {
+      free(pool->jobs[i].src);
+      free(pool->jobs[i].out);
+    }
+    free(pool->jobs);
+    free(pool);
+  }
+}
+
+static struct zsv_zstd_pool *zsv_zstd_pool_new(unsigned threads) {
+  struct zsv_zstd_pool *pool = calloc(1, sizeof(*pool));
+  if (!pool)
+    return NULL;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+  pool->job_count = threads * 2;
+  if (!(pool->jobs = calloc(pool->job_count, sizeof(*pool->jobs))) ||
+      !(pool->threads = calloc(threads, sizeof(*pool->threads)))) {
+    zsv_zstd_pool_delete(pool);
+    return NULL;
+  }
+  for (; pool->thread_count < threads; pool->thread_count++)
+    if (pthread_create(&pool->threads[pool->thread_count], NULL, zsv_zstd_thread, pool))
+      break;
+  if (!pool->thread_count) {
+    zsv_zstd_pool_delete(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/**
+ * Get the size of the next whole frame in the input, reading more as needed
+ * @return size of the frame, or 0 if the input has ended or the frame does not
+ *         end within ZSV_ZSTD_FRAME_MAX bytes, or is invalid
+ */
+static size_t zsv_zstd_next_frame(struct zsv_decompressor *d, size_t offset) {
+  while (1) {
+    size_t avail = d->in_end - d->in_start - offset;
+    size_t frame_size = avail ? ZSTD_findFrameCompressedSize(d->in + d->in_start + offset, avail) : 0;
+    if (avail && !ZSTD_isError(frame_size))
+      return frame_size;
+    if (d->eof || offset + avail >= ZSV_ZSTD_FRAME_MAX)
+      return 0;
+    if (d->in_start == 0 && d->in_end == d->in_size) { // the buffer is full: grow it
+      unsigned char *in = realloc(d->in, d->in_size * 2);
+      if (!in)
+        return 0;
+      d->in = in;
+      d->in_size *= 2;
+    }
+    zsv_decompress_fill(d);
+  }
+}
+
+/**
+ * Queue the next job, with as many whole frames as are available up to ZSV_ZSTD_JOB_MIN bytes
+ * @return 1 if a job was queued
+ */
+static int zsv_zstd_submit(struct zsv_decompressor *d) {
+  struct zsv_zstd_pool *pool = d->pool;
+  size_t len = 0, frame_size;
+  while (len < ZSV_ZSTD_JOB_MIN && (frame_size = zsv_zstd_next_frame(d, len)))
+    len += frame_size;
+  if (!len) {
+    // end of input, or a frame that is too large for the pool (or invalid)
+    pool->streaming = 1;
+    return 0;
+  }
+
+  struct zsv_zstd_job *job = &pool->jobs[pool->submitted % pool->job_count];
+  if (job->src_size < len) {
+    unsigned char *src = realloc(job->src, len);
+    if (!src) {
+      pool->streaming = 1;
+      return 0;
+    }
+    job->src = src;
+    job->src_size = len;
+  }
+  memcpy(job->src, d->in + d->in_start, len);
+  job->src_len = len;
+  d->in_start += len;
+
+  pthread_mutex_lock(&pool->mutex);
+  job->done = job->error = 0;
+  pool->submitted++;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+  return 1;
+}
+
+static size_t zsv_zstd_parallel_read(struct zsv_decompressor *d, unsigned char *buff, size_t len) {
+  struct zsv_zstd_pool *pool = d->pool;
+  size_t produced = 0;
+  while (produced < len && !d->done) {
+    while (!pool->streaming && pool->submitted - pool->consumed < pool->job_count)
+      if (!zsv_zstd_submit(d))
+        break;
+    if (pool->consumed == pool->submitted) {
+      // all of the jobs have been read: decode the rest here, if any
+      produced += zsv_zstd_stream_read(d, buff + produced, len - produced);
+      break;
+    }
+
+    struct zsv_zstd_job *job = &pool->jobs[pool->consumed % pool->job_count];
+    pthread_mutex_lock(&pool->mutex);
+    while (!job->done)
+      pthread_cond_wait(&pool->cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    if (job->error) {
+      zsv_decompress_error(d, "invalid data");
+      break;
+    }
+    size_t n = job->out_len - job->out_pos;
+    if (n > len - produced)
+      n = len - produced;
+    memcpy(buff + produced, job->out + job->out_pos, n);
+    job->out_pos += n;
+    produced += n;
+    if (job->out_pos == job->out_len)
+      pool->consumed++;
+  }
+  return produced;
+}
+#endif // ZSV_ZSTD_PARALLEL
+#endif // HAVE_ZSTD_H
+
+size_t zsv_decompress_read(void *restrict buff, size_t size, size_t n, void *restrict stream) {
+  struct zsv_decompressor *d = stream;
+  size_t len = size * n;
+  if (d->type == zsv_compression_none)
+    return zsv_passthrough_read(d, buff, len) / size;
+  if (d->done || !len)
+    return 0;
+  size_t got = 0;
+  switch (d->type) {
+#ifdef HAVE_ZLIB_H
+  case zsv_compression_gzip:
+    got = zsv_gzip_read(d, buff, len);
+    break;
+#endif
+#ifdef HAVE_BZLIB_H
+  case zsv_compression_bzip2:
+    got = zsv_bzip2_read(d, buff, len);
+    break;
+#endif
+#ifdef HAVE_ZSTD_H
+  case zsv_compression_zstd:
+#ifdef ZSV_ZSTD_PARALLEL
+    if (d->pool) {
+      got = zsv_zstd_parallel_read(d, buff, len);
+      break;
+    }
+#endif
+    got = zsv_zstd_stream_read(d, buff, len);
+    break;
+#endif
+  default:
+    break;
+  }
+  return got / size;
+}
+
+void zsv_decompressor_delete(void *p) {
+  struct zsv_decompressor *d = p;
+  if (d) {
+    if (d->initialized) {
+      switch (d->type) {
+#ifdef HAVE_ZLIB_H
+      case zsv_compression_gzip:
+        inflateEnd(&d->s.gz);
+        break;
+#endif
+#ifdef HAVE_BZLIB_H
+      case zsv_compression_bzip2:
+        BZ2_bzDecompressEnd(&d->s.bz);
+        break;
+#endif
+#ifdef HAVE_ZSTD_H
+      case zsv_compression_zstd:
+        ZSTD_freeDCtx(d->s.zstd);
+        break;
+#endif
+      default:
+        break;
+      }
+    }
+#ifdef ZSV_ZSTD_PARALLEL
+    zsv_zstd_pool_delete(d->pool);
+#endif
+    free(d->in);
+    free(d);
+  }
+}
+
+enum zsv_compression zsv_decompressor_type(struct zsv_decompressor *d) {
+  return d ? d->type : zsv_compression_none;
+}
+
+int zsv_decompressor_error(void *p) {
+  struct zsv_decompressor *d = p;
+  return d && d->error;
+}
+
+#ifdef ZSV_ZSTD_PARALLEL
+static unsigned zsv_decompress_threads(unsigned threads) {
+  if (!threads) {
+    const char *s = getenv("ZSV_DECOMPRESS_THREADS");
+    if (s && *s)
+      threads = (unsigned)atoi(s);
+    else {
+#ifdef _SC_NPROCESSORS_ONLN
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      threads = n > 0 ? (unsigned)n : 1;
+#else
+      threads = 1;
+#endif
+    }
+  }
+  return threads > ZSV_DECOMPRESS_THREADS_MAX ? ZSV_DECOMPRESS_THREADS_MAX : threads;
+}
+#endif
+
+enum zsv_status zsv_decompressor_new(FILE *f, unsigned threads, struct zsv_decompressor **dp) {
+  *dp = NULL;
+  unsigned char magic[4];
+  size_t magic_len = fread(magic, 1, sizeof(magic), f);
+  enum zsv_compression type = zsv_compression_detect(magic, magic_len);
+  if (type == zsv_compression_none && (!magic_len || !fseeko(f, -(off_t)magic_len, SEEK_CUR)))
+    return zsv_status_ok;
+  if (!zsv_compression_supported(type))
+    return zsv_status_invalid_option;
+
+  struct zsv_decompressor *d = calloc(1, sizeof(*d));
+  if (!d || !(d->in = malloc(ZSV_DECOMPRESS_IN_SIZE))) {
+    free(d);
+    return zsv_status_memory;
+  }
+  d->f = f;
+  d->type = type;
+  d->in_size = ZSV_DECOMPRESS_IN_SIZE;
+  memcpy(d->in, magic, magic_len);
+  d->in_end = magic_len;
+
+  char ok = 1;
+  switch (type) {
+#ifdef HAVE_ZLIB_H
+  case zsv_compression_gzip:
+    ok = inflateInit2(&d->s.gz, 15 + 16) == Z_OK;
+    break;
+#endif
+#ifdef HAVE_BZLIB_H
+  case zsv_compression_bzip2:
+    ok = BZ2_bzDecompressInit(&d->s.bz, 0, 0) == BZ_OK;
+    break;
+#endif
+#ifdef HAVE_ZSTD_H
+  case zsv_compression_zstd:
+    ok = (d->s.zstd = ZSTD_createDCtx()) != NULL;
+#ifdef ZSV_ZSTD_PARALLEL
+    threads = zsv_decompress_threads(threads);
+    if (ok && threads > 1)
+      d->pool = zsv_zstd_pool_new(threads); // if NULL, decode on this thread
+#else
+    (void)(threads);
+#endif
+    break;
+#endif
+  default:
+    (void)(threads);
+    break;
+  }
+  d->initialized = ok && type != zsv_compression_none;
+  if (!ok) {
+    zsv_decompressor_delete(d);
+    return zsv_status_memory;
+  }
+  *dp = d;
+  return zsv_status_ok;
+}
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Removal of duplicate rows (see zsv_dedupe_new())
+ *
+ * Keys are hashed 8 bytes at a time (with the MurmurHash3 mixing steps) into a
+ * 64-bit hash, which is stored with a pointer to the key in an open-addressing
+ * table with linear probing, so that a probe only compares keys whose hashes
+ * are equal. The keys themselves are copied, each after its length, into large
+ * blocks of memory
+ *
+ * Once the table and its blocks reach the memory limit, the table is frozen and
+ * each row whose key is not in it is appended to one of ZSV_DEDUPE_PARTITIONS
+ * temporary files, chosen by the top bits of its key's hash, so that all the rows
+ * with a given key end up in the same file. After the last row, each file is
+ * deduplicated in turn with a new table (in memory, as it holds only a fraction
+ * of the rows), into a second file of the rows that are the first with their
+ * key; as these are in order of row number, merging them restores that order
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsv/utils/dedupe.h>
+
+#define ZSV_DEDUPE_PARTITION_BITS 6
+#define ZSV_DEDUPE_PARTITIONS (1 << ZSV_DEDUPE_PARTITION_BITS)
+#define ZSV_DEDUPE_INITIAL_CAPACITY 1024 // a power of 2
+#define ZSV_DEDUPE_BLOCK_SIZE (1024 * 1024)
+
+struct zsv_dedupe_slot {
+  uint64_t hash;            // 0 if the slot is empty
+  const unsigned char *key; // the key's length (a size_t), then the key
+};
+
+struct zsv_dedupe_block {
+  struct zsv_dedupe_block *next;
+  size_t used;
+  size_t size;
+  unsigned char data[];
+};
+
+struct zsv_dedupe_set {
+  struct zsv_dedupe_slot *slots;
+  size_t count;
+  size_t capacity; // a power of 2
+  struct zsv_dedupe_block *blocks;
+  size_t memory; // bytes allocated for slots and blocks
+};
+
+// header of a row in a temporary file, followed by its key and data
+struct zsv_dedupe_record {
+  size_t row_number;
+  size_t key_len;
+  size_t len;
+};
+
+struct zsv_dedupe {
+  struct zsv_dedupe_opts opts;
+  struct zsv_dedupe_set set;
+
+  uint64_t *bloom;   // 512-bit blocks, with one bit per 8 bits of set.capacity
+  size_t bloom_mask; // number of blocks - 1
+
+  FILE *partitions[ZSV_DEDUPE_PARTITIONS];
+  char spilling; // the set is full and rows whose key is not in it are deferred
+};
+
+static inline uint64_t zsv_dedupe_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t zsv_dedupe_mix(uint64_t k) {
+  k *= 0x87c37b91114253d5;
+  k = zsv_dedupe_rotl(k, 31);
+  return k * 0x4cf5ad432745937f;
+}
+
+static uint64_t zsv_dedupe_hash(const unsigned char *s, size_t len) {
+  uint64_t h = 0x9e3779b97f4a7c15 ^ len;
+  for (; len >= 8; s += 8, len -= 8) {
+    uint64_t k;
+    memcpy(&k, s, 8);
+    h ^= zsv_dedupe_mix(k);
+    h = zsv_dedupe_rotl(h, 27) * 5 + 0x52dce729;
+  }
+  if (len) {
+    uint64_t k = 0;
+    memcpy(&k, s, len);
+    h ^= zsv_dedupe_mix(k);
+  }
+  // finalizer, so that every bit of the hash depends on every bit of the key
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccd;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= h >> 33;
+  return h ? h : 1;
+}
+
+static void zsv_dedupe_set_free(struct zsv_dedupe_set *set) {
+  for (struct zsv_dedupe_block *next; set->blocks; set->blocks = next) {
+    next = set->blocks->next;
+    free(set->blocks);
+  }
+  free(set->slots);
+  memset(set, 0, sizeof(*set));
+}
+
+// zsv_dedupe_set_find(): get the slot of the given key, or the empty slot where it would go
+static size_t zsv_dedupe_set_find(const struct zsv_dedupe_set *set, uint64_t hash, const unsigned char *key,
+                                  size_t len) {
+  size_t mask = set->capacity - 1;
+  size_t i = hash & mask;
+  for (const struct zsv_dedupe_slot *slot; (slot = &set->slots[i])->hash; i = (i + 1) & mask) {
+    if (slot->hash == hash) {
+      size_t slot_len;
+      memcpy(&slot_len, slot->key, sizeof(slot_len));
+      if (slot_len == len && !memcmp(slot->key + sizeof(slot_len), key, len))
+        break;
+    }
+  }
+  return i;
+}
+
+static int zsv_dedupe_set_grow(struct zsv_dedupe_set *set, size_t max_memory) {
+  size_t capacity = set->capacity ? set->capacity * 2 : ZSV_DEDUPE_INITIAL_CAPACITY;
+  if (max_memory && set->memory + capacity * sizeof(*set->slots) > max_memory)
+    return 1;
+  struct zsv_dedupe_slot *slots = calloc(capacity, sizeof(*slots));
+  if (!slots)
+    return 1;
+  for (size_t i = 0; i < set->capacity; i++) {
+    if (set->slots[i].hash) {
+      size_t j = set->slots[i].hash & (capacity - 1);
+      while (slots[j].hash)
+        j = (j + 1) & (capacity - 1);
+      slots[j] = set->slots[i];
+    }
+  }
+  free(set->slots);
+  set->memory += (capacity - set->capacity) * sizeof(*slots);
+  set->slots = slots;
+  set->capacity = capacity;
+  return 0;
+}
+
+// zsv_dedupe_set_copy(): copy a key, after its length, into a block
+static const unsigned char *zsv_dedupe_set_copy(struct zsv_dedupe_set *set, const unsigned char *key, size_t len,
+                                                size_t max_memory) {
+  size_t n = sizeof(len) + len;
+  struct zsv_dedupe_block *b = set->blocks;
+  if (!b || b->size - b->used < n) {
+    size_t size = max_memory && max_memory / 16 < ZSV_DEDUPE_BLOCK_SIZE ? max_memory / 16 : ZSV_DEDUPE_BLOCK_SIZE;
+    if (size < n)
+      size = n;
+    if (max_memory && set->memory + size > max_memory)
+      return NULL;
+    if (!(b = malloc(sizeof(*b) + size)))
+      return NULL;
+    b->used = 0;
+    b->size = size;
+    b->next = set->blocks;
+    set->blocks = b;
+    set->memory += size;
+  }
+  unsigned char *s = b->data + b->used;
+  memcpy(s, &len, sizeof(len));
+  if (len)
+    memcpy(s + sizeof(len), key, len);
+  b->used += n;
+  return s;
+}
+
+// zsv_dedupe_set_add(): add a key to a set, unless it is already there
+// return 0 if it was already there, 1 if it was added, or -1 if the set is full
+static int zsv_dedupe_set_add(struct zsv_dedupe_set *set, uint64_t hash, const unsigned char *key, size_t len,
+                              size_t max_memory) {
+  size_t i = 0;
+  if (set->capacity) {
+    i = zsv_dedupe_set_find(set, hash, key, len);
+    if (set->slots[i].hash)
+      return 0;
+  }
+  if ((set->count + 1) * 4 > set->capacity * 3) { // keep the table at most 3/4 full
+    if (zsv_dedupe_set_grow(set, max_memory))
+      return -1;
+    i = zsv_dedupe_set_find(set, hash, key, len);
+  }
+  const unsigned char *copy = zsv_dedupe_set_copy(set, key, len, max_memory);
+  if (!copy)
+    return -1;
+  set->slots[i].hash = hash;
+  set->slots[i].key = copy;
+  set->count++;
+  return 1;
+}
+
+// zsv_dedupe_bloom_bit(): get the i-th of the 6 bits, within a 512-bit block, that a hash sets
+static inline unsigned zsv_dedupe_bloom_bit(uint64_t hash, int i) {
+  return (unsigned)((hash * 0x9e3779b97f4a7c15) >> (i * 9)) & 511;
+}
+
+static void zsv_dedupe_bloom_add(struct zsv_dedupe *d, uint64_t hash) {
+  uint64_t *block = d->bloom + ((hash >> 32) & d->bloom_mask) * 8;
+  for (int i = 0; i < 6; i++) {
+    unsigned bit = zsv_dedupe_bloom_bit(hash, i);
+    block[bit / 64] |= (uint64_t)1 << (bit % 64);
+  }
+}
+
+static char zsv_dedupe_bloom_check(const struct zsv_dedupe *d, uint64_t hash) {
+  const uint64_t *block = d->bloom + ((hash >> 32) & d->bloom_mask) * 8;
+  for (int i = 0; i < 6; i++) {
+    unsigned bit = zsv_dedupe_bloom_bit(hash, i);
+    if (!(block[bit / 64] & ((uint64_t)1 << (bit % 64))))
+      return 0;
+  }
+  return 1;
+}
+
+// zsv_dedupe_bloom_init(): fill a bloom filter with the keys of the (frozen) set;
+// without one if there is not enough memory for it
+static void zsv_dedupe_bloom_init(struct zsv_dedupe *d) {
+  size_t blocks = d->set.capacity / 64;
+  if (!blocks || !(d->bloom = calloc(blocks * 8, sizeof(*d->bloom))))
+    return;
+  d->bloom_mask = blocks - 1;
+  for (size_t i = 0; i < d->set.capacity; i++)
+    if (d->set.slots[i].hash)
+      zsv_dedupe_bloom_add(d, d->set.slots[i].hash);
+}
+
+enum zsv_status zsv_dedupe_new(const struct zsv_dedupe_opts *opts, struct zsv_dedupe **dedupe) {
+  *dedupe = calloc(1, sizeof(**dedupe));
+  if (!*dedupe)
+    return zsv_status_memory;
+  if (opts)
+    (*dedupe)->opts = *opts;
+  return zsv_status_ok;
+}
+
+enum zsv_dedupe_result zsv_dedupe_offer(struct zsv_dedupe *d, const unsigned char *key, size_t key_len) {
+  uint64_t hash = zsv_dedupe_hash(key, key_len);
+  if (!d->spilling) {
+    int added = zsv_dedupe_set_add(&d->set, hash, key, key_len, d->opts.max_memory);
+    if (added >= 0)
+      return added ? zsv_dedupe_first : zsv_dedupe_duplicate;
+    d->spilling = 1;
+    if (d->opts.bloom)
+      zsv_dedupe_bloom_init(d);
+  }
+  if (d->bloom && !zsv_dedupe_bloom_check(d, hash))
+    return zsv_dedupe_deferred;
+  if (d->set.capacity && d->set.slots[zsv_dedupe_set_find(&d->set, hash, key, key_len)].hash)
+    return zsv_dedupe_duplicate;
+  return zsv_dedupe_deferred;
+}
+
+static enum zsv_status zsv_dedupe_write(FILE *f, const struct zsv_dedupe_record *r, const unsigned char *key,
+                                        const unsigned char *data) {
+  if (fwrite(r, sizeof(*r), 1, f) != 1 || (r->key_len && fwrite(key, r->key_len, 1, f) != 1) ||
+      (r->len && fwrite(data, r->len, 1, f) != 1))
+    return zsv_status_error;
+  return zsv_status_ok;
+}
+
+enum zsv_status zsv_dedupe_defer(struct zsv_dedupe *d, const unsigned char *key, size_t key_len, size_t row_number,
+                                 const unsigned char *data, size_t len) {
+  FILE **f = &d->partitions[zsv_dedupe_hash(key, key_len) >> (64 - ZSV_DEDUPE_PARTITION_BITS)];
+  if (!*f && !(*f = tmpfile()))
+    return zsv_status_error;
+  struct zsv_dedupe_record r = {row_number, key_len, len};
+  return zsv_dedupe_write(*f, &r, key, data);
+}
+
+// zsv_dedupe_read(): read the next row of a temporary file into *buff, which is
+// grown as needed; return 0 at the end of the file, 1 if a row was read, or -1 on error
+static int zsv_dedupe_read(FILE *f, struct zsv_dedupe_record *r, unsigned char **buff, size_t *buff_size) {
+  if (fread(r, sizeof(*r), 1, f) != 1)
+    return ferror(f) ? -1 : 0;
+  size_t n = r->key_len + r->len;
+  if (n > *buff_size) {
+    unsigned char *b = realloc(*buff, n);
+    if (!b)
+      return -1;
+    *buff = b;
+    *buff_size = n;
+  }
+  return n && fread(*buff, n, 1, f) != 1 ? -1 : 1;
+}
+
+// zsv_dedupe_partition(): replace the rows of a temporary file with those that are
+// the first with their key
+static enum zsv_status zsv_dedupe_partition(FILE **f, unsigned char **buff, size_t *buff_size) {
+  FILE *out = tmpfile();
+  if (!out)
+    return zsv_status_error;
+  enum zsv_status stat = zsv_status_ok;
+  struct zsv_dedupe_set set = {0};
+  struct zsv_dedupe_record r;
+  int got;
+  rewind(*f);
+  while (stat == zsv_status_ok && (got = zsv_dedupe_read(*f, &r, buff, buff_size)) > 0) {
+    int added = zsv_dedupe_set_add(&set, zsv_dedupe_hash(*buff, r.key_len), *buff, r.key_len, 0);
+    if (added < 0)
+      stat = zsv_status_memory;
+    else if (added) {
+      const unsigned char *data = *buff + r.key_len;
+      r.key_len = 0;
+      stat = zsv_dedupe_write(out, &r, *buff, data);
+    }
+  }
+  zsv_dedupe_set_free(&set);
+  if (stat == zsv_status_ok && got < 0)
+    stat = zsv_status_error;
+  fclose(*f);
+  *f = out;
+  rewind(out);
+  return stat;
+}
+
+enum zsv_status zsv_dedupe_rows(struct zsv_dedupe *d,
+                                int (*handler)(void *ctx, size_t row_number, const unsigned char *data, size_t len),
+                                void *ctx) {
+  if (!d->spilling)
+    return zsv_status_ok;
+
+  // the set and its bloom filter are no longer needed, and each partition needs memory of its own
+  zsv_dedupe_set_free(&d->set);
+  free(d->bloom);
+  d->bloom = NULL;
+
+  struct {
+    struct zsv_dedupe_record r;
+    unsigned char *data;
+    size_t size;
+    char more;
+  } cursors[ZSV_DEDUPE_PARTITIONS] = {0};
+  unsigned char *buff = NULL;
+  size_t buff_size = 0;
+  enum zsv_status stat = zsv_status_ok;
+  for (int p = 0; p < ZSV_DEDUPE_PARTITIONS && stat == zsv_status_ok; p++) {
+    if (d->partitions[p]) {
+      stat = zsv_dedupe_partition(&d->partitions[p], &buff, &buff_size);
+      if (stat == zsv_status_ok) {
+        int got = zsv_dedupe_read(d->partitions[p], &cursors[p].r, &cursors[p].data, &cursors[p].size);
+        if (got < 0)
+          stat = zsv_status_error;
+        cursors[p].more = got > 0;
+      }
+    }
+  }
+
+  // merge the partitions in order of row number
+  while (stat == zsv_status_ok) {
+    int next = -1;
+    for (int p = 0; p < ZSV_DEDUPE_PARTITIONS; p++)
+      if (cursors[p].more && (next < 0 || cursors[p].r.row_number < cursors[next].r.row_number))
+        next = p;
+    if (next < 0 || handler(ctx, cursors[next].r.row_number, cursors[next].data, cursors[next].r.len))
+      break;
+    int got = zsv_dedupe_read(d->partitions[next], &cursors[next].r, &cursors[next].data, &cursors[next].size);
+    if (got < 0)
+      stat = zsv_status_error;
+    cursors[next].more = got > 0;
+  }
+
+  free(buff);
+  for (int p = 0; p < ZSV_DEDUPE_PARTITIONS; p++)
+    free(cursors[p].data);
+  return stat;
+}
+
+void zsv_dedupe_delete(struct zsv_dedupe *d) {
+  if (d) {
+    zsv_dedupe_set_free(&d->set);
+    free(d->bloom);
+    for (int p = 0; p < ZSV_DEDUPE_PARTITIONS; p++)
+      if (d->partitions[p])
+        fclose(d->partitions[p]);
+    free(d);
+  }
+}
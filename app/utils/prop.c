@@ -6,6 +6,7 @@
 #include <zsv/utils/prop.h>
 #include <zsv/utils/cache.h>
 #include <zsv/utils/file.h>
+#include <zsv/utils/decompress.h>
 #include <yajl_helper/yajl_helper.h>
 
 #ifndef ZSVTLS
@@ -253,6 +254,12 @@ static int zsv_properties_parse_process_value(yajl_helper_t yh, struct json_valu
  * ignored), but a warning is printed
  *
  * optional `struct zsv_file_properties` supports custom file property processing
+ *
+ * If the input stream is read with the default read function and is gzip, bzip2
+ * or zstd-compressed, the parser reads it through a decompressing reader (see
+ * zsv_decompressor_new()), which zsv_delete() frees. opts->stream itself is
+ * left for the caller to close as usual. If the compressed input is corrupt or
+ * truncated, zsv_parse_more() then returns zsv_status_error
  */
 enum zsv_status zsv_new_with_properties(struct zsv_opts *opts, struct zsv_prop_handler *custom_prop_handler,
                                         const char *input_path, const char *opts_used, zsv_parser *handle_out) {
@@ -262,6 +269,34 @@ enum zsv_status zsv_new_with_properties(struct zsv_opts *opts, struct zsv_prop_h
     if (fp.stat != zsv_status_ok)
       return fp.stat;
   }
+
+  struct zsv_decompressor *decompressor = NULL;
+  if (!opts->read) {
+    enum zsv_status stat = zsv_decompressor_new(opts->stream ? opts->stream : stdin, 0, &decompressor);
+    if (stat == zsv_status_invalid_option)
+      fprintf(stderr, "Unable to read %s: this build does not support compressed input of this type\n",
+              input_path ? input_path : "input");
+    if (stat != zsv_status_ok)
+      return stat;
+  }
+  if (decompressor) {
+    struct zsv_opts tmp_opts = *opts;
+    tmp_opts.read = zsv_decompress_read;
+    tmp_opts.stream = decompressor;
+    *handle_out = zsv_new(&tmp_opts);
+    // keep any changes that zsv_new() made to the options (e.g. buffsize)
+    tmp_opts.read = opts->read;
+    tmp_opts.stream = opts->stream;
+    *opts = tmp_opts;
+    if (!*handle_out) {
+      zsv_decompressor_delete(decompressor);
+      return zsv_status_memory;
+    }
+    zsv_set_input_close(*handle_out, zsv_decompressor_delete, decompressor);
+    zsv_set_input_error(*handle_out, zsv_decompressor_error, decompressor);
+    return zsv_status_ok;
+  }
+
   if ((*handle_out = zsv_new(opts)))
     return zsv_status_ok;
   return zsv_status_memory;
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * xoshiro256** (see https://prng.di.unimi.it/), with its state filled in from
+ * the seed by splitmix64, as its authors suggest
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <zsv/utils/random.h>
+
+static inline uint64_t zsv_random_splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t zsv_random_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+void zsv_random_seed(struct zsv_random *r, uint64_t seed) {
+  for (int i = 0; i < 4; i++)
+    r->s[i] = zsv_random_splitmix64(&seed);
+}
+
+uint64_t zsv_random_default_seed(void) {
+  uint64_t x = (uint64_t)time(NULL);
+  uint64_t seed = zsv_random_splitmix64(&x) ^ (uint64_t)clock();
+  x = (uint64_t)(uintptr_t)&x; // differs between processes where addresses are randomized
+  return seed ^ zsv_random_splitmix64(&x);
+}
+
+uint64_t zsv_random_next(struct zsv_random *r) {
+  uint64_t *s = r->s;
+  const uint64_t result = zsv_random_rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = zsv_random_rotl(s[3], 45);
+  return result;
+}
+
+double zsv_random_double(struct zsv_random *r) {
+  return (double)(zsv_random_next(r) >> 11) * 0x1.0p-53;
+}
+
+uint64_t zsv_random_below(struct zsv_random *r, uint64_t n) {
+  if (!n)
+    return 0;
+#ifdef __SIZEOF_INT128__
+  // Lemire's multiply-and-reject, which mostly avoids a division
+  __uint128_t m = (__uint128_t)zsv_random_next(r) * n;
+  uint64_t lo = (uint64_t)m;
+  if (lo < n) {
+    uint64_t threshold = (0 - n) % n;
+    while (lo < threshold) {
+      m = (__uint128_t)zsv_random_next(r) * n;
+      lo = (uint64_t)m;
+    }
+  }
+  return (uint64_t)(m >> 64);
+#else
+  uint64_t threshold = (0 - n) % n, x;
+  while ((x = zsv_random_next(r)) < threshold)
+    ;
+  return x % n;
+#endif
+}
+
+size_t zsv_random_geometric(struct zsv_random *r, double p) {
+  if (p >= 1)
+    return 0;
+  if (!(p > 0))
+    return SIZE_MAX;
+  // inverse transform: floor(log(u) / log(1 - p)) for u in (0, 1]
+  double n = floor(log(1 - zsv_random_double(r)) / log1p(-p));
+  return n < (double)(SIZE_MAX / 2) ? (size_t)n : SIZE_MAX;
+}
@@ -0,0 +1,1230 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Regular expressions (see zsv_regex_new())
+ *
+ * A pattern is parsed into a tree, which is compiled into a program for a
+ * Thompson NFA: each instruction either consumes a byte in a set, or leads
+ * without consuming anything to one or two other instructions. The program is
+ * never run by backtracking:
+ *
+ * - to check whether a value matches, the NFA is converted up front into a DFA,
+ *   each state of which is the set of instructions that the NFA could be at, so
+ *   that each input byte costs one table lookup. To keep the table small, bytes
+ *   are first mapped to classes of bytes that no set in the pattern tells apart.
+ *   If the DFA would be too large or take too long to build, the NFA is
+ *   simulated instead
+ *
+ * - to find the groups of a match, the NFA is simulated (a "Pike VM"): all the
+ *   threads that the NFA could be at advance together, one byte at a time, each
+ *   with the positions of its groups, and kept in the order in which a
+ *   backtracking matcher would try them, so that the same match is found. A
+ *   repetition that can match nothing also records where each repetition
+ *   started (see zsv_regex_emit_repeat()), so that, as when backtracking, one
+ *   that matches nothing ends the repetition instead of being dropped
+ *
+ * If every match starts with the same literal string, memchr() or memmem() skip
+ * to the places where a match could start, and a value that does not contain
+ * the string at all is rejected without running the DFA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsv/utils/compiler.h>
+#include <zsv/utils/memmem.h>
+#include <zsv/utils/regex.h>
+
+#define ZSV_REGEX_INST_MAX 10000          // largest program, once repetitions are expanded
+#define ZSV_REGEX_REPEAT_MAX 1000         // largest bound of a {n,m} repetition
+#define ZSV_REGEX_DEPTH_MAX 200           // deepest nesting of groups
+#define ZSV_REGEX_DFA_CELLS_MAX (1 << 20) // largest DFA table (states x classes) ...
+#define ZSV_REGEX_DFA_WORK_MAX (1 << 26)  // ... and most instructions visited to build it
+#define ZSV_REGEX_PREFIX_MAX 32           // longest literal prefix that is used to skip ahead
+#define ZSV_REGEX_LOOP_KEY_BITS 3         // innermost loops that tell apart visits to an instruction
+
+#define ZSV_REGEX_NONE ((size_t)-1) // position of a group that did not match
+
+// DFA state flags
+#define ZSV_REGEX_ACCEPT 1     // a match ends here
+#define ZSV_REGEX_DEAD 2       // no match is possible from here
+#define ZSV_REGEX_ACCEPT_END 4 // a match ends here if the value ends here
+
+enum zsv_regex_op {
+  zsv_regex_op_set = 1, // consume a byte in sets[x]
+  zsv_regex_op_split,   // continue at x and, with lower priority, at y
+  zsv_regex_op_jmp,     // continue at x
+  zsv_regex_op_save,    // record the current position in group slot x
+  zsv_regex_op_bol,     // only continue at the start of the value
+  zsv_regex_op_eol,     // only continue at the end of the value
+  zsv_regex_op_mark,    // record the current position in loop register x
+  zsv_regex_op_check,   // continue at y if loop register x holds the current position, else at the next instruction
+  zsv_regex_op_match
+};
+
+struct zsv_regex_inst {
+  unsigned char op;
+  unsigned short loops; // number of loop registers that are in use here
+  int x;
+  int y;
+};
+
+struct zsv_regex_set {
+  uint32_t bits[8];
+};
+
+struct zsv_regex {
+  struct zsv_regex_inst *prog;
+  size_t prog_len;
+  size_t prog_capacity;
+  struct zsv_regex_set *sets;
+  size_t set_count;
+  size_t set_capacity;
+  unsigned group_count;
+  unsigned loop_count;       // loop registers (see zsv_regex_emit_repeat())
+  unsigned char anchored;    // the pattern contains ^
+  unsigned char empty_match; // an empty value matches
+
+  unsigned char prefix[ZSV_REGEX_PREFIX_MAX]; // literal that every match starts with
+  size_t prefix_len;
+
+  // DFA; delta is NULL if it would be too large
+  unsigned class_count;
+  uint16_t classes[256];      // byte => class
+  uint32_t *delta;            // [state * class_count + class] => next state
+  unsigned char *state_flags; // [state] => ZSV_REGEX_XXX flags
+  uint32_t start;             // state at the start of a value
+  uint32_t restart;           // state in which no match is under way
+};
+
+static inline char zsv_regex_set_has(const struct zsv_regex_set *set, unsigned c) {
+  return (set->bits[c >> 5] >> (c & 31)) & 1;
+}
+
+static inline void zsv_regex_set_add(struct zsv_regex_set *set, unsigned c) {
+  set->bits[c >> 5] |= (uint32_t)1 << (c & 31);
+}
+
+// zsv_regex_class_has(): check whether a byte is in a named class of bytes
+static char zsv_regex_class_has(char cls, unsigned c) {
+  char upper = c >= 'A' && c <= 'Z';
+  char lower = c >= 'a' && c <= 'z';
+  char digit = c >= '0' && c <= '9';
+  switch (cls) {
+  case 'a':
+    return upper || lower;
+  case 'd':
+    return digit;
+  case 'n':
+    return upper || lower || digit;
+  case 'w':
+    return upper || lower || digit || c == '_';
+  case 'u':
+    return upper;
+  case 'l':
+    return lower;
+  case 's':
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  case 'p':
+    return c > ' ' && c < 127 && !(upper || lower || digit);
+  case 'x':
+    return digit || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+  }
+  return 0;
+}
+
+static void zsv_regex_set_add_class(struct zsv_regex_set *set, char cls, char negate) {
+  for (unsigned c = 0; c < 256; c++)
+    if (zsv_regex_class_has(cls, c) != negate)
+      zsv_regex_set_add(set, c);
+}
+
+/* parser */
+
+enum zsv_regex_node_type {
+  zsv_regex_node_empty = 1,
+  zsv_regex_node_set,    // sets[n]
+  zsv_regex_node_cat,    // a then b
+  zsv_regex_node_alt,    // a or b
+  zsv_regex_node_repeat, // a, min to max (-1: unbounded) times
+  zsv_regex_node_group,  // a, captured as group n if n > 0
+  zsv_regex_node_bol,
+  zsv_regex_node_eol
+};
+
+struct zsv_regex_node {
+  unsigned char type;
+  unsigned char greedy;
+  int a;
+  int b;
+  int min;
+  int max;
+  int n;
+};
+
+struct zsv_regex_parser {
+  const unsigned char *p;
+  struct zsv_regex *re;
+  struct zsv_regex_node *nodes;
+  size_t node_count;
+  size_t node_capacity;
+  unsigned depth;
+  unsigned loop_depth; // repetitions of a node that can match nothing, being emitted
+  const char *error;
+  enum zsv_status stat;
+};
+
+static int zsv_regex_error(struct zsv_regex_parser *ps, const char *msg) {
+  if (ps->stat == zsv_status_ok) {
+    ps->error = msg;
+    ps->stat = zsv_status_invalid_option;
+  }
+  return -1;
+}
+
+static int zsv_regex_memory_error(struct zsv_regex_parser *ps) {
+  if (ps->stat == zsv_status_ok)
+    ps->stat = zsv_status_memory;
+  return -1;
+}
+
+static int zsv_regex_node_new(struct zsv_regex_parser *ps, unsigned char type) {
+  if (ps->node_count == ZSV_REGEX_INST_MAX)
+    return zsv_regex_error(ps, "pattern is too large");
+  if (ps->node_count == ps->node_capacity) {
+    size_t capacity = ps->node_capacity ? ps->node_capacity * 2 : 32;
+    struct zsv_regex_node *nodes = realloc(ps->nodes, capacity * sizeof(*nodes));
+    if (!nodes)
+      return zsv_regex_memory_error(ps);
+    ps->nodes = nodes;
+    ps->node_capacity = capacity;
+  }
+  struct zsv_regex_node *node = &ps->nodes[ps->node_count];
+  memset(node, 0, sizeof(*node));
+  node->type = type;
+  return (int)ps->node_count++;
+}
+
+// zsv_regex_set_node_new(): create a node for a new, empty set
+static int zsv_regex_set_node_new(struct zsv_regex_parser *ps) {
+  struct zsv_regex *re = ps->re;
+  if (re->set_count == re->set_capacity) {
+    size_t capacity = re->set_capacity ? re->set_capacity * 2 : 16;
+    struct zsv_regex_set *sets = realloc(re->sets, capacity * sizeof(*sets));
+    if (!sets)
+      return zsv_regex_memory_error(ps);
+    re->sets = sets;
+    re->set_capacity = capacity;
+  }
+  int node = zsv_regex_node_new(ps, zsv_regex_node_set);
+  if (node >= 0) {
+    memset(&re->sets[re->set_count], 0, sizeof(*re->sets));
+    ps->nodes[node].n = (int)re->set_count++;
+  }
+  return node;
+}
+
+static int zsv_regex_hex(unsigned char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// zsv_regex_escape(): parse what follows a backslash and add the bytes that it
+// matches to a set; return the byte if it is a single one, -1 if it is a class
+// (e.g. \d), or -2 if it is invalid
+static int zsv_regex_escape(struct zsv_regex_parser *ps, struct zsv_regex_set *set) {
+  unsigned char c = *ps->p;
+  if (!c) {
+    zsv_regex_error(ps, "trailing backslash");
+    return -2;
+  }
+  ps->p++;
+  switch (c) {
+  case 'd':
+  case 'w':
+  case 's':
+    zsv_regex_set_add_class(set, (char)c, 0);
+    return -1;
+  case 'D':
+  case 'W':
+  case 'S':
+    zsv_regex_set_add_class(set, (char)(c + ('a' - 'A')), 1);
+    return -1;
+  case 't':
+    c = '\t';
+    break;
+  case 'n':
+    c = '\n';
+    break;
+  case 'r':
+    c = '\r';
+    break;
+  case 'f':
+    c = '\f';
+    break;
+  case 'v':
+    c = '\v';
+    break;
+  case 'x': {
+    int hi = zsv_regex_hex(ps->p[0]);
+    int lo = hi < 0 ? -1 : zsv_regex_hex(ps->p[1]);
+    if (lo < 0) {
+      zsv_regex_error(ps, "\\x must be followed by two hex digits");
+      return -2;
+    }
+    ps->p += 2;
+    c = (unsigned char)(hi * 16 + lo);
+  } break;
+  default:
+    if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+      zsv_regex_error(ps, "unsupported escape sequence");
+      return -2;
+    }
+  }
+  zsv_regex_set_add(set, c);
+  return c;
+}
+
+// zsv_regex_parse_class(): parse a bracket expression, e.g. [^a-z_]
+static int zsv_regex_parse_class(struct zsv_regex_parser *ps) {
+  static const struct {
+    const char *name;
+    char cls;
+  } names[] = {{"alpha", 'a'}, {"digit", 'd'}, {"alnum", 'n'}, {"upper", 'u'},
+               {"lower", 'l'}, {"space", 's'}, {"punct", 'p'}, {"xdigit", 'x'}};
+  struct zsv_regex_set set = {0};
+  char negate = 0;
+  ps->p++;
+  if (*ps->p == '^') {
+    negate = 1;
+    ps->p++;
+  }
+  for (char first = 1; first || *ps->p != ']'; first = 0) {
+    if (!*ps->p)
+      return zsv_regex_error(ps, "missing ]");
+    if (ps->p[0] == '[' && ps->p[1] == ':') {
+      const char *end = strstr((const char *)ps->p + 2, ":]");
+      size_t i = 0;
+      if (end)
+        for (; i < sizeof(names) / sizeof(names[0]); i++)
+          if (strlen(names[i].name) == (size_t)(end - (const char *)ps->p - 2) &&
+              !memcmp(names[i].name, ps->p + 2, strlen(names[i].name)))
+            break;
+      if (!end || i == sizeof(names) / sizeof(names[0]))
+        return zsv_regex_error(ps, "unknown character class");
+      zsv_regex_set_add_class(&set, names[i].cls, 0);
+      ps->p = (const unsigned char *)end + 2;
+      continue;
+    }
+    int lo;
+    if (*ps->p == '\\') {
+      ps->p++;
+      if ((lo = zsv_regex_escape(ps, &set)) == -2)
+        return -1;
+      if (lo == -1)
+        continue;
+    } else
+      lo = *ps->p++;
+    if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+      struct zsv_regex_set tmp = {0};
+      int hi;
+      ps->p++;
+      if (*ps->p == '\\') {
+        ps->p++;
+        hi = zsv_regex_escape(ps, &tmp);
+      } else
+        hi = *ps->p++;
+      if (hi == -2)
+        return -1;
+      if (hi < lo)
+        return zsv_regex_error(ps, "invalid range");
+      for (int c = lo; c <= hi; c++)
+        zsv_regex_set_add(&set, (unsigned)c);
+    } else
+      zsv_regex_set_add(&set, (unsigned)lo);
+  }
+  ps->p++;
+  if (negate)
+    for (int i = 0; i < 8; i++)
+      set.bits[i] = ~set.bits[i];
+  int node = zsv_regex_set_node_new(ps);
+  if (node >= 0)
+    ps->re->sets[ps->nodes[node].n] = set;
+  return node;
+}
+
+static int zsv_regex_parse_alt(struct zsv_regex_parser *ps);
+
+static int zsv_regex_parse_atom(struct zsv_regex_parser *ps) {
+  int node;
+  switch (*ps->p) {
+  case '(': {
+    int group = 0;
+    if (++ps->depth > ZSV_REGEX_DEPTH_MAX)
+      return zsv_regex_error(ps, "groups are nested too deeply");
+    ps->p++;
+    if (ps->p[0] == '?' && ps->p[1] == ':')
+      ps->p += 2;
+    else if (ps->p[0] == '?')
+      return zsv_regex_error(ps, "unsupported group syntax");
+    else
+      group = (int)++ps->re->group_count;
+    int child = zsv_regex_parse_alt(ps);
+    if (child < 0)
+      return -1;
+    if (*ps->p != ')')
+      return zsv_regex_error(ps, "missing )");
+    ps->p++;
+    ps->depth--;
+    if ((node = zsv_regex_node_new(ps, zsv_regex_node_group)) >= 0) {
+      ps->nodes[node].a = child;
+      ps->nodes[node].n = group;
+    }
+    return node;
+  }
+  case '[':
+    return zsv_regex_parse_class(ps);
+  case '^':
+    ps->p++;
+    ps->re->anchored = 1;
+    return zsv_regex_node_new(ps, zsv_regex_node_bol);
+  case '$':
+    ps->p++;
+    return zsv_regex_node_new(ps, zsv_regex_node_eol);
+  case '*':
+  case '+':
+  case '?':
+    return zsv_regex_error(ps, "nothing to repeat");
+  }
+  if ((node = zsv_regex_set_node_new(ps)) < 0)
+    return -1;
+  struct zsv_regex_set *set = &ps->re->sets[ps->nodes[node].n];
+  if (*ps->p == '.') {
+    ps->p++;
+    memset(set->bits, 0xff, sizeof(set->bits));
+  } else if (*ps->p == '\\') {
+    ps->p++;
+    if (zsv_regex_escape(ps, set) == -2)
+      return -1;
+  } else
+    zsv_regex_set_add(set, *ps->p++);
+  return node;
+}
+
+// zsv_regex_bounds(): parse a {n}, {n,} or {n,m} repetition, if there is one
+static char zsv_regex_bounds(const unsigned char **pp, int *min, int *max) {
+  const unsigned char *p = *pp + 1;
+  long lo = 0, hi;
+  if (!(*p >= '0' && *p <= '9'))
+    return 0;
+  for (; *p >= '0' && *p <= '9'; p++)
+    if (lo <= ZSV_REGEX_REPEAT_MAX)
+      lo = lo * 10 + (*p - '0');
+  hi = lo;
+  if (*p == ',') {
+    p++;
+    if (*p == '}')
+      hi = -1;
+    else if (!(*p >= '0' && *p <= '9'))
+      return 0;
+    else
+      for (hi = 0; *p >= '0' && *p <= '9'; p++)
+        if (hi <= ZSV_REGEX_REPEAT_MAX)
+          hi = hi * 10 + (*p - '0');
+  }
+  if (*p != '}')
+    return 0;
+  *pp = p + 1;
+  *min = (int)lo;
+  *max = (int)hi;
+  return 1;
+}
+
+static int zsv_regex_parse_repeat(struct zsv_regex_parser *ps) {
+  int node = zsv_regex_parse_atom(ps);
+  while (node >= 0) {
+    const unsigned char *p = ps->p;
+    int min, max;
+    if (*p == '*' || *p == '+' || *p == '?') {
+      min = *p == '+';
+      max = *p == '?' ? 1 : -1;
+      p++;
+    } else if (!(*p == '{' && zsv_regex_bounds(&p, &min, &max)))
+      break; // a { that does not start a repetition is a literal
+    if (min > ZSV_REGEX_REPEAT_MAX || max > ZSV_REGEX_REPEAT_MAX)
+      return zsv_regex_error(ps, "repetition count is too large");
+    if (max >= 0 && max < min)
+      return zsv_regex_error(ps, "invalid repetition count");
+    unsigned char greedy = 1;
+    if (*p == '?') {
+      greedy = 0;
+      p++;
+    }
+    ps->p = p;
+    int child = node;
+    if ((node = zsv_regex_node_new(ps, zsv_regex_node_repeat)) >= 0) {
+      ps->nodes[node].a = child;
+      ps->nodes[node].min = min;
+      ps->nodes[node].max = max;
+      ps->nodes[node].greedy = greedy;
+    }
+  }
+  return node;
+}
+
+static int zsv_regex_parse_cat(struct zsv_regex_parser *ps) {
+  int left = -1;
+  while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+    int right = zsv_regex_parse_repeat(ps);
+    if (right < 0)
+      return -1;
+    if (left < 0)
+      left = right;
+    else {
+      int node = zsv_regex_node_new(ps, zsv_regex_node_cat);
+      if (node < 0)
+        return -1;
+      ps->nodes[node].a = left;
+      ps->nodes[node].b = right;
+      left = node;
+    }
+  }
+  return left < 0 ? zsv_regex_node_new(ps, zsv_regex_node_empty) : left;
+}
+
+static int zsv_regex_parse_alt(struct zsv_regex_parser *ps) {
+  int left = zsv_regex_parse_cat(ps);
+  while (left >= 0 && *ps->p == '|') {
+    ps->p++;
+    int right = zsv_regex_parse_cat(ps);
+    if (right < 0)
+      return -1;
+    int node = zsv_regex_node_new(ps, zsv_regex_node_alt);
+    if (node >= 0) {
+      ps->nodes[node].a = left;
+      ps->nodes[node].b = right;
+    }
+    left = node;
+  }
+  return left;
+}
+
+// zsv_regex_prefix(): add the literal bytes that every match of a node starts
+// with to the pattern's prefix; return non-zero if the whole node is literal,
+// so that what follows it may extend the prefix
+static char zsv_regex_prefix(struct zsv_regex_parser *ps, int n) {
+  const struct zsv_regex_node *node = &ps->nodes[n];
+  struct zsv_regex *re = ps->re;
+  switch (node->type) {
+  case zsv_regex_node_empty:
+  case zsv_regex_node_bol:
+    return 1;
+  case zsv_regex_node_group:
+    return zsv_regex_prefix(ps, node->a);
+  case zsv_regex_node_cat:
+    return zsv_regex_prefix(ps, node->a) && zsv_regex_prefix(ps, node->b);
+  case zsv_regex_node_repeat:
+    if (node->min > 0)
+      zsv_regex_prefix(ps, node->a);
+    return 0;
+  case zsv_regex_node_set: {
+    const struct zsv_regex_set *set = &re->sets[node->n];
+    int byte = -1;
+    for (unsigned c = 0; c < 256; c++) {
+      if (zsv_regex_set_has(set, c)) {
+        if (byte >= 0)
+          return 0;
+        byte = (int)c;
+      }
+    }
+    if (byte < 0 || re->prefix_len == ZSV_REGEX_PREFIX_MAX)
+      return 0;
+    re->prefix[re->prefix_len++] = (unsigned char)byte;
+    return 1;
+  }
+  }
+  return 0;
+}
+
+/* compiler */
+
+static int zsv_regex_inst(struct zsv_regex_parser *ps, unsigned char op, int x, int y) {
+  struct zsv_regex *re = ps->re;
+  if (re->prog_len == ZSV_REGEX_INST_MAX)
+    return zsv_regex_error(ps, "pattern is too large");
+  if (re->prog_len == re->prog_capacity) {
+    size_t capacity = re->prog_capacity ? re->prog_capacity * 2 : 64;
+    struct zsv_regex_inst *prog = realloc(re->prog, capacity * sizeof(*prog));
+    if (!prog)
+      return zsv_regex_memory_error(ps);
+    re->prog = prog;
+    re->prog_capacity = capacity;
+  }
+  re->prog[re->prog_len].op = op;
+  re->prog[re->prog_len].loops = (unsigned short)ps->loop_depth;
+  re->prog[re->prog_len].x = x;
+  re->prog[re->prog_len].y = y;
+  return (int)re->prog_len++;
+}
+
+// zsv_regex_nullable(): check whether a node can match without consuming a byte
+static char zsv_regex_nullable(const struct zsv_regex_parser *ps, int n) {
+  const struct zsv_regex_node *node = &ps->nodes[n];
+  switch (node->type) {
+  case zsv_regex_node_set:
+    return 0;
+  case zsv_regex_node_cat:
+    return zsv_regex_nullable(ps, node->a) && zsv_regex_nullable(ps, node->b);
+  case zsv_regex_node_alt:
+    return zsv_regex_nullable(ps, node->a) || zsv_regex_nullable(ps, node->b);
+  case zsv_regex_node_repeat:
+    return node->min == 0 || zsv_regex_nullable(ps, node->a);
+  case zsv_regex_node_group:
+    return zsv_regex_nullable(ps, node->a);
+  }
+  return 1; // empty, bol or eol
+}
+
+// zsv_regex_split_set(): set the targets of a split that either continues into
+// a repeated node or exits it
+static void zsv_regex_split_set(struct zsv_regex *re, int pc, int body, int exit, unsigned char greedy) {
+  re->prog[pc].x = greedy ? body : exit;
+  re->prog[pc].y = greedy ? exit : body;
+}
+
+static int zsv_regex_emit(struct zsv_regex_parser *ps, int n);
+
+/**
+ * Emit a repetition. As with a backtracking matcher, an optional repetition
+ * that matches nothing ends the repetition: what follows is then tried, with
+ * the groups that it set, before the option of not repeating at all. To tell
+ * when a repetition of a node that can match nothing did so, the position at
+ * which it started is kept in a loop register, one per level of nesting
+ * (zsv_regex_op_mark), and checked at its end (zsv_regex_op_check)
+ */
+static int zsv_regex_emit_repeat(struct zsv_regex_parser *ps, const struct zsv_regex_node *node) {
+  struct zsv_regex *re = ps->re;
+  for (int i = 0; i < node->min; i++)
+    if (zsv_regex_emit(ps, node->a) < 0)
+      return -1;
+  if (node->max >= 0 && node->max == node->min)
+    return 0;
+
+  int loop = -1; // loop register, if the node can match nothing
+  if (zsv_regex_nullable(ps, node->a)) {
+    loop = (int)ps->loop_depth++;
+    if (re->loop_count < ps->loop_depth)
+      re->loop_count = ps->loop_depth;
+  }
+  int count = node->max < 0 ? 1 : node->max - node->min;
+  int *splits = malloc((size_t)count * 2 * sizeof(*splits));
+  if (!splits)
+    return zsv_regex_memory_error(ps);
+  int *checks = splits + count; // checks[i] < 0 if repetition i has none
+  int i = 0;
+  for (; i < count; i++) {
+    // each optional repetition is nested in the one before, and any may exit
+    checks[i] = -1;
+    if ((splits[i] = zsv_regex_inst(ps, zsv_regex_op_split, 0, 0)) < 0 ||
+        (loop >= 0 && zsv_regex_inst(ps, zsv_regex_op_mark, loop, 0) < 0) || zsv_regex_emit(ps, node->a) < 0)
+      break;
+    if (loop >= 0 && (node->max < 0 || i + 1 < count) &&
+        (checks[i] = zsv_regex_inst(ps, zsv_regex_op_check, loop, 0)) < 0)
+      break;
+  }
+  if (i == count && node->max < 0)
+    zsv_regex_inst(ps, zsv_regex_op_jmp, splits[0], 0);
+  if (ps->stat == zsv_status_ok)
+    for (i = 0; i < count; i++) {
+      zsv_regex_split_set(re, splits[i], splits[i] + 1, (int)re->prog_len, node->greedy);
+      if (checks[i] >= 0)
+        re->prog[checks[i]].y = (int)re->prog_len;
+    }
+  free(splits);
+  if (loop >= 0)
+    ps->loop_depth--;
+  return ps->stat == zsv_status_ok ? 0 : -1;
+}
+
+static int zsv_regex_emit(struct zsv_regex_parser *ps, int n) {
+  const struct zsv_regex_node node = ps->nodes[n];
+  struct zsv_regex *re = ps->re;
+  switch (node.type) {
+  case zsv_regex_node_empty:
+    return 0;
+  case zsv_regex_node_set:
+    return zsv_regex_inst(ps, zsv_regex_op_set, node.n, 0);
+  case zsv_regex_node_bol:
+    return zsv_regex_inst(ps, zsv_regex_op_bol, 0, 0);
+  case zsv_regex_node_eol:
+    return zsv_regex_inst(ps, zsv_regex_op_eol, 0, 0);
+  case zsv_regex_node_cat:
+    return zsv_regex_emit(ps, node.a) < 0 ? -1 : zsv_regex_emit(ps, node.b);
+  case zsv_regex_node_group:
+    if (node.n && zsv_regex_inst(ps, zsv_regex_op_save, node.n * 2, 0) < 0)
+      return -1;
+    if (zsv_regex_emit(ps, node.a) < 0)
+      return -1;
+    return node.n ? zsv_regex_inst(ps, zsv_regex_op_save, node.n * 2 + 1, 0) : 0;
+  case zsv_regex_node_alt: {
+    int split = zsv_regex_inst(ps, zsv_regex_op_split, 0, 0);
+    if (split < 0 || zsv_regex_emit(ps, node.a) < 0)
+      return -1;
+    int jmp = zsv_regex_inst(ps, zsv_regex_op_jmp, 0, 0);
+    if (jmp < 0)
+      return -1;
+    re->prog[split].x = split + 1;
+    re->prog[split].y = jmp + 1;
+    if (zsv_regex_emit(ps, node.b) < 0)
+      return -1;
+    re->prog[jmp].x = (int)re->prog_len;
+    return 0;
+  }
+  case zsv_regex_node_repeat:
+    return zsv_regex_emit_repeat(ps, &node);
+  }
+  return 0;
+}
+
+/* NFA simulation */
+
+struct zsv_regex_threads {
+  size_t count;
+  int *pcs;
+  size_t *caps; // [thread * width + slot] => position
+};
+
+struct zsv_regex_vm {
+  const struct zsv_regex *re;
+  size_t ncap;  // group slots
+  size_t width; // group slots, then loop registers
+  unsigned shift; // ZSV_REGEX_LOOP_KEY_BITS, or 0 if there are no loop registers
+  unsigned *seen; // [pc << shift | loops] => stamp of the thread list that pc was last added to
+  unsigned stamp;
+  struct zsv_regex_vm_entry {
+    int pc;
+    int slot; // if >= 0, this entry restores caps[slot] to value
+    size_t value;
+  } *stack;
+  size_t *caps; // the captures and loop registers of the thread that is being added
+  struct zsv_regex_threads lists[2];
+};
+
+// zsv_regex_vm_add(): add a thread at pc, and every thread that it leads to
+// without consuming a byte, to a thread list, in priority order
+static void zsv_regex_vm_add(struct zsv_regex_vm *vm, struct zsv_regex_threads *list, int pc, size_t pos,
+                             char bol, char eol) {
+  const struct zsv_regex_inst *prog = vm->re->prog;
+  size_t top = 0;
+  vm->stack[top].pc = pc;
+  vm->stack[top++].slot = -1;
+  while (top) {
+    struct zsv_regex_vm_entry e = vm->stack[--top];
+    if (e.slot >= 0) {
+      vm->caps[e.slot] = e.value;
+      continue;
+    }
+    const struct zsv_regex_inst *inst = &prog[e.pc];
+    // an instruction in a loop may be visited once in a repetition that
+    // started at an earlier position, and again in one that starts here
+    size_t key = (size_t)e.pc << vm->shift;
+    if (inst->op != zsv_regex_op_set && inst->op != zsv_regex_op_match)
+      for (unsigned i = 0; i < vm->shift && i < inst->loops; i++)
+        if (vm->caps[vm->ncap + inst->loops - 1 - i] == pos)
+          key |= (size_t)1 << i;
+    if (vm->seen[key] == vm->stamp)
+      continue;
+    vm->seen[key] = vm->stamp;
+    switch (inst->op) {
+    case zsv_regex_op_jmp:
+      vm->stack[top].pc = inst->x;
+      vm->stack[top++].slot = -1;
+      break;
+    case zsv_regex_op_split:
+      vm->stack[top].pc = inst->y;
+      vm->stack[top++].slot = -1;
+      vm->stack[top].pc = inst->x;
+      vm->stack[top++].slot = -1;
+      break;
+    case zsv_regex_op_save:
+      if ((size_t)inst->x < vm->ncap) {
+        vm->stack[top].slot = inst->x;
+        vm->stack[top++].value = vm->caps[inst->x];
+        vm->caps[inst->x] = pos;
+      }
+      vm->stack[top].pc = e.pc + 1;
+      vm->stack[top++].slot = -1;
+      break;
+    case zsv_regex_op_mark:
+      vm->stack[top].slot = (int)vm->ncap + inst->x;
+      vm->stack[top++].value = vm->caps[vm->ncap + inst->x];
+      vm->caps[vm->ncap + inst->x] = pos;
+      vm->stack[top].pc = e.pc + 1;
+      vm->stack[top++].slot = -1;
+      break;
+    case zsv_regex_op_check:
+      vm->stack[top].pc = vm->caps[vm->ncap + inst->x] == pos ? inst->y : e.pc + 1;
+      vm->stack[top++].slot = -1;
+      break;
+    case zsv_regex_op_bol:
+    case zsv_regex_op_eol:
+      if (inst->op == zsv_regex_op_bol ? bol : eol) {
+        vm->stack[top].pc = e.pc + 1;
+        vm->stack[top++].slot = -1;
+      }
+      break;
+    default: // set or match
+      list->pcs[list->count] = e.pc;
+      memcpy(list->caps + list->count * vm->width, vm->caps, vm->width * sizeof(*vm->caps));
+      list->count++;
+    }
+  }
+}
+
+// zsv_regex_pike(): find the leftmost match by simulating the NFA; with
+// groups, also find the positions of the groups, else stop at any match
+static char zsv_regex_pike(const struct zsv_regex *re, const unsigned char *s, size_t len,
+                           struct zsv_regex_group *groups, size_t n) {
+  size_t threads_max = 0;
+  for (size_t pc = 0; pc < re->prog_len; pc++)
+    threads_max += re->prog[pc].op == zsv_regex_op_set || re->prog[pc].op == zsv_regex_op_match;
+
+  struct zsv_regex_vm vm = {0};
+  vm.re = re;
+  vm.ncap = 2 * (n < re->group_count + 1 ? (n ? n : 1) : re->group_count + 1);
+  vm.width = vm.ncap + re->loop_count;
+  vm.shift = re->loop_count ? ZSV_REGEX_LOOP_KEY_BITS : 0;
+  vm.seen = calloc(re->prog_len << vm.shift, sizeof(*vm.seen));
+  vm.stack = malloc(((2 * re->prog_len) << vm.shift | 1) * sizeof(*vm.stack));
+  vm.caps = malloc((vm.width + vm.ncap) * sizeof(*vm.caps)); // the last ncap hold the best match
+  for (int i = 0; i < 2; i++) {
+    vm.lists[i].pcs = malloc(threads_max * sizeof(*vm.lists[i].pcs));
+    vm.lists[i].caps = malloc(threads_max * vm.width * sizeof(*vm.lists[i].caps));
+  }
+
+  char matched = 0;
+  if (vm.seen && vm.stack && vm.caps && vm.lists[0].pcs && vm.lists[0].caps && vm.lists[1].pcs &&
+      vm.lists[1].caps) {
+    size_t *best = vm.caps + vm.width;
+    struct zsv_regex_threads *current = &vm.lists[0], *next = &vm.lists[1];
+    vm.stamp++;
+    for (size_t pos = 0; pos <= len; pos++) {
+      if (!matched) { // a match may start here, with lower priority than any that started earlier
+        for (size_t i = 0; i < vm.width; i++)
+          vm.caps[i] = ZSV_REGEX_NONE;
+        zsv_regex_vm_add(&vm, current, 0, pos, pos == 0, pos == len);
+      }
+      if (!current->count)
+        break;
+      vm.stamp++;
+      next->count = 0;
+      for (size_t i = 0; i < current->count; i++) {
+        const struct zsv_regex_inst *inst = &re->prog[current->pcs[i]];
+        const size_t *caps = current->caps + i * vm.width;
+        if (inst->op == zsv_regex_op_match) {
+          matched = 1;
+          memcpy(best, caps, vm.ncap * sizeof(*best));
+          break; // threads of lower priority are dropped
+        }
+        if (pos < len && zsv_regex_set_has(&re->sets[inst->x], s[pos])) {
+          memcpy(vm.caps, caps, vm.width * sizeof(*vm.caps));
+          zsv_regex_vm_add(&vm, next, current->pcs[i] + 1, pos + 1, 0, pos + 1 == len);
+        }
+      }
+      if (matched && !n)
+        break;
+      struct zsv_regex_threads *tmp = current;
+      current = next;
+      next = tmp;
+    }
+    if (matched) {
+      for (size_t i = 0; i < n; i++) {
+        groups[i].str = NULL;
+        groups[i].len = 0;
+        if (2 * i + 1 < vm.ncap && best[2 * i] != ZSV_REGEX_NONE && best[2 * i + 1] != ZSV_REGEX_NONE) {
+          groups[i].str = s + best[2 * i];
+          groups[i].len = best[2 * i + 1] - best[2 * i];
+        }
+      }
+    }
+  }
+  free(vm.seen);
+  free(vm.stack);
+  free(vm.caps);
+  for (int i = 0; i < 2; i++) {
+    free(vm.lists[i].pcs);
+    free(vm.lists[i].caps);
+  }
+  return matched;
+}
+
+/* DFA */
+
+struct zsv_regex_dfa {
+  const struct zsv_regex *re;
+  unsigned *seen; // [pc] => stamp of the set that pc was last added to
+  unsigned stamp;
+  size_t work; // instructions visited so far
+  int *stack;
+  int *pcs; // the set that is being built
+  size_t pcs_count;
+
+  int **states; // [state] => sorted set of instructions (set, eol or match)
+  size_t *state_sizes;
+  size_t state_count;
+  size_t state_capacity;
+  uint32_t *table; // hash table of states: state + 1, or 0 if empty
+  size_t table_size;
+};
+
+// zsv_regex_closure(): add pc, and every instruction that it leads to without
+// consuming a byte, to the set that is being built
+static void zsv_regex_closure(struct zsv_regex_dfa *dfa, int pc, char bol) {
+  const struct zsv_regex_inst *prog = dfa->re->prog;
+  size_t top = 0;
+  dfa->stack[top++] = pc;
+  while (top) {
+    pc = dfa->stack[--top];
+    if (dfa->seen[pc] == dfa->stamp)
+      continue;
+    dfa->seen[pc] = dfa->stamp;
+    dfa->work++;
+    switch (prog[pc].op) {
+    case zsv_regex_op_jmp:
+      dfa->stack[top++] = prog[pc].x;
+      break;
+    case zsv_regex_op_split:
+      dfa->stack[top++] = prog[pc].y;
+      dfa->stack[top++] = prog[pc].x;
+      break;
+    case zsv_regex_op_check: // either way, as the DFA only tells whether there is a match
+      dfa->stack[top++] = prog[pc].y;
+      dfa->stack[top++] = pc + 1;
+      break;
+    case zsv_regex_op_save:
+    case zsv_regex_op_mark:
+      dfa->stack[top++] = pc + 1;
+      break;
+    case zsv_regex_op_bol:
+      if (bol)
+        dfa->stack[top++] = pc + 1;
+      break;
+    default: // set, match, or eol, which is only resolved at the end of the value
+      dfa->pcs[dfa->pcs_count++] = pc;
+    }
+  }
+}
+
+// zsv_regex_ends(): check whether an eol instruction leads to a match at the end of the value
+static char zsv_regex_ends(struct zsv_regex_dfa *dfa, int pc) {
+  const struct zsv_regex_inst *prog = dfa->re->prog;
+  size_t top = 0;
+  dfa->stamp++;
+  dfa->stack[top++] = pc + 1;
+  while (top) {
+    pc = dfa->stack[--top];
+    if (dfa->seen[pc] == dfa->stamp)
+      continue;
+    dfa->seen[pc] = dfa->stamp;
+    switch (prog[pc].op) {
+    case zsv_regex_op_match:
+      return 1;
+    case zsv_regex_op_jmp:
+      dfa->stack[top++] = prog[pc].x;
+      break;
+    case zsv_regex_op_split:
+      dfa->stack[top++] = prog[pc].y;
+      dfa->stack[top++] = prog[pc].x;
+      break;
+    case zsv_regex_op_check:
+      dfa->stack[top++] = prog[pc].y;
+      dfa->stack[top++] = pc + 1;
+      break;
+    case zsv_regex_op_save:
+    case zsv_regex_op_mark:
+    case zsv_regex_op_eol:
+      dfa->stack[top++] = pc + 1;
+      break;
+    }
+  }
+  return 0;
+}
+
+static int zsv_regex_int_cmp(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+static uint32_t zsv_regex_hash(const int *pcs, size_t count) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < count; i++)
+    h = (h ^ (uint32_t)pcs[i]) * 16777619u;
+  return h;
+}
+
+// zsv_regex_state(): get the state for the set that was built, adding it if it
+// is new; return -1 if there would be too many states, or -2 if out of memory
+static long zsv_regex_state(struct zsv_regex_dfa *dfa, struct zsv_regex *re) {
+  qsort(dfa->pcs, dfa->pcs_count, sizeof(*dfa->pcs), zsv_regex_int_cmp);
+  size_t mask = dfa->table_size - 1;
+  size_t slot = zsv_regex_hash(dfa->pcs, dfa->pcs_count) & mask;
+  for (; dfa->table[slot]; slot = (slot + 1) & mask) {
+    uint32_t st = dfa->table[slot] - 1;
+    if (dfa->state_sizes[st] == dfa->pcs_count &&
+        !memcmp(dfa->states[st], dfa->pcs, dfa->pcs_count * sizeof(*dfa->pcs)))
+      return (long)st;
+  }
+  if ((dfa->state_count + 1) * re->class_count > ZSV_REGEX_DFA_CELLS_MAX || dfa->work > ZSV_REGEX_DFA_WORK_MAX)
+    return -1;
+
+  if (dfa->state_count == dfa->state_capacity) {
+    size_t capacity = dfa->state_capacity ? dfa->state_capacity * 2 : 16;
+    int **states = realloc(dfa->states, capacity * sizeof(*states));
+    if (states)
+      dfa->states = states;
+    size_t *sizes = realloc(dfa->state_sizes, capacity * sizeof(*sizes));
+    if (sizes)
+      dfa->state_sizes = sizes;
+    unsigned char *flags = realloc(re->state_flags, capacity);
+    if (flags)
+      re->state_flags = flags;
+    uint32_t *delta = realloc(re->delta, capacity * re->class_count * sizeof(*delta));
+    if (delta)
+      re->delta = delta;
+    if (!(states && sizes && flags && delta))
+      return -2;
+    dfa->state_capacity = capacity;
+  }
+  uint32_t st = (uint32_t)dfa->state_count;
+  if (!(dfa->states[st] = malloc((dfa->pcs_count ? dfa->pcs_count : 1) * sizeof(*dfa->pcs))))
+    return -2;
+  memcpy(dfa->states[st], dfa->pcs, dfa->pcs_count * sizeof(*dfa->pcs));
+  dfa->state_sizes[st] = dfa->pcs_count;
+  dfa->state_count++;
+  dfa->table[slot] = st + 1;
+
+  unsigned char flags = dfa->pcs_count ? 0 : ZSV_REGEX_DEAD;
+  for (size_t i = 0; i < dfa->pcs_count; i++) {
+    if (re->prog[dfa->pcs[i]].op == zsv_regex_op_match)
+      flags |= ZSV_REGEX_ACCEPT | ZSV_REGEX_ACCEPT_END;
+    else if (re->prog[dfa->pcs[i]].op == zsv_regex_op_eol && zsv_regex_ends(dfa, dfa->pcs[i]))
+      flags |= ZSV_REGEX_ACCEPT_END;
+  }
+  re->state_flags[st] = flags;
+
+  if (dfa->state_count * 2 > dfa->table_size) { // grow the hash table
+    size_t size = dfa->table_size * 2;
+    uint32_t *table = calloc(size, sizeof(*table));
+    if (!table)
+      return -2;
+    for (uint32_t i = 0; i < dfa->state_count; i++) {
+      size_t j = zsv_regex_hash(dfa->states[i], dfa->state_sizes[i]) & (size - 1);
+      while (table[j])
+        j = (j + 1) & (size - 1);
+      table[j] = i + 1;
+    }
+    free(dfa->table);
+    dfa->table = table;
+    dfa->table_size = size;
+  }
+  return (long)st;
+}
+
+// zsv_regex_dfa_build(): build the DFA or, if it would be too large, leave re->delta NULL
+static enum zsv_status zsv_regex_dfa_build(struct zsv_regex *re) {
+  // byte classes: split every class by whether or not each set contains its bytes
+  re->class_count = 1;
+  for (size_t i = 0; i < re->set_count; i++) {
+    uint16_t map[512];
+    uint16_t count = 0;
+    memset(map, 0xff, sizeof(map));
+    for (unsigned c = 0; c < 256; c++) {
+      unsigned key = re->classes[c] * 2u + (unsigned)zsv_regex_set_has(&re->sets[i], c);
+      if (map[key] == 0xffff)
+        map[key] = count++;
+      re->classes[c] = map[key];
+    }
+    re->class_count = count;
+  }
+  unsigned char reps[256]; // class => a byte in it
+  for (unsigned c = 256; c-- > 0;)
+    reps[re->classes[c]] = (unsigned char)c;
+
+  struct zsv_regex_dfa dfa = {0};
+  dfa.re = re;
+  dfa.seen = calloc(re->prog_len, sizeof(*dfa.seen));
+  dfa.stack = malloc((2 * re->prog_len + 1) * sizeof(*dfa.stack));
+  dfa.pcs = malloc(re->prog_len * sizeof(*dfa.pcs));
+  dfa.table_size = 64;
+  dfa.table = calloc(dfa.table_size, sizeof(*dfa.table));
+
+  enum zsv_status stat = zsv_status_ok;
+  long st = -2;
+  if (dfa.seen && dfa.stack && dfa.pcs && dfa.table) {
+    dfa.stamp++;
+    zsv_regex_closure(&dfa, 0, 1);
+    if ((st = zsv_regex_state(&dfa, re)) >= 0) {
+      re->start = (uint32_t)st;
+      dfa.stamp++;
+      dfa.pcs_count = 0;
+      zsv_regex_closure(&dfa, 0, 0);
+      if ((st = zsv_regex_state(&dfa, re)) >= 0)
+        re->restart = (uint32_t)st;
+    }
+    // states are numbered in the order they are found, so this visits them all
+    for (size_t i = 0; st >= 0 && i < dfa.state_count; i++) {
+      uint32_t *row = re->delta + i * re->class_count;
+      if (re->state_flags[i] & (ZSV_REGEX_ACCEPT | ZSV_REGEX_DEAD)) { // the scan stops here
+        for (unsigned c = 0; c < re->class_count; c++)
+          row[c] = (uint32_t)i;
+        continue;
+      }
+      for (unsigned c = 0; st >= 0 && c < re->class_count; c++) {
+        dfa.stamp++;
+        dfa.pcs_count = 0;
+        const int *pcs = dfa.states[i];
+        for (size_t j = 0; j < dfa.state_sizes[i]; j++) {
+          const struct zsv_regex_inst *inst = &re->prog[pcs[j]];
+          if (inst->op == zsv_regex_op_set && zsv_regex_set_has(&re->sets[inst->x], reps[c]))
+            zsv_regex_closure(&dfa, pcs[j] + 1, 0);
+        }
+        zsv_regex_closure(&dfa, 0, 0); // a match may start after any byte
+        if ((st = zsv_regex_state(&dfa, re)) >= 0)
+          re->delta[i * re->class_count + c] = (uint32_t)st; // row may have moved
+      }
+    }
+  }
+  if (st < 0) {
+    if (st == -2)
+      stat = zsv_status_memory;
+    free(re->delta); // too large: simulate the NFA instead
+    re->delta = NULL;
+  }
+
+  for (size_t i = 0; i < dfa.state_count; i++)
+    free(dfa.states[i]);
+  free(dfa.states);
+  free(dfa.state_sizes);
+  free(dfa.table);
+  free(dfa.seen);
+  free(dfa.stack);
+  free(dfa.pcs);
+  return stat;
+}
+
+/* API */
+
+enum zsv_status zsv_regex_new(const char *pattern, unsigned flags, struct zsv_regex **rep) {
+  *rep = NULL;
+  struct zsv_regex *re = calloc(1, sizeof(*re));
+  if (!re)
+    return zsv_status_memory;
+
+  struct zsv_regex_parser ps = {0};
+  ps.re = re;
+  ps.p = (const unsigned char *)pattern;
+  if (!strncmp(pattern, "(?i)", 4)) {
+    flags |= ZSV_REGEX_ICASE;
+    ps.p += 4;
+  }
+  int root = zsv_regex_parse_alt(&ps);
+  if (root >= 0 && *ps.p) // only a ) can stop the parse early
+    zsv_regex_error(&ps, "unmatched )");
+
+  if (ps.stat == zsv_status_ok) {
+    if (flags & ZSV_REGEX_ICASE)
+      for (size_t i = 0; i < re->set_count; i++)
+        for (unsigned c = 'a'; c <= 'z'; c++)
+          if (zsv_regex_set_has(&re->sets[i], c) || zsv_regex_set_has(&re->sets[i], c - ('a' - 'A'))) {
+            zsv_regex_set_add(&re->sets[i], c);
+            zsv_regex_set_add(&re->sets[i], c - ('a' - 'A'));
+          }
+    zsv_regex_prefix(&ps, root);
+    if (zsv_regex_inst(&ps, zsv_regex_op_save, 0, 0) >= 0 && zsv_regex_emit(&ps, root) >= 0 &&
+        zsv_regex_inst(&ps, zsv_regex_op_save, 1, 0) >= 0)
+      zsv_regex_inst(&ps, zsv_regex_op_match, 0, 0);
+  }
+  free(ps.nodes);
+
+  if (ps.stat == zsv_status_ok)
+    ps.stat = zsv_regex_dfa_build(re);
+  if (ps.stat != zsv_status_ok) {
+    if (ps.stat == zsv_status_invalid_option)
+      fprintf(stderr, "Invalid regular expression %s: %s\n", pattern, ps.error);
+    zsv_regex_delete(re);
+    return ps.stat;
+  }
+  re->empty_match = zsv_regex_pike(re, (const unsigned char *)"", 0, NULL, 0);
+  *rep = re;
+  return zsv_status_ok;
+}
+
+unsigned zsv_regex_group_count(const struct zsv_regex *re) {
+  return re->group_count;
+}
+
+static inline const unsigned char *zsv_regex_find_prefix(const struct zsv_regex *re, const unsigned char *s,
+                                                         size_t len) {
+  if (re->prefix_len == 1)
+    return memchr(s, re->prefix[0], len);
+  return memmem(s, len, re->prefix, re->prefix_len);
+}
+
+char zsv_regex_match(const struct zsv_regex *re, const unsigned char *s, size_t len) {
+  if (!len)
+    return re->empty_match;
+  const unsigned char *p = s;
+  const unsigned char *end = s + len;
+  const char skip = re->prefix_len && !re->anchored; // skip ahead to where a match could start
+  if (re->prefix_len && !(p = zsv_regex_find_prefix(re, s, len)))
+    return 0;
+  if (!re->delta)
+    return zsv_regex_pike(re, s, len, NULL, 0);
+  if (!skip)
+    p = s;
+
+  const uint32_t *delta = re->delta;
+  const unsigned char *state_flags = re->state_flags;
+  const uint16_t *classes = re->classes;
+  const size_t k = re->class_count;
+  const uint32_t restart = re->restart;
+  uint32_t st = p == s ? re->start : restart;
+  if (state_flags[st] & (ZSV_REGEX_ACCEPT | ZSV_REGEX_DEAD))
+    return state_flags[st] & ZSV_REGEX_ACCEPT;
+  while (p < end) {
+    if (st == restart && skip && !(p = zsv_regex_find_prefix(re, p, (size_t)(end - p))))
+      return 0;
+    st = delta[st * k + classes[*p++]];
+    if (VERY_UNLIKELY(state_flags[st] & (ZSV_REGEX_ACCEPT | ZSV_REGEX_DEAD)))
+      return state_flags[st] & ZSV_REGEX_ACCEPT;
+  }
+  return (state_flags[st] & ZSV_REGEX_ACCEPT_END) != 0;
+}
+
+char zsv_regex_capture(const struct zsv_regex *re, const unsigned char *s, size_t len,
+                       struct zsv_regex_group *groups, size_t n) {
+  if (!zsv_regex_match(re, s, len))
+    return 0;
+  return zsv_regex_pike(re, s, len, groups, n);
+}
+
+void zsv_regex_delete(struct zsv_regex *re) {
+  if (re) {
+    free(re->prog);
+    free(re->sets);
+    free(re->delta);
+    free(re->state_flags);
+    free(re);
+  }
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Reservoir sampling (see zsv_sample_new())
+ *
+ * Rows offered without a key share a single reservoir, filled by Algorithm L:
+ * once the reservoir is full, the rows between two that are kept follow a
+ * geometric distribution whose parameter w shrinks by a random factor after each
+ * replacement, so only one or two random numbers are drawn per row kept, and none
+ * per row passed over. Rows offered with a key each go to the reservoir of their
+ * key, found in an open-addressing hash table, and are kept by Algorithm R: the
+ * i-th row of a key replaces a random one of its n rows with probability n / i
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsv/utils/random.h>
+#include <zsv/utils/sample.h>
+
+struct zsv_sample_row {
+  size_t row_number;
+  size_t len;
+  unsigned char data[];
+};
+
+struct zsv_sample_group {
+  unsigned char *key;
+  size_t key_len;
+  uint64_t hash;
+  size_t seen; // rows offered so far
+  struct zsv_sample_row **rows;
+  size_t count; // up to n
+  size_t capacity;
+};
+
+struct zsv_sample {
+  size_t n;
+  struct zsv_random random;
+
+  struct zsv_sample_group all; // rows offered without a key
+  double w;                    // Algorithm L's weight
+  size_t gap;                  // rows to pass over before the next one that is kept
+
+  struct zsv_sample_group **groups; // rows offered with a key: hash table of group_capacity (a power of 2)
+  size_t group_count;
+  size_t group_capacity;
+
+  struct zsv_sample_group *pending; // group of the row to keep, if any; NULL if it could not be created
+  size_t slot;                      // index of the row to keep in pending->rows
+  char pending_memory_error;
+};
+
+enum zsv_status zsv_sample_new(size_t n, uint64_t seed, struct zsv_sample **sample) {
+  *sample = NULL;
+  if (!n)
+    return zsv_status_invalid_option;
+  struct zsv_sample *s = calloc(1, sizeof(*s));
+  if (!s)
+    return zsv_status_memory;
+  s->n = n;
+  s->w = 1;
+  zsv_random_seed(&s->random, seed);
+  *sample = s;
+  return zsv_status_ok;
+}
+
+static uint64_t zsv_sample_hash(const unsigned char *key, size_t len) {
+  uint64_t h = 0xcbf29ce484222325; // FNV-1a
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ key[i]) * 0x100000001b3;
+  return h;
+}
+
+static int zsv_sample_groups_grow(struct zsv_sample *s) {
+  size_t capacity = s->group_capacity ? s->group_capacity * 2 : 64;
+  struct zsv_sample_group **groups = calloc(capacity, sizeof(*groups));
+  if (!groups)
+    return 1;
+  for (size_t i = 0; i < s->group_capacity; i++) {
+    struct zsv_sample_group *g = s->groups[i];
+    if (g) {
+      size_t j = g->hash & (capacity - 1);
+      while (groups[j])
+        j = (j + 1) & (capacity - 1);
+      groups[j] = g;
+    }
+  }
+  free(s->groups);
+  s->groups = groups;
+  s->group_capacity = capacity;
+  return 0;
+}
+
+// zsv_sample_group(): find or add the group with the given key; NULL if out of memory
+static struct zsv_sample_group *zsv_sample_group(struct zsv_sample *s, const unsigned char *key, size_t len) {
+  if ((s->group_count + 1) * 2 > s->group_capacity && zsv_sample_groups_grow(s))
+    return NULL;
+  uint64_t hash = zsv_sample_hash(key, len);
+  size_t mask = s->group_capacity - 1;
+  size_t i = hash & mask;
+  for (struct zsv_sample_group *g; (g = s->groups[i]); i = (i + 1) & mask)
+    if (g->hash == hash && g->key_len == len && !memcmp(g->key, key, len))
+      return g;
+
+  struct zsv_sample_group *g = calloc(1, sizeof(*g));
+  if (!g || !(g->key = malloc(len ? len : 1))) {
+    free(g);
+    return NULL;
+  }
+  memcpy(g->key, key, len);
+  g->key_len = len;
+  g->hash = hash;
+  s->groups[i] = g;
+  s->group_count++;
+  return g;
+}
+
+char zsv_sample_offer(struct zsv_sample *s, const unsigned char *key, size_t key_len) {
+  struct zsv_sample_group *g;
+  s->pending = NULL;
+  s->pending_memory_error = 0;
+  if (!key) {
+    if (s->gap) {
+      s->gap--;
+      return 0;
+    }
+    g = &s->all;
+    g->seen++;
+    s->slot = g->count < s->n ? g->count : (size_t)zsv_random_below(&s->random, s->n);
+    if (g->count + 1 >= s->n) { // the reservoir is full once this row is kept
+      s->w *= exp(log(1 - zsv_random_double(&s->random)) / (double)s->n);
+      s->gap = zsv_random_geometric(&s->random, s->w);
+    }
+  } else {
+    if (!(g = zsv_sample_group(s, key, key_len))) {
+      s->pending_memory_error = 1;
+      return 1; // for zsv_sample_keep() to report
+    }
+    g->seen++;
+    if (g->count < s->n)
+      s->slot = g->count;
+    else if ((s->slot = (size_t)zsv_random_below(&s->random, g->seen)) >= s->n)
+      return 0;
+  }
+  s->pending = g;
+  return 1;
+}
+
+enum zsv_status zsv_sample_keep(struct zsv_sample *s, size_t row_number, const unsigned char *data, size_t len) {
+  struct zsv_sample_group *g = s->pending;
+  s->pending = NULL;
+  if (!g)
+    return s->pending_memory_error ? zsv_status_memory : zsv_status_error;
+  if (s->slot == g->count) {
+    if (g->count == g->capacity) {
+      size_t capacity = g->capacity ? g->capacity * 2 : 16;
+      if (capacity > s->n)
+        capacity = s->n;
+      struct zsv_sample_row **rows = realloc(g->rows, capacity * sizeof(*rows));
+      if (!rows)
+        return zsv_status_memory;
+      g->rows = rows;
+      g->capacity = capacity;
+    }
+    g->rows[g->count] = NULL;
+  }
+  struct zsv_sample_row *r = realloc(g->rows[s->slot], sizeof(*r) + len);
+  if (!r)
+    return zsv_status_memory;
+  r->row_number = row_number;
+  r->len = len;
+  if (len)
+    memcpy(r->data, data, len);
+  g->rows[s->slot] = r;
+  if (s->slot == g->count)
+    g->count++;
+  return zsv_status_ok;
+}
+
+size_t zsv_sample_gap(struct zsv_sample *s) {
+  size_t gap = s->gap;
+  s->gap = 0;
+  return gap;
+}
+
+static int zsv_sample_row_cmp(const void *x, const void *y) {
+  const struct zsv_sample_row *a = *(struct zsv_sample_row *const *)x;
+  const struct zsv_sample_row *b = *(struct zsv_sample_row *const *)y;
+  return a->row_number < b->row_number ? -1 : a->row_number > b->row_number;
+}
+
+void zsv_sample_rows(struct zsv_sample *s, int (*handler)(void *ctx, size_t row_number, const unsigned char *data,
+                                                          size_t len),
+                     void *ctx) {
+  size_t count = s->all.count;
+  for (size_t i = 0; i < s->group_capacity; i++)
+    if (s->groups[i])
+      count += s->groups[i]->count;
+  if (!count)
+    return;
+
+  struct zsv_sample_row **rows = malloc(count * sizeof(*rows));
+  if (!rows) {
+    // fall back to the order in which the rows are stored
+    for (size_t j = 0; j < s->all.count; j++)
+      if (handler(ctx, s->all.rows[j]->row_number, s->all.rows[j]->data, s->all.rows[j]->len))
+        return;
+    for (size_t i = 0; i < s->group_capacity; i++)
+      for (size_t j = 0; s->groups[i] && j < s->groups[i]->count; j++)
+        if (handler(ctx, s->groups[i]->rows[j]->row_number, s->groups[i]->rows[j]->data, s->groups[i]->rows[j]->len))
+          return;
+    return;
+  }
+  size_t used = 0;
+  for (size_t j = 0; j < s->all.count; j++)
+    rows[used++] = s->all.rows[j];
+  for (size_t i = 0; i < s->group_capacity; i++)
+    for (size_t j = 0; s->groups[i] && j < s->groups[i]->count; j++)
+      rows[used++] = s->groups[i]->rows[j];
+  qsort(rows, count, sizeof(*rows), zsv_sample_row_cmp);
+  for (size_t i = 0; i < count; i++)
+    if (handler(ctx, rows[i]->row_number, rows[i]->data, rows[i]->len))
+      break;
+  free(rows);
+}
+
+static void zsv_sample_group_free(struct zsv_sample_group *g) {
+  for (size_t i = 0; i < g->count; i++)
+    free(g->rows[i]);
+  free(g->rows);
+  free(g->key);
+}
+
+void zsv_sample_delete(struct zsv_sample *s) {
+  if (s) {
+    zsv_sample_group_free(&s->all);
+    for (size_t i = 0; i < s->group_capacity; i++) {
+      if (s->groups[i]) {
+        zsv_sample_group_free(s->groups[i]);
+        free(s->groups[i]);
+      }
+    }
+    free(s->groups);
+    free(s);
+  }
+}
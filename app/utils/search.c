@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Multi-pattern search (see zsv_search_new())
+ *
+ * The search strings are compiled into an Aho-Corasick automaton, which is
+ * then filled out into a DFA so that each input byte costs one table lookup,
+ * regardless of how many strings are searched for. To keep the table small,
+ * bytes are first mapped to classes: each byte that occurs in a search string
+ * (folded to lower case, with ZSV_SEARCH_ICASE) gets a class of its own, and
+ * all other bytes share class 0, which always leads back to the start state
+ *
+ * Each state that completes a search string records its length, and each state
+ * links to the next state on its chain of suffixes that also completes one, so
+ * that all matches that end at a given position are found
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsv/utils/compiler.h>
+#include <zsv/utils/search.h>
+
+// maximum number of bytes (quotes and delimiter) between the end of one cell
+// and the start of the next for zsv_search_cells() to scan them in one pass
+#define ZSV_SEARCH_CELL_GAP_MAX 4
+
+struct zsv_search_string {
+  unsigned char *value;
+  size_t len;
+};
+
+struct zsv_search {
+  struct zsv_search_string *strings;
+  size_t count;
+  size_t capacity;
+  size_t min_len;
+  size_t max_len;
+  unsigned flags;
+
+  unsigned class_count;
+  uint16_t classes[256]; // byte => class
+
+  uint32_t *delta;    // [state * class_count + class] => next state; NULL if nothing to search for
+  uint32_t *out_len;  // [state] => length of the search string that ends at this state, or 0
+  uint32_t *out_next; // [state] => next state on the suffix chain with a non-zero out_len, or 0
+
+  int first_byte; // the first byte of every search string, if they all share it and it has no other case; else -1
+};
+
+static inline unsigned char zsv_search_fold(unsigned char c) {
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+struct zsv_search *zsv_search_new(unsigned flags) {
+  struct zsv_search *search = calloc(1, sizeof(*search));
+  if (search)
+    search->flags = flags;
+  return search;
+}
+
+enum zsv_status zsv_search_add(struct zsv_search *search, const unsigned char *value, size_t len) {
+  if (search->delta)
+    return zsv_status_invalid_option;
+  if (!len)
+    return zsv_status_ok;
+  if (search->count == search->capacity) {
+    size_t capacity = search->capacity ? search->capacity * 2 : 8;
+    struct zsv_search_string *strings = realloc(search->strings, capacity * sizeof(*strings));
+    if (!strings)
+      return zsv_status_memory;
+    search->strings = strings;
+    search->capacity = capacity;
+  }
+  unsigned char *copy = malloc(len);
+  if (!copy)
+    return zsv_status_memory;
+  for (size_t i = 0; i < len; i++)
+    copy[i] = search->flags & ZSV_SEARCH_ICASE ? zsv_search_fold(value[i]) : value[i];
+  search->strings[search->count].value = copy;
+  search->strings[search->count].len = len;
+  search->count++;
+  if (!search->min_len || len < search->min_len)
+    search->min_len = len;
+  if (len > search->max_len)
+    search->max_len = len;
+  return zsv_status_ok;
+}
+
+enum zsv_status zsv_search_compile(struct zsv_search *search) {
+  if (search->delta || !search->count)
+    return zsv_status_ok;
+
+  // byte classes
+  size_t max_states = 1;
+  search->class_count = 1;
+  for (size_t i = 0; i < search->count; i++) {
+    max_states += search->strings[i].len;
+    for (size_t j = 0; j < search->strings[i].len; j++) {
+      unsigned char c = search->strings[i].value[j];
+      if (!search->classes[c])
+        search->classes[c] = (uint16_t)search->class_count++;
+    }
+  }
+  if (search->flags & ZSV_SEARCH_ICASE)
+    for (unsigned c = 'A'; c <= 'Z'; c++)
+      search->classes[c] = search->classes[c + ('a' - 'A')];
+
+  search->first_byte = search->strings[0].value[0];
+  for (size_t i = 1; i < search->count; i++)
+    if (search->strings[i].value[0] != search->first_byte)
+      search->first_byte = -1;
+  if (search->first_byte >= 'a' && search->first_byte <= 'z' && (search->flags & ZSV_SEARCH_ICASE))
+    search->first_byte = -1;
+
+  const size_t k = search->class_count;
+  uint32_t *delta = calloc(max_states * k, sizeof(*delta));
+  uint32_t *out_len = calloc(max_states, sizeof(*out_len));
+  uint32_t *out_next = calloc(max_states, sizeof(*out_next));
+  uint32_t *fail = calloc(max_states, sizeof(*fail));
+  uint32_t *queue = calloc(max_states, sizeof(*queue));
+  if (!(delta && out_len && out_next && fail && queue)) {
+    free(delta);
+    free(out_len);
+    free(out_next);
+    free(fail);
+    free(queue);
+    return zsv_status_memory;
+  }
+
+  // trie; a zero transition means there is none, as no edge leads to the start state
+  uint32_t state_count = 1;
+  for (size_t i = 0; i < search->count; i++) {
+    uint32_t st = 0;
+    for (size_t j = 0; j < search->strings[i].len; j++) {
+      uint32_t *next = &delta[st * k + search->classes[search->strings[i].value[j]]];
+      if (!*next)
+        *next = state_count++;
+      st = *next;
+    }
+    out_len[st] = (uint32_t)search->strings[i].len;
+  }
+
+  // breadth-first, set each state's failure state and fill in its missing
+  // transitions from those of its failure state, which is always shallower
+  size_t head = 0, tail = 0;
+  for (size_t c = 0; c < k; c++)
+    if (delta[c])
+      queue[tail++] = delta[c];
+  while (head < tail) {
+    uint32_t st = queue[head++];
+    for (size_t c = 0; c < k; c++) {
+      uint32_t next = delta[st * k + c];
+      if (next) {
+        uint32_t f = fail[next] = delta[fail[st] * k + c];
+        out_next[next] = out_len[f] ? f : out_next[f];
+        queue[tail++] = next;
+      } else
+        delta[st * k + c] = delta[fail[st] * k + c];
+    }
+  }
+  free(fail);
+  free(queue);
+
+  search->delta = delta;
+  search->out_len = out_len;
+  search->out_next = out_next;
+  return zsv_status_ok;
+}
+
+char zsv_search_scan(const struct zsv_search *search, const unsigned char *s, size_t len,
+                     zsv_search_handler handler, void *ctx) {
+  if (!search->delta || len < search->min_len)
+    return 0;
+  const uint32_t *delta = search->delta;
+  const uint32_t *out_len = search->out_len;
+  const uint32_t *out_next = search->out_next;
+  const uint16_t *classes = search->classes;
+  const size_t k = search->class_count;
+  const unsigned char *end = s + len;
+  uint32_t st = 0;
+  for (const unsigned char *p = s; p < end; p++) {
+    if (st == 0 && search->first_byte >= 0 && !(p = memchr(p, search->first_byte, end - p)))
+      break;
+    st = delta[st * k + classes[*p]];
+    if (VERY_UNLIKELY(out_len[st] || out_next[st])) {
+      for (uint32_t o = out_len[st] ? st : out_next[st]; o; o = out_next[o])
+        if (handler(ctx, p + 1 - out_len[o], out_len[o]))
+          return 1;
+    }
+  }
+  return 0;
+}
+
+static char zsv_search_any(void *ctx, const unsigned char *match, size_t len) {
+  (void)(ctx);
+  (void)(match);
+  (void)(len);
+  return 1;
+}
+
+// zsv_search_equals(): check whether a search string ends at the end of s and is as long as s
+static char zsv_search_equals(const struct zsv_search *search, const unsigned char *s, size_t len) {
+  if (len < search->min_len || len > search->max_len)
+    return 0;
+  const size_t k = search->class_count;
+  uint32_t st = 0;
+  for (size_t i = 0; i < len; i++)
+    st = search->delta[st * k + search->classes[s[i]]];
+  for (uint32_t o = search->out_len[st] ? st : search->out_next[st]; o; o = search->out_next[o])
+    if (search->out_len[o] == len)
+      return 1;
+  return 0;
+}
+
+char zsv_search_cell(const struct zsv_search *search, const unsigned char *s, size_t len) {
+  if (!search->delta)
+    return 0;
+  if (search->flags & ZSV_SEARCH_WHOLE_CELL)
+    return zsv_search_equals(search, s, len);
+  return zsv_search_scan(search, s, len, zsv_search_any, NULL);
+}
+
+struct zsv_search_cells_ctx {
+  const struct zsv_cell *cells; // cells of the run that is scanned
+  size_t n;
+  size_t hit;
+};
+
+// zsv_search_cells_match(): accept a match that lies within a single cell
+static char zsv_search_cells_match(void *ctx, const unsigned char *match, size_t len) {
+  struct zsv_search_cells_ctx *c = ctx;
+  size_t lo = 0, hi = c->n;
+  while (hi - lo > 1) { // find the last cell that starts at or before the match
+    size_t mid = lo + (hi - lo) / 2;
+    if (c->cells[mid].str <= match)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  const struct zsv_cell *cell = &c->cells[lo];
+  if (match >= cell->str && match + len <= cell->str + cell->len) {
+    c->hit = lo;
+    return 1;
+  }
+  return 0;
+}
+
+char zsv_search_cells(const struct zsv_search *search, const struct zsv_cell *cells, size_t n, size_t *hit) {
+  if (!search->delta)
+    return 0;
+  if (search->flags & ZSV_SEARCH_WHOLE_CELL) {
+    for (size_t i = 0; i < n; i++) {
+      if (zsv_search_equals(search, cells[i].str, cells[i].len)) {
+        if (hit)
+          *hit = i;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  for (size_t i = 0, j; i < n; i = j) {
+    j = i + 1;
+    if (!cells[i].str)
+      continue;
+    // extend the run over each following cell that starts just after the last one ends
+    const unsigned char *end = cells[i].str + cells[i].len;
+    for (; j < n && cells[j].str >= end && (size_t)(cells[j].str - end) <= ZSV_SEARCH_CELL_GAP_MAX; j++)
+      end = cells[j].str + cells[j].len;
+    struct zsv_search_cells_ctx ctx = {cells + i, j - i, 0};
+    if (zsv_search_scan(search, cells[i].str, (size_t)(end - cells[i].str), zsv_search_cells_match, &ctx)) {
+      if (hit)
+        *hit = i + ctx.hit;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void zsv_search_delete(struct zsv_search *search) {
+  if (search) {
+    for (size_t i = 0; i < search->count; i++)
+      free(search->strings[i].value);
+    free(search->strings);
+    free(search->delta);
+    free(search->out_len);
+    free(search->out_next);
+    free(search);
+  }
+}
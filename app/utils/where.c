@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Row filter expressions (see zsv/utils/where.h)
+ *
+ * The parser emits tests directly, without building a syntax tree. Each test
+ * has a column, a kernel that is picked for its operator and operand type when
+ * it is compiled (e.g. a numeric range, or a case-insensitive prefix for
+ * `LIKE 'abc%'`), and a next step for each outcome: the index of another test,
+ * or ZSV_WHERE_TRUE / ZSV_WHERE_FALSE
+ *
+ * The next steps are the usual short-circuit jumps: the operands of `a AND b`
+ * both fail to the target that the whole expression fails to, and `a` passes
+ * to `b`. As the parser does not know what follows `a` until it has emitted
+ * `a`, it uses a new label (a negative value below ZSV_WHERE_FALSE) as the
+ * target, and replaces it once it does. NOT swaps the two targets
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsv/utils/regex.h>
+#include <zsv/utils/search.h>
+#include <zsv/utils/where.h>
+
+#define ZSV_WHERE_TRUE -1
+#define ZSV_WHERE_FALSE -2
+
+#define ZSV_WHERE_NUMBER_MAX 64 // longest value that may be parsed as a number
+
+// outcomes of a string comparison
+#define ZSV_WHERE_LT 1
+#define ZSV_WHERE_EQ 2
+#define ZSV_WHERE_GT 4
+
+struct zsv_where_test;
+typedef char (*zsv_where_kernel)(const struct zsv_where_test *test, const unsigned char *s, size_t len);
+
+struct zsv_where_test {
+  zsv_where_kernel kernel;
+  char *col_name;
+  size_t col; // set by zsv_where_bind()
+  int on_true;
+  int on_false;
+
+  unsigned char *value; // string operand
+  size_t len;
+  unsigned char cmp; // ZSV_WHERE_XX outcomes of a string comparison that pass
+  double lo;         // numeric range
+  double hi;
+  unsigned char lo_open : 1;
+  unsigned char hi_open : 1;
+  unsigned char _ : 6;
+  struct zsv_search *search; // IN list, or LIKE '%...%'
+  struct zsv_regex *re;      // REGEXP
+};
+
+struct zsv_where {
+  struct zsv_where_test *tests;
+  size_t count;
+  size_t capacity;
+  size_t *columns;
+  size_t column_count;
+};
+
+struct zsv_where_parser {
+  struct zsv_where *where;
+  const char *p;
+  int next_label;
+  enum zsv_status stat;
+};
+
+static inline unsigned char zsv_where_fold(unsigned char c) {
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static char zsv_where_ieq(const unsigned char *a, const unsigned char *b, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    if (zsv_where_fold(a[i]) != zsv_where_fold(b[i]))
+      return 0;
+  return 1;
+}
+
+static char zsv_where_number(const unsigned char *s, size_t len, double *d) {
+  char buff[ZSV_WHERE_NUMBER_MAX + 1];
+  if (!len || len > ZSV_WHERE_NUMBER_MAX || !(isdigit(*s) || *s == '-' || *s == '+' || *s == '.'))
+    return 0;
+  memcpy(buff, s, len);
+  buff[len] = '\0';
+  char *end;
+  *d = strtod(buff, &end);
+  return end == buff + len;
+}
+
+/* kernels */
+
+static char zsv_where_null(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  (void)(test);
+  (void)(s);
+  return len == 0;
+}
+
+static char zsv_where_str_eq(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return len == test->len && !memcmp(s, test->value, len);
+}
+
+static char zsv_where_str_cmp(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  int c = memcmp(s, test->value, len < test->len ? len : test->len);
+  if (!c)
+    c = len < test->len ? -1 : len > test->len;
+  return (test->cmp & (c < 0 ? ZSV_WHERE_LT : c > 0 ? ZSV_WHERE_GT : ZSV_WHERE_EQ)) != 0;
+}
+
+static char zsv_where_num_range(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  double d;
+  return zsv_where_number(s, len, &d) && (test->lo_open ? d > test->lo : d >= test->lo) &&
+         (test->hi_open ? d < test->hi : d <= test->hi);
+}
+
+static char zsv_where_num_ne(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  double d;
+  return zsv_where_number(s, len, &d) && d != test->lo;
+}
+
+static char zsv_where_search(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return zsv_search_cell(test->search, s, len);
+}
+
+static char zsv_where_like_exact(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return len == test->len && zsv_where_ieq(s, test->value, len);
+}
+
+static char zsv_where_like_prefix(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return len >= test->len && zsv_where_ieq(s, test->value, test->len);
+}
+
+static char zsv_where_like_suffix(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return len >= test->len && zsv_where_ieq(s + len - test->len, test->value, test->len);
+}
+
+// zsv_where_like(): match any LIKE pattern, where _ matches one UTF-8 char,
+// by retrying from the last % on a mismatch
+static char zsv_where_like(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  const unsigned char *p = test->value, *p_end = test->value + test->len;
+  const unsigned char *s_end = s + len;
+  const unsigned char *retry_p = NULL, *retry_s = NULL;
+  while (s < s_end) {
+    if (p < p_end && *p == '%') {
+      retry_p = ++p;
+      retry_s = s;
+    } else if (p < p_end && (*p == '_' || zsv_where_fold(*p) == zsv_where_fold(*s))) {
+      if (*p == '_')
+        while (s + 1 < s_end && (s[1] & 0xC0) == 0x80)
+          s++;
+      p++;
+      s++;
+    } else if (retry_p) {
+      p = retry_p;
+      s = ++retry_s;
+    } else
+      return 0;
+  }
+  while (p < p_end && *p == '%')
+    p++;
+  return p == p_end;
+}
+
+static char zsv_where_regex(const struct zsv_where_test *test, const unsigned char *s, size_t len) {
+  return zsv_regex_match(test->re, s, len);
+}
+
+/* parser */
+
+static void zsv_where_error(struct zsv_where_parser *ps, const char *msg) {
+  if (ps->stat == zsv_status_ok) {
+    if (*ps->p)
+      fprintf(stderr, "Invalid expression (%s) at: %s\n", msg, ps->p);
+    else
+      fprintf(stderr, "Invalid expression (%s) at end\n", msg);
+    ps->stat = zsv_status_invalid_option;
+  }
+}
+
+static void zsv_where_skip_white(struct zsv_where_parser *ps) {
+  while (isspace((unsigned char)*ps->p))
+    ps->p++;
+}
+
+static inline char zsv_where_is_name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+static char zsv_where_accept(struct zsv_where_parser *ps, const char *token) {
+  zsv_where_skip_white(ps);
+  size_t n = strlen(token);
+  if (zsv_where_is_name_char(*token)) { // keyword
+    if (!zsv_where_ieq((const unsigned char *)ps->p, (const unsigned char *)token, n) ||
+        zsv_where_is_name_char(ps->p[n]))
+      return 0;
+  } else if (strncmp(ps->p, token, n))
+    return 0;
+  ps->p += n;
+  return 1;
+}
+
+static void zsv_where_expect(struct zsv_where_parser *ps, const char *token) {
+  if (!zsv_where_accept(ps, token)) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "expected %s", token);
+    zsv_where_error(ps, msg);
+  }
+}
+
+// zsv_where_quoted(): parse a string that is enclosed in the given quote, in
+// which a doubled quote stands for one
+static unsigned char *zsv_where_quoted(struct zsv_where_parser *ps, char quote, size_t *lenp) {
+  const char *start = ++ps->p;
+  size_t len = 0;
+  for (; *ps->p; ps->p++, len++) {
+    if (*ps->p == quote) {
+      if (ps->p[1] != quote)
+        break;
+      ps->p++;
+    }
+  }
+  if (*ps->p != quote) {
+    zsv_where_error(ps, "unterminated string or name");
+    return NULL;
+  }
+  ps->p++;
+  unsigned char *s = malloc(len + 1);
+  if (!s) {
+    ps->stat = zsv_status_memory;
+    return NULL;
+  }
+  for (size_t i = 0; i < len; i++, start++) {
+    s[i] = (unsigned char)*start;
+    if (*start == quote)
+      start++;
+  }
+  s[len] = '\0';
+  *lenp = len;
+  return s;
+}
+
+static char *zsv_where_column(struct zsv_where_parser *ps) {
+  zsv_where_skip_white(ps);
+  size_t len;
+  if (*ps->p == '"')
+    return (char *)zsv_where_quoted(ps, '"', &len);
+  const char *start = ps->p;
+  while (zsv_where_is_name_char(*ps->p))
+    ps->p++;
+  if (ps->p == start) {
+    zsv_where_error(ps, "expected a column name");
+    return NULL;
+  }
+  char *name = malloc(ps->p - start + 1);
+  if (!name)
+    ps->stat = zsv_status_memory;
+  else {
+    memcpy(name, start, ps->p - start);
+    name[ps->p - start] = '\0';
+  }
+  return name;
+}
+
+struct zsv_where_value {
+  unsigned char *str; // NULL if the value is a number
+  size_t len;
+  double number;
+  const char *text; // the number as written
+  size_t text_len;
+};
+
+static char zsv_where_value(struct zsv_where_parser *ps, struct zsv_where_value *v) {
+  zsv_where_skip_white(ps);
+  memset(v, 0, sizeof(*v));
+  if (*ps->p == '\'')
+    return (v->str = zsv_where_quoted(ps, '\'', &v->len)) != NULL;
+  const char *start = ps->p;
+  while (*ps->p && !isspace((unsigned char)*ps->p) && !strchr("(),", *ps->p))
+    ps->p++;
+  if (!zsv_where_number((const unsigned char *)start, ps->p - start, &v->number)) {
+    ps->p = start;
+    zsv_where_error(ps, "expected a number or a string in single quotes");
+    return 0;
+  }
+  v->text = start;
+  v->text_len = ps->p - start;
+  return 1;
+}
+
+// zsv_where_emit(): add a test, which takes ownership of col_name; return its index, or -1
+static int zsv_where_emit(struct zsv_where_parser *ps, char *col_name, zsv_where_kernel kernel, int on_true,
+                          int on_false) {
+  struct zsv_where *w = ps->where;
+  if (w->count == w->capacity) {
+    size_t capacity = w->capacity ? w->capacity * 2 : 8;
+    struct zsv_where_test *tests = realloc(w->tests, capacity * sizeof(*tests));
+    if (!tests) {
+      free(col_name);
+      ps->stat = zsv_status_memory;
+      return -1;
+    }
+    w->tests = tests;
+    w->capacity = capacity;
+  }
+  struct zsv_where_test *test = &w->tests[w->count];
+  memset(test, 0, sizeof(*test));
+  test->col_name = col_name;
+  test->kernel = kernel;
+  test->on_true = on_true;
+  test->on_false = on_false;
+  test->lo = -HUGE_VAL;
+  test->hi = HUGE_VAL;
+  return (int)w->count++;
+}
+
+// zsv_where_patch(): replace a label with a target in the tests from start on
+static void zsv_where_patch(struct zsv_where *w, size_t start, int label, int target) {
+  for (size_t i = start; i < w->count; i++) {
+    if (w->tests[i].on_true == label)
+      w->tests[i].on_true = target;
+    if (w->tests[i].on_false == label)
+      w->tests[i].on_false = target;
+  }
+}
+
+static void zsv_where_or(struct zsv_where_parser *ps, int on_true, int on_false);
+
+static void zsv_where_like_test(struct zsv_where_parser *ps, char *col, int on_true, int on_false) {
+  struct zsv_where_value v;
+  if (!zsv_where_value(ps, &v) || !v.str) {
+    if (ps->stat == zsv_status_ok)
+      zsv_where_error(ps, "expected a LIKE pattern in single quotes");
+    free(col);
+    return;
+  }
+  // pick a kernel for the usual forms: 'abc', 'abc%', '%abc' and '%abc%'
+  size_t lead = 0, trail = 0;
+  while (lead < v.len && v.str[lead] == '%')
+    lead++;
+  while (trail < v.len - lead && v.str[v.len - 1 - trail] == '%')
+    trail++;
+  char simple = 1;
+  for (size_t i = lead; i < v.len - trail; i++)
+    if (v.str[i] == '%' || v.str[i] == '_')
+      simple = 0;
+  size_t len = v.len - lead - trail;
+  zsv_where_kernel kernel = zsv_where_like;
+  if (simple && len)
+    kernel = lead ? (trail ? zsv_where_search : zsv_where_like_suffix) : (trail ? zsv_where_like_prefix : zsv_where_like_exact);
+  int ix = zsv_where_emit(ps, col, kernel, on_true, on_false);
+  if (ix < 0) {
+    free(v.str);
+    return;
+  }
+  struct zsv_where_test *test = &ps->where->tests[ix];
+  test->value = v.str;
+  test->len = v.len;
+  if (kernel != zsv_where_like) {
+    memmove(v.str, v.str + lead, len);
+    test->len = len;
+  }
+  if (kernel == zsv_where_search &&
+      (!(test->search = zsv_search_new(ZSV_SEARCH_ICASE)) || zsv_search_add(test->search, v.str, len) ||
+       zsv_search_compile(test->search)))
+    ps->stat = zsv_status_memory;
+}
+
+static void zsv_where_in_test(struct zsv_where_parser *ps, char *col, int on_true, int on_false) {
+  int ix = zsv_where_emit(ps, col, zsv_where_search, on_true, on_false);
+  if (ix < 0)
+    return;
+  struct zsv_search *search = ps->where->tests[ix].search = zsv_search_new(ZSV_SEARCH_WHOLE_CELL);
+  if (!search) {
+    ps->stat = zsv_status_memory;
+    return;
+  }
+  zsv_where_expect(ps, "(");
+  do {
+    struct zsv_where_value v;
+    if (ps->stat != zsv_status_ok || !zsv_where_value(ps, &v))
+      return;
+    // a number is compared as text, as written
+    if ((v.str ? zsv_search_add(search, v.str, v.len)
+               : zsv_search_add(search, (const unsigned char *)v.text, v.text_len)) != zsv_status_ok)
+      ps->stat = zsv_status_memory;
+    free(v.str);
+  } while (zsv_where_accept(ps, ","));
+  zsv_where_expect(ps, ")");
+  if (ps->stat == zsv_status_ok && zsv_search_compile(search) != zsv_status_ok)
+    ps->stat = zsv_status_memory;
+}
+
+static void zsv_where_regex_test(struct zsv_where_parser *ps, char *col, int on_true, int on_false) {
+  struct zsv_where_value v;
+  if (!zsv_where_value(ps, &v) || !v.str) {
+    if (ps->stat == zsv_status_ok)
+      zsv_where_error(ps, "expected a regular expression in single quotes");
+    free(col);
+    return;
+  }
+  int ix = zsv_where_emit(ps, col, zsv_where_regex, on_true, on_false);
+  if (ix >= 0) {
+    enum zsv_status stat = zsv_regex_new((const char *)v.str, 0, &ps->where->tests[ix].re);
+    if (stat != zsv_status_ok)
+      ps->stat = stat;
+  }
+  free(v.str);
+}
+
+static void zsv_where_compare(struct zsv_where_parser *ps, char *col, int on_true, int on_false) {
+  unsigned char cmp;
+  if (zsv_where_accept(ps, "<="))
+    cmp = ZSV_WHERE_LT | ZSV_WHERE_EQ;
+  else if (zsv_where_accept(ps, "<>") || zsv_where_accept(ps, "!="))
+    cmp = ZSV_WHERE_LT | ZSV_WHERE_GT;
+  else if (zsv_where_accept(ps, "<"))
+    cmp = ZSV_WHERE_LT;
+  else if (zsv_where_accept(ps, ">="))
+    cmp = ZSV_WHERE_GT | ZSV_WHERE_EQ;
+  else if (zsv_where_accept(ps, ">"))
+    cmp = ZSV_WHERE_GT;
+  else if (zsv_where_accept(ps, "==") || zsv_where_accept(ps, "="))
+    cmp = ZSV_WHERE_EQ;
+  else {
+    zsv_where_error(ps, "expected an operator");
+    free(col);
+    return;
+  }
+
+  struct zsv_where_value v;
+  if (!zsv_where_value(ps, &v)) {
+    free(col);
+    return;
+  }
+  zsv_where_kernel kernel;
+  if (v.str)
+    kernel = cmp == ZSV_WHERE_EQ ? zsv_where_str_eq : zsv_where_str_cmp;
+  else
+    kernel = cmp == (ZSV_WHERE_LT | ZSV_WHERE_GT) ? zsv_where_num_ne : zsv_where_num_range;
+  int ix = zsv_where_emit(ps, col, kernel, on_true, on_false);
+  if (ix < 0) {
+    free(v.str);
+    return;
+  }
+  struct zsv_where_test *test = &ps->where->tests[ix];
+  test->value = v.str;
+  test->len = v.len;
+  test->cmp = cmp;
+  if (kernel == zsv_where_num_ne)
+    test->lo = v.number;
+  else if (!v.str) {
+    if (!(cmp & ZSV_WHERE_LT))
+      test->lo = v.number;
+    if (!(cmp & ZSV_WHERE_GT))
+      test->hi = v.number;
+    test->lo_open = cmp == ZSV_WHERE_GT;
+    test->hi_open = cmp == ZSV_WHERE_LT;
+  }
+}
+
+static void zsv_where_between(struct zsv_where_parser *ps, char *col, int on_true, int on_false) {
+  struct zsv_where_value lo, hi;
+  if (!zsv_where_value(ps, &lo)) {
+    free(col);
+    return;
+  }
+  zsv_where_expect(ps, "AND");
+  if (ps->stat != zsv_status_ok || !zsv_where_value(ps, &hi)) {
+    free(lo.str);
+    free(col);
+    return;
+  }
+  if (!lo.str != !hi.str) {
+    zsv_where_error(ps, "BETWEEN values must both be numbers or both be strings");
+    free(lo.str);
+    free(hi.str);
+    free(col);
+  } else if (!lo.str) { // one numeric range
+    int ix = zsv_where_emit(ps, col, zsv_where_num_range, on_true, on_false);
+    if (ix >= 0) {
+      ps->where->tests[ix].lo = lo.number;
+      ps->where->tests[ix].hi = hi.number;
+    }
+  } else { // >= lo, then <= hi
+    char *col2 = strdup(col);
+    int ix = zsv_where_emit(ps, col, zsv_where_str_cmp, (int)ps->where->count + 1, on_false);
+    if (ix >= 0) {
+      ps->where->tests[ix].value = lo.str;
+      ps->where->tests[ix].len = lo.len;
+      ps->where->tests[ix].cmp = ZSV_WHERE_GT | ZSV_WHERE_EQ;
+      lo.str = NULL;
+    }
+    if (!col2)
+      ps->stat = zsv_status_memory;
+    else if ((ix = zsv_where_emit(ps, col2, zsv_where_str_cmp, on_true, on_false)) >= 0) {
+      ps->where->tests[ix].value = hi.str;
+      ps->where->tests[ix].len = hi.len;
+      ps->where->tests[ix].cmp = ZSV_WHERE_LT | ZSV_WHERE_EQ;
+      hi.str = NULL;
+    }
+    free(lo.str);
+    free(hi.str);
+  }
+}
+
+static void zsv_where_primary(struct zsv_where_parser *ps, int on_true, int on_false) {
+  if (zsv_where_accept(ps, "(")) {
+    zsv_where_or(ps, on_true, on_false);
+    zsv_where_expect(ps, ")");
+    return;
+  }
+  char *col = zsv_where_column(ps);
+  if (!col)
+    return;
+  if (zsv_where_accept(ps, "IS")) {
+    if (zsv_where_accept(ps, "NOT")) {
+      int tmp = on_true;
+      on_true = on_false;
+      on_false = tmp;
+    }
+    zsv_where_expect(ps, "NULL");
+    if (ps->stat == zsv_status_ok)
+      zsv_where_emit(ps, col, zsv_where_null, on_true, on_false);
+    else
+      free(col);
+    return;
+  }
+  char negated = zsv_where_accept(ps, "NOT");
+  if (negated) {
+    int tmp = on_true;
+    on_true = on_false;
+    on_false = tmp;
+  }
+  if (zsv_where_accept(ps, "BETWEEN"))
+    zsv_where_between(ps, col, on_true, on_false);
+  else if (zsv_where_accept(ps, "LIKE"))
+    zsv_where_like_test(ps, col, on_true, on_false);
+  else if (zsv_where_accept(ps, "IN"))
+    zsv_where_in_test(ps, col, on_true, on_false);
+  else if (zsv_where_accept(ps, "REGEXP") || zsv_where_accept(ps, "~"))
+    zsv_where_regex_test(ps, col, on_true, on_false);
+  else if (negated) {
+    zsv_where_error(ps, "expected BETWEEN, LIKE, IN or REGEXP");
+    free(col);
+  } else
+    zsv_where_compare(ps, col, on_true, on_false);
+}
+
+static void zsv_where_not(struct zsv_where_parser *ps, int on_true, int on_false) {
+  if (zsv_where_accept(ps, "NOT"))
+    zsv_where_not(ps, on_false, on_true);
+  else
+    zsv_where_primary(ps, on_true, on_false);
+}
+
+static void zsv_where_and(struct zsv_where_parser *ps, int on_true, int on_false) {
+  while (ps->stat == zsv_status_ok) {
+    int label = ps->next_label--;
+    size_t start = ps->where->count;
+    zsv_where_not(ps, label, on_false);
+    if (!zsv_where_accept(ps, "AND")) {
+      zsv_where_patch(ps->where, start, label, on_true);
+      return;
+    }
+    zsv_where_patch(ps->where, start, label, (int)ps->where->count);
+  }
+}
+
+static void zsv_where_or(struct zsv_where_parser *ps, int on_true, int on_false) {
+  while (ps->stat == zsv_status_ok) {
+    int label = ps->next_label--;
+    size_t start = ps->where->count;
+    zsv_where_and(ps, on_true, label);
+    if (!zsv_where_accept(ps, "OR")) {
+      zsv_where_patch(ps->where, start, label, on_false);
+      return;
+    }
+    zsv_where_patch(ps->where, start, label, (int)ps->where->count);
+  }
+}
+
+enum zsv_status zsv_where_new(const char *expr, struct zsv_where **where) {
+  struct zsv_where_parser ps = {0};
+  ps.p = expr;
+  ps.next_label = ZSV_WHERE_FALSE - 1;
+  if (!(ps.where = calloc(1, sizeof(*ps.where))))
+    return zsv_status_memory;
+  zsv_where_or(&ps, ZSV_WHERE_TRUE, ZSV_WHERE_FALSE);
+  zsv_where_skip_white(&ps);
+  if (ps.stat == zsv_status_ok && *ps.p)
+    zsv_where_error(&ps, "expected AND, OR or the end of the expression");
+  if (ps.stat != zsv_status_ok) {
+    zsv_where_delete(ps.where);
+    return ps.stat;
+  }
+  *where = ps.where;
+  return zsv_status_ok;
+}
+
+enum zsv_status zsv_where_bind(struct zsv_where *where, unsigned char *const *names, size_t count) {
+  free(where->columns);
+  where->column_count = 0;
+  if (!(where->columns = calloc(where->count + 1, sizeof(*where->columns))))
+    return zsv_status_memory;
+  for (size_t i = 0; i < where->count; i++) {
+    struct zsv_where_test *test = &where->tests[i];
+    const unsigned char *name = (const unsigned char *)test->col_name;
+    size_t len = strlen(test->col_name), j;
+    for (j = 0; j < count; j++)
+      if (names[j] && !strcmp((const char *)names[j], test->col_name))
+        break;
+    if (j == count)
+      for (j = 0; j < count; j++)
+        if (names[j] && strlen((const char *)names[j]) == len && zsv_where_ieq(names[j], name, len))
+          break;
+    if (j == count) {
+      fprintf(stderr, "Unknown column in expression: %s\n", test->col_name);
+      return zsv_status_invalid_option;
+    }
+    test->col = j;
+    size_t k;
+    for (k = 0; k < where->column_count && where->columns[k] != j; k++)
+      ;
+    if (k == where->column_count)
+      where->columns[where->column_count++] = j;
+  }
+  return zsv_status_ok;
+}
+
+const size_t *zsv_where_columns(const struct zsv_where *where, size_t *count) {
+  *count = where->column_count;
+  return where->columns;
+}
+
+char zsv_where_eval(const struct zsv_where *where, zsv_where_get_cell get_cell, void *ctx) {
+  int next = 0;
+  while (next >= 0) {
+    const struct zsv_where_test *test = &where->tests[next];
+    struct zsv_cell cell = get_cell(ctx, test->col);
+    next = test->kernel(test, cell.str, cell.len) ? test->on_true : test->on_false;
+  }
+  return next == ZSV_WHERE_TRUE;
+}
+
+void zsv_where_delete(struct zsv_where *where) {
+  if (where) {
+    for (size_t i = 0; i < where->count; i++) {
+      struct zsv_where_test *test = &where->tests[i];
+      free(test->col_name);
+      free(test->value);
+      zsv_search_delete(test->search);
+      zsv_regex_delete(test->re);
+    }
+    free(where->tests);
+    free(where->columns);
+    free(where);
+  }
+}
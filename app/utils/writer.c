@@ -8,6 +8,7 @@
 
 #include <zsv/utils/writer.h>
 #include <zsv/utils/compiler.h>
+#include <zsv/common.h> // ZSV_PARSER_QUOTE_ESCAPED
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
@@ -205,7 +206,12 @@ enum zsv_writer_status zsv_writer_delete(zsv_csv_writer w) {
 static inline enum zsv_writer_status zsv_writer_cell_aux(zsv_csv_writer w, const unsigned char *s, size_t len,
                                                          char check_if_needs_quoting) {
   if (len) {
-    if (check_if_needs_quoting) {
+    if (UNLIKELY(check_if_needs_quoting & ZSV_PARSER_QUOTE_ESCAPED)) {
+      // already escaped; just restore the enclosing quotes
+      zsv_output_buff_write(&w->out, (const unsigned char *)"\"", 1);
+      zsv_output_buff_write(&w->out, s, len);
+      zsv_output_buff_write(&w->out, (const unsigned char *)"\"", 1);
+    } else if (check_if_needs_quoting) {
       unsigned char *quoted_s = zsv_csv_quote(s, len, w->buff, w->buffsize);
       if (!quoted_s)
         zsv_output_buff_write(&w->out, s, len);
@@ -220,29 +226,61 @@ static inline enum zsv_writer_status zsv_writer_cell_aux(zsv_csv_writer w, const
   return zsv_writer_status_ok;
 }
 
+static inline void zsv_writer_start(zsv_csv_writer w) {
+  if (w->table_init)
+    w->table_init(w->table_init_ctx);
+  if (w->with_bom)
+    zsv_output_buff_write(&w->out, (const unsigned char *)"\xef\xbb\xbf", 3);
+  w->started = 1;
+}
+
+enum zsv_writer_status zsv_writer_raw(zsv_csv_writer w, char new_row, const unsigned char *s, size_t len) {
+  if (!w)
+    return zsv_writer_status_missing_handle;
+  if (!w->started)
+    zsv_writer_start(w);
+  else if (new_row)
+    zsv_output_buff_write(&w->out, (const unsigned char *)"\n", 1);
+  zsv_output_buff_write(&w->out, s, len);
+  return zsv_writer_status_ok;
+}
+
 enum zsv_writer_status zsv_writer_cell(zsv_csv_writer w, char new_row, const unsigned char *s, size_t len,
                                        char check_if_needs_quoting) {
   if (!w)
     return zsv_writer_status_missing_handle;
-  if (!w->started) {
-    if (w->table_init)
-      w->table_init(w->table_init_ctx);
-    if (w->with_bom)
-      zsv_output_buff_write(&w->out, (const unsigned char *)"\xef\xbb\xbf", 3);
-    w->started = 1;
-  } else if (new_row)
+  if (!w->started)
+    zsv_writer_start(w);
+  else if (new_row)
     zsv_output_buff_write(&w->out, (const unsigned char *)"\n", 1);
   else
     zsv_output_buff_write(&w->out, (const unsigned char *)",", 1);
 
   if (VERY_UNLIKELY(w->cell_prepend && *w->cell_prepend)) {
-    char *tmp = NULL;
-    asprintf(&tmp, "%s%.*s", w->cell_prepend, (int)len, s ? s : (const unsigned char *)"");
+    // copy the cell after the prefix, unescaping any embedded dbl-quotes (see
+    // zsv_opts.lazy_unescape) as it is copied
+    size_t prepend_len = strlen(w->cell_prepend);
+    unsigned char *tmp = malloc(prepend_len + len + 1);
     if (!tmp)
       return zsv_writer_status_error; // zsv_writer_status_memory;
-    s = (const unsigned char *)tmp;
-    len = len + strlen(w->cell_prepend);
-    enum zsv_writer_status stat = zsv_writer_cell_aux(w, s, len, 1);
+    memcpy(tmp, w->cell_prepend, prepend_len);
+    unsigned char *end = tmp + prepend_len;
+    if (check_if_needs_quoting & ZSV_PARSER_QUOTE_ESCAPED) {
+      for (const unsigned char *s_end = s + len; s < s_end;) {
+        const unsigned char *q = memchr(s, '"', (size_t)(s_end - s));
+        size_t n = q ? (size_t)(q - s) + 1 : (size_t)(s_end - s);
+        memcpy(end, s, n);
+        end += n;
+        s += n;
+        if (q && s < s_end && *s == '"') // skip the second quote of the pair
+          s++;
+      }
+    } else if (len) {
+      memcpy(end, s, len);
+      end += len;
+    }
+    *end = '\0';
+    enum zsv_writer_status stat = zsv_writer_cell_aux(w, tmp, (size_t)(end - tmp), 1);
     free(tmp);
     return stat;
   }
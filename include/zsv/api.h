@@ -20,6 +20,8 @@
 #define ZSV_MIN_SCANNER_BUFFSIZE 4096
 #define ZSV_DEFAULT_SCANNER_BUFFSIZE (1 << 18) // 256k
 
+#define ZSV_ROW_INDEX_STEP_DEFAULT 1024
+
 #include "zsv_export.h"
 /*****************************************************************************
  * libzsv API
@@ -115,6 +117,22 @@ size_t zsv_cell_count(zsv_parser parser);
  */
 struct zsv_cell zsv_get_cell(zsv_parser parser, size_t index);
 
+/**
+ * Get the contents of a cell, with any escaped dbl-quotes (see
+ * `zsv_opts.lazy_unescape`) unescaped into a caller-provided buffer
+ *
+ * @param parser
+ * @param index    zero-based index of the cell to fetch
+ * @param buff     buffer to unescape into. Only used if the cell has
+ *                 ZSV_PARSER_QUOTE_ESCAPED set
+ * @param buffsize size of buff, which must be at least the length of the cell as
+ *                 returned by `zsv_get_cell()`
+ * @return `zsv_cell` structure. If unescaping was required but buffsize was too
+ *         small, `str` is NULL and `len` is the required buffer size
+ */
+ZSV_EXPORT
+struct zsv_cell zsv_get_cell_unescaped(zsv_parser parser, size_t index, unsigned char *buff, size_t buffsize);
+
 /**
  * `zsv_get_cell_len()` is not needed in most cases, but may be useful in
  * restrictive cases such as when calling from Javascript into wasm
@@ -192,6 +210,32 @@ void zsv_set_read(zsv_parser parser, size_t (*read_func)(void *restrict, size_t
 ZSV_EXPORT
 void zsv_set_input(zsv_parser, void *in);
 
+/**
+ * Set a function that `zsv_delete()` calls to release an input stream, such as
+ * the state of a custom read function (see `zsv_set_read()`). It is called
+ * after any read-ahead thread has stopped
+ *
+ * @param parser
+ * @param close_func function to call, or NULL
+ * @param in         value that is passed to close_func
+ */
+ZSV_EXPORT
+void zsv_set_input_close(zsv_parser parser, void (*close_func)(void *in), void *in);
+
+/**
+ * Set a function that checks, when a read returns no more data, whether the
+ * input ended because of an error (as `ferror()` does for a FILE *), such as a
+ * custom read function (see `zsv_set_read()`) whose source is corrupt. If it
+ * returns non-zero, `zsv_parse_more()` returns zsv_status_error instead of
+ * zsv_status_no_more_input
+ *
+ * @param parser
+ * @param error_func function to call, or NULL
+ * @param in         value that is passed to error_func
+ */
+ZSV_EXPORT
+void zsv_set_input_error(zsv_parser parser, int (*error_func)(void *in), void *in);
+
 /**
  * Insert a filter to process or modify, before parsing, the next chunk of raw
  * bytes read from the input stream. For example, to save a copy of the raw
@@ -219,6 +263,59 @@ ZSV_EXPORT enum zsv_status zsv_set_scan_filter(zsv_parser parser,
  */
 ZSV_EXPORT enum zsv_status zsv_set_fixed_offsets(zsv_parser parser, size_t count, size_t *offsets);
 
+/**
+ * In fixed-width mode, treat the input as a sequence of records of the given
+ * length, without row ends (e.g. mainframe-style extracts). Rows are then sliced
+ * from the input without it being scanned at all. A final partial record is
+ * returned as a shorter row, less any trailing row end
+ *
+ * Must be called after `zsv_set_fixed_offsets()` and before parsing starts.
+ * Fixed-width input with a record length may also be pulled with `zsv_next_row()`
+ * or `zsv_next_batch()`, which slices all the rows in a buffer at once
+ *
+ * @param parser        parser handle
+ * @param record_length length of each record in bytes, or 0 for rows that end with \n, \r or \r\n
+ * @return status code
+ */
+ZSV_EXPORT enum zsv_status zsv_set_fixed_record_length(zsv_parser parser, size_t record_length);
+
+/**
+ * Only store the cells of the given columns. Other cells are skipped without
+ * any quote handling, and are returned by `zsv_get_cell()` as empty. Cells after
+ * the last selected column are not stored at all, so `zsv_cell_count()` will not
+ * exceed one more than the index of the last selected column, and the scanner
+ * may skip straight to the end of each row once that column has been parsed
+ *
+ * Takes effect from the next row, so may be called from a row handler e.g.
+ * after the header row has been processed. If called before then (e.g. before
+ * parsing starts), it takes effect from the row after the header row, whose
+ * cells are all stored so that e.g. empty leading rows (see
+ * `keep_empty_header_rows`) are still recognized as such. Has no effect in tape
+ * mode, where cells are only processed when they are fetched
+ *
+ * @param parser
+ * @param bitmap       bit (i % 8) of bitmap[i / 8] is set if the column with 0-based
+ *                     index i should be stored, or NULL to store all columns
+ * @param column_count number of columns (bits) in bitmap
+ * @return status code
+ */
+ZSV_EXPORT enum zsv_status zsv_set_column_filter(zsv_parser parser, const unsigned char *bitmap,
+                                                 size_t column_count);
+
+/**
+ * Skip the next rows: their cells are not stored, and they are not passed to
+ * the row handler or returned by `zsv_next_row()`. Where the scanner allows,
+ * a skipped row is only scanned for its end, which is much faster than parsing
+ * it, so e.g. a sample of rows is best taken by skipping the rows in between
+ *
+ * Takes effect from the next row, so is usually called from a row handler or
+ * after `zsv_next_row()`. Has no effect on fixed-width rows that are pulled
+ *
+ * @param parser
+ * @param n      number of rows to skip, replacing any prior number not yet skipped
+ */
+ZSV_EXPORT void zsv_skip_rows(zsv_parser parser, size_t n);
+
 /**
  * Parse a buffer of bytes. This function is usually not needed, but
  * can be used to parse in a push instead of pull manner
@@ -254,6 +351,23 @@ ZSV_EXPORT size_t zsv_scanned_length(zsv_parser);
  */
 ZSV_EXPORT size_t zsv_cum_scanned_length(zsv_parser parser);
 
+/**
+ * @return total time, in microseconds, that the parser has waited for input from
+ *         the read-ahead thread (see `zsv_opts.read_ahead`), or 0 if read-ahead
+ *         is not in use. If this is a significant portion of the total parse
+ *         time, consider a larger queue depth or buffer size
+ */
+ZSV_EXPORT size_t zsv_read_ahead_stall_usecs(zsv_parser parser);
+
+/**
+ * Get the statistics that have been collected so far by a parser that was
+ * created with `zsv_opts.stats` set (see `struct zsv_stats`). May be called
+ * from a handler
+ *
+ * @return stats, or all zeros if stats are not enabled
+ */
+ZSV_EXPORT struct zsv_stats zsv_get_stats(zsv_parser parser);
+
 /**
  * @return number of raw bytes scanned from the beginning to the end of this row
  */
@@ -310,6 +424,256 @@ ZSV_EXPORT void zsv_opts_delete(struct zsv_opts *);
 ZSV_EXPORT
 enum zsv_status zsv_next_row(zsv_parser parser);
 
+/**
+ * Pull up to batch->max_rows rows at once. Rows are only taken from the data
+ * that has already been read, so that all of their cells remain valid until
+ * the next `zsv_next_batch()` or `zsv_next_row()` call; more input is read
+ * only if no rows are left. If parsing has not yet started, tape mode (see
+ * `zsv_opts.tape`) is turned on, if possible, so that rows are scanned a
+ * buffer at a time, unless a column filter has been set (see
+ * `zsv_set_column_filter()`), which would then have no effect
+ *
+ * `zsv_next_row()` and `zsv_next_batch()` may be used on the same parser
+ *
+ * In fixed-width mode, a record length is required (see
+ * `zsv_set_fixed_record_length()`), and each call returns up to all of the
+ * whole records in the buffer, without any scanning
+ *
+ * @param  parser parser handle
+ * @param  batch  see `struct zsv_row_batch`
+ * @return zsv_status_row if batch->rows > 0, else a status code as returned by
+ *         `zsv_next_row()`
+ */
+ZSV_EXPORT
+enum zsv_status zsv_next_batch(zsv_parser parser, struct zsv_row_batch *batch);
+
+/******************************************************************************
+ * Parallel parsing functions
+ ******************************************************************************/
+
+/**
+ * Parse a seekable file using multiple threads. The file is split into byte
+ * ranges whose edges are moved to row boundaries using a quote-parity pass
+ * (which assumes that every double-quote toggles quoted state). Each range is
+ * parsed by its own parser on a worker thread, which calls the `row_handler()`
+ * set in `opts` with the context returned by `popts->chunk_start()`.
+ *
+ * If a chunk turns out to end inside a quoted cell (e.g. the input contains
+ * unbalanced quotes in unquoted cells), then in ordered mode the remainder of
+ * the file is re-parsed serially; in unordered mode, zsv_status_error is returned
+ *
+ * Options that only apply to the start of the input (`rows_to_ignore`,
+ * `header_span`, `insert_header_row`, `keep_empty_header_rows`) are applied
+ * only to the header row (or to the first chunk, if `popts->header` is not set)
+ *
+ * @param  path  path of the file to parse. Must be a regular file
+ * @param  opts  parser options. `stream`, `read` and `buff` are ignored
+ * @param  popts see `struct zsv_parallel_opts` in common.h
+ * @return zsv_status_ok on success, zsv_status_invalid_option if the input is
+ *         not a regular file, its header row does not fit in the parser's
+ *         buffer, or `opts` has a multi-byte delimiter, row terminator or
+ *         escape char (in which case the caller should parse serially), or
+ *         other zsv status code in the event of error or cancellation
+ */
+ZSV_EXPORT
+enum zsv_status zsv_parse_parallel(const char *path, struct zsv_opts *opts, struct zsv_parallel_opts *popts);
+
+/**
+ * Count the data rows of a seekable file, without parsing any cells. The
+ * header row is parsed as usual (applying `rows_to_ignore`, `header_span`
+ * etc), after which the file is memory-mapped and split into byte ranges that
+ * are scanned in parallel for row ends, tracking only quote parity
+ *
+ * The result is the same as the number of data rows that the parser would
+ * return. If the input contains a dbl-quote that does not open or close a cell
+ * (e.g. abc"def), or a row that exceeds the parser's buffer size, then the
+ * remainder of the file, from the start of the affected row, is parsed serially
+ *
+ * @param  path  path of the file to count. Must be a regular file
+ * @param  opts  parser options. `stream`, `read` and `buff` are ignored
+ * @param  popts optional; only `threads` and `chunk_size` are used
+ * @param  count on success, the number of data rows (excluding the header)
+ * @return zsv_status_ok on success, zsv_status_invalid_option if the input is
+ *         not a regular file, cannot be memory-mapped, its header row does not
+ *         fit in the parser's buffer, or `opts` requires the input to be
+ *         parsed (e.g. `max_rows`, `row_terminator` or `escape_char` is set),
+ *         in which case the caller should parse the file instead, or other
+ *         zsv status code on error
+ */
+ZSV_EXPORT
+enum zsv_status zsv_count_rows(const char *path, struct zsv_opts *opts, struct zsv_parallel_opts *popts,
+                               size_t *count);
+
+/******************************************************************************
+ * Random access functions
+ ******************************************************************************/
+
+struct zsv_row_index;
+
+/**
+ * Build a sparse index of the data rows of a seekable file, for use with
+ * `zsv_seek_row()`. The file is parsed once, and the offset of every `step`-th
+ * data row is recorded. Each of these checkpoints is at the start of a row, and
+ * so is always outside of quotes
+ *
+ * The index may only be used by a parser with the same delimiter, quote, escape,
+ * row terminator and header options (`rows_to_ignore`, `header_span`,
+ * `insert_header_row`, `keep_empty_header_rows`)
+ *
+ * @param  path  path of the file to index. Must be a regular file
+ * @param  opts  parser options. `stream`, `read` and `buff` are ignored
+ * @param  step  number of rows between checkpoints, or 0 for
+ *               ZSV_ROW_INDEX_STEP_DEFAULT. A seek parses at most `step - 1`
+ *               rows before the row sought
+ * @param  index on success, the index, which the caller must free with
+ *               `zsv_row_index_delete()`
+ * @return zsv_status_ok on success, zsv_status_invalid_option if the input is
+ *         not a regular file or has a row that does not fit in the parser's
+ *         buffer, or other zsv status code on error
+ */
+ZSV_EXPORT
+enum zsv_status zsv_index_rows(const char *path, struct zsv_opts *opts, size_t step, struct zsv_row_index **index);
+
+/**
+ * Save an index to a file. The file is in native byte order, and also records
+ * the size and modification time of the indexed file
+ */
+ZSV_EXPORT
+enum zsv_status zsv_row_index_save(const struct zsv_row_index *index, const char *path);
+
+/**
+ * Load an index that was saved with `zsv_row_index_save()`
+ * @param  path      path of the saved index
+ * @param  data_path path of the indexed file
+ * @param  index     on success, the index, which the caller must free with
+ *                   `zsv_row_index_delete()`
+ * @return zsv_status_ok on success, zsv_status_invalid_option if the saved
+ *         index is invalid or out of date (the size or modification time of
+ *         the indexed file has changed), or zsv_status_error if either file
+ *         cannot be read
+ */
+ZSV_EXPORT
+enum zsv_status zsv_row_index_load(const char *path, const char *data_path, struct zsv_row_index **index);
+
+/**
+ * @return the number of data rows in an index
+ */
+ZSV_EXPORT
+size_t zsv_row_index_rows(const struct zsv_row_index *index);
+
+ZSV_EXPORT
+void zsv_row_index_delete(struct zsv_row_index *index);
+
+/**
+ * Set the index used by `zsv_seek_row()`. The index is not copied, and must
+ * outlive its use by the parser
+ *
+ * The parser's input must be the indexed file, read with the default read
+ * function (or memory-mapped), starting at the beginning of the file. Fixed-width
+ * mode, read-ahead and overwrites are not supported
+ *
+ * @return zsv_status_ok on success, or zsv_status_invalid_option if the index
+ *         does not match the parser's options or input, or the input cannot be
+ *         repositioned
+ */
+ZSV_EXPORT
+enum zsv_status zsv_set_row_index(zsv_parser parser, const struct zsv_row_index *index);
+
+/**
+ * Reposition the parser so that the next data row it returns (or passes to its
+ * row handler) is data row `n` (0-based, excluding the header). If `n` is not
+ * less than the number of rows in the index, there are no more rows
+ *
+ * If parsing has not started, the header is first parsed, and passed to the
+ * row handler (or returned by `zsv_next_row()`), as usual. Otherwise, the seek
+ * applies immediately, and must not be called from within a handler
+ *
+ * @return zsv_status_ok on success, or zsv_status_invalid_option if no index
+ *         has been set (see `zsv_set_row_index()`)
+ */
+ZSV_EXPORT
+enum zsv_status zsv_seek_row(zsv_parser parser, size_t n);
+
+/******************************************************************************
+ * Arena functions
+ ******************************************************************************/
+
+/**
+ * An arena hands out memory from large blocks, all of which are freed at once.
+ * Use it to keep cell values past the row they belong to (see
+ * `zsv_cell_persist()`), instead of allocating and freeing each one
+ */
+struct zsv_arena;
+
+/**
+ * Create an arena
+ * @param  block_size size of the first block, or 0 for the default (64KB).
+ *                    Each further block is twice as large, up to 4MB
+ * @return arena, or NULL if out of memory
+ */
+ZSV_EXPORT
+struct zsv_arena *zsv_arena_new(size_t block_size);
+
+/**
+ * Allocate n bytes, aligned for any type, that remain valid until the arena is
+ * reset or deleted
+ * @return pointer to the allocated memory, or NULL if out of memory
+ */
+ZSV_EXPORT
+void *zsv_arena_alloc(struct zsv_arena *arena, size_t n);
+
+/**
+ * Copy len bytes of s to the arena, followed by a null terminator
+ * @return pointer to the copy, or NULL if out of memory
+ */
+ZSV_EXPORT
+unsigned char *zsv_arena_memdup(struct zsv_arena *arena, const void *s, size_t len);
+
+/**
+ * Free everything that was allocated from an arena, keeping its most recent
+ * block for reuse
+ */
+ZSV_EXPORT
+void zsv_arena_reset(struct zsv_arena *arena);
+
+ZSV_EXPORT
+void zsv_arena_delete(struct zsv_arena *arena);
+
+/**
+ * Lifetimes of the arenas that a parser owns (see `zsv_parser_arena()`)
+ */
+enum zsv_arena_scope {
+  zsv_arena_scope_row = 0, /* reset before each row is passed to the row handler or
+                              returned by `zsv_next_row()` or `zsv_next_batch()` */
+  zsv_arena_scope_parse    /* freed by `zsv_delete()` */
+};
+
+/**
+ * Get one of the arenas that a parser owns, creating it on first use. The
+ * caller must not reset or delete it
+ *
+ * Use the row-scoped arena for temporary values that are derived from the
+ * current row (e.g. a lowercase copy of a cell), and the parse-scoped arena
+ * for values that are kept until the parser is deleted
+ *
+ * @return arena, or NULL if out of memory
+ */
+ZSV_EXPORT
+struct zsv_arena *zsv_parser_arena(zsv_parser parser, enum zsv_arena_scope scope);
+
+/**
+ * Copy a cell value to an arena, so that it remains valid after the parser has
+ * moved on to the next row or refilled its buffer. The copy is null-terminated
+ *
+ * @param  parser parser handle
+ * @param  arena  arena to copy to, or NULL for the parser's parse-scoped arena
+ * @param  cell   cell returned by e.g. `zsv_get_cell()`
+ * @return the cell, with `str` pointing to the copy, or to NULL (and `len` set
+ *         to 0) if out of memory
+ */
+ZSV_EXPORT
+struct zsv_cell zsv_cell_persist(zsv_parser parser, struct zsv_arena *arena, struct zsv_cell cell);
+
 /******************************************************************************
  * Miscellaneous functions used by the parser that may have standalone utility
  ******************************************************************************/
@@ -60,6 +60,7 @@ struct zsv_cell {
 #define ZSV_PARSER_QUOTE_NEEDED 4   /* value contains delimiter or dbl-quote */
 #define ZSV_PARSER_QUOTE_EMBEDDED 8 /* value contains dbl-quote */
 #define ZSV_PARSER_QUOTE_PENDING 16 /* only used internally by parser */
+#define ZSV_PARSER_QUOTE_ESCAPED 32 /* value still contains escaped "" (see zsv_opts.lazy_unescape) */
   /**
    * quoted flags enable additional efficiency, in particular when input data will
    * be output as text (csv, json etc), by indicating whether the cell contents may
@@ -71,6 +72,34 @@ struct zsv_cell {
   unsigned char overwritten : 1;
 };
 
+/**
+ * Rows returned by `zsv_next_batch()`. The caller sets everything except `rows`
+ */
+struct zsv_row_batch {
+  /**
+   * array of max_rows * max_columns cells. Cell c of row r is at
+   * cells[c * max_rows + r] if column_major is set, else at
+   * cells[r * max_columns + c]. Cells that a row does not have are empty.
+   * May be NULL if max_columns is 0
+   */
+  struct zsv_cell *cells;
+
+  /**
+   * optional array of max_rows counts, which is set to the number of cells
+   * in each row (which may exceed max_columns)
+   */
+  size_t *cell_counts;
+
+  size_t max_rows;
+  size_t max_columns;
+  unsigned char column_major;
+
+  /**
+   * number of rows returned
+   */
+  size_t rows;
+};
+
 typedef size_t (*zsv_generic_write)(const void *restrict, size_t, size_t, void *restrict);
 typedef size_t (*zsv_generic_read)(void *restrict, size_t n, size_t size, void *restrict);
 
@@ -252,6 +281,136 @@ struct zsv_opts {
 #define ZSV_MALFORMED_UTF8_REMOVE -1
   char malformed_utf8_replace;
 
+  /**
+   * by default, escaped dbl-quotes in a quoted cell are unescaped during
+   * parsing (e.g. `"aaa""aaa"` becomes `aaa"aaa`). If lazy_unescape is set,
+   * cells of data rows are instead returned with only the enclosing quotes
+   * removed (e.g. `aaa""aaa`), with ZSV_PARSER_QUOTE_ESCAPED set. Such a cell
+   * can be output as CSV verbatim (see `zsv_writer_cell()`), or unescaped on
+   * demand with `zsv_get_cell_unescaped()`. Header rows are always unescaped
+   */
+  unsigned char lazy_unescape;
+
+  /**
+   * by default, delimited input is scanned with the fastest kernel that the
+   * cpu supports. To instead force a particular vector width (e.g. for testing
+   * or benchmarking), set scan_kernel to one of the below width values; a
+   * width that the cpu does not support is ignored. Add ZSV_SCAN_KERNEL_CLASSIC
+   * to use the standard kernel rather than the quote-parity kernel
+   *
+   * If scan_kernel is 0, the environment variable ZSV_SCAN_KERNEL is checked
+   * for a comma-separated list of any of: baseline, sse2, avx2, avx512, classic
+   */
+#define ZSV_SCAN_KERNEL_AUTO 0
+#define ZSV_SCAN_KERNEL_BASELINE 1 /* width set by compiler flags */
+#define ZSV_SCAN_KERNEL_SSE2 2
+#define ZSV_SCAN_KERNEL_AVX2 3
+#define ZSV_SCAN_KERNEL_AVX512 4
+#define ZSV_SCAN_KERNEL_CLASSIC 16
+  unsigned char scan_kernel;
+
+  /**
+   * If non-zero, each buffer of delimited input is scanned in a single pass
+   * that only records the position of each cell and row end, and cell values
+   * are then only processed (e.g. quotes removed) when requested via
+   * `zsv_get_cell()`. This may be faster when only a few of the columns of
+   * each row are used
+   *
+   * Tape mode is not used if a cell handler or overwrite is set, or if the
+   * buffer size exceeds 128MB
+   */
+  unsigned char tape;
+
+  /**
+   * If non-zero and `stream` is a regular file that is read with the default
+   * read function, the file is memory-mapped and parsed in place, without
+   * being copied into a buffer. `buffsize` then sets the size of the window
+   * that is scanned by each `zsv_parse_more()` call. Otherwise (e.g. if the
+   * input is a pipe, or `buff` or `insert_header_row` is set), this option is
+   * ignored
+   *
+   * As with any memory-mapped file, if the file is truncated by another process
+   * while it is being parsed, accessing the part that was removed raises SIGBUS,
+   * which terminates the process unless the caller handles it. Do not set this
+   * option for input that may be truncated in place (e.g. a log file that is
+   * rotated by truncation)
+   */
+  unsigned char mmap;
+
+  /**
+   * Read-ahead: if queue_depth is non-zero, input is read on a background thread
+   * into up to queue_depth buffers of buffsize bytes (defaults to the parser's
+   * buffsize), while previously read input is parsed. This can help when
+   * reading is slow, e.g. from a network filesystem or a decompressing pipe.
+   * Ignored if memory-mapped input (see `mmap`) is in use, or if built with
+   * NO_THREADING. If the buffers or the thread cannot be set up, input is read
+   * directly (with a warning if `verbose` is set). See also
+   * `zsv_read_ahead_stall_usecs()`
+   */
+  struct {
+    unsigned queue_depth;
+    size_t buffsize;
+  } read_ahead;
+
+  /**
+   * delimiter_string: a column delimiter of up to ZSV_DELIMITER_MAX bytes (e.g.
+   * "||"), which, if set, is used instead of `delimiter`. May not contain a
+   * newline, form feed or quote
+   *
+   * cli option: -O,--other-delim <delim>
+   */
+#define ZSV_DELIMITER_MAX 8
+  const char *delimiter_string;
+
+  /**
+   * row_terminator: if set, rows end with this string of up to ZSV_DELIMITER_MAX
+   * bytes (e.g. "\x1e") instead of with \n, \r or \r\n, which are then treated
+   * as ordinary chars. May not contain a quote, or be the start of the column
+   * delimiter
+   *
+   * Input with a multi-byte delimiter or a row terminator is scanned with a
+   * separate kernel (see `scan_kernel`), and is not supported by
+   * `zsv_parse_parallel()` or `zsv_count_rows()`
+   *
+   * cli option: -E,--row-terminator <string>
+   */
+  const char *row_terminator;
+
+  /**
+   * quote_char: the char that encloses quoted cells, if not dbl-quote (e.g.
+   * '\''). A quoted cell may contain an escaped quote char as two consecutive
+   * quote chars, as with dbl-quotes. Ignored if `no_quotes` is set
+   *
+   * cli option: -Q,--quote-char <char>
+   */
+  char quote_char;
+
+  /**
+   * escape_char: if set (e.g. to '\\', for MySQL `SELECT ... INTO OUTFILE` or
+   * PostgreSQL text-format exports), the char that follows this char, inside or
+   * outside of quotes, is cell content, and the escape char itself is removed.
+   * An escaped t, n or r is converted to a tab, newline or carriage return
+   *
+   * As with a multi-byte delimiter, input with an escape char is scanned with
+   * a separate kernel, and is not supported by `zsv_parse_parallel()` or
+   * `zsv_count_rows()`. `lazy_unescape` is ignored if either this or
+   * `quote_char` is set
+   *
+   * cli option: -X,--escape-char <char>
+   */
+  char escape_char;
+
+  /**
+   * If non-zero, the parser collects the statistics that are returned by
+   * `zsv_get_stats()`, and prints them to stderr when it is deleted. This adds
+   * a timer call around each read and each row or cell handler call. Not
+   * collected by the parsers that `zsv_parse_parallel()`, `zsv_count_rows()`
+   * and `zsv_index_rows()` use internally
+   *
+   * cli option: --stats
+   */
+  unsigned char stats;
+
 #ifdef ZSV_EXTRAS
   struct {
     /**
@@ -299,4 +458,94 @@ struct zsv_opts {
 #endif
 };
 
+/**
+ * Options for `zsv_parse_parallel()`
+ */
+struct zsv_parallel_opts {
+  /**
+   * number of worker threads. If 0, defaults to the number of online processors
+   */
+  unsigned threads;
+
+  /**
+   * approximate size, in bytes, of each chunk that is parsed by a single worker.
+   * If 0, a size is derived from the file size and the number of threads
+   */
+  size_t chunk_size;
+
+  /**
+   * by default, `chunk_end()` is called in the original order of the input
+   * chunks. Set `unordered` to 1 to instead call `chunk_end()` as soon as each
+   * chunk has been parsed
+   */
+  char unordered;
+
+  /**
+   * context passed to `header()`, `chunk_start()` and `chunk_end()`
+   */
+  void *ctx;
+
+  /**
+   * Optional callback that is called on the calling thread, before any chunk
+   * is parsed, with the (first) header row. Header options such as
+   * `rows_to_ignore` and `header_span` are applied to this row. If omitted,
+   * all rows are delivered to `row_handler()`
+   *
+   * @return zero to continue, non-zero to cancel
+   */
+  int (*header)(void *ctx, zsv_parser parser);
+
+  /**
+   * Optional callback that is called on a worker thread before a chunk is
+   * parsed. The returned value is used as the context passed to the
+   * `row_handler()` and `cell_handler()` set in `struct zsv_opts` for each
+   * row in this chunk. To cancel, call `zsv_abort(parser)`
+   */
+  void *(*chunk_start)(void *ctx, zsv_parser parser, size_t chunk_ix);
+
+  /**
+   * Optional callback that is called after a chunk has been parsed. Calls to
+   * `chunk_end()` are serialized and never overlap. If `stat` is not
+   * zsv_status_ok, the chunk's rows should be discarded (for example, the
+   * chunk will be re-parsed after a quote-parity mismatch); `chunk_end()` should
+   * still release any resources allocated by `chunk_start()`
+   *
+   * @return zsv_status_ok to continue, any other value to cancel
+   */
+  enum zsv_status (*chunk_end)(void *ctx, void *chunk_ctx, size_t chunk_ix, enum zsv_status stat);
+};
+
+/**
+ * Parser statistics returned by `zsv_get_stats()` (see `zsv_opts.stats`)
+ */
+struct zsv_stats {
+  size_t bytes_scanned;
+  size_t rows;          /* rows passed to the row handler or returned, including header rows */
+  size_t cells;         /* cells in those rows */
+  size_t quoted_cells;  /* cells that were enclosed in quotes */
+  size_t escaped_cells; /* cells that contained an escaped quote or an escape char */
+  size_t refills;       /* reads that added input to the buffer */
+  size_t shifted_bytes; /* bytes of partial rows that were moved to the start of the buffer */
+
+  /**
+   * time, in nanoseconds, spent in parse calls (`zsv_parse_more()`,
+   * `zsv_next_row()`, `zsv_next_batch()` and `zsv_finish()`), split into time
+   * spent reading (including any wait for read-ahead), in row and cell handlers,
+   * and the rest (scanning)
+   */
+  unsigned long long read_ns;
+  unsigned long long scan_ns;
+  unsigned long long callback_ns;
+
+  /**
+   * hardware counters for the thread that parses, from its first parse call on
+   * (including time spent in handlers). Only collected on Linux, if permitted
+   * (see perf_event_open(2)), in which case hw_counters is set
+   */
+  unsigned char hw_counters;
+  unsigned long long cycles;
+  unsigned long long instructions;
+  unsigned long long branch_misses;
+};
+
 #endif
@@ -9,7 +9,7 @@
 #ifndef ZSV_ARG_H
 #define ZSV_ARG_H
 
-#define ZSV_OPTS_SIZE_MAX 16
+#define ZSV_OPTS_SIZE_MAX 32
 
 #include <zsv/common.h>
 
@@ -56,11 +56,15 @@ void zsv_set_default_completed_callback(zsv_completed_callback cb, void *ctx);
  *     -c,--max-column-count <N>
  *     -r,--max-row-size <N>
  *     -t,--tab-delim
- *     -O,--other-delim <C>
+ *     -O,--other-delim <C>: column delimiter of up to ZSV_DELIMITER_MAX bytes
+ *     -E,--row-terminator <string>: end rows with this string instead of a newline
+ *     -Q,--quote-char <C>: quote char, if not dbl-quote
+ *     -X,--escape-char <C>: escape char e.g. '\\'
  *     -q,--no-quote
  *     -S,--keep-blank-headers: disable default behavior of ignoring leading blank rows
  *     -d,--header-row-span <n>: apply header depth (rowspan) of n
  *     -v,--verbose
+ *     --stats: print parser statistics to stderr when done (see zsv_get_stats())
  *
  * @param  argc      count of args to process
  * @param  argv      args to process
@@ -1,6 +1,8 @@
 #ifndef ZSV_CACHE_H
 #define ZSV_CACHE_H
 
+#include <zsv/common.h>
+
 /**
  * Overridable constants: ZSV_CACHE_PREFIX and ZSV_TEMPFILE_SUFFIX
  */
@@ -23,6 +25,7 @@
 #endif
 
 #define ZSV_CACHE_PROPERTIES_NAME "props"
+#define ZSV_CACHE_ROW_INDEX_NAME "rows"
 
 /**
  * Return the folder or file path to the cache for a given data file
@@ -32,7 +35,8 @@ unsigned char *zsv_cache_path(const unsigned char *data_filepath, const unsigned
 
 enum zsv_cache_type {
   zsv_cache_type_property = 1,
-  zsv_cache_type_tag
+  zsv_cache_type_tag,
+  zsv_cache_type_row_index // binary; see zsv_cache_row_index()
 };
 
 unsigned char *zsv_cache_filepath(const unsigned char *data_filepath, enum zsv_cache_type type, char create_dir,
@@ -42,6 +46,20 @@ int zsv_cache_print(const unsigned char *filepath, enum zsv_cache_type ctype, co
 
 int zsv_cache_remove(const unsigned char *filepath, enum zsv_cache_type ctype);
 
+struct zsv_row_index;
+
+/**
+ * Set a row index on a parser of the given data file (see zsv_seek_row()). The
+ * index is loaded from the cache if it is up to date and matches the parser's
+ * options; otherwise, it is built and saved to the cache
+ * @param opts  the options that the parser was created with
+ * @param index on success, the index, which the caller must free with
+ *              zsv_row_index_delete() after the parser is done with it
+ * @return zsv_status_ok on success
+ */
+enum zsv_status zsv_cache_row_index(const char *data_filepath, struct zsv_opts *opts, zsv_parser parser,
+                                    struct zsv_row_index **index);
+
 int zsv_modify_cache_file(const unsigned char *filepath, enum zsv_cache_type ctype, const unsigned char *json_value1,
                           const unsigned char *json_value2, const unsigned char *filter);
 
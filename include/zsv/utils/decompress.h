@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_DECOMPRESS_H
+#define ZSV_DECOMPRESS_H
+
+#include <stdio.h>
+#include <zsv/common.h>
+
+/**
+ * Compressed input formats, which are detected by their magic bytes
+ */
+enum zsv_compression {
+  zsv_compression_none = 0,
+  zsv_compression_gzip,
+  zsv_compression_zstd,
+  zsv_compression_bzip2
+};
+
+/**
+ * Maximum number of threads that decode a multi-frame zstd input
+ */
+#define ZSV_DECOMPRESS_THREADS_MAX 8
+
+/**
+ * Get the compression format of data that starts with the given bytes
+ * (at least 4 bytes are needed to detect any format)
+ */
+enum zsv_compression zsv_compression_detect(const unsigned char *buff, size_t len);
+
+/**
+ * Get the compression format of a file, or zsv_compression_none if the file
+ * is not compressed or cannot be read
+ */
+enum zsv_compression zsv_file_compression(const char *filepath);
+
+/**
+ * Get the name of a compression format (e.g. "gzip")
+ */
+const char *zsv_compression_name(enum zsv_compression compression);
+
+/**
+ * Check whether this build can decompress a given format
+ */
+char zsv_compression_supported(enum zsv_compression compression);
+
+struct zsv_decompressor;
+
+/**
+ * Create a reader that decompresses a stream, if the stream starts with the
+ * magic bytes of a compressed format. Decompressed data is decoded directly
+ * into the buffer that is passed to `zsv_decompress_read()`
+ *
+ * If the stream is not compressed, *d is set to NULL and the stream is left at
+ * its original position; or, if it cannot seek back (e.g. a pipe), *d is set to
+ * a reader that passes through the bytes that were read to check the format
+ *
+ * @param f       stream to read from. The caller remains responsible for closing it
+ * @param threads maximum number of threads to decode multi-frame zstd input with,
+ *                or 0 for the value of environment variable ZSV_DECOMPRESS_THREADS,
+ *                if set, else the number of CPUs (up to ZSV_DECOMPRESS_THREADS_MAX)
+ * @param d       on success, the reader or NULL, which the caller must free with
+ *                `zsv_decompressor_delete()`
+ * @return zsv_status_ok on success, zsv_status_invalid_option if the stream is
+ *         in a format that this build cannot decompress (see
+ *         `zsv_compression_supported()`), or zsv_status_memory
+ */
+enum zsv_status zsv_decompressor_new(FILE *f, unsigned threads, struct zsv_decompressor **d);
+
+/**
+ * Get the compression format of the stream that a reader decompresses
+ */
+enum zsv_compression zsv_decompressor_type(struct zsv_decompressor *d);
+
+/**
+ * Read function with the same signature as `fread()`, for use with
+ * `zsv_set_read()` or `zsv_opts.read` together with a `zsv_decompressor` as
+ * the stream. Returns 0 at the end of the input, or if the input is corrupt,
+ * in which case an error is printed to stderr (see `zsv_decompressor_error()`)
+ */
+size_t zsv_decompress_read(void *restrict buff, size_t size, size_t n, void *restrict d);
+
+/**
+ * Check whether a reader stopped because its input is corrupt or truncated.
+ * Takes a void pointer so that it can be passed to `zsv_set_input_error()`
+ *
+ * @return non-zero if `zsv_decompress_read()` returned 0 because of an error
+ */
+int zsv_decompressor_error(void *d);
+
+/**
+ * Free a reader that was created with `zsv_decompressor_new()`. Takes a void
+ * pointer so that it can be passed to `zsv_set_input_close()`
+ */
+void zsv_decompressor_delete(void *d);
+
+#endif
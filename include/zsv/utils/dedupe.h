@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_DEDUPE_H
+#define ZSV_DEDUPE_H
+
+#include <stddef.h>
+#include <zsv/common.h>
+
+/**
+ * Removal of duplicate rows, in a single pass, keeping the first row of each key
+ *
+ * Each row's key (e.g. the row as it would be output, or the values of some of
+ * its columns) is offered with `zsv_dedupe_offer()`, which tells whether the row
+ * is the first with that key. The keys seen so far are kept in a set in memory.
+ * If the set reaches its memory limit, it stops growing, and each row whose key
+ * is not in it is instead deferred, with its content, to one of a number of
+ * temporary files according to its key, so that each file can be deduplicated
+ * on its own once all rows have been offered (see `zsv_dedupe_rows()`)
+ */
+struct zsv_dedupe;
+
+struct zsv_dedupe_opts {
+  /**
+   * Maximum memory, in bytes, used by the set of keys, after which rows are
+   * deferred to temporary files. 0 for no limit
+   */
+  size_t max_memory;
+
+  /**
+   * Once the set has reached its memory limit, check a bloom filter of its keys
+   * before the set itself, which saves most lookups of keys that are not in it
+   */
+  char bloom;
+};
+
+enum zsv_dedupe_result {
+  zsv_dedupe_duplicate = 0, // a row with the same key was offered before
+  zsv_dedupe_first,         // the first row with this key: output it now
+  zsv_dedupe_deferred       // possibly the first: pass it to `zsv_dedupe_defer()`
+};
+
+/**
+ * Create a deduplication set
+ *
+ * @param opts  options, or NULL for the defaults
+ * @param dedupe on success, the set, which the caller must free with
+ *              `zsv_dedupe_delete()`
+ * @return zsv_status_ok or zsv_status_memory
+ */
+enum zsv_status zsv_dedupe_new(const struct zsv_dedupe_opts *opts, struct zsv_dedupe **dedupe);
+
+/**
+ * Offer the key of the next row
+ */
+enum zsv_dedupe_result zsv_dedupe_offer(struct zsv_dedupe *dedupe, const unsigned char *key, size_t key_len);
+
+/**
+ * Store a row for which `zsv_dedupe_offer()` returned zsv_dedupe_deferred
+ *
+ * @param key        key of the row, as offered
+ * @param row_number number of the row, in whatever numbering orders the output
+ * @param data       content of the row (e.g. as it would be output)
+ * @return zsv_status_ok, or zsv_status_error if it could not be written to a
+ *         temporary file
+ */
+enum zsv_status zsv_dedupe_defer(struct zsv_dedupe *dedupe, const unsigned char *key, size_t key_len,
+                                 size_t row_number, const unsigned char *data, size_t len);
+
+/**
+ * Process the deferred rows that are the first with their key, in order of row
+ * number, after all rows have been offered
+ *
+ * @param handler called for each row; a non-zero return value stops the iteration
+ * @return zsv_status_ok, zsv_status_memory or zsv_status_error (if a temporary
+ *         file could not be read or written)
+ */
+enum zsv_status zsv_dedupe_rows(struct zsv_dedupe *dedupe,
+                                int (*handler)(void *ctx, size_t row_number, const unsigned char *data, size_t len),
+                                void *ctx);
+
+/**
+ * Free a set that was created with `zsv_dedupe_new()`, and its temporary files
+ */
+void zsv_dedupe_delete(struct zsv_dedupe *dedupe);
+
+#endif
@@ -74,6 +74,10 @@ enum zsv_status zsv_properties_parser_destroy(struct zsv_properties_parser *pars
  * command-line option, the command-line option "wins" (the property value is
  * ignored), but a warning is printed
  *
+ * gzip, bzip2 or zstd-compressed input is decompressed as it is read, if
+ * opts->read is not set (see `zsv_decompressor_new()`); if it is corrupt or
+ * truncated, `zsv_parse_more()` returns zsv_status_error at its end
+ *
  * @param opts       parser options. see `zsv_new()`
  * @param cust_prop  optional custom file property handler
  * @param input_path path of file whose zsv properties should be loaded. this
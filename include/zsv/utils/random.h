@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_RANDOM_H
+#define ZSV_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Pseudo-random numbers (xoshiro256**), for sampling. A generator that is
+ * seeded with a given value always returns the same sequence, on any platform.
+ * Not suitable for cryptographic use
+ */
+struct zsv_random {
+  uint64_t s[4];
+};
+
+/**
+ * Seed a generator
+ */
+void zsv_random_seed(struct zsv_random *r, uint64_t seed);
+
+/**
+ * Get a seed that differs from one run to the next, for when none is given
+ */
+uint64_t zsv_random_default_seed(void);
+
+/**
+ * Get the next 64 random bits
+ */
+uint64_t zsv_random_next(struct zsv_random *r);
+
+/**
+ * Get a random number in [0, 1), with 53 bits of randomness
+ */
+double zsv_random_double(struct zsv_random *r);
+
+/**
+ * Get a random number in [0, n), without bias; 0 if n is 0
+ */
+uint64_t zsv_random_below(struct zsv_random *r, uint64_t n);
+
+/**
+ * Get the number of failures before the first success in a run of trials that
+ * each succeed with probability p, i.e. the number of rows to skip until the next
+ * one that is picked, when each row is picked with probability p
+ *
+ * @param p probability in (0, 1]
+ * @return number of failures, or SIZE_MAX if p is 0 or the number is too large
+ */
+size_t zsv_random_geometric(struct zsv_random *r, double p);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_REGEX_H
+#define ZSV_REGEX_H
+
+#include <stddef.h>
+#include <zsv/common.h>
+
+/**
+ * Regular expressions, matched in time linear in the length of the input
+ * (there is no backtracking, and so no back-references)
+ *
+ * Syntax, which applies to bytes rather than to UTF-8 characters:
+ *   .            any byte
+ *   [abc] [^a-z] a byte in (or not in) a set, which may include \d, \w, \s
+ *                and [:alpha:], [:digit:], [:alnum:], [:upper:], [:lower:],
+ *                [:space:], [:punct:] and [:xdigit:]
+ *   \d \w \s     a digit, a word byte (letter, digit or _), white space
+ *   \D \W \S     any byte that is not one of the above
+ *   \t \n \r \f \v \xHH, or \ followed by a punctuation byte, e.g. \.
+ *   ^ $          the start / end of the value
+ *   (...)        group; (?:...) for a group without a capture
+ *   a|b          alternatives
+ *   * + ? {n} {n,} {n,m}  repetition, which takes as much as it can, or as
+ *                little as it can if followed by ?
+ *   (?i)         at the start of the pattern: ignore the case of ASCII letters
+ */
+struct zsv_regex;
+
+/**
+ * Flags for `zsv_regex_new()`
+ */
+#define ZSV_REGEX_ICASE 1 // match ASCII letters regardless of case
+
+/**
+ * Compile a pattern. An error message is printed to stderr if it is invalid
+ *
+ * @param pattern NUL-terminated pattern
+ * @param flags   ZSV_REGEX_XXX flags
+ * @param re      on success, the compiled pattern, which the caller must free
+ *                with `zsv_regex_delete()`
+ * @return zsv_status_ok, zsv_status_invalid_option or zsv_status_memory
+ */
+enum zsv_status zsv_regex_new(const char *pattern, unsigned flags, struct zsv_regex **re);
+
+/**
+ * Get the number of capturing groups in a pattern
+ */
+unsigned zsv_regex_group_count(const struct zsv_regex *re);
+
+/**
+ * Check whether any part of a value matches
+ */
+char zsv_regex_match(const struct zsv_regex *re, const unsigned char *s, size_t len);
+
+/**
+ * Part of a value that a match, or a group within it, covers
+ */
+struct zsv_regex_group {
+  const unsigned char *str; // NULL if the group did not take part in the match
+  size_t len;
+};
+
+/**
+ * Find the leftmost match in a value, and the part of it that each group
+ * matched. Where the pattern allows more than one way to match, the one that
+ * is picked is the one that a backtracking matcher (e.g. Perl's or Python's)
+ * would find, including its handling of repetitions of a group that can match
+ * nothing: a repetition beyond the minimum count that matches nothing ends the
+ * repetition, and leaves the group matching nothing at the end of it. This may
+ * not hold if more than three such repetitions are nested in one another
+ *
+ * @param groups set to the whole match ([0]) and to groups 1 to n - 1, unless
+ *               there is no match
+ * @param n      number of elements in groups
+ * @return non-zero if there is a match
+ */
+char zsv_regex_capture(const struct zsv_regex *re, const unsigned char *s, size_t len,
+                       struct zsv_regex_group *groups, size_t n);
+
+/**
+ * Free a pattern that was compiled with `zsv_regex_new()`
+ */
+void zsv_regex_delete(struct zsv_regex *re);
+
+#endif
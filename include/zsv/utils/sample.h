@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_SAMPLE_H
+#define ZSV_SAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zsv/common.h>
+
+/**
+ * Random samples of exactly n rows (or all rows, if there are fewer), taken in
+ * a single pass without knowing the number of rows in advance, either of all
+ * rows or of each group of rows that share a key (stratified sampling)
+ *
+ * Each row is offered with `zsv_sample_offer()` and, if it is to be kept, its
+ * content (e.g. as it would be output) is then stored with `zsv_sample_keep()`.
+ * Without keys, the rows to keep are picked with Algorithm L (Li, 1994), which
+ * draws the number of rows to pass over until the next one to keep, so that a
+ * caller may skip those rows (see `zsv_sample_gap()`) instead of offering them
+ */
+struct zsv_sample;
+
+/**
+ * Create a sample
+ *
+ * @param n      number of rows to keep, per key if rows are offered with keys
+ * @param seed   seed for the random choices, which are the same for a given seed
+ *               and sequence of offers (see zsv/utils/random.h)
+ * @param sample on success, the sample, which the caller must free with
+ *               `zsv_sample_delete()`
+ * @return zsv_status_ok, zsv_status_invalid_option (if n is 0) or zsv_status_memory
+ */
+enum zsv_status zsv_sample_new(size_t n, uint64_t seed, struct zsv_sample **sample);
+
+/**
+ * Offer the next row
+ *
+ * @param key key of the row's group, or NULL if rows are not grouped, in which
+ *            case every row must be offered without a key
+ * @return non-zero if the row is to be kept (or if a new key could not be
+ *         stored), in which case `zsv_sample_keep()` must be called before the
+ *         next offer
+ */
+char zsv_sample_offer(struct zsv_sample *sample, const unsigned char *key, size_t key_len);
+
+/**
+ * Store the content of the row that was last offered, and replace the row that
+ * it displaces, if any
+ *
+ * @param row_number number of the row, in whatever numbering orders the output
+ * @return zsv_status_ok, or zsv_status_memory if the row or its key could not be stored
+ */
+enum zsv_status zsv_sample_keep(struct zsv_sample *sample, size_t row_number, const unsigned char *data, size_t len);
+
+/**
+ * Get the number of rows, offered without a key, that will be passed over
+ * before the next one is kept, and reset it to 0: a caller that skips that many
+ * rows without offering them gets the same sample as if it had offered them
+ */
+size_t zsv_sample_gap(struct zsv_sample *sample);
+
+/**
+ * Process the kept rows in order of row number
+ *
+ * @param handler called for each row; a non-zero return value stops the iteration
+ */
+void zsv_sample_rows(struct zsv_sample *sample,
+                     int (*handler)(void *ctx, size_t row_number, const unsigned char *data, size_t len), void *ctx);
+
+/**
+ * Free a sample that was created with `zsv_sample_new()`
+ */
+void zsv_sample_delete(struct zsv_sample *sample);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_SEARCH_H
+#define ZSV_SEARCH_H
+
+#include <stddef.h>
+#include <zsv/common.h>
+
+/**
+ * Multi-pattern search: a set of search strings is compiled into a single
+ * matcher that finds every occurrence of every string in one pass over its input
+ */
+struct zsv_search;
+
+/**
+ * Flags for `zsv_search_new()`
+ */
+#define ZSV_SEARCH_ICASE 1      // match ASCII letters regardless of case
+#define ZSV_SEARCH_WHOLE_CELL 2 // with zsv_search_cell[s](), only match a cell that equals a search string
+
+/**
+ * Create a matcher. Add search strings with `zsv_search_add()`, then call
+ * `zsv_search_compile()` before searching
+ *
+ * @param flags ZSV_SEARCH_XXX flags
+ * @return matcher, which the caller must free with `zsv_search_delete()`, or NULL
+ */
+struct zsv_search *zsv_search_new(unsigned flags);
+
+/**
+ * Add a search string. An empty string is ignored
+ * @return zsv_status_ok, zsv_status_memory, or zsv_status_invalid_option if
+ *         the matcher was already compiled
+ */
+enum zsv_status zsv_search_add(struct zsv_search *search, const unsigned char *value, size_t len);
+
+/**
+ * Compile the search strings that have been added
+ * @return zsv_status_ok or zsv_status_memory
+ */
+enum zsv_status zsv_search_compile(struct zsv_search *search);
+
+/**
+ * Called for each match that `zsv_search_scan()` finds
+ * @param ctx   caller context
+ * @param match start of the match
+ * @param len   length of the match (i.e. of the search string that matched)
+ * @return non-zero to stop scanning
+ */
+typedef char (*zsv_search_handler)(void *ctx, const unsigned char *match, size_t len);
+
+/**
+ * Scan a string for all search strings at once. Matches are reported in order
+ * of their end position
+ *
+ * @return non-zero if the handler stopped the scan, else zero
+ */
+char zsv_search_scan(const struct zsv_search *search, const unsigned char *s, size_t len,
+                     zsv_search_handler handler, void *ctx);
+
+/**
+ * Check whether a cell value contains (or with ZSV_SEARCH_WHOLE_CELL, equals)
+ * any of the search strings
+ */
+char zsv_search_cell(const struct zsv_search *search, const unsigned char *s, size_t len);
+
+/**
+ * Check whether any cell of a row contains (or with ZSV_SEARCH_WHOLE_CELL,
+ * equals) any of the search strings
+ *
+ * Cells that lie next to each other in memory, as cells of a row normally do
+ * (see docs/memory.md), are scanned in a single pass that also covers the
+ * delimiters and quotes between them; a match is only counted if it lies within
+ * a single cell. A cell value may be any part of the original cell (e.g. after
+ * trimming), and a cell that was moved elsewhere is scanned separately
+ *
+ * @param cells the cells of the row, in order
+ * @param n     number of cells
+ * @param hit   if not NULL, set to the index of a matching cell
+ * @return non-zero if a match was found
+ */
+char zsv_search_cells(const struct zsv_search *search, const struct zsv_cell *cells, size_t n, size_t *hit);
+
+/**
+ * Free a matcher that was created with `zsv_search_new()`
+ */
+void zsv_search_delete(struct zsv_search *search);
+
+#endif
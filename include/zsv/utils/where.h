@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Liquidaty and the zsv/lib contributors
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef ZSV_WHERE_H
+#define ZSV_WHERE_H
+
+#include <stddef.h>
+#include <zsv/common.h>
+
+/**
+ * Row filter expressions, e.g. `amount > 1000 AND region = 'EU'`
+ *
+ * An expression is a combination, with AND, OR, NOT and parentheses, of
+ * conditions on single columns:
+ *   <col> = | != | <> | < | <= | > | >= <value>
+ *   <col> [NOT] BETWEEN <value> AND <value>
+ *   <col> [NOT] LIKE '<pattern>'        (% and _ wildcards, ignoring ASCII case)
+ *   <col> [NOT] IN ('<value>', ...)     (text comparison)
+ *   <col> [NOT] REGEXP '<pattern>'      (see zsv/utils/regex.h; also: ~)
+ *   <col> IS [NOT] NULL                 (an empty value is null)
+ *
+ * A column is a name made of letters, digits and underscores, or any name in
+ * double quotes (with "" for an embedded double quote). A value is a string in
+ * single quotes (with '' for an embedded single quote), or a number, in which
+ * case the comparison (including != and <>) is numeric and is false for any
+ * value that is not a number. NOT negates the outcome of what follows it, so
+ * e.g. `NOT amount > 0` is true for a value that is not a number
+ *
+ * The expression is compiled into a sequence of typed tests, each of which
+ * leads to a next test or to a result depending on its outcome, so that a row
+ * is only tested, and its cells only fetched, until the outcome is known
+ */
+struct zsv_where;
+
+/**
+ * Compile an expression. An error message is printed to stderr if it is invalid
+ *
+ * @param expr  expression
+ * @param where on success, the compiled expression, which the caller must free
+ *              with `zsv_where_delete()`
+ * @return zsv_status_ok, zsv_status_invalid_option or zsv_status_memory
+ */
+enum zsv_status zsv_where_new(const char *expr, struct zsv_where **where);
+
+/**
+ * Resolve the column names in an expression to column indexes, given the
+ * column names of the header row. A name is matched exactly or, failing that,
+ * ignoring ASCII case. An error message is printed to stderr for an unknown name
+ *
+ * @return zsv_status_ok or zsv_status_invalid_option
+ */
+enum zsv_status zsv_where_bind(struct zsv_where *where, unsigned char *const *names, size_t count);
+
+/**
+ * Get the indexes of the columns that an expression refers to, after
+ * `zsv_where_bind()`
+ *
+ * @param count set to the number of columns
+ * @return array of distinct column indexes
+ */
+const size_t *zsv_where_columns(const struct zsv_where *where, size_t *count);
+
+/**
+ * Fetch a cell of the row that is being tested
+ */
+typedef struct zsv_cell (*zsv_where_get_cell)(void *ctx, size_t ix);
+
+/**
+ * Test a row
+ *
+ * @param get_cell called for each cell that is needed, possibly more than once
+ * @return non-zero if the row satisfies the expression
+ */
+char zsv_where_eval(const struct zsv_where *where, zsv_where_get_cell get_cell, void *ctx);
+
+/**
+ * Free an expression that was created with `zsv_where_new()`
+ */
+void zsv_where_delete(struct zsv_where *where);
+
+#endif
@@ -43,10 +43,28 @@ enum zsv_writer_status zsv_writer_flush(zsv_csv_writer w);
 
 void zsv_writer_set_temp_buff(zsv_csv_writer w, unsigned char *buff, size_t buffsize);
 
+/**
+ * write a cell value
+ *
+ * @param check_if_needs_quoting non-zero to quote the value if needed. If the
+ *        value is a parser cell with ZSV_PARSER_QUOTE_ESCAPED set (see
+ *        `zsv_opts.lazy_unescape`), pass its `quoted` flags as-is so that the
+ *        already-escaped value is output verbatim within enclosing quotes
+ */
 enum zsv_writer_status zsv_writer_cell(zsv_csv_writer,
                                        char new_row, // ZSV_WRITER_NEW_ROW or ZSV_WRITER_SAME_ROW
                                        const unsigned char *s, size_t len, char check_if_needs_quoting);
 
+/**
+ * write bytes that are already in CSV format (e.g. one or more complete rows
+ * produced by another writer) without any quoting or delimiters
+ *
+ * @param w       handle to the writer
+ * @param new_row ZSV_WRITER_NEW_ROW to start a new row, or ZSV_WRITER_SAME_ROW
+ *                to append to the prior output as-is
+ */
+enum zsv_writer_status zsv_writer_raw(zsv_csv_writer w, char new_row, const unsigned char *s, size_t len);
+
 unsigned char *zsv_writer_str_to_csv(const unsigned char *s, size_t len);
 
 /*
@@ -12,6 +12,7 @@
 #include <stdbool.h>
 #include <string.h>
 
+#ifndef clear_lowest_bit
 #if VECTOR_BYTES == 64 && (defined(HAVE__BLSR_U64) || defined(HAVE___BLSR_U64))
 #if defined(HAVE__BLSR_U64)
 #define clear_lowest_bit(n) _blsr_u64(n)
@@ -27,8 +28,10 @@
 #else
 #define clear_lowest_bit(n) (n & (n - 1))
 #endif
+#endif
 
 // vec_delims: return bitfield of next 32 bytes that contain at least 1 token
+ZSV_SCAN_TARGET
 __attribute__((always_inline)) static inline int vec_delims(const unsigned char *s, size_t n,
                                                             zsv_uc_vector *char_match1, zsv_uc_vector *char_match2,
                                                             zsv_uc_vector *char_match3, zsv_uc_vector *char_match4,
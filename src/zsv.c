@@ -18,8 +18,11 @@
 
 static struct zsv_cell zsv_get_cell_1(zsv_parser parser, size_t ix);
 static struct zsv_cell zsv_get_cell_with_overwrite(zsv_parser parser, size_t col_ix);
+static enum zsv_status zsv_seek_apply(struct zsv_scanner *scanner);
 #include "zsv_internal.c"
 
+static void zsv_stats_print(zsv_parser parser, FILE *f);
+
 #ifndef ZSV_VERSION
 #define ZSV_VERSION "unknown"
 #endif
@@ -42,18 +45,29 @@ inline static size_t scanner_pre_parse(struct zsv_scanner *scanner) {
   scanner->last = '\0';
   if (VERY_LIKELY(scanner->old_bytes_read)) {
     scanner->last = scanner->buff.buff[scanner->old_bytes_read - 1];
+    if (scanner->tape)
+      zsv_tape_shift(scanner->tape, scanner->row_start);
     if (scanner->row_start < scanner->old_bytes_read) {
       size_t len = scanner->old_bytes_read - scanner->row_start;
-      memmove(scanner->buff.buff, scanner->buff.buff + scanner->row_start, len);
+      if (scanner->mapped.data) // the partial row is already in place; just move the window
+        scanner->buff.buff += scanner->row_start;
+      else {
+        memmove(scanner->buff.buff, scanner->buff.buff + scanner->row_start, len);
+        if (VERY_UNLIKELY(scanner->stats != NULL))
+          scanner->stats->stats.shifted_bytes += len;
+      }
       scanner->partial_row_length = len;
     } else {
+      if (scanner->mapped.data)
+        scanner->buff.buff += scanner->old_bytes_read;
       scanner->cell_start = 0;
       scanner->row_start = 0;
       zsv_clear_cell(scanner);
     }
     scanner->cell_start -= scanner->row_start;
-    for (size_t i2 = 0; i2 < scanner->row.used; i2++)
-      scanner->row.cells[i2].str -= scanner->row_start;
+    if (!scanner->mapped.data)
+      for (size_t i2 = 0; i2 < scanner->row.used; i2++)
+        scanner->row.cells[i2].str -= scanner->row_start;
     scanner->row_start = 0;
     scanner->old_bytes_read = 0;
   }
@@ -63,19 +77,34 @@ inline static size_t scanner_pre_parse(struct zsv_scanner *scanner) {
   size_t capacity = scanner->buff.size - scanner->partial_row_length;
   if (VERY_UNLIKELY(capacity == 0)) {
     // our row size was too small to fit a single row of data
-    fprintf(stderr, "Warning: row %zu truncated\n", scanner->data_row_count);
+    if (!scanner->quiet_truncate)
+      fprintf(stderr, "Warning: row %zu truncated\n", scanner->data_row_count);
     if (scanner->mode == ZSV_MODE_FIXED) {
       if (VERY_UNLIKELY(row_fx(scanner, scanner->buff.buff, 0, scanner->buff.size)))
         return zsv_status_cancelled;
+    } else if (scanner->tape) {
+      if (scanner->tape->rows_used > scanner->tape->rows_done)
+        scanner->tape->rows_done++;
+      if (VERY_UNLIKELY(zsv_tape_deliver(scanner, 1)))
+        return zsv_status_cancelled;
+      zsv_tape_shift(scanner->tape, 0);
     } else if (VERY_UNLIKELY(row_dl(scanner)))
       return zsv_status_cancelled;
 
     // throw away the next row end
     scanner->buffer_exceeded = 1;
+    scanner->truncated = 1;
     scanner->opts.row_handler = zsv_throwaway_row;
     scanner->opts.ctx = scanner;
 
+    if (scanner->mapped.data)
+      scanner->buff.buff += scanner->partial_row_length;
     scanner->partial_row_length = 0;
+    // the rest of the row, if scanned, starts at the start of the buffer; keep
+    // the quote state, so that a delimiter or row end within quotes stays so
+    scanner->cell_start = 0;
+    scanner->row_start = 0;
+    scanner->delims.rescan = 0;
     capacity = scanner->buff.size;
   }
   return capacity;
@@ -88,12 +117,15 @@ static enum zsv_status zsv_insert_string(struct zsv_scanner *scanner) {
   // to do: replace below with
   // return parse_bytes(scanner, bytes, len);
   size_t len = strlen(scanner->insert_string);
-  if (len > scanner->buff.size - scanner->partial_row_length)
-    len = scanner->buff.size - 1; // to do: throw an error instead
+  size_t row_end_len = scanner->delims.term_len ? scanner->delims.term_len : 1;
+  if (len + row_end_len > scanner->buff.size - scanner->partial_row_length)
+    len = scanner->buff.size - row_end_len; // to do: throw an error instead
   memcpy(scanner->buff.buff + scanner->partial_row_length, scanner->insert_string, len);
-  if (scanner->buff.buff[len] != '\n')
+  if (scanner->delims.term_len)
+    memcpy(scanner->buff.buff + len, scanner->delims.term, row_end_len);
+  else if (scanner->buff.buff[len] != '\n')
     scanner->buff.buff[len] = '\n';
-  enum zsv_status stat = zsv_scan(scanner, scanner->buff.buff, len + 1);
+  enum zsv_status stat = zsv_scan(scanner, scanner->buff.buff, len + row_end_len);
   scanner->insert_string = NULL;
   return stat;
 }
@@ -104,11 +136,27 @@ static enum zsv_status zsv_insert_string(struct zsv_scanner *scanner) {
  */
 ZSV_EXPORT
 enum zsv_status zsv_parse_more(struct zsv_scanner *scanner) {
+  if (VERY_UNLIKELY(scanner->stats != NULL) && !scanner->stats->timing) {
+    zsv_stats_parse_begin(scanner->stats);
+    enum zsv_status stat = zsv_parse_more(scanner);
+    zsv_stats_parse_end(scanner->stats);
+    return stat;
+  }
   if (VERY_UNLIKELY(scanner->insert_string != NULL))
     zsv_insert_string(scanner);
 
   size_t capacity = scanner_pre_parse(scanner);
+  if (VERY_UNLIKELY(scanner->pull.now) && scanner->mode == ZSV_MODE_DELIM_PULL) {
+    // scanner_pre_parse() delivered a truncated row: return it before the
+    // buffer that holds it is overwritten
+    if (scanner->tape)
+      return zsv_status_ok; // zsv_tape_next_row() returns it
+    scanner->pull.now = 0;
+    scanner->row.used = scanner->pull.row_used;
+    return zsv_status_row;
+  }
   size_t bytes_read;
+  uint64_t read_start = VERY_UNLIKELY(scanner->stats != NULL) ? zsv_stats_now_ns() : 0;
   if (VERY_UNLIKELY(scanner->checked_bom == 0)) {
 #ifdef ZSV_EXTRAS
     // initialize progress timer
@@ -117,7 +165,13 @@ enum zsv_status zsv_parse_more(struct zsv_scanner *scanner) {
 #endif
     size_t bom_len = strlen(ZSV_BOM);
     scanner->checked_bom = 1;
-    if ((bytes_read = scanner->read(scanner->buff.buff, 1, bom_len, scanner->in)) == bom_len &&
+    if (scanner->mapped.data) {
+      if (zsv_mmap_read(scanner, bom_len) == bom_len && !memcmp(scanner->buff.buff, ZSV_BOM, bom_len)) {
+        scanner->buff.buff += bom_len;
+        scanner->had_bom = 1;
+      }
+      bytes_read = zsv_mmap_read(scanner, capacity);
+    } else if ((bytes_read = scanner->read(scanner->buff.buff, 1, bom_len, scanner->in)) == bom_len &&
         !memcmp(scanner->buff.buff, ZSV_BOM, bom_len)) {
       // have bom. disregard what we just read
       bytes_read = scanner->read(scanner->buff.buff, 1, capacity, scanner->in);
@@ -127,14 +181,27 @@ enum zsv_status zsv_parse_more(struct zsv_scanner *scanner) {
       if (bytes_read == bom_len) // maybe we only read < 3 bytes
         bytes_read += scanner->read(scanner->buff.buff + bom_len, 1, capacity - bom_len, scanner->in);
     }
-  } else // already checked bom. read as usual
+  } else if (scanner->mapped.data)
+    bytes_read = zsv_mmap_read(scanner, capacity);
+  else // already checked bom. read as usual
     bytes_read = scanner->read(scanner->buff.buff + scanner->partial_row_length, 1, capacity, scanner->in);
+  if (VERY_UNLIKELY(scanner->stats != NULL))
+    zsv_stats_read(scanner->stats, read_start, bytes_read);
   scanner->started = 1;
   if (VERY_UNLIKELY(scanner->filter != NULL))
     bytes_read = scanner->filter(scanner->filter_ctx, scanner->buff.buff + scanner->partial_row_length, bytes_read);
+  zsv_utf8_check(scanner, scanner->partial_row_length + bytes_read);
   if (VERY_LIKELY(bytes_read))
     return zsv_scan(scanner, scanner->buff.buff, bytes_read);
+  if (VERY_UNLIKELY(scanner->input_error.error != NULL) && scanner->input_error.error(scanner->input_error.in))
+    return zsv_status_error;
 
+  if (VERY_UNLIKELY(scanner->seek.pending)) {
+    // the header has been parsed: continue from the row that was sought (see zsv_seek_row())
+    enum zsv_status stat = zsv_seek_apply(scanner);
+    if (stat != zsv_status_no_more_input)
+      return stat == zsv_status_ok ? zsv_parse_more(scanner) : stat;
+  }
   scanner->scanned_length = scanner->partial_row_length;
   return zsv_status_no_more_input;
 }
@@ -146,6 +213,12 @@ void zsv_abort(zsv_parser parser) {
 
 ZSV_EXPORT
 char zsv_row_is_blank(zsv_parser parser) {
+  if (parser->tape) {
+    for (size_t i = 0; i < parser->row.used; i++)
+      if (zsv_get_cell_tape(parser, i).len)
+        return 0;
+    return 1;
+  }
   return zsv_internal_row_is_blank(parser);
 }
 
@@ -156,16 +229,138 @@ static void zsv_pull_row(void *ctx) {
 }
 
 /**
- * For pull parsing, use zsv_next_row(). Not quite as fast as push parsing, but pretty close
- * @return zsv_status_row on success
+ * zsv_next_row() with opts.tape: each buffer is scanned onto the tape in a
+ * single pass, after which its rows are returned one at a time
+ * @param buffered if non-zero, return zsv_status_ok instead of reading more input
  */
-ZSV_EXPORT
-enum zsv_status zsv_next_row(zsv_parser parser) {
-  if (VERY_UNLIKELY(!parser->pull.regs)) {
+static enum zsv_status zsv_tape_next_row(zsv_parser parser, char buffered) {
+  parser->row.used = 0;
+  while (parser->pull.stat == zsv_status_ok) {
+    parser->pull.stat = zsv_tape_deliver(parser, 0);
+    if (parser->pull.now) {
+      parser->pull.now = 0;
+      if (parser->pull.stat == zsv_status_ok) {
+        parser->row.used = parser->pull.row_used;
+        return zsv_status_row;
+      }
+    } else if (parser->pull.stat == zsv_status_ok) {
+      if (buffered)
+        return zsv_status_ok;
+      if (parser->finished)
+        parser->pull.stat = zsv_status_done;
+      else if ((parser->pull.stat = zsv_parse_more(parser)) == zsv_status_no_more_input)
+        parser->pull.stat = zsv_finish(parser); // the final row, if any, is delivered in the next iteration
+    }
+  }
+  return parser->pull.stat;
+}
+
+/**
+ * Switch a parser that has not yet started to tape mode, unless its options
+ * are incompatible with tape mode (see zsv_tape_init())
+ * @return non-zero on out-of-memory
+ */
+static int zsv_tape_enable(zsv_parser parser) {
+  parser->opts.tape = 1;
+  if (zsv_tape_init(parser))
+    return 1;
+  if (parser->tape) {
+    parser->scan_delim = zsv_scan_delim_select(&parser->opts, 1);
+    set_callbacks(parser);
+  }
+  return 0;
+}
+
+/**
+ * zsv_next_batch() in fixed-width mode with a fixed record length (see
+ * zsv_set_fixed_record_length()). Each buffer is read without being scanned,
+ * and the cells of all of its whole records are then sliced at once. The last
+ * row of the batch is also the parser's current row
+ */
+static enum zsv_status zsv_fixed_next_batch(zsv_parser parser, struct zsv_row_batch *batch) {
+  size_t record_length = parser->fixed.record_length;
+  if (!record_length) {
+    fprintf(stderr, "Fixed-width pull parsing requires a record length (see zsv_set_fixed_record_length())\n");
+    return zsv_status_invalid_option;
+  }
+  if (!parser->fixed.pull) {
     if (parser->started)
       return zsv_status_error; // error: already started a push parser
-    if (!(parser->pull.regs = calloc(1, sizeof(*parser->pull.regs))))
-      return zsv_status_memory;
+    parser->fixed.pull = 1;
+  }
+  zsv_row_arena_reset(parser);
+
+  size_t rows;
+  size_t row_length = record_length;
+  unsigned char *s = parser->buff.buff + parser->row_start;
+  while ((rows = (parser->old_bytes_read - parser->row_start) / record_length) == 0) {
+    if (parser->finished)
+      return zsv_status_done;
+    enum zsv_status stat = zsv_parse_more(parser);
+    s = parser->buff.buff + parser->row_start;
+    if (stat == zsv_status_no_more_input) {
+      // the final partial record, if any, less a trailing row end
+      row_length = parser->partial_row_length;
+      if (row_length && memchr("\n\r", s[row_length - 1], 2))
+        row_length--;
+      parser->partial_row_length = 0;
+      parser->finished = 1;
+      if (!row_length)
+        return zsv_status_done;
+      rows = 1;
+      break;
+    }
+    if (stat != zsv_status_ok)
+      return stat;
+  }
+  if (rows > batch->max_rows)
+    rows = batch->max_rows;
+  if (!parser->finished)
+    parser->row_start += rows * record_length;
+
+  size_t count = parser->fixed.count;
+  size_t n = count < batch->max_columns ? count : batch->max_columns;
+  size_t stride = batch->column_major ? batch->max_rows : 1;
+  const struct zsv_cell empty = {0, 0, 0, 0};
+  for (size_t r = 0; r < rows; r++) {
+    struct zsv_cell *out = batch->cells + (batch->column_major ? r : r * batch->max_columns);
+    if (batch->cell_counts)
+      batch->cell_counts[r] = count;
+    zsv_fixed_cells(parser, s + r * record_length, row_length, out, stride, n);
+    for (size_t i = n; i < batch->max_columns; i++)
+      out[i * stride] = empty;
+  }
+  zsv_fixed_cells(parser, s + (rows - 1) * record_length, row_length, parser->row.cells, 1, count);
+  parser->row.used = count;
+  batch->rows = rows;
+  if (VERY_UNLIKELY(parser->stats != NULL)) {
+    parser->stats->stats.rows += rows;
+    parser->stats->stats.cells += rows * count;
+  }
+  return zsv_status_row;
+}
+
+/**
+ * @param buffered if non-zero, return zsv_status_ok instead of reading more input
+ *                 (see zsv_next_batch())
+ */
+static enum zsv_status zsv_next_row_1(zsv_parser parser, char buffered) {
+  if (VERY_UNLIKELY(parser->mode == ZSV_MODE_FIXED)) {
+    struct zsv_row_batch batch = {0};
+    batch.max_rows = 1;
+    return zsv_fixed_next_batch(parser, &batch);
+  }
+  if (VERY_UNLIKELY(!parser->pull.started)) {
+    if (parser->started)
+      return zsv_status_error; // error: already started a push parser
+    if (parser->delims.delim_len && !parser->tape) {
+      // the multi-char kernel has no pull variant (see zsv_scan_multi.c)
+      if (zsv_tape_enable(parser))
+        return zsv_status_memory;
+      if (!parser->tape)
+        return zsv_status_invalid_option;
+    }
+    parser->pull.started = 1;
     parser->mode = ZSV_MODE_DELIM_PULL;
     zsv_set_row_handler(parser, zsv_pull_row);
     zsv_set_context(parser, parser);
@@ -174,9 +369,15 @@ enum zsv_status zsv_next_row(zsv_parser parser) {
     if (parser->pull.stat == zsv_status_row)
       return parser->pull.stat;
   }
+  if (parser->tape)
+    return zsv_tape_next_row(parser, buffered);
   if (VERY_LIKELY(parser->pull.stat == zsv_status_row))
-    parser->pull.stat = zsv_scan_delim_pull(parser, parser->pull.buff, parser->pull.bytes_read);
+    // unless the row was truncated, in which case there is nothing left to scan
+    parser->pull.stat = parser->pull.resume ? zsv_scan_delim_pull(parser, parser->pull.buff, parser->pull.bytes_read)
+                                            : zsv_status_ok;
   if (VERY_UNLIKELY(parser->pull.stat == zsv_status_ok)) {
+    if (buffered)
+      return zsv_status_ok;
     do {
       parser->pull.stat = zsv_parse_more(parser); // should return zsv_status_row or zsv_status_no_more_input
     } while (parser->pull.stat == zsv_status_ok);
@@ -198,6 +399,64 @@ enum zsv_status zsv_next_row(zsv_parser parser) {
   return parser->pull.stat;
 }
 
+/**
+ * For pull parsing, use zsv_next_row(). Not quite as fast as push parsing, but pretty close
+ * @return zsv_status_row on success
+ */
+ZSV_EXPORT
+enum zsv_status zsv_next_row(zsv_parser parser) {
+  if (VERY_UNLIKELY(parser->stats != NULL) && !parser->stats->timing) {
+    zsv_stats_parse_begin(parser->stats);
+    enum zsv_status stat = zsv_next_row_1(parser, 0);
+    zsv_stats_parse_end(parser->stats);
+    return stat;
+  }
+  return zsv_next_row_1(parser, 0);
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_next_batch(zsv_parser parser, struct zsv_row_batch *batch) {
+  if (VERY_UNLIKELY(parser->stats != NULL) && !parser->stats->timing) {
+    zsv_stats_parse_begin(parser->stats);
+    enum zsv_status stat = zsv_next_batch(parser, batch);
+    zsv_stats_parse_end(parser->stats);
+    return stat;
+  }
+  batch->rows = 0;
+  if (!batch->max_rows || (batch->max_columns && !batch->cells))
+    return zsv_status_invalid_option;
+  if (parser->mode == ZSV_MODE_FIXED)
+    return zsv_fixed_next_batch(parser, batch);
+
+  if (!parser->pull.started && !parser->started && !parser->tape && parser->mode == ZSV_MODE_DELIM &&
+      !parser->column_filter.bitmap && !parser->column_filter.pending) {
+    // scan a buffer at a time, instead of saving and restoring the scanner state for each row
+    // (unless a column filter is set, which has no effect in tape mode)
+    if (zsv_tape_enable(parser))
+      return zsv_status_memory;
+  }
+
+  const struct zsv_cell empty = {0, 0, 0, 0};
+  size_t stride = batch->column_major ? batch->max_rows : 1;
+  enum zsv_status stat;
+  while (batch->rows < batch->max_rows && (stat = zsv_next_row_1(parser, batch->rows > 0)) == zsv_status_row) {
+    size_t r = batch->rows++;
+    size_t count = zsv_cell_count(parser);
+    size_t n = count < batch->max_columns ? count : batch->max_columns;
+    struct zsv_cell *out = batch->cells + (batch->column_major ? r : r * batch->max_columns);
+    if (batch->cell_counts)
+      batch->cell_counts[r] = count;
+    if (parser->tape)
+      zsv_tape_get_cells(parser, out, stride, n);
+    else
+      for (size_t i = 0; i < n; i++)
+        out[i * stride] = zsv_get_cell(parser, i);
+    for (size_t i = n; i < batch->max_columns; i++)
+      out[i * stride] = empty;
+  }
+  return batch->rows ? zsv_status_row : stat;
+}
+
 // to do: rename to zsv_column_count(). rename all other zsv_hand to just zsv_
 ZSV_EXPORT
 size_t zsv_cell_count(zsv_parser parser) {
@@ -220,12 +479,50 @@ void zsv_set_context(zsv_parser parser, void *ctx) {
 
 ZSV_EXPORT
 void zsv_set_read(zsv_parser parser, size_t (*read_func)(void *restrict, size_t n, size_t size, void *restrict)) {
-  parser->read = read_func;
+  zsv_mmap_release(parser);
+  if (parser->read_ahead)
+    zsv_read_ahead_set_source(parser, read_func, NULL);
+  else
+    parser->read = read_func;
+}
+
+ZSV_EXPORT
+void zsv_set_input_close(zsv_parser parser, void (*close_func)(void *in), void *in) {
+  parser->input_close.close = close_func;
+  parser->input_close.in = in;
+}
+
+ZSV_EXPORT
+void zsv_set_input_error(zsv_parser parser, int (*error_func)(void *in), void *in) {
+  parser->input_error.error = error_func;
+  parser->input_error.in = in;
+}
+
+ZSV_EXPORT
+struct zsv_arena *zsv_parser_arena(zsv_parser parser, enum zsv_arena_scope scope) {
+  struct zsv_arena **arena = scope == zsv_arena_scope_row ? &parser->arenas.row : &parser->arenas.parse;
+  if (!*arena)
+    *arena = zsv_arena_new(0);
+  return *arena;
+}
+
+ZSV_EXPORT
+struct zsv_cell zsv_cell_persist(zsv_parser parser, struct zsv_arena *arena, struct zsv_cell cell) {
+  if (!arena)
+    arena = zsv_parser_arena(parser, zsv_arena_scope_parse);
+  cell.str = arena ? zsv_arena_memdup(arena, cell.str, cell.len) : NULL;
+  if (!cell.str)
+    cell.len = 0;
+  return cell;
 }
 
 ZSV_EXPORT
 void zsv_set_input(zsv_parser parser, void *in) {
-  parser->in = in;
+  zsv_mmap_release(parser);
+  if (parser->read_ahead)
+    zsv_read_ahead_set_source(parser, NULL, in);
+  else
+    parser->in = in;
 }
 
 ZSV_EXPORT
@@ -247,12 +544,30 @@ struct zsv_cell zsv_get_cell(zsv_parser parser, size_t ix) {
   return parser->get_cell(parser, ix);
 }
 
+ZSV_EXPORT
+struct zsv_cell zsv_get_cell_unescaped(zsv_parser parser, size_t ix, unsigned char *buff, size_t buffsize) {
+  struct zsv_cell c = parser->get_cell(parser, ix);
+  if (c.quoted & ZSV_PARSER_QUOTE_ESCAPED) {
+    if (buffsize < c.len || !buff) {
+      c.str = NULL;
+      return c;
+    }
+    char pending = 0;
+    c.len = zsv_unescape_quotes(buff, c.str, c.len, &pending, (unsigned char)parser->opts.quote_char);
+    c.str = buff;
+    c.quoted &= ~ZSV_PARSER_QUOTE_ESCAPED;
+  }
+  return c;
+}
+
 /**
  * `zsv_get_cell_len()` is not needed in most cases, but may be useful in
  * restrictive cases such as when calling from Javascript into wasm
  */
 ZSV_EXPORT
 size_t zsv_get_cell_len(zsv_parser parser, size_t ix) {
+  if (parser->tape)
+    return zsv_get_cell_tape(parser, ix).len;
   if (ix < parser->row.used)
     return parser->row.cells[ix].len;
   return 0;
@@ -260,7 +575,7 @@ size_t zsv_get_cell_len(zsv_parser parser, size_t ix) {
 
 ZSV_EXPORT
 unsigned char *zsv_get_cell_str(zsv_parser parser, size_t ix) {
-  struct zsv_cell c = zsv_get_cell_1(parser, ix);
+  struct zsv_cell c = parser->tape ? zsv_get_cell_tape(parser, ix) : zsv_get_cell_1(parser, ix);
   return c.len ? c.str : NULL;
 }
 
@@ -279,6 +594,10 @@ ZSV_EXPORT enum zsv_status zsv_set_fixed_offsets(zsv_parser parser, size_t count
       fprintf(stderr, "Warning: offset %zu repeated, will always yield empty cell\n", offsets[i - 1]);
   }
 
+  if (count > parser->opts.max_columns) {
+    fprintf(stderr, "Fixed offset count %zu exceeds max columns %u\n", count, parser->opts.max_columns);
+    return zsv_status_invalid_option;
+  }
   if (offsets[count - 1] > parser->buff.size) {
     fprintf(stderr, "Offset %zu exceeds total buffer size %zu\n", offsets[count - 1], parser->buff.size);
     return zsv_status_invalid_option;
@@ -300,15 +619,75 @@ ZSV_EXPORT enum zsv_status zsv_set_fixed_offsets(zsv_parser parser, size_t count
 
   parser->mode = ZSV_MODE_FIXED;
   parser->checked_bom = 1;
+  zsv_tape_delete(&parser->tape);
 
   set_callbacks(parser);
 
   return zsv_status_ok;
 }
 
+ZSV_EXPORT enum zsv_status zsv_set_fixed_record_length(zsv_parser parser, size_t record_length) {
+  if (parser->mode != ZSV_MODE_FIXED) {
+    fprintf(stderr, "Record length requires fixed-width mode\n");
+    return zsv_status_invalid_option;
+  }
+  if (parser->cum_scanned_length || parser->started) {
+    fprintf(stderr, "Record length cannot be changed after parsing has begun\n");
+    return zsv_status_invalid_option;
+  }
+  if (record_length > parser->buff.size) {
+    fprintf(stderr, "Record length %zu exceeds total buffer size %zu\n", record_length, parser->buff.size);
+    return zsv_status_invalid_option;
+  }
+  if (record_length && parser->fixed.offsets[parser->fixed.count - 1] > record_length) {
+    fprintf(stderr, "Offset %u exceeds record length %zu\n", parser->fixed.offsets[parser->fixed.count - 1],
+            record_length);
+    return zsv_status_invalid_option;
+  }
+  parser->fixed.record_length = record_length;
+  return zsv_status_ok;
+}
+
+ZSV_EXPORT enum zsv_status zsv_set_column_filter(zsv_parser parser, const unsigned char *bitmap, size_t column_count) {
+  free(parser->column_filter.bitmap);
+  free(parser->column_filter.pending);
+  parser->column_filter.bitmap = parser->column_filter.pending = NULL;
+  parser->column_filter.count = 0;
+  if (!bitmap)
+    return zsv_status_ok;
+
+  // cells beyond max_columns are never stored, and the scanner may stop
+  // processing each row after the last selected column
+  if (column_count > parser->row.allocated)
+    column_count = parser->row.allocated;
+  while (column_count && !(bitmap[(column_count - 1) / 8] & (1 << ((column_count - 1) % 8))))
+    column_count--;
+
+  unsigned char *filter = calloc(column_count / 8 + 1, 1);
+  if (!filter) {
+    fprintf(stderr, "Out of memory!\n");
+    return zsv_status_memory;
+  }
+  memcpy(filter, bitmap, (column_count + 7) / 8);
+  parser->column_filter.count = column_count;
+
+  // header rows are processed by internal handlers which use all cells (e.g.
+  // to skip blank rows), so until they are done, the filter is kept aside
+  if (parser->opts.row_handler != parser->opts_orig.row_handler)
+    parser->column_filter.pending = filter;
+  else
+    parser->column_filter.bitmap = filter;
+  return zsv_status_ok;
+}
+
+ZSV_EXPORT void zsv_skip_rows(zsv_parser parser, size_t n) {
+  parser->skip_rows = n;
+}
+
 ZSV_EXPORT
 int zsv_peek(zsv_parser z) {
-  if (z->scanned_length + 1 < z->buff.size)
+  if (z->scanned_length + 1 < z->buff.size &&
+      (!z->mapped.data || z->buff.buff + z->scanned_length + 1 < z->mapped.data + z->mapped.size))
     return z->buff.buff[z->scanned_length + 1];
   return -1;
 }
@@ -349,7 +728,21 @@ enum zsv_status zsv_finish(struct zsv_scanner *scanner) {
   enum zsv_status stat = zsv_status_ok;
   if (!scanner)
     return zsv_status_error;
+  if (VERY_UNLIKELY(scanner->stats != NULL) && !scanner->stats->timing) {
+    zsv_stats_parse_begin(scanner->stats);
+    stat = zsv_finish(scanner);
+    zsv_stats_parse_end(scanner->stats);
+    return stat;
+  }
   if (!scanner->abort) {
+    if (VERY_UNLIKELY(scanner->delims.rescan) && !scanner->finished) {
+      // scan the possible delimiter or row terminator at the end of the input
+      // once more, as cell content (see zsv_scan_multi.c)
+      if (scanner->old_bytes_read)
+        scanner_pre_parse(scanner);
+      scanner->delims.at_eof = 1;
+      stat = zsv_scan(scanner, scanner->buff.buff, 0);
+    }
     if (scanner->mode == ZSV_MODE_FIXED) {
       if (scanner->partial_row_length && memchr("\n\r", scanner->buff.buff[scanner->partial_row_length - 1], 2))
         scanner->partial_row_length--;
@@ -359,7 +752,7 @@ enum zsv_status zsv_finish(struct zsv_scanner *scanner) {
     }
 
     if ((scanner->quoted & ZSV_PARSER_QUOTE_UNCLOSED) && scanner->partial_row_length > scanner->cell_start) {
-      int quote = '"';
+      int quote = (unsigned char)scanner->opts.quote_char;
       scanner->quoted |= ZSV_PARSER_QUOTE_CLOSED;
       scanner->quoted -= ZSV_PARSER_QUOTE_UNCLOSED;
       if (scanner->last == quote)
@@ -374,11 +767,23 @@ enum zsv_status zsv_finish(struct zsv_scanner *scanner) {
   if (!scanner->finished) {
     scanner->finished = 1;
     if (!scanner->abort) {
-      if (scanner->scanned_length > 0 && scanner->scanned_length >= scanner->cell_start)
-        cell_dl(scanner, scanner->buff.buff + scanner->cell_start, scanner->scanned_length - scanner->cell_start);
-      if (scanner->have_cell) {
-        if (row_dl(scanner))
-          stat = zsv_status_cancelled;
+      if (scanner->tape) {
+        if (scanner->scanned_length > 0 && scanner->scanned_length >= scanner->cell_start &&
+            zsv_tape_cell(scanner, scanner->scanned_length))
+          stat = zsv_status_memory;
+        else if (scanner->have_cell) {
+          scanner->tape->rows_done++;
+          // in pull mode, the row is delivered by zsv_next_row()
+          if (scanner->mode != ZSV_MODE_DELIM_PULL && zsv_tape_deliver(scanner, 0))
+            stat = zsv_status_cancelled;
+        }
+      } else {
+        if (scanner->scanned_length > 0 && scanner->scanned_length >= scanner->cell_start)
+          cell_dl(scanner, scanner->buff.buff + scanner->cell_start, scanner->scanned_length - scanner->cell_start);
+        if (scanner->have_cell) {
+          if (row_dl(scanner))
+            stat = zsv_status_cancelled;
+        }
       }
     } else
       stat = zsv_status_cancelled;
@@ -398,8 +803,26 @@ enum zsv_status zsv_delete(zsv_parser parser) {
 
     free(parser->row.cells);
     free(parser->fixed.offsets);
+    free(parser->column_filter.bitmap);
+    free(parser->column_filter.pending);
     collate_header_destroy(&parser->collate_header);
-    free(parser->pull.regs);
+    zsv_tape_delete(&parser->tape);
+    if (parser->seek.pending && parser->mapped.data)
+      parser->mapped.size = parser->seek.mapped_size;
+    zsv_mmap_unmap(parser);
+    free(parser->mapped.arena);
+    if (parser->read_ahead && parser->opts.verbose)
+      fprintf(stderr, "Read-ahead: waited for input %zu times, for a total of %.3f seconds\n",
+              parser->read_ahead->stall_count, (double)parser->read_ahead->stall_ns / 1e9);
+    zsv_read_ahead_delete(&parser->read_ahead);
+    if (parser->input_close.close)
+      parser->input_close.close(parser->input_close.in);
+    zsv_arena_delete(parser->arenas.row);
+    zsv_arena_delete(parser->arenas.parse);
+    if (parser->stats) {
+      zsv_stats_print(parser, stderr);
+      zsv_stats_delete(parser->stats);
+    }
 
 #ifdef ZSV_EXTRAS
     if (parser->overwrite.ctx && parser->overwrite.close_ctx)
@@ -451,6 +874,68 @@ size_t zsv_cum_scanned_length(zsv_parser parser) {
          (parser->had_bom ? strlen(ZSV_BOM) : 0);
 }
 
+ZSV_EXPORT
+size_t zsv_read_ahead_stall_usecs(zsv_parser parser) {
+  return parser->read_ahead ? (size_t)(parser->read_ahead->stall_ns / 1000) : 0;
+}
+
+ZSV_EXPORT
+struct zsv_stats zsv_get_stats(zsv_parser parser) {
+  struct zsv_stats stats;
+  memset(&stats, 0, sizeof(stats));
+  struct zsv_stats_state *st = parser->stats;
+  if (!st)
+    return stats;
+  stats = st->stats;
+  stats.bytes_scanned = zsv_cum_scanned_length(parser);
+  uint64_t parse_ns = st->parse_ns;
+  if (st->timing) // called from a handler
+    parse_ns += zsv_stats_now_ns() - st->parse_start;
+  if (parse_ns > stats.read_ns + stats.callback_ns)
+    stats.scan_ns = parse_ns - stats.read_ns - stats.callback_ns;
+#ifdef ZSV_STATS_PERF
+  if (st->perf_fd[0] >= 0) {
+    unsigned long long *counters[ZSV_STATS_PERF_COUNTERS] = {&stats.cycles, &stats.instructions,
+                                                             &stats.branch_misses};
+    stats.hw_counters = 1;
+    for (int i = 0; i < ZSV_STATS_PERF_COUNTERS; i++) {
+      uint64_t value;
+      if (read(st->perf_fd[i], &value, sizeof(value)) == (ssize_t)sizeof(value))
+        *counters[i] = value;
+      else
+        stats.hw_counters = 0;
+    }
+  }
+#endif
+  return stats;
+}
+
+/**
+ * Print the stats of a parser that was created with opts.stats set
+ */
+static void zsv_stats_print(zsv_parser parser, FILE *f) {
+  struct zsv_stats stats = zsv_get_stats(parser);
+  fprintf(f,
+          "Parser stats:\n"
+          "  bytes scanned: %zu\n"
+          "  rows: %zu\n"
+          "  cells: %zu (quoted: %zu, escaped: %zu)\n"
+          "  buffer refills: %zu\n"
+          "  partial-row bytes shifted: %zu\n"
+          "  seconds: read %.3f, scan %.3f, callbacks %.3f\n",
+          stats.bytes_scanned, stats.rows, stats.cells, stats.quoted_cells, stats.escaped_cells, stats.refills,
+          stats.shifted_bytes, (double)stats.read_ns / 1e9, (double)stats.scan_ns / 1e9,
+          (double)stats.callback_ns / 1e9);
+  if (!stats.hw_counters)
+    fprintf(f, "  hardware counters: not available\n");
+  else {
+    fprintf(f, "  cycles: %llu, instructions: %llu, branch misses: %llu\n", stats.cycles, stats.instructions,
+            stats.branch_misses);
+    if (stats.bytes_scanned)
+      fprintf(f, "  cycles per byte: %.2f\n", (double)stats.cycles / (double)stats.bytes_scanned);
+  }
+}
+
 ZSV_EXPORT
 size_t zsv_row_length_raw_bytes(zsv_parser parser) {
   return parser->scanned_length - parser->row_start;
@@ -463,7 +948,7 @@ size_t zsv_row_length_raw_bytes(zsv_parser parser) {
  * @param len    length of the input to parse
  */
 enum zsv_status zsv_parse_bytes(struct zsv_scanner *scanner, const unsigned char *bytes, size_t len) {
-  enum zsv_status stat = zsv_status_ok;
+  enum zsv_status stat = zsv_mmap_release(scanner);
   const unsigned char *cursor = bytes;
   while (len && stat == zsv_status_ok) {
     size_t capacity = scanner_pre_parse(scanner);
@@ -474,8 +959,13 @@ enum zsv_status zsv_parse_bytes(struct zsv_scanner *scanner, const unsigned char
     if (scanner->filter)
       this_chunk_size =
         scanner->filter(scanner->filter_ctx, scanner->buff.buff + scanner->partial_row_length, this_chunk_size);
+    zsv_utf8_check(scanner, scanner->partial_row_length + this_chunk_size);
     if (this_chunk_size)
       stat = zsv_scan(scanner, scanner->buff.buff, this_chunk_size);
   }
   return stat;
 }
+
+#include "zsv_parallel.c"
+#include "zsv_count.c"
+#include "zsv_index.c"
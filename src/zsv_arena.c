@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Bump allocator for data that is freed all at once (see zsv_arena_new())
+ *
+ * Memory is handed out from the most recent block, and a new block, twice the
+ * size of the last (up to ZSV_ARENA_BLOCK_MAX), is added when it is full. A
+ * request that is larger than a block gets a block of its own, which is linked
+ * behind the current one so that the space left in the current one is not lost
+ *
+ * zsv_arena_reset() keeps the current block, so that an arena that is reset
+ * after each row (see zsv_parser_arena()) settles into a single block
+ */
+
+#define ZSV_ARENA_BLOCK_DEFAULT (64 * 1024)
+#define ZSV_ARENA_BLOCK_MAX (4 * 1024 * 1024)
+#define ZSV_ARENA_ALIGN 16
+
+struct zsv_arena_block {
+  struct zsv_arena_block *prev;
+  size_t size; // bytes in data
+  size_t used;
+  unsigned char data[];
+};
+
+struct zsv_arena {
+  struct zsv_arena_block *head;
+  size_t next_size; // size of the next block
+};
+
+ZSV_EXPORT
+struct zsv_arena *zsv_arena_new(size_t block_size) {
+  struct zsv_arena *arena = calloc(1, sizeof(*arena));
+  if (arena)
+    arena->next_size = block_size ? block_size : ZSV_ARENA_BLOCK_DEFAULT;
+  return arena;
+}
+
+static void *zsv_arena_grow(struct zsv_arena *arena, size_t n, size_t align) {
+  size_t size = arena->next_size;
+  char oversized = n + align > size;
+  if (oversized)
+    size = n + align;
+  struct zsv_arena_block *b = malloc(sizeof(*b) + size);
+  if (!b)
+    return NULL;
+  b->size = size;
+  b->used = 0;
+  if (oversized && arena->head) {
+    b->prev = arena->head->prev;
+    arena->head->prev = b;
+  } else {
+    b->prev = arena->head;
+    arena->head = b;
+    if (!oversized && arena->next_size < ZSV_ARENA_BLOCK_MAX)
+      arena->next_size *= 2;
+  }
+  size_t pad = (size_t)(-(uintptr_t)b->data) & (align - 1);
+  b->used = pad + n;
+  return b->data + pad;
+}
+
+__attribute__((always_inline)) static inline void *zsv_arena_take(struct zsv_arena *arena, size_t n, size_t align) {
+  struct zsv_arena_block *b = arena->head;
+  if (VERY_LIKELY(b != NULL)) {
+    size_t pad = (size_t)(-(uintptr_t)(b->data + b->used)) & (align - 1);
+    if (VERY_LIKELY(b->size - b->used >= pad + n)) {
+      void *p = b->data + b->used + pad;
+      b->used += pad + n;
+      return p;
+    }
+  }
+  return zsv_arena_grow(arena, n, align);
+}
+
+ZSV_EXPORT
+void *zsv_arena_alloc(struct zsv_arena *arena, size_t n) {
+  return zsv_arena_take(arena, n ? n : 1, ZSV_ARENA_ALIGN);
+}
+
+ZSV_EXPORT
+unsigned char *zsv_arena_memdup(struct zsv_arena *arena, const void *s, size_t len) {
+  unsigned char *p = zsv_arena_take(arena, len + 1, 1);
+  if (p) {
+    if (len)
+      memcpy(p, s, len);
+    p[len] = '\0';
+  }
+  return p;
+}
+
+static void zsv_arena_free_blocks(struct zsv_arena_block *b) {
+  while (b) {
+    struct zsv_arena_block *prev = b->prev;
+    free(b);
+    b = prev;
+  }
+}
+
+ZSV_EXPORT
+void zsv_arena_reset(struct zsv_arena *arena) {
+  struct zsv_arena_block *b = arena->head;
+  if (b) {
+    zsv_arena_free_blocks(b->prev);
+    b->prev = NULL;
+    b->used = 0;
+  }
+}
+
+ZSV_EXPORT
+void zsv_arena_delete(struct zsv_arena *arena) {
+  if (arena) {
+    zsv_arena_free_blocks(arena->head);
+    free(arena);
+  }
+}
+
+/**
+ * Called before each row is passed to the row handler or returned by
+ * zsv_next_row(), to free what was allocated from the row-scoped arena
+ */
+__attribute__((always_inline)) static inline void zsv_row_arena_reset(struct zsv_scanner *scanner) {
+  struct zsv_arena *arena = scanner->arenas.row;
+  if (VERY_UNLIKELY(arena != NULL) && arena->head && (arena->head->used || arena->head->prev))
+    zsv_arena_reset(arena);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Row counting without cell parsing (see zsv_count_rows()). Included by zsv.c
+ * after zsv_parallel.c
+ *
+ * Approach:
+ * 1. parse the header row on the calling thread, as zsv_parse_parallel() does
+ * 2. memory-map the file and split the remaining data into ranges of whole
+ *    64-byte blocks, which are scanned in parallel by the row-count kernel
+ *    (see zsv_scan_count.c) for each possible starting quote state
+ * 3. combine the range results in order: the quote state at the start of each
+ *    range is the running quote parity of the ranges before it
+ *
+ * If, in the starting quote state that applies, a range has a dbl-quote that
+ * neither opens nor closes a cell, or has a row that may not fit in the
+ * parser's buffer, then the rest of the file is parsed serially, starting with
+ * the row that contains the start of that range
+ */
+
+#if !defined(ZSV_NO_MMAP) && !defined(ZSV_NO_QUOTE_PARITY)
+
+struct zsv_count {
+  struct zsv_parallel p; // must be first
+  const unsigned char *data;
+  struct zsv_count_range *ranges;
+  zsv_scan_count_func scan;
+  size_t rows;
+};
+
+static int zsv_count_header(void *ctx, zsv_parser parser) {
+  (void)(ctx);
+  (void)(parser);
+  return 0;
+}
+
+static void zsv_count_row(void *ctx) {
+  ((struct zsv_count *)ctx)->rows++;
+}
+
+static void *zsv_count_chunk_start(void *ctx, zsv_parser parser, size_t chunk_ix) {
+  (void)(chunk_ix);
+  // number the rows as a serial parse would, e.g. in a warning that a row is truncated
+  parser->data_row_count = ((struct zsv_count *)ctx)->rows + 1;
+  return ctx;
+}
+
+static void zsv_count_scan_range(struct zsv_parallel *p, size_t ix) {
+  struct zsv_count *c = (struct zsv_count *)p;
+  c->scan(c->data, p->file_size, &c->ranges[ix], (unsigned char)p->opts->delimiter, (unsigned char)p->opts->quote_char,
+          p->opts->no_quotes);
+}
+
+/**
+ * Offset of the row start after the row end at the given offset
+ */
+static size_t zsv_count_next_row_start(struct zsv_count *c, size_t row_end) {
+  if (c->data[row_end] == '\r' && row_end + 1 < c->p.file_size && c->data[row_end + 1] == '\n')
+    return row_end + 2;
+  return row_end + 1;
+}
+
+/**
+ * Parse [offset, file_size) serially, and add its number of rows
+ */
+static enum zsv_status zsv_count_parse_rest(struct zsv_count *c, size_t offset) {
+  struct zsv_parallel *p = &c->p;
+  struct zsv_parallel_chunk chunk = {0};
+  if (p->opts->verbose)
+    fprintf(stderr, "Quote parity did not hold at offset %zu; counting remaining rows serially\n", offset);
+  chunk.start = offset;
+  chunk.end = p->file_size;
+  p->chunks = &chunk;
+  p->chunk_count = 1;
+  p->fallback_ix = 1;
+  p->next_end = 0;
+  p->popts->chunk_start = zsv_count_chunk_start;
+  p->popts->ctx = c;
+  zsv_parallel_parse_chunk(p, 0);
+  p->chunks = NULL;
+  return p->stat;
+}
+
+/**
+ * Scan [data_start, file_size) of the file with the given descriptor, and set c->rows
+ */
+static enum zsv_status zsv_count_scan(struct zsv_count *c, int fd) {
+  struct zsv_parallel *p = &c->p;
+  void *data = mmap(NULL, p->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return zsv_status_invalid_option;
+  c->data = data;
+
+  size_t data_size = p->file_size - p->data_start;
+  size_t chunk_size = p->popts->chunk_size;
+  if (!chunk_size) {
+    chunk_size = data_size / ((size_t)p->threads * ZSV_PARALLEL_CHUNKS_PER_THREAD);
+    if (chunk_size < ZSV_PARALLEL_MIN_CHUNK_SIZE)
+      chunk_size = ZSV_PARALLEL_MIN_CHUNK_SIZE;
+  }
+  chunk_size = (chunk_size + 63) & ~(size_t)63; // whole blocks
+  size_t count = data_size / chunk_size + (data_size % chunk_size ? 1 : 0);
+  if (!(c->ranges = calloc(count, sizeof(*c->ranges)))) {
+    munmap(data, p->file_size);
+    return zsv_status_memory;
+  }
+  for (size_t i = 0; i < count; i++) {
+    c->ranges[i].start = p->data_start + i * chunk_size;
+    c->ranges[i].end = i + 1 < count ? c->ranges[i].start + chunk_size : p->file_size;
+  }
+  c->ranges[0].at_row_start = 1;
+  zsv_parallel_run(p, count, zsv_count_scan_range);
+
+  // combine the results; rows must be shorter than the parser's buffer so that
+  // none are truncated
+  size_t max_row = p->buffsize / 2;
+  size_t row_start = p->data_start;
+  unsigned char in_quote = 0;
+  size_t fallback = p->file_size;
+  for (size_t i = 0; i < count; i++) {
+    struct zsv_count_range *r = &c->ranges[i];
+    if (r->invalid[in_quote] || r->max_gap[in_quote] >= max_row ||
+        (r->rows[in_quote] && r->first_end[in_quote] - row_start >= max_row)) {
+      fallback = row_start;
+      break;
+    }
+    if (r->rows[in_quote]) {
+      c->rows += r->rows[in_quote];
+      row_start = zsv_count_next_row_start(c, r->last_end[in_quote]);
+    }
+    in_quote ^= r->quote_parity;
+  }
+  if (fallback == p->file_size && (in_quote || p->file_size - row_start >= max_row))
+    fallback = row_start; // unclosed quote, or long row, at the end of the input
+  else if (fallback == p->file_size && row_start < p->file_size)
+    c->rows++; // final row without a row end
+
+  free(c->ranges);
+  c->ranges = NULL;
+  munmap(data, p->file_size);
+  c->data = NULL;
+  if (fallback < p->file_size)
+    return zsv_count_parse_rest(c, fallback);
+  return zsv_status_ok;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_count_rows(const char *path, struct zsv_opts *opts, struct zsv_parallel_opts *popts,
+                               size_t *count) {
+  zsv_scan_count_func scan = zsv_scan_count_select(opts);
+  if (!scan)
+    return zsv_status_invalid_option;
+#ifdef ZSV_EXTRAS
+  if (opts->max_rows)
+    return zsv_status_invalid_option;
+#endif
+
+  struct stat st;
+  FILE *f;
+  if (!path || !(f = fopen(path, "rb")))
+    return zsv_status_error;
+  if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode)) {
+    fclose(f);
+    return zsv_status_invalid_option;
+  }
+
+  struct zsv_parallel_opts count_popts = {0};
+  if (popts) {
+    count_popts.threads = popts->threads;
+    count_popts.chunk_size = popts->chunk_size;
+  }
+  count_popts.header = zsv_count_header;
+
+  struct zsv_opts count_opts = *opts;
+  count_opts.row_handler = zsv_count_row;
+  count_opts.cell_handler = NULL;
+  count_opts.overflow_row_handler = NULL;
+  if (!count_opts.delimiter || count_opts.delimiter == '\n' || count_opts.delimiter == '\r' ||
+      count_opts.delimiter == '"')
+    count_opts.delimiter = ','; // as in zsv_new()
+  if (!count_opts.quote_char)
+    count_opts.quote_char = '"';
+
+  struct zsv_count c = {0};
+  struct zsv_parallel *p = &c.p;
+  c.scan = scan;
+  p->path = path;
+  p->opts = &count_opts;
+  p->popts = &count_popts;
+  p->file_size = (size_t)st.st_size;
+  p->threads = count_popts.threads ? count_popts.threads : zsv_parallel_default_threads();
+  p->have_header = 1;
+#ifndef NO_THREADING
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->cond, NULL);
+#endif
+
+  p->stat = zsv_parallel_parse_header(p, f);
+  if (p->stat == zsv_status_ok && p->data_start < p->file_size)
+    p->stat = zsv_count_scan(&c, fileno(f));
+  fclose(f);
+
+#ifndef NO_THREADING
+  pthread_cond_destroy(&p->cond);
+  pthread_mutex_destroy(&p->mutex);
+#endif
+  if (p->stat == zsv_status_ok)
+    *count = c.rows;
+  return p->stat;
+}
+
+#else
+
+ZSV_EXPORT
+enum zsv_status zsv_count_rows(const char *path, struct zsv_opts *opts, struct zsv_parallel_opts *popts,
+                               size_t *count) {
+  (void)(path);
+  (void)(opts);
+  (void)(popts);
+  (void)(count);
+  return zsv_status_invalid_option;
+}
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Sparse row index of a seekable file, for random access to its data rows (see
+ * zsv_index_rows() and zsv_seek_row()). Included by zsv.c after zsv_count.c
+ *
+ * The index holds the input offset of every step-th data row. Each of these
+ * checkpoints is at the start of a row, where the scanner is always outside of
+ * quotes, so parsing may resume there with a freshly reset scanner. To seek to
+ * row n, the input is moved to checkpoint n / step, and the next n % step rows
+ * are skipped in the same way as zsv_opts.rows_to_ignore, so that row ends
+ * inside quoted cells are handled exactly as in a sequential parse
+ *
+ * The index is built by a single sequential parse, and may only be used by a
+ * parser with the same row-level options (see zsv_row_index_signature()). When
+ * saved, it also records the size and modification time of the input, so that
+ * a stale index is not loaded
+ *
+ * If the parser has not started when zsv_seek_row() is called, the input is
+ * first limited to the bytes before the first data row, so that the header is
+ * parsed (and delivered) as usual. Once those have been scanned, zsv_parse_more()
+ * applies the seek (see zsv_seek_apply()) and continues from the new offset
+ */
+
+#define ZSV_ROW_INDEX_MAGIC "ZSVRIX01"
+#define ZSV_ROW_INDEX_HEADER_FIELDS 7
+
+struct zsv_row_index {
+  uint64_t signature;  // see zsv_row_index_signature()
+  uint64_t file_size;  // size of the input
+  uint64_t mtime;      // modification time of the input
+  uint64_t data_start; // offset of the first data row, or file_size if none
+  uint64_t rows;       // number of data rows
+  uint64_t step;       // number of rows between checkpoints
+  uint64_t count;      // number of offsets
+  uint64_t *offsets;   // offsets[i] = offset of data row i * step
+};
+
+/**
+ * Hash of the options that determine where the rows of the input start. The
+ * options are those of a parser that has been initialized, so that defaults
+ * such as the delimiter have already been applied (see zsv_scanner_init())
+ */
+static uint64_t zsv_row_index_signature(const struct zsv_opts *opts) {
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+#define ZSV_ROW_INDEX_HASH(v) h = (h ^ (uint64_t)(v)) * 1099511628211ULL
+  ZSV_ROW_INDEX_HASH((unsigned char)opts->delimiter);
+  ZSV_ROW_INDEX_HASH((unsigned char)opts->quote_char);
+  ZSV_ROW_INDEX_HASH((unsigned char)opts->escape_char);
+  ZSV_ROW_INDEX_HASH(opts->no_quotes > 0);
+  ZSV_ROW_INDEX_HASH(opts->rows_to_ignore);
+  ZSV_ROW_INDEX_HASH(opts->header_span);
+  ZSV_ROW_INDEX_HASH(opts->keep_empty_header_rows);
+  const char *strings[] = {opts->delimiter_string, opts->row_terminator, opts->insert_header_row};
+  for (size_t i = 0; i < sizeof(strings) / sizeof(*strings); i++) {
+    for (const char *s = strings[i]; s && *s; s++)
+      ZSV_ROW_INDEX_HASH((unsigned char)*s);
+    ZSV_ROW_INDEX_HASH(0x100); // end of string
+  }
+#undef ZSV_ROW_INDEX_HASH
+  return h;
+}
+
+ZSV_EXPORT
+void zsv_row_index_delete(struct zsv_row_index *index) {
+  if (index) {
+    free(index->offsets);
+    free(index);
+  }
+}
+
+ZSV_EXPORT
+size_t zsv_row_index_rows(const struct zsv_row_index *index) {
+  return index ? (size_t)index->rows : 0;
+}
+
+struct zsv_index_builder {
+  zsv_parser parser;
+  FILE *f;
+  size_t bytes_read; // total bytes read from f
+  size_t base;       // input offset of the start of the parser's buffer
+  struct zsv_row_index *index;
+  size_t allocated;
+  unsigned char have_header : 1;
+  unsigned char oom : 1;
+  unsigned char truncated : 1;
+};
+
+static size_t zsv_index_read(void *restrict buff, size_t n, size_t size, void *restrict ctx) {
+  struct zsv_index_builder *b = ctx;
+  // buff follows the partial row, if any, at the start of the parser's buffer (see zsv_parse_more())
+  b->base = b->bytes_read - (size_t)((unsigned char *)buff - b->parser->buff.buff);
+  size_t got = fread(buff, n, size, b->f);
+  b->bytes_read += got * n;
+  return got;
+}
+
+static void zsv_index_row(void *ctx) {
+  struct zsv_index_builder *b = ctx;
+  struct zsv_row_index *index = b->index;
+  if (VERY_UNLIKELY(b->parser->partial_row_length == b->parser->buff.size))
+    b->truncated = 1; // a row that does not fit in the buffer (see scanner_pre_parse())
+  if (VERY_UNLIKELY(!b->have_header)) {
+    // the first row is the header (or, with header_span, the rows collated into it)
+    b->have_header = 1;
+    return;
+  }
+  if (index->rows % index->step == 0) {
+    if (index->count == b->allocated) {
+      size_t allocated = b->allocated ? b->allocated * 2 : 1024;
+      uint64_t *offsets = realloc(index->offsets, allocated * sizeof(*offsets));
+      if (!offsets) {
+        b->oom = 1;
+        zsv_abort(b->parser);
+        return;
+      }
+      index->offsets = offsets;
+      b->allocated = allocated;
+    }
+    index->offsets[index->count++] = b->base + b->parser->row_start;
+  }
+  index->rows++;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_index_rows(const char *path, struct zsv_opts *opts, size_t step, struct zsv_row_index **index) {
+  *index = NULL;
+  struct stat st;
+  FILE *f;
+  if (!path || !(f = fopen(path, "rb")))
+    return zsv_status_error;
+  if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode)) {
+    fclose(f);
+    return zsv_status_invalid_option;
+  }
+
+  struct zsv_index_builder b = {0};
+  struct zsv_opts index_opts = *opts;
+  index_opts.row_handler = zsv_index_row;
+  index_opts.cell_handler = NULL;
+  index_opts.overflow_row_handler = NULL;
+  index_opts.ctx = &b;
+  index_opts.read = zsv_index_read;
+  index_opts.stream = &b;
+  index_opts.buff = NULL;
+  index_opts.read_ahead.queue_depth = 0;
+  index_opts.tape = 0;
+  index_opts.stats = 0;
+#ifdef ZSV_EXTRAS
+  memset(&index_opts.progress, 0, sizeof(index_opts.progress));
+  memset(&index_opts.completed, 0, sizeof(index_opts.completed));
+  memset(&index_opts.overwrite, 0, sizeof(index_opts.overwrite));
+  index_opts.max_rows = 0;
+#endif
+
+  enum zsv_status stat = zsv_status_memory;
+  b.f = f;
+  if ((b.index = calloc(1, sizeof(*b.index))) && (b.parser = zsv_new(&index_opts))) {
+    b.index->signature = zsv_row_index_signature(&b.parser->opts_orig);
+    b.index->file_size = (uint64_t)st.st_size;
+    b.index->mtime = (uint64_t)st.st_mtime;
+    b.index->step = step ? step : ZSV_ROW_INDEX_STEP_DEFAULT;
+    while ((stat = zsv_parse_more(b.parser)) == zsv_status_ok && !b.truncated)
+      ;
+    if (stat == zsv_status_no_more_input)
+      stat = zsv_finish(b.parser);
+    if (b.oom)
+      stat = zsv_status_memory;
+    else if (b.truncated)
+      stat = zsv_status_invalid_option;
+    else if (stat == zsv_status_ok && ferror(f))
+      stat = zsv_status_error;
+    b.index->data_start = b.index->count ? b.index->offsets[0] : b.index->file_size;
+  }
+  zsv_delete(b.parser);
+  fclose(f);
+  if (stat == zsv_status_ok)
+    *index = b.index;
+  else
+    zsv_row_index_delete(b.index);
+  return stat;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_row_index_save(const struct zsv_row_index *index, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return zsv_status_error;
+  uint64_t header[ZSV_ROW_INDEX_HEADER_FIELDS] = {index->signature, index->file_size, index->mtime, index->data_start,
+                                                  index->rows,      index->step,      index->count};
+  int ok = fwrite(ZSV_ROW_INDEX_MAGIC, 1, strlen(ZSV_ROW_INDEX_MAGIC), f) == strlen(ZSV_ROW_INDEX_MAGIC) &&
+           fwrite(header, sizeof(*header), ZSV_ROW_INDEX_HEADER_FIELDS, f) == ZSV_ROW_INDEX_HEADER_FIELDS &&
+           (!index->count || fwrite(index->offsets, sizeof(*index->offsets), (size_t)index->count, f) == index->count);
+  if (fclose(f))
+    ok = 0;
+  return ok ? zsv_status_ok : zsv_status_error;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_row_index_load(const char *path, const char *data_path, struct zsv_row_index **index) {
+  *index = NULL;
+  struct stat st;
+  FILE *f;
+  if (!data_path || stat(data_path, &st) || !path || !(f = fopen(path, "rb")))
+    return zsv_status_error;
+
+  enum zsv_status stat = zsv_status_invalid_option;
+  char magic[sizeof(ZSV_ROW_INDEX_MAGIC) - 1];
+  uint64_t header[ZSV_ROW_INDEX_HEADER_FIELDS];
+  struct zsv_row_index *ix = calloc(1, sizeof(*ix));
+  if (!ix)
+    stat = zsv_status_memory;
+  else if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, ZSV_ROW_INDEX_MAGIC, sizeof(magic)) &&
+           fread(header, sizeof(*header), ZSV_ROW_INDEX_HEADER_FIELDS, f) == ZSV_ROW_INDEX_HEADER_FIELDS) {
+    ix->signature = header[0];
+    ix->file_size = header[1];
+    ix->mtime = header[2];
+    ix->data_start = header[3];
+    ix->rows = header[4];
+    ix->step = header[5];
+    ix->count = header[6];
+    // the index must match the input as it is now
+    if (ix->file_size == (uint64_t)st.st_size && ix->mtime == (uint64_t)st.st_mtime && ix->step &&
+        ix->count == ix->rows / ix->step + (ix->rows % ix->step ? 1 : 0) && ix->data_start <= ix->file_size) {
+      if (ix->count && !(ix->offsets = malloc(ix->count * sizeof(*ix->offsets))))
+        stat = zsv_status_memory;
+      else if (!ix->count || fread(ix->offsets, sizeof(*ix->offsets), (size_t)ix->count, f) == ix->count) {
+        stat = zsv_status_ok;
+        for (size_t i = 0; i < ix->count && stat == zsv_status_ok; i++)
+          if (ix->offsets[i] > ix->file_size || (i && ix->offsets[i] < ix->offsets[i - 1]))
+            stat = zsv_status_invalid_option;
+      }
+    }
+  }
+  fclose(f);
+  if (stat == zsv_status_ok)
+    *index = ix;
+  else
+    zsv_row_index_delete(ix);
+  return stat;
+}
+
+/**
+ * @return non-zero if the parser's input cannot be repositioned
+ */
+static int zsv_seek_unsupported(zsv_parser parser) {
+#ifdef ZSV_EXTRAS
+  if (parser->overwrite.have)
+    return 1;
+#endif
+  return parser->mode == ZSV_MODE_FIXED || parser->read_ahead ||
+         (!parser->mapped.data && (parser->read != (zsv_generic_read)fread || !parser->in));
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_set_row_index(zsv_parser parser, const struct zsv_row_index *index) {
+  if (index) {
+    if (zsv_seek_unsupported(parser) || index->signature != zsv_row_index_signature(&parser->opts_orig))
+      return zsv_status_invalid_option;
+    struct stat st;
+    size_t size = parser->mapped.data ? parser->mapped.size
+                  : fstat(fileno((FILE *)parser->in), &st) ? 0
+                                                           : (size_t)st.st_size;
+    if (size != index->file_size)
+      return zsv_status_invalid_option;
+  }
+  parser->seek.index = index;
+  return zsv_status_ok;
+}
+
+/**
+ * Limit the input to the bytes before the first data row, while the header is parsed
+ */
+static size_t zsv_seek_header_read(void *restrict buff, size_t n, size_t size, void *restrict ctx) {
+  struct zsv_scanner *scanner = ctx;
+  size_t want = n * size;
+  if (want > scanner->seek.remaining)
+    want = scanner->seek.remaining;
+  size_t got = want ? scanner->seek.read(buff, 1, want, scanner->seek.in) : 0;
+  scanner->seek.remaining -= got;
+  return got;
+}
+
+/**
+ * Reposition the input at seek.offset, reset the scanner state, and skip the
+ * next seek.skip rows
+ * @return zsv_status_no_more_input if the seek was pending, and the header is
+ *         still a partial row
+ */
+static enum zsv_status zsv_seek_apply(struct zsv_scanner *scanner) {
+  size_t offset = scanner->seek.offset;
+  if (scanner->seek.pending) {
+    scanner->seek.pending = 0;
+    if (scanner->mapped.data)
+      scanner->mapped.size = scanner->seek.mapped_size;
+    else {
+      scanner->read = scanner->seek.read;
+      scanner->in = scanner->seek.in;
+    }
+    if (scanner->partial_row_length)
+      return zsv_status_no_more_input; // the header ends at the end of the input
+  }
+  if (scanner->mapped.data)
+    scanner->buff.buff = scanner->mapped.data + offset;
+  else if (fseeko(scanner->in, (off_t)offset, SEEK_SET))
+    return zsv_status_error;
+
+  // zsv_cum_scanned_length() remains the input offset
+  size_t bom_len = scanner->had_bom ? strlen(ZSV_BOM) : 0;
+  scanner->cum_scanned_length = offset > bom_len ? offset - bom_len : 0;
+  scanner->checked_bom = 1;
+  scanner->scanned_length = scanner->partial_row_length = scanner->old_bytes_read = 0;
+  scanner->row_start = scanner->cell_start = 0;
+  scanner->row.used = 0;
+  scanner->last = '\0';
+  scanner->have_cell = 0;
+  scanner->quote_close_position = 0;
+  zsv_clear_cell(scanner);
+  scanner->buffer_exceeded = 0;
+  scanner->finished = 0;
+  scanner->delims.rescan = scanner->delims.at_eof = 0;
+  scanner->pull.stat = zsv_status_ok;
+  scanner->pull.resume = 0;
+  scanner->pull.now = 0;
+  if (scanner->tape)
+    zsv_tape_clear(scanner->tape);
+
+  scanner->opts.rows_to_ignore = scanner->seek.skip;
+  set_callbacks(scanner);
+  return zsv_status_ok;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_seek_row(zsv_parser parser, size_t n) {
+  const struct zsv_row_index *index = parser->seek.index;
+  if (!index || zsv_seek_unsupported(parser))
+    return zsv_status_invalid_option;
+  if (n < index->rows) {
+    parser->seek.offset = (size_t)index->offsets[n / index->step];
+    parser->seek.skip = n % index->step;
+  } else {
+    parser->seek.offset = (size_t)index->file_size;
+    parser->seek.skip = 0;
+  }
+
+  if (parser->started || parser->seek.pending)
+    return parser->seek.pending ? zsv_status_ok : zsv_seek_apply(parser);
+
+  // parse the header first
+  parser->seek.pending = 1;
+  if (parser->mapped.data) {
+    parser->seek.mapped_size = parser->mapped.size;
+    parser->mapped.size = (size_t)index->data_start;
+  } else {
+    parser->seek.read = parser->read;
+    parser->seek.in = parser->in;
+    parser->seek.remaining = (size_t)index->data_start;
+    parser->read = zsv_seek_header_read;
+    parser->in = parser;
+  }
+  return zsv_status_ok;
+}
@@ -57,6 +57,29 @@
 
 typedef unsigned char zsv_uc_vector __attribute__((vector_size(VECTOR_BYTES)));
 
+struct zsv_scanner;
+typedef enum zsv_status (*zsv_scan_delim_func)(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read);
+
+/**
+ * Result of a row-count kernel (see zsv_scan_count.c) for a byte range of the
+ * input, for each quote state (0 = outside, 1 = inside quotes) that the range
+ * may start in
+ */
+struct zsv_count_range {
+  size_t start; // file offset at which this range starts
+  size_t end;   // file offset at which this range ends (exclusive)
+  size_t rows[2];
+  size_t first_end[2];      // offset of the first row end, if rows > 0
+  size_t last_end[2];       // offset of the last row end, if rows > 0
+  size_t max_gap[2];        // max bytes between two row ends in this range
+  unsigned char invalid[2]; // 1 = a dbl-quote neither opens nor closes a cell
+  unsigned char quote_parity : 1;
+  unsigned char at_row_start : 1; // 1 = range starts at a row start, outside quotes
+  unsigned char _ : 6;
+};
+typedef void (*zsv_scan_count_func)(const unsigned char *data, size_t data_size, struct zsv_count_range *r,
+                                    unsigned char delimiter, unsigned char quote, char no_quotes);
+
 struct zsv_row {
   size_t used, allocated, overflow;
   struct zsv_cell *cells;
@@ -71,22 +94,15 @@ struct collate_header {
   size_t column_count;
 };
 
-struct zsv_scan_delim_regs {
-  size_t i;
-  size_t bytes_chunk_end;
-  size_t bytes_read;
-  char delimiter;
-  unsigned char c;
-  char skip_next_delim;
-  int quote;
-  size_t mask_total_offset;
-  zsv_mask_t mask;
-  int mask_last_start;
-  unsigned char location;
-};
-
-struct zsv_scan_fixed_regs {
-  char xx; // to do
+/**
+ * Where the pull parser's scan kernel stopped after it returned a row (see
+ * zsv_scan_delim.c). Everything else the kernel needs is in the scanner itself,
+ * or is derived from the parser options
+ */
+struct zsv_pull_cursor {
+  size_t i;               // position of the end of the returned row
+  size_t mask_last_start; // position of the vector from which mask was computed
+  zsv_mask_t mask;        // candidates in that vector that are yet to be processed
 };
 
 #ifdef ZSV_EXTRAS
@@ -133,6 +149,8 @@ struct zsv_scanner {
   unsigned char abort : 1;
   unsigned char have_cell : 1;
   unsigned char started : 1;
+  unsigned char truncated : 1;      // a row has not fit in the buffer (see scanner_pre_parse())
+  unsigned char quiet_truncate : 1; // do not warn when a row is truncated
 
   size_t quote_close_position;
   struct zsv_opts opts;
@@ -146,6 +164,21 @@ struct zsv_scanner {
 
   size_t (*read)(void *buff, size_t n, size_t size, void *in);
   void *in;
+  struct {
+    void (*close)(void *in); // called by zsv_delete() (see zsv_set_input_close())
+    void *in;
+  } input_close;
+  struct {
+    int (*error)(void *in); // checked at the end of the input (see zsv_set_input_error())
+    void *in;
+  } input_error;
+
+  struct {
+    struct zsv_arena *row;   // reset before each row (see zsv_parser_arena())
+    struct zsv_arena *parse; // freed by zsv_delete()
+  } arenas;
+
+  struct zsv_stats_state *stats; // non-NULL if opts.stats is set (see zsv_stats.c)
 
   size_t (*filter)(void *ctx, unsigned char *buff, size_t bytes_read);
   void *filter_ctx;
@@ -159,18 +192,45 @@ struct zsv_scanner {
 
   struct zsv_opts opts_orig;
 
+  zsv_scan_delim_func scan_delim; // kernel used in ZSV_MODE_DELIM
+
 #define ZSV_MODE_DELIM 0
 #define ZSV_MODE_FIXED 1
 #define ZSV_MODE_DELIM_PULL 2
   unsigned char mode;
   struct {
-    unsigned *offsets; // 0-based position of each cell end. offset[0] = end of first cell
-    unsigned count;    // number of offsets
+    unsigned *offsets;    // 0-based position of each cell end. offset[0] = end of first cell
+    unsigned count;       // number of offsets
+    size_t record_length; // non-zero if rows are records of this length, with no row ends
+    unsigned char pull;   // 1 = rows are sliced by zsv_next_batch() instead of by the scanner
   } fixed;
 
   struct collate_header *collate_header;
   size_t data_row_count; /* 0 = in header row; 1 = first data row */
   struct zsv_cell (*get_cell)(zsv_parser parser, size_t ix);
+  struct zsv_tape *tape; // non-NULL if opts.tape is in effect (see zsv_tape.c)
+  struct {
+    unsigned char *data; // non-NULL if the input is memory-mapped (see zsv_mmap.c)
+    size_t size;
+    unsigned char *arena; // copies of cells that are modified in place
+    size_t arena_used;
+  } mapped;
+  struct zsv_read_ahead *read_ahead; // non-NULL if opts.read_ahead is in effect (see zsv_read_ahead.c)
+  unsigned char *utf8_clean_end;     // cells that end at or before this are well-formed (see zsv_utf8_check.c)
+  struct {
+    unsigned char delim[ZSV_DELIMITER_MAX + 1];
+    unsigned char term[ZSV_DELIMITER_MAX + 1];
+    unsigned char delim_len; // non-zero if the multi-char kernel is in use (see zsv_scan_multi.c)
+    unsigned char term_len;  // 0 = rows end with \n, \r or \r\n
+    unsigned char rescan;    // length of a possible delimiter, row terminator or escape at the end of the last scan
+    unsigned char at_eof;    // 1 = there is no more input, so a partial match is not a match
+  } delims;
+  struct {
+    unsigned char *bitmap;  // non-NULL if only some columns are stored (see zsv_set_column_filter())
+    unsigned char *pending; // bitmap to use once the header rows have been processed
+    size_t count;           // 1 + index of the last column to store
+  } column_filter;
+  size_t skip_rows; // number of rows still to skip without storing their cells (see zsv_skip_rows())
 
 #ifdef ZSV_EXTRAS
   struct {
@@ -180,16 +240,25 @@ struct zsv_scanner {
   } progress;
 #endif
   struct {
-    union {
-      struct zsv_scan_delim_regs delim;
-      struct zsv_scan_fixed_regs fixed;
-    } *regs;
+    struct zsv_pull_cursor cursor;
     enum zsv_status stat; // last status
     unsigned char *buff;
     size_t bytes_read;
     size_t row_used;
     unsigned char now;
+    unsigned char started : 1; // 1 = zsv_next_row() or zsv_next_batch() has been called
+    unsigned char resume : 1;  // 1 = the kernel returned a row, and will resume from cursor
   } pull;
+  struct {
+    const struct zsv_row_index *index; // see zsv_set_row_index()
+    size_t offset;                     // input offset at which to resume
+    size_t skip;                       // number of rows to skip after resuming
+    size_t (*read)(void *buff, size_t n, size_t size, void *in); // input, while the header is parsed
+    void *in;
+    size_t remaining;   // input left before the first data row, while the header is parsed
+    size_t mapped_size; // size of the mapping, while the header is parsed
+    unsigned char pending : 1; // 1 = the seek applies once the header has been parsed (see zsv_index.c)
+  } seek;
 
 #ifdef ZSV_EXTRAS
   struct zsv_overwrite overwrite;
@@ -277,68 +346,212 @@ __attribute__((always_inline)) static inline void zsv_clear_cell(struct zsv_scan
   scanner->quoted = 0;
 }
 
-// always_inline has a noticeable impact. do not remove without benchmarking!
-__attribute__((always_inline)) static inline void cell_dl(struct zsv_scanner *scanner, unsigned char *s, size_t n) {
+#include "zsv_mmap.c"
+#include "zsv_read_ahead.c"
+#include "zsv_arena.c"
+#include "zsv_stats.c"
+
+/**
+ * Copy src[0..n) to dst, replacing each pair of quote chars (see
+ * zsv_opts.quote_char) with a single quote char. dst may overlap src if it
+ * does not follow it, so that a cell can be compacted in place. Text between
+ * quotes is moved a run at a time, so the cost is linear in n regardless of
+ * how many pairs there are
+ *
+ * @param pending in/out: 1 if the byte before src was a quote that has not
+ *                been paired, so that a leading quote in src is its pair
+ * @return number of bytes written
+ */
+static size_t zsv_unescape_quotes(unsigned char *dst, const unsigned char *src, size_t n, char *pending,
+                                  unsigned char quote) {
+  unsigned char *start = dst;
+  const unsigned char *end = src + n;
+  if (*pending && src < end && *src == quote)
+    src++;
+  *pending = 0;
+  while (src < end) {
+    const unsigned char *q = memchr(src, quote, (size_t)(end - src));
+    size_t len = q ? (size_t)(q - src) + 1 : (size_t)(end - src);
+    if (dst != src)
+      memmove(dst, src, len);
+    dst += len;
+    src += len;
+    if (q) {
+      if (src < end && *src == quote)
+        src++;
+      else
+        *pending = 1;
+    }
+  }
+  return (size_t)(dst - start);
+}
+
+/**
+ * Remove the escape chars (see zsv_opts.escape_char), and any enclosing or
+ * escaped quote chars, from a raw cell in place, in a single pass
+ * @return the new length
+ */
+static size_t zsv_unescape_escaped(unsigned char *s, size_t n, int quote, unsigned char escape) {
+  size_t j = 0;
+  char in_quote = 0;
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = s[i];
+    if (c == escape && i + 1 < n) {
+      c = s[++i];
+      s[j++] = c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+    } else if (c == quote && i == 0)
+      in_quote = 1;
+    else if (c == quote && in_quote) {
+      if (i + 1 < n && s[i + 1] == quote) // escaped quote
+        s[j++] = s[++i];
+      else
+        in_quote = 0;
+    } else
+      s[j++] = c;
+  }
+  return j;
+}
+
+/**
+ * Check whether an unquoted cell needs quotes in CSV output. The scan kernel
+ * only detects this for comma-delimited, dbl-quoted input, which cannot
+ * contain an unquoted comma, dbl-quote, \n or \r (see zsv_cell_check_quotes())
+ */
+static inline char zsv_cell_needs_quotes(struct zsv_scanner *scanner, const unsigned char *s, size_t n) {
+  return memchr(s, ',', n) || (scanner->delims.term_len && (memchr(s, '\n', n) || memchr(s, '\r', n))) ||
+         (scanner->opts.quote_char != '"' && memchr(s, '"', n));
+}
+
+/**
+ * @return non-zero if unquoted cells must be checked with zsv_cell_needs_quotes()
+ */
+static inline char zsv_cell_check_quotes(struct zsv_scanner *scanner) {
+  return scanner->opts.delimiter != ',' || scanner->delims.delim_len || scanner->opts.quote_char != '"';
+}
+
+/**
+ * Remove enclosing quotes and escaped quotes from a parsed cell, and handle
+ * malformed UTF8. Cell content may be modified in place
+ *
+ * @param s                    start of the raw cell
+ * @param np                   length of the raw cell; updated to the final length
+ * @param quoted               ZSV_PARSER_QUOTE_XXX flags; may be updated
+ * @param quote_close_position position of the closing quote, if any
+ * @return start of the final cell content
+ */
+
+__attribute__((always_inline)) static inline unsigned char *zsv_cell_value(struct zsv_scanner *scanner,
+                                                                           unsigned char *s, size_t *np,
+                                                                           unsigned char *quoted,
+                                                                           size_t quote_close_position) {
+  size_t n = *np;
+  // a quoted cell that ends at EOF is closed by zsv_finish() with its closing
+  // quote, which is the last char, counted as a position past the end
+  if (UNLIKELY(quote_close_position >= n) && n)
+    quote_close_position = n - 1;
+  // delimiters and dbl-quotes are ASCII, so a cell that is well-formed as
+  // scanned remains so after its quotes are handled
+  char utf8_check = scanner->opts.malformed_utf8_replace && s + n > scanner->utf8_clean_end;
+  if (UNLIKELY(scanner->mapped.data != NULL) &&
+      (utf8_check ||
+       ((*quoted & ZSV_PARSER_QUOTE_EMBEDDED) && !scanner->opts.lazy_unescape) ||
+       (*quoted && quote_close_position && quote_close_position + 1 != n)))
+    s = zsv_mmap_cell_copy(scanner, s, n);
+
   // handle quoting
-  if (UNLIKELY(scanner->quoted > 0)) {
-    if (LIKELY(scanner->quote_close_position + 1 == n)) {
-      if (LIKELY((scanner->quoted & ZSV_PARSER_QUOTE_EMBEDDED) == 0)) {
+  if (UNLIKELY(*quoted > 0)) {
+    if (VERY_UNLIKELY(scanner->opts.escape_char) && (*quoted & ZSV_PARSER_QUOTE_EMBEDDED)) {
+      // the cell contains an escape char or an escaped quote (see zsv_scan_multi.c)
+      n = zsv_unescape_escaped(s, n, scanner->opts.no_quotes > 0 ? -1 : (unsigned char)scanner->opts.quote_char,
+                               (unsigned char)scanner->opts.escape_char);
+      *quoted = ZSV_PARSER_QUOTE_NEEDED;
+    } else if (LIKELY(quote_close_position + 1 == n)) {
+      if (LIKELY((*quoted & ZSV_PARSER_QUOTE_EMBEDDED) == 0)) {
         // this is the easy and usual case: no embedded double-quotes
         // just remove surrounding quotes from content
         s++;
         n -= 2;
-      } else { // embedded dbl-quotes to remove
+      } else if (scanner->opts.lazy_unescape && scanner->data_row_count &&
+                 scanner->opts.row_handler == scanner->opts_orig.row_handler) {
+        // data row: leave embedded dbl-quotes escaped (see zsv_get_cell_unescaped())
         s++;
-        n--;
-        // remove dbl-quotes. TO DO: consider adding option to skip this
-        for (size_t i = 0; i + 1 < n; i++) {
-          if (s[i] == '"' && s[i + 1] == '"') {
-            if (n > i + 2)
-              memmove(s + i + 1, s + i + 2, n - i - 2);
-            n--;
-          }
-        }
-        n--;
+        n -= 2;
+        *quoted |= ZSV_PARSER_QUOTE_ESCAPED;
+      } else { // embedded dbl-quotes to remove
+        // the closing quote is included so that, as when the cell is
+        // scanned, it may complete a pair; the last char is then dropped
+        char pending = 0;
+        n = zsv_unescape_quotes(s, s + 1, n - 1, &pending, (unsigned char)scanner->opts.quote_char) - 1;
       }
     } else {
-      if (scanner->quote_close_position) {
-        // the first char was a quote, and we have content after the closing quote
-        // the solution below is a generalized on that will work
-        // for the easy and usual case, but by handling separately
-        // we avoid the memmove in the easy / usual case
-        memmove(s + 1, s, scanner->quote_close_position);
-        s += 2;
-        n -= 2;
-        if (UNLIKELY((scanner->quoted & ZSV_PARSER_QUOTE_EMBEDDED) != 0)) {
-          // remove dbl-quotes
-          for (size_t i = 0; i + 1 < n; i++) {
-            if (s[i] == '"' && s[i + 1] == '"') {
-              if (n > i + 2)
-                memmove(s + i + 1, s + i + 2, n - i - 2);
-              n--;
-            }
-          }
+      if (quote_close_position) {
+        // the first char was a quote, and we have content after the closing
+        // quote: remove both quotes. In the easy / usual case of no embedded
+        // dbl-quotes, the (usually shorter) quoted part is moved up to the
+        // content that follows it
+        if (LIKELY((*quoted & ZSV_PARSER_QUOTE_EMBEDDED) == 0)) {
+          memmove(s + 1, s, quote_close_position);
+          s += 2;
+          n -= 2;
+        } else {
+          char pending = 0;
+          unsigned char quote = (unsigned char)scanner->opts.quote_char;
+          size_t len = zsv_unescape_quotes(s, s + 1, quote_close_position - 1, &pending, quote);
+          n = len +
+              zsv_unescape_quotes(s + len, s + quote_close_position + 1, n - quote_close_position - 1, &pending, quote);
         }
       }
     }
-  } else if (UNLIKELY(scanner->opts.delimiter != ',')) {
-    if (memchr(s, ',', n))
-      scanner->quoted = ZSV_PARSER_QUOTE_NEEDED;
+  } else if (UNLIKELY(zsv_cell_check_quotes(scanner))) {
+    if (zsv_cell_needs_quotes(scanner, s, n))
+      *quoted = ZSV_PARSER_QUOTE_NEEDED;
   }
   // end quote handling
 
-  if (scanner->opts.malformed_utf8_replace) {
+  if (UNLIKELY(utf8_check)) {
     if (scanner->opts.malformed_utf8_replace < 0)
       n = zsv_strencode(s, n, 0, NULL, NULL);
     else
       n = zsv_strencode(s, n, scanner->opts.malformed_utf8_replace, NULL, NULL);
   }
+  *np = n;
+  return s;
+}
 
-  if (UNLIKELY(scanner->opts.cell_handler != NULL))
-    scanner->opts.cell_handler(scanner->opts.ctx, s, n);
+// always_inline has a noticeable impact. do not remove without benchmarking!
+__attribute__((always_inline)) static inline void cell_dl(struct zsv_scanner *scanner, unsigned char *s, size_t n) {
+  if (VERY_UNLIKELY(scanner->skip_rows)) {
+    scanner->have_cell = 1;
+    zsv_clear_cell(scanner);
+    return;
+  }
+  if (VERY_UNLIKELY(scanner->column_filter.bitmap != NULL)) {
+    size_t ix = scanner->row.used;
+    if (ix >= scanner->column_filter.count || !(scanner->column_filter.bitmap[ix / 8] & (1 << (ix % 8)))) {
+      // not selected: store as empty, without any quote handling
+      if (ix < scanner->column_filter.count) {
+        struct zsv_cell c = {s, 0, 0, 0};
+        scanner->row.cells[scanner->row.used++] = c;
+      }
+      scanner->have_cell = 1;
+      zsv_clear_cell(scanner);
+      return;
+    }
+  }
+
+  unsigned char quoted = scanner->quoted;
+  s = zsv_cell_value(scanner, s, &n, &quoted, scanner->quote_close_position);
+
+  if (UNLIKELY(scanner->opts.cell_handler != NULL)) {
+    scanner->quoted = quoted;
+    if (VERY_UNLIKELY(scanner->stats != NULL))
+      zsv_stats_cell_handler(scanner, s, n);
+    else
+      scanner->opts.cell_handler(scanner->opts.ctx, s, n);
+  }
   if (VERY_LIKELY(scanner->row.used < scanner->row.allocated)) {
     struct zsv_row *row = &scanner->row;
-    struct zsv_cell c = {s, n, scanner->opts.no_quotes ? 1 : scanner->quoted, 0};
+    struct zsv_cell c = {s, n, scanner->opts.no_quotes ? 1 : quoted, 0};
     row->cells[row->used++] = c;
   } else
     scanner->row.overflow++;
@@ -353,7 +566,12 @@ __attribute__((always_inline)) static inline enum zsv_status row_dl(struct zsv_s
             scanner->row.allocated + scanner->row.overflow, scanner->row.allocated);
     scanner->row.overflow = 0;
   }
-  if (VERY_LIKELY(scanner->opts.row_handler != NULL)) // TO DO: disallow row_handler to be null; if null, set to dummy
+  zsv_row_arena_reset(scanner);
+  if (VERY_UNLIKELY(scanner->skip_rows))
+    scanner->skip_rows--;
+  else if (VERY_UNLIKELY(scanner->stats != NULL))
+    zsv_stats_row_handler(scanner);
+  else if (VERY_LIKELY(scanner->opts.row_handler != NULL)) // TO DO: disallow row_handler to be null; if null, set to dummy
     scanner->opts.row_handler(scanner->opts.ctx);
     // Note: scanner->data_row_count will be incremented AFTER this call
     //       in order to accommodate pull parsing, in which case incrementing here
@@ -405,6 +623,8 @@ __attribute__((always_inline)) static inline enum zsv_status cell_and_row_dl(str
   return row_dl(scanner);
 }
 
+#include "zsv_tape.c"
+
 #ifndef movemask_pseudo
 /*
   provide our own pseudo-movemask, which sets the 1 bit for each corresponding
@@ -460,15 +680,116 @@ static inline zsv_mask_t movemask_pseudo(zsv_uc_vector v) {
 #endif // __EMSCRIPTEN__
 #endif // ndef movemask_pseudo
 
+#ifndef ZSV_SCAN_TARGET
+#define ZSV_SCAN_TARGET // function attributes for scan kernels (see zsv_scan_dispatch.c)
+#endif
+
 #include "vector_delim.c"
+#include "zsv_utf8_check.c"
 
 #ifdef ZSV_SUPPORT_PULL_PARSER
 #undef ZSV_SUPPORT_PULL_PARSER
 #endif
 #define ZSV_SCAN_DELIM zsv_scan_delim
 #include "zsv_scan_delim.c"
+#undef scanner_last
 #undef ZSV_SCAN_DELIM
+
+// tape mode variant (see zsv_tape.c)
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape
+#include "zsv_scan_delim.c"
 #undef scanner_last
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+
+// multi-char delimiter and row terminator kernels (see zsv_scan_multi.c)
+#define ZSV_SCAN_MULTI zsv_scan_multi
+#include "zsv_scan_multi.c"
+#undef ZSV_SCAN_MULTI
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_MULTI zsv_scan_multi_tape
+#include "zsv_scan_multi.c"
+#undef ZSV_SCAN_MULTI
+#undef ZSV_SCAN_TAPE
+
+#ifndef ZSV_NO_QUOTE_PARITY
+// prefix_xor: bit n of the result is the XOR of bits 0..n of x
+__attribute__((always_inline)) static inline uint64_t zsv_prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+#define ZSV_PREFIX_XOR zsv_prefix_xor
+#define ZSV_SCAN_DELIM zsv_scan_delim
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#undef ZSV_SCAN_DELIM
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_tape
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+#define ZSV_SCAN_COUNT zsv_scan_count
+#include "zsv_scan_count.c"
+#undef ZSV_SCAN_COUNT
+#undef ZSV_PREFIX_XOR
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// carry-less multiply by all-ones computes the prefix-XOR in a single instruction.
+// If the compiler was not already told that PCLMULQDQ is available, this variant
+// is compiled for that target anyway and only selected if the cpu supports it
+#define ZSV_HAVE_CLMUL
+#include <wmmintrin.h>
+#ifdef __PCLMUL__
+#define ZSV_CLMUL_TARGET
+#else
+#define ZSV_CLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#endif
+
+ZSV_CLMUL_TARGET
+__attribute__((always_inline)) static inline uint64_t zsv_prefix_xor_clmul(uint64_t x) {
+  __m128i all_ones = _mm_set1_epi8((char)0xFF);
+  return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x), all_ones, 0));
+}
+
+#undef ZSV_SCAN_TARGET
+#define ZSV_SCAN_TARGET ZSV_CLMUL_TARGET
+#define ZSV_PREFIX_XOR zsv_prefix_xor_clmul
+#define ZSV_SCAN_DELIM zsv_scan_delim
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_clmul
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#undef ZSV_SCAN_DELIM
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_tape_clmul
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+#define ZSV_SCAN_COUNT zsv_scan_count_clmul
+#include "zsv_scan_count.c"
+#undef ZSV_SCAN_COUNT
+#undef ZSV_PREFIX_XOR
+#undef ZSV_SCAN_TARGET
+#define ZSV_SCAN_TARGET
+#endif
+#endif // ZSV_NO_QUOTE_PARITY
+
+#if !defined(ZSV_NO_SCAN_DISPATCH) && (defined(__x86_64__) || defined(__i386__)) &&                              \
+  (defined(__GNUC__) || defined(__clang__))
+#define ZSV_SCAN_DISPATCH
+#include "zsv_scan_dispatch.c"
+#endif
 
 #define ZSV_SUPPORT_PULL_PARSER 1
 #define ZSV_SCAN_DELIM zsv_scan_delim_pull
@@ -476,15 +797,152 @@ static inline zsv_mask_t movemask_pseudo(zsv_uc_vector v) {
 
 #include "zsv_scan_fixed.c"
 
+/**
+ * Parse a comma-separated list of ZSV_SCAN_KERNEL names into a
+ * ZSV_SCAN_KERNEL_XXX value
+ */
+static unsigned char zsv_scan_kernel_parse(const char *s) {
+  static const struct {
+    const char *name;
+    unsigned char value;
+  } names[] = {
+    {"baseline", ZSV_SCAN_KERNEL_BASELINE}, {"sse2", ZSV_SCAN_KERNEL_SSE2},       {"avx2", ZSV_SCAN_KERNEL_AVX2},
+    {"avx512", ZSV_SCAN_KERNEL_AVX512},     {"classic", ZSV_SCAN_KERNEL_CLASSIC},
+  };
+  unsigned char kernel = ZSV_SCAN_KERNEL_AUTO;
+  while (s && *s) {
+    size_t len = strcspn(s, ",");
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++)
+      if (strlen(names[i].name) == len && !memcmp(s, names[i].name, len))
+        kernel |= names[i].value;
+    s += len + (s[len] == ',');
+  }
+  return kernel;
+}
+
+/**
+ * @return non-zero if opts has a multi-byte delimiter, a row terminator or an
+ *         escape char, which require the multi-char kernel (see zsv_scan_multi.c)
+ */
+static char zsv_opts_scan_multi(const struct zsv_opts *opts) {
+  return (opts->delimiter_string && strlen(opts->delimiter_string) > 1) ||
+         (opts->row_terminator && *opts->row_terminator) || opts->escape_char;
+}
+
+/**
+ * Select the kernel used by zsv_scan() in ZSV_MODE_DELIM: unless overridden by
+ * opts->scan_kernel or the ZSV_SCAN_KERNEL environment variable, the
+ * quote-parity kernel with the widest vectors that the cpu supports. Kernels
+ * can be excluded at build time with ZSV_NO_QUOTE_PARITY or ZSV_NO_SCAN_DISPATCH.
+ * A multi-byte delimiter, row terminator or escape char always uses the
+ * multi-char kernel
+ *
+ * @param tape if non-zero, select a tape mode kernel (see zsv_tape.c), which
+ *             is also used by the pull parser
+ */
+static zsv_scan_delim_func zsv_scan_delim_select(struct zsv_opts *opts, char tape) {
+  if (zsv_opts_scan_multi(opts))
+    return tape ? zsv_scan_multi_tape : zsv_scan_multi;
+
+  unsigned char kernel = opts->scan_kernel ? opts->scan_kernel : zsv_scan_kernel_parse(getenv("ZSV_SCAN_KERNEL"));
+  unsigned char width = kernel & ~ZSV_SCAN_KERNEL_CLASSIC;
+  char classic = opts->no_quotes > 0 || (kernel & ZSV_SCAN_KERNEL_CLASSIC);
+
+#ifdef ZSV_SCAN_DISPATCH
+  if (width > ZSV_SCAN_KERNEL_BASELINE && !zsv_scan_kernel_supported(width)) {
+    if (opts->verbose)
+      fprintf(stderr, "Requested scan kernel not supported by this cpu; using default\n");
+    width = ZSV_SCAN_KERNEL_AUTO;
+  }
+  if (width != ZSV_SCAN_KERNEL_BASELINE) {
+    for (size_t i = 0; i < sizeof(zsv_scan_kernels) / sizeof(*zsv_scan_kernels); i++) {
+      const struct zsv_scan_kernel *k = &zsv_scan_kernels[i];
+      if ((width == ZSV_SCAN_KERNEL_AUTO || width == k->width) && zsv_scan_kernel_supported(k->width)) {
+        if (tape)
+          return classic || !k->scan_qp_tape ? k->scan_tape : k->scan_qp_tape;
+        return classic || !k->scan_qp ? k->scan : k->scan_qp;
+      }
+    }
+  }
+#else
+  (void)(width);
+#endif
+
+#ifndef ZSV_NO_QUOTE_PARITY
+  if (!classic) {
+#ifdef ZSV_HAVE_CLMUL
+#ifdef __PCLMUL__
+    return tape ? zsv_scan_delim_qp_tape_clmul : zsv_scan_delim_qp_clmul;
+#else
+    if (__builtin_cpu_supports("pclmul"))
+      return tape ? zsv_scan_delim_qp_tape_clmul : zsv_scan_delim_qp_clmul;
+#endif
+#endif
+    return tape ? zsv_scan_delim_qp_tape : zsv_scan_delim_qp;
+  }
+#else
+  (void)(classic);
+#endif
+  return tape ? zsv_scan_delim_tape : zsv_scan_delim;
+}
+
+/**
+ * Select the row-count kernel used by zsv_count_rows(), using the same vector
+ * width as zsv_scan_delim_select()
+ *
+ * @return NULL if the quote-parity kernels are excluded or not requested, or if
+ *         opts has a multi-byte delimiter, row terminator or escape char
+ */
+static zsv_scan_count_func zsv_scan_count_select(struct zsv_opts *opts) {
+  unsigned char kernel = opts->scan_kernel ? opts->scan_kernel : zsv_scan_kernel_parse(getenv("ZSV_SCAN_KERNEL"));
+  unsigned char width = kernel & ~ZSV_SCAN_KERNEL_CLASSIC;
+  if ((kernel & ZSV_SCAN_KERNEL_CLASSIC) || zsv_opts_scan_multi(opts))
+    return NULL;
+
+#ifdef ZSV_SCAN_DISPATCH
+  if (width > ZSV_SCAN_KERNEL_BASELINE && !zsv_scan_kernel_supported(width))
+    width = ZSV_SCAN_KERNEL_AUTO;
+  if (width != ZSV_SCAN_KERNEL_BASELINE) {
+    for (size_t i = 0; i < sizeof(zsv_scan_kernels) / sizeof(*zsv_scan_kernels); i++) {
+      const struct zsv_scan_kernel *k = &zsv_scan_kernels[i];
+      if ((width == ZSV_SCAN_KERNEL_AUTO || width == k->width) && zsv_scan_kernel_supported(k->width))
+        return k->scan_count;
+    }
+  }
+#else
+  (void)(width);
+#endif
+
+#ifndef ZSV_NO_QUOTE_PARITY
+#ifdef ZSV_HAVE_CLMUL
+#ifdef __PCLMUL__
+  return zsv_scan_count_clmul;
+#else
+  if (__builtin_cpu_supports("pclmul"))
+    return zsv_scan_count_clmul;
+#endif
+#endif
+  return zsv_scan_count;
+#else
+  return NULL;
+#endif
+}
+
 static enum zsv_status zsv_scan(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
   switch (scanner->mode) {
   case ZSV_MODE_FIXED:
     return zsv_scan_fixed(scanner, buff, bytes_read);
   case ZSV_MODE_DELIM_PULL:
+    if (scanner->tape) // rows are delivered by zsv_next_row()
+      return scanner->scan_delim(scanner, buff, bytes_read);
     // return zsv_status_row or zsv_status_ok (next call to parse_more)
     return zsv_scan_delim_pull(scanner, buff, bytes_read);
   default:
-    return zsv_scan_delim(scanner, buff, bytes_read);
+    if (scanner->tape) {
+      enum zsv_status stat = scanner->scan_delim(scanner, buff, bytes_read);
+      return stat ? stat : zsv_tape_deliver(scanner, 0);
+    }
+    return scanner->scan_delim(scanner, buff, bytes_read);
   }
 }
 
@@ -496,6 +954,10 @@ static enum zsv_status zsv_scan(struct zsv_scanner *scanner, unsigned char *buff
 // must be done in-place to *buff
 enum zsv_status zsv_set_scan_filter(struct zsv_scanner *scanner,
                                     size_t (*filter)(void *ctx, unsigned char *buff, size_t bytes_read), void *ctx) {
+  // a filter may shorten the data, which the mapped input cannot accommodate
+  enum zsv_status stat = zsv_mmap_release(scanner);
+  if (stat)
+    return stat;
   scanner->filter = filter;
   scanner->filter_ctx = ctx;
   return zsv_status_ok;
@@ -512,7 +974,9 @@ static void apply_callbacks(struct zsv_scanner *scanner) {
     }
     scanner->quoted = saved_quoted;
   }
-  // call the user-provided row() callback
+  // call the user-provided row() callback. This is called from an internal
+  // row handler, so the row has already been counted and timed (see zsv_stats.c)
+  zsv_row_arena_reset(scanner);
   if (VERY_LIKELY(scanner->opts.row_handler != NULL))
     scanner->opts.row_handler(scanner->opts.ctx);
 }
@@ -606,9 +1070,15 @@ static void set_callbacks(struct zsv_scanner *scanner) {
   } else {
     if (scanner->overwrite.have)
       scanner->get_cell = zsv_get_cell_with_overwrite;
+    else if (scanner->tape)
+      scanner->get_cell = zsv_get_cell_tape;
     else
       scanner->get_cell = zsv_get_cell_1;
     scanner->data_row_count = 0;
+    if (VERY_UNLIKELY(scanner->column_filter.pending != NULL)) { // see zsv_set_column_filter()
+      scanner->column_filter.bitmap = scanner->column_filter.pending;
+      scanner->column_filter.pending = NULL;
+    }
     scanner->opts.row_handler = scanner->opts_orig.row_handler;
     scanner->opts.cell_handler = scanner->opts_orig.cell_handler;
     scanner->opts.ctx = scanner->opts_orig.ctx;
@@ -622,7 +1092,9 @@ static void zsv_throwaway_row(void *ctx) {
       scanner->opts.overflow_row_handler(ctx);
   }
   scanner->buffer_exceeded = 0;
+  size_t data_row_count = scanner->data_row_count; // the rest of the row keeps its number
   set_callbacks(ctx);
+  scanner->data_row_count = data_row_count;
 }
 
 #ifdef ZSV_EXTRAS
@@ -721,17 +1193,95 @@ static struct zsv_cell zsv_get_cell_with_overwrite(zsv_parser parser, size_t col
 }
 #endif
 
+/**
+ * Validate and save a multi-byte delimiter and/or row terminator, if either is
+ * specified, or the delimiter if the multi-char kernel is otherwise required
+ * (see zsv_opts_scan_multi()). A single-byte delimiter_string is applied as
+ * opts->delimiter
+ * @return non-zero on error
+ */
+static int zsv_delims_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
+  size_t delim_len = opts->delimiter_string ? strlen(opts->delimiter_string) : 0;
+  size_t term_len = opts->row_terminator ? strlen(opts->row_terminator) : 0;
+  if (delim_len == 1)
+    opts->delimiter = *opts->delimiter_string;
+  if (!zsv_opts_scan_multi(opts))
+    return 0;
+
+  if (delim_len > ZSV_DELIMITER_MAX || term_len > ZSV_DELIMITER_MAX) {
+    fprintf(stderr, "Delimiter and row terminator may not exceed %i bytes\n", ZSV_DELIMITER_MAX);
+    return 1;
+  }
+  if (delim_len > 1)
+    memcpy(scanner->delims.delim, opts->delimiter_string, delim_len);
+  else {
+    scanner->delims.delim[0] = opts->delimiter ? opts->delimiter : ',';
+    delim_len = 1;
+  }
+  memcpy(scanner->delims.term, opts->row_terminator ? opts->row_terminator : "", term_len);
+
+  if (memchr(scanner->delims.delim, '"', delim_len) || memchr(scanner->delims.delim, '\n', delim_len) ||
+      memchr(scanner->delims.delim, '\r', delim_len)) {
+    fprintf(stderr, "Invalid delimiter\n");
+    return 1;
+  }
+  if (memchr(scanner->delims.term, '"', term_len) ||
+      (term_len && term_len <= delim_len && !memcmp(scanner->delims.term, scanner->delims.delim, term_len))) {
+    fprintf(stderr, "Invalid row terminator\n");
+    return 1;
+  }
+  scanner->delims.delim_len = (unsigned char)delim_len;
+  scanner->delims.term_len = (unsigned char)term_len;
+  opts->delimiter = (char)scanner->delims.delim[0];
+  return 0;
+}
+
+/**
+ * @return non-zero if c would be ambiguous as a quote or escape char
+ */
+static char zsv_char_is_structural(struct zsv_scanner *scanner, const struct zsv_opts *opts, char c) {
+  return c == '\n' || c == '\r' || c == opts->delimiter ||
+         memchr(scanner->delims.delim, c, scanner->delims.delim_len) ||
+         memchr(scanner->delims.term, c, scanner->delims.term_len);
+}
+
+/**
+ * Validate the quote and escape chars, and apply the default quote char
+ * @return non-zero on error
+ */
+static int zsv_quote_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
+  if (!opts->quote_char)
+    opts->quote_char = '"';
+  if (zsv_char_is_structural(scanner, opts, opts->quote_char)) {
+    fprintf(stderr, "Invalid quote char\n");
+    return 1;
+  }
+  if (opts->escape_char &&
+      (opts->escape_char == opts->quote_char || zsv_char_is_structural(scanner, opts, opts->escape_char))) {
+    fprintf(stderr, "Invalid escape char\n");
+    return 1;
+  }
+  // CSV output escapes dbl-quotes, so other escaping cannot be left as-is
+  if (opts->quote_char != '"' || opts->escape_char)
+    opts->lazy_unescape = 0;
+  return 0;
+}
+
 static int zsv_scanner_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
   size_t need_buff_size = 0;
   if (opts->malformed_utf8_replace == ZSV_MALFORMED_UTF8_DO_NOT_REPLACE)
     opts->malformed_utf8_replace = 0;
   if (opts->buffsize < opts->max_row_size * 2)
     need_buff_size = opts->max_row_size * 2;
+  if (zsv_delims_init(scanner, opts))
+    return 1;
   opts->delimiter = opts->delimiter ? opts->delimiter : ',';
   if (opts->delimiter == '\n' || opts->delimiter == '\r' || opts->delimiter == '"') {
     fprintf(stderr, "warning: ignoring illegal delimiter\n");
     opts->delimiter = ',';
   }
+  if (zsv_quote_init(scanner, opts))
+    return 1;
 
   if (opts->insert_header_row)
     scanner->insert_string = opts->insert_header_row;
@@ -765,7 +1315,7 @@ static int zsv_scanner_init(struct zsv_scanner *scanner, struct zsv_opts *opts)
   scanner->buff.buff = opts->buff;
   scanner->buff.size = opts->buffsize;
 
-  if (opts->buffsize && !opts->buff) {
+  if (opts->buffsize && !opts->buff && !zsv_mmap_init(scanner, opts)) {
     scanner->buff.buff = malloc(opts->buffsize);
     scanner->free_buff = 1;
   }
@@ -776,7 +1326,10 @@ static int zsv_scanner_init(struct zsv_scanner *scanner, struct zsv_opts *opts)
 #endif
   if (scanner->buff.buff) {
     scanner->opts = *opts;
-    scanner->opts_orig = *opts;
+    // the caller's strings need not outlive the parser
+    scanner->opts.delimiter_string = scanner->delims.delim_len > 1 ? (const char *)scanner->delims.delim : NULL;
+    scanner->opts.row_terminator = scanner->delims.term_len ? (const char *)scanner->delims.term : NULL;
+    scanner->opts_orig = scanner->opts;
     if (!scanner->opts.max_columns)
       scanner->opts.max_columns = 1024;
     set_callbacks(scanner);
@@ -786,7 +1339,12 @@ static int zsv_scanner_init(struct zsv_scanner *scanner, struct zsv_opts *opts)
       // initialize overwrites
       if (zsv_init_overwrites(scanner, &scanner->opts.overwrite) == zsv_status_ok)
 #endif
-        return 0;
+        if (!zsv_tape_init(scanner) && (!opts->stats || (scanner->stats = zsv_stats_new()))) {
+          zsv_read_ahead_init(scanner, opts);
+          scanner->scan_delim = zsv_scan_delim_select(&scanner->opts, scanner->tape != NULL);
+          set_callbacks(scanner); // use zsv_get_cell_tape() if applicable
+          return 0;
+        }
   }
   return 1;
 }
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Memory-mapped input (see zsv_opts.mmap)
+ *
+ * Instead of reading each chunk into an allocated buffer, and moving any
+ * partial row to the front of that buffer before the next read, buff.buff is
+ * a window into a private, writable mapping of the input file. Each
+ * zsv_parse_more() call moves the window forward to the start of the partial
+ * row (if any) and scans up to buff.size bytes, so cells point directly into
+ * the mapping. A cell that would be modified in place (e.g. to unescape
+ * embedded dbl-quotes) is first copied to a separate arena (see
+ * zsv_mmap_cell_copy()), so the mapping's pages stay shared with the page
+ * cache, and the file itself is never changed
+ *
+ * If the input cannot be mapped (e.g. it is a pipe), the buffered path is used.
+ * If the file is truncated while it is mapped, reading past its new end raises
+ * SIGBUS, which is not handled here (see zsv_opts.mmap)
+ */
+
+#if defined(_WIN32) && !defined(ZSV_NO_MMAP)
+#define ZSV_NO_MMAP
+#endif
+
+#ifndef ZSV_NO_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Map the input, if opts.mmap is set and the input is a regular file that is
+ * read with the default read function
+ * @return non-zero if the input was mapped
+ */
+static int zsv_mmap_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
+#ifndef ZSV_NO_MMAP
+  FILE *f = opts->stream;
+  if (!opts->mmap || opts->read || !f || opts->buff || opts->insert_header_row)
+    return 0;
+
+  struct stat st;
+  int fd = fileno(f);
+  off_t pos = ftello(f);
+  if (fd < 0 || pos < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= pos)
+    return 0;
+
+  size_t size = (size_t)st.st_size;
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return 0;
+  madvise(data, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(data, size, MADV_HUGEPAGE);
+#endif
+  scanner->mapped.data = data;
+  scanner->mapped.size = size;
+  scanner->buff.buff = (unsigned char *)data + pos;
+  return 1;
+#else
+  (void)(scanner);
+  (void)(opts);
+  return 0;
+#endif
+}
+
+/**
+ * Number of bytes available to scan after the partial row, if any, without
+ * exceeding the window size
+ */
+static inline size_t zsv_mmap_read(struct zsv_scanner *scanner, size_t capacity) {
+  const unsigned char *start = scanner->buff.buff + scanner->partial_row_length;
+  size_t remaining = (size_t)(scanner->mapped.data + scanner->mapped.size - start);
+  return remaining < capacity ? remaining : capacity;
+}
+
+/**
+ * Copy a cell that is about to be modified in place (e.g. to unescape embedded
+ * dbl-quotes) to the arena, so that the mapping is not copied-on-write
+ *
+ * The arena is a ring of twice the window size. Because a row never spans more
+ * than one window, all of the current row's copies remain intact when the ring
+ * wraps around
+ */
+static unsigned char *zsv_mmap_cell_copy(struct zsv_scanner *scanner, unsigned char *s, size_t n) {
+  size_t arena_size = scanner->buff.size * 2;
+  if (!scanner->mapped.arena && !(scanner->mapped.arena = malloc(arena_size)))
+    return s; // modify the mapping instead
+  if (scanner->mapped.arena_used + n > arena_size)
+    scanner->mapped.arena_used = 0;
+  unsigned char *copy = scanner->mapped.arena + scanner->mapped.arena_used;
+  memcpy(copy, s, n);
+  scanner->mapped.arena_used += n;
+  return copy;
+}
+
+static void zsv_mmap_unmap(struct zsv_scanner *scanner) {
+#ifndef ZSV_NO_MMAP
+  if (scanner->mapped.data)
+    munmap(scanner->mapped.data, scanner->mapped.size);
+#endif
+  scanner->mapped.data = NULL;
+  scanner->mapped.size = 0;
+}
+
+/**
+ * Switch from memory-mapped input to the buffered path, e.g. because the read
+ * function, input stream or scan filter was changed. Any unprocessed data in
+ * the current window is copied into a newly allocated buffer, and the input
+ * stream is positioned at the end of the window
+ * @return zsv_status_ok on success
+ */
+static enum zsv_status zsv_mmap_release(struct zsv_scanner *scanner) {
+  if (!scanner->mapped.data)
+    return zsv_status_ok;
+
+  unsigned char *old = scanner->buff.buff;
+  unsigned char *buff = malloc(scanner->buff.size);
+  if (!buff) {
+    fprintf(stderr, "Out of memory!\n");
+    return zsv_status_memory;
+  }
+  size_t len = scanner->old_bytes_read ? scanner->old_bytes_read : scanner->partial_row_length;
+  if (scanner->pull.resume) // the pull scan returned a row, and has yet to scan the rest of the window
+    len = scanner->pull.bytes_read;
+  memcpy(buff, old, len);
+  for (size_t i = 0; i < scanner->row.used; i++)
+    if (scanner->row.cells[i].str >= old && scanner->row.cells[i].str <= old + len)
+      scanner->row.cells[i].str = buff + (scanner->row.cells[i].str - old);
+  if (scanner->pull.buff == old)
+    scanner->pull.buff = buff;
+#ifndef ZSV_NO_MMAP
+  if (scanner->in)
+    fseeko(scanner->in, (off_t)(old + len - scanner->mapped.data), SEEK_SET);
+#endif
+
+  zsv_mmap_unmap(scanner);
+  scanner->buff.buff = buff;
+  scanner->free_buff = 1;
+  return zsv_status_ok;
+}
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Parallel parsing of a seekable file. Included by zsv.c
+ *
+ * Approach:
+ * 1. parse the header row (if requested) on the calling thread, to find where data begins
+ * 2. split the remaining data into raw byte ranges, and count the dbl-quotes in each range
+ *    (in parallel). The running parity of those counts tells us whether each raw split
+ *    point falls inside a quoted cell
+ * 3. move each split point forward to the next row end that is outside of quotes
+ * 4. parse each resulting chunk with its own parser (in parallel), and deliver chunk
+ *    results to the caller via chunk_end(), either in order or as completed
+ *
+ * The quote-parity approach assumes that every dbl-quote toggles quoted state. If that
+ * does not hold (e.g. a dbl-quote in the middle of an unquoted cell), a chunk may end
+ * inside a quoted cell, which is detected when that chunk is parsed. In ordered mode,
+ * we then discard the remaining chunks and parse the rest of the file serially
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef NO_THREADING
+#include <pthread.h>
+#endif
+
+#define ZSV_PARALLEL_MIN_CHUNK_SIZE (1 << 20)
+#define ZSV_PARALLEL_CHUNKS_PER_THREAD 4
+#define ZSV_PARALLEL_READ_SIZE 65536
+
+struct zsv_parallel_chunk {
+  size_t start; // file offset at which this chunk starts
+  size_t end;   // file offset at which this chunk ends (exclusive)
+  unsigned char quote_parity : 1;
+  unsigned char unclosed : 1; // 1 = parsing ended inside a quoted cell
+  unsigned char _ : 6;
+};
+
+struct zsv_parallel {
+  const char *path;
+  struct zsv_opts *opts;
+  struct zsv_parallel_opts *popts;
+  size_t data_start;
+  size_t file_size;
+  size_t buffsize; // buffer size of the header parser
+
+  struct zsv_parallel_chunk *chunks;
+  size_t chunk_count;
+
+  unsigned threads;
+  void (*task)(struct zsv_parallel *p, size_t ix);
+  size_t task_count;
+  size_t next_task;
+
+  size_t next_end;    // next chunk ix whose chunk_end() may be called (ordered mode)
+  size_t fallback_ix; // first chunk that ended inside a quoted cell, or chunk_count
+  enum zsv_status stat;
+  char stop;
+  char have_header;
+
+#ifndef NO_THREADING
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+#endif
+};
+
+#ifndef NO_THREADING
+#define zsv_parallel_lock(p) pthread_mutex_lock(&(p)->mutex)
+#define zsv_parallel_unlock(p) pthread_mutex_unlock(&(p)->mutex)
+#define zsv_parallel_wait(p) pthread_cond_wait(&(p)->cond, &(p)->mutex)
+#define zsv_parallel_broadcast(p) pthread_cond_broadcast(&(p)->cond)
+#else
+#define zsv_parallel_lock(p) (void)(p)
+#define zsv_parallel_unlock(p) (void)(p)
+#define zsv_parallel_wait(p) (void)(p)
+#define zsv_parallel_broadcast(p) (void)(p)
+#endif
+
+static unsigned zsv_parallel_default_threads(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    return (unsigned)n;
+#endif
+  return 1;
+}
+
+static char zsv_parallel_stopped(struct zsv_parallel *p) {
+  zsv_parallel_lock(p);
+  char stop = p->stop;
+  zsv_parallel_unlock(p);
+  return stop;
+}
+
+/**
+ * Open the input and position it at the given offset
+ */
+static FILE *zsv_parallel_open(struct zsv_parallel *p, size_t offset) {
+  FILE *f = fopen(p->path, "rb");
+  if (f && offset && fseeko(f, (off_t)offset, SEEK_SET)) {
+    fclose(f);
+    f = NULL;
+  }
+  return f;
+}
+
+struct zsv_parallel_range_reader {
+  FILE *f;
+  size_t remaining;
+};
+
+static size_t zsv_parallel_range_read(void *restrict buff, size_t n, size_t size, void *restrict ctx) {
+  struct zsv_parallel_range_reader *r = ctx;
+  size_t want = n * size;
+  if (want > r->remaining)
+    want = r->remaining;
+  size_t got = want ? fread(buff, 1, want, r->f) : 0;
+  r->remaining -= got;
+  return got;
+}
+
+static void *zsv_parallel_worker(void *ctx) {
+  struct zsv_parallel *p = ctx;
+  while (1) {
+    zsv_parallel_lock(p);
+    size_t ix = p->stop ? p->task_count : p->next_task++;
+    zsv_parallel_unlock(p);
+    if (ix >= p->task_count)
+      break;
+    p->task(p, ix);
+  }
+  return NULL;
+}
+
+/**
+ * Run task(p, 0) ... task(p, task_count - 1) on up to p->threads threads (including
+ * the calling thread). Tasks are claimed in ascending order
+ */
+static void zsv_parallel_run(struct zsv_parallel *p, size_t task_count,
+                             void (*task)(struct zsv_parallel *p, size_t ix)) {
+  p->task = task;
+  p->task_count = task_count;
+  p->next_task = 0;
+#ifndef NO_THREADING
+  size_t thread_count = p->threads < task_count ? p->threads : task_count;
+  pthread_t *tids = thread_count > 1 ? calloc(thread_count - 1, sizeof(*tids)) : NULL;
+  size_t started = 0;
+  if (tids) {
+    for (; started < thread_count - 1; started++)
+      if (pthread_create(&tids[started], NULL, zsv_parallel_worker, p))
+        break;
+  }
+  zsv_parallel_worker(p);
+  for (size_t i = 0; i < started; i++)
+    pthread_join(tids[i], NULL);
+  free(tids);
+#else
+  zsv_parallel_worker(p);
+#endif
+}
+
+/**
+ * Count (the parity of) the quote chars in the raw range of chunk ix
+ */
+static void zsv_parallel_count_quotes(struct zsv_parallel *p, size_t ix) {
+  struct zsv_parallel_chunk *c = &p->chunks[ix];
+  FILE *f = zsv_parallel_open(p, c->start);
+  if (!f) {
+    zsv_parallel_lock(p);
+    p->stat = zsv_status_error;
+    p->stop = 1;
+    zsv_parallel_unlock(p);
+    return;
+  }
+  unsigned char *buff = malloc(ZSV_PARALLEL_READ_SIZE);
+  unsigned char quote = p->opts->quote_char ? (unsigned char)p->opts->quote_char : '"';
+  size_t quotes = 0;
+  if (buff) {
+    size_t remaining = c->end - c->start;
+    size_t n;
+    while (remaining &&
+           (n = fread(buff, 1, remaining < ZSV_PARALLEL_READ_SIZE ? remaining : ZSV_PARALLEL_READ_SIZE, f)) > 0) {
+      for (size_t i = 0; i < n; i++)
+        quotes += buff[i] == quote;
+      remaining -= n;
+    }
+    free(buff);
+  }
+  c->quote_parity = quotes & 1;
+  fclose(f);
+}
+
+/**
+ * Starting at offset, find the first row end that is not inside a quoted cell
+ * and return the offset immediately after it (or the file size, if none)
+ */
+static size_t zsv_parallel_next_row_start(struct zsv_parallel *p, size_t offset, char in_quote) {
+  FILE *f = zsv_parallel_open(p, offset);
+  if (!f)
+    return p->file_size;
+  char quotes = !p->opts->no_quotes;
+  int quote = p->opts->quote_char ? (unsigned char)p->opts->quote_char : '"';
+  size_t result = p->file_size;
+  int c;
+  while ((c = getc(f)) != EOF) {
+    offset++;
+    if (c == quote && quotes)
+      in_quote = !in_quote;
+    else if (!in_quote && (c == '\n' || c == '\r')) {
+      if (c == '\r' && getc(f) == '\n')
+        offset++;
+      result = offset;
+      break;
+    }
+  }
+  fclose(f);
+  return result < p->file_size ? result : p->file_size;
+}
+
+/**
+ * Deliver the results of a parsed chunk to the caller
+ */
+static void zsv_parallel_chunk_done(struct zsv_parallel *p, size_t ix, void *chunk_ctx, enum zsv_status stat) {
+  struct zsv_parallel_chunk *c = &p->chunks[ix];
+  zsv_parallel_lock(p);
+  if (!p->popts->unordered) {
+    while (p->next_end != ix)
+      zsv_parallel_wait(p);
+  }
+
+  if (p->fallback_ix < ix || p->stop)
+    stat = zsv_status_cancelled; // this chunk's results are no longer wanted
+  else if (c->unclosed) {
+    if (p->popts->unordered) {
+      fprintf(stderr, "Parallel parse error: chunk %zu ended inside a quoted cell\n", ix);
+      stat = p->stat = zsv_status_error;
+    } else {
+      // discard this and all subsequent chunks, and parse the rest serially
+      stat = zsv_status_cancelled;
+      p->fallback_ix = ix;
+    }
+    p->stop = 1;
+  } else if (stat != zsv_status_ok) {
+    p->stat = stat;
+    p->stop = 1;
+  }
+
+  if (p->popts->chunk_end) {
+    enum zsv_status end_stat = p->popts->chunk_end(p->popts->ctx, chunk_ctx, ix, stat);
+    if (end_stat != zsv_status_ok && stat == zsv_status_ok) {
+      p->stat = end_stat;
+      p->stop = 1;
+    }
+  }
+  p->next_end++;
+  zsv_parallel_broadcast(p);
+  zsv_parallel_unlock(p);
+}
+
+/**
+ * Parse a single chunk
+ */
+static void zsv_parallel_parse_chunk(struct zsv_parallel *p, size_t ix) {
+  struct zsv_parallel_chunk *c = &p->chunks[ix];
+  struct zsv_parallel_range_reader reader = {0};
+  struct zsv_opts opts = *p->opts;
+  enum zsv_status stat = zsv_status_error;
+  void *chunk_ctx = NULL;
+  zsv_parser parser = NULL;
+
+  opts.read = zsv_parallel_range_read;
+  opts.stream = &reader;
+  opts.buff = NULL;
+  opts.read_ahead.queue_depth = 0;
+  opts.stats = 0;
+  opts.ctx = NULL;
+  if (p->have_header || c->start > 0) {
+    // options that apply to the start of the input have already been applied
+    opts.rows_to_ignore = 0;
+    opts.header_span = 0;
+    opts.insert_header_row = NULL;
+    opts.keep_empty_header_rows = 1;
+  }
+#ifdef ZSV_EXTRAS
+  memset(&opts.progress, 0, sizeof(opts.progress));
+  memset(&opts.completed, 0, sizeof(opts.completed));
+  memset(&opts.overwrite, 0, sizeof(opts.overwrite));
+  opts.max_rows = 0;
+#endif
+
+  if ((reader.f = zsv_parallel_open(p, c->start)) && (parser = zsv_new(&opts))) {
+    reader.remaining = c->end - c->start;
+    if (c->start > 0)
+      parser->checked_bom = 1;
+    if (p->popts->chunk_start)
+      chunk_ctx = p->popts->chunk_start(p->popts->ctx, parser, ix);
+    zsv_set_context(parser, chunk_ctx);
+    while (!zsv_parallel_stopped(p) && (stat = zsv_parse_more(parser)) == zsv_status_ok)
+      ;
+    if (stat == zsv_status_no_more_input) {
+      if ((parser->quoted & ZSV_PARSER_QUOTE_UNCLOSED) && ix + 1 < p->chunk_count)
+        c->unclosed = 1;
+      stat = zsv_finish(parser);
+    } else if (stat == zsv_status_ok)
+      stat = zsv_status_cancelled;
+  } else if (reader.f)
+    stat = zsv_status_memory;
+
+  zsv_parallel_chunk_done(p, ix, chunk_ctx, stat);
+  zsv_delete(parser);
+  if (reader.f)
+    fclose(reader.f);
+}
+
+/**
+ * Parse the header row on the calling thread, and set p->data_start to the
+ * offset of the first data row
+ */
+static enum zsv_status zsv_parallel_parse_header(struct zsv_parallel *p, FILE *f) {
+  struct zsv_opts opts = *p->opts;
+  opts.row_handler = NULL;
+  opts.cell_handler = NULL;
+  opts.ctx = NULL;
+  opts.read = NULL;
+  opts.buff = NULL;
+  opts.stream = f;
+  opts.stats = 0;
+#ifdef ZSV_EXTRAS
+  memset(&opts.progress, 0, sizeof(opts.progress));
+  memset(&opts.completed, 0, sizeof(opts.completed));
+  memset(&opts.overwrite, 0, sizeof(opts.overwrite));
+  opts.max_rows = 0;
+#endif
+  zsv_parser parser = zsv_new(&opts);
+  if (!parser)
+    return zsv_status_memory;
+
+  parser->quiet_truncate = 1; // a truncated header row is parsed again serially (see below)
+  enum zsv_status stat = zsv_next_row(parser);
+  p->data_start = p->file_size;
+  p->buffsize = parser->buff.size;
+  if (stat == zsv_status_row && parser->truncated)
+    stat = zsv_status_invalid_option; // the header row was truncated, so where it ends is not known
+  else if (stat == zsv_status_row) {
+    stat = zsv_status_ok;
+    if (p->popts->header(p->popts->ctx, parser))
+      stat = zsv_status_cancelled;
+    else if (p->opts->insert_header_row)
+      p->data_start = 0;
+    else if (!parser->finished) {
+      // the header row ended with the char at zsv_cum_scanned_length()
+      size_t row_end = zsv_cum_scanned_length(parser);
+      p->data_start = row_end + 1;
+      if (parser->buff.buff[parser->scanned_length] == '\r' && !fseeko(f, (off_t)p->data_start, SEEK_SET) &&
+          getc(f) == '\n')
+        p->data_start++;
+    }
+  } else if (stat == zsv_status_done)
+    stat = zsv_status_ok;
+  zsv_delete(parser);
+  return stat;
+}
+
+/**
+ * Split [data_start, file_size) into chunks that each start at a row boundary
+ */
+static enum zsv_status zsv_parallel_split(struct zsv_parallel *p) {
+  size_t data_size = p->file_size - p->data_start;
+  size_t chunk_size = p->popts->chunk_size;
+  if (!chunk_size) {
+    chunk_size = data_size / ((size_t)p->threads * ZSV_PARALLEL_CHUNKS_PER_THREAD);
+    if (chunk_size < ZSV_PARALLEL_MIN_CHUNK_SIZE)
+      chunk_size = ZSV_PARALLEL_MIN_CHUNK_SIZE;
+  }
+  size_t raw_count = data_size / chunk_size + (data_size % chunk_size ? 1 : 0);
+  if (!raw_count)
+    return zsv_status_ok;
+  if (!(p->chunks = calloc(raw_count, sizeof(*p->chunks))))
+    return zsv_status_memory;
+  for (size_t i = 0; i < raw_count; i++) {
+    p->chunks[i].start = p->data_start + i * chunk_size;
+    p->chunks[i].end = i + 1 < raw_count ? p->chunks[i].start + chunk_size : p->file_size;
+  }
+
+  if (raw_count > 1 && !p->opts->no_quotes)
+    zsv_parallel_run(p, raw_count, zsv_parallel_count_quotes);
+  if (p->stat != zsv_status_ok)
+    return p->stat;
+
+  // move each raw split point to the next row start, and drop any resulting empty chunks
+  char in_quote = 0;
+  size_t count = 1;
+  for (size_t i = 1; i < raw_count; i++) {
+    in_quote ^= p->chunks[i - 1].quote_parity;
+    size_t start = zsv_parallel_next_row_start(p, p->chunks[i].start, in_quote);
+    if (start > p->chunks[count - 1].start && start < p->file_size)
+      p->chunks[count++].start = start;
+  }
+  for (size_t i = 0; i < count; i++) {
+    p->chunks[i].end = i + 1 < count ? p->chunks[i + 1].start : p->file_size;
+    p->chunks[i].quote_parity = 0;
+    p->chunks[i].unclosed = 0;
+  }
+  p->chunk_count = count;
+  return zsv_status_ok;
+}
+
+ZSV_EXPORT
+enum zsv_status zsv_parse_parallel(const char *path, struct zsv_opts *opts, struct zsv_parallel_opts *popts) {
+  struct stat st;
+  FILE *f;
+  if (zsv_opts_scan_multi(opts)) // chunk boundaries are found by scanning for \n, \r and quotes
+    return zsv_status_invalid_option;
+  if (!path || !(f = fopen(path, "rb")))
+    return zsv_status_error;
+  if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode)) {
+    fclose(f);
+    return zsv_status_invalid_option;
+  }
+
+  struct zsv_parallel p = {0};
+  p.path = path;
+  p.opts = opts;
+  p.popts = popts;
+  p.file_size = (size_t)st.st_size;
+  p.threads = popts->threads ? popts->threads : zsv_parallel_default_threads();
+#ifndef NO_THREADING
+  pthread_mutex_init(&p.mutex, NULL);
+  pthread_cond_init(&p.cond, NULL);
+#endif
+
+  if (popts->header) {
+    p.have_header = 1;
+    p.stat = zsv_parallel_parse_header(&p, f);
+  }
+  fclose(f);
+
+  if (p.stat == zsv_status_ok && p.data_start < p.file_size)
+    p.stat = zsv_parallel_split(&p);
+
+  if (p.stat == zsv_status_ok && p.chunk_count) {
+    p.fallback_ix = p.chunk_count;
+    zsv_parallel_run(&p, p.chunk_count, zsv_parallel_parse_chunk);
+
+    if (p.fallback_ix < p.chunk_count && p.stat == zsv_status_ok) {
+      // quote parity did not hold; parse everything from the mismatched chunk serially
+      size_t ix = p.fallback_ix;
+      if (opts->verbose)
+        fprintf(stderr, "Chunk %zu ended inside a quoted cell; parsing remaining data serially\n", ix);
+      p.chunks[ix].end = p.file_size;
+      p.chunks[ix].unclosed = 0;
+      p.chunk_count = ix + 1;
+      p.fallback_ix = p.chunk_count;
+      p.next_end = ix;
+      p.stop = 0;
+      zsv_parallel_parse_chunk(&p, ix);
+    }
+  }
+
+  free(p.chunks);
+#ifndef NO_THREADING
+  pthread_cond_destroy(&p.cond);
+  pthread_mutex_destroy(&p.mutex);
+#endif
+  return p.stat;
+}
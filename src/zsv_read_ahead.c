@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Read-ahead (see zsv_opts.read_ahead)
+ *
+ * A background thread calls the underlying read function to fill a ring of
+ * queue_depth blocks, while the parser scans the data that was read before.
+ * The parser's read function is replaced with zsv_read_ahead_read(), which
+ * hands over the filled blocks in order, so the parser only waits ("stalls")
+ * when the ring is empty. Each block is released back to the reader thread as
+ * soon as it has been consumed
+ *
+ * A zero-length block marks the end of the input
+ */
+
+#ifndef NO_THREADING
+#include <pthread.h>
+#include <time.h>
+
+struct zsv_read_ahead_block {
+  unsigned char *data;
+  size_t len;
+};
+
+struct zsv_read_ahead {
+  zsv_generic_read read; // underlying read function and stream
+  void *in;
+
+  struct zsv_read_ahead_block *blocks;
+  unsigned depth;
+  size_t block_size;
+
+  unsigned head;  // next block to consume
+  unsigned count; // number of filled blocks, including the head block
+  size_t offset;  // number of bytes of the head block that have been consumed
+
+  size_t stall_count;
+  uint64_t stall_ns;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  unsigned char running : 1; // the reader thread has been started and not yet joined
+  unsigned char eof : 1;     // the reader thread has queued the end-of-input block
+  unsigned char stop : 1;
+  unsigned char _ : 5;
+};
+
+static uint64_t zsv_read_ahead_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void *zsv_read_ahead_thread(void *ctx) {
+  struct zsv_read_ahead *ra = ctx;
+  pthread_mutex_lock(&ra->mutex);
+  while (!ra->stop && !ra->eof) {
+    if (ra->count == ra->depth) {
+      pthread_cond_wait(&ra->cond, &ra->mutex);
+      continue;
+    }
+    struct zsv_read_ahead_block *b = &ra->blocks[(ra->head + ra->count) % ra->depth];
+    pthread_mutex_unlock(&ra->mutex);
+
+    size_t len = ra->read(b->data, 1, ra->block_size, ra->in);
+
+    pthread_mutex_lock(&ra->mutex);
+    b->len = len;
+    ra->count++;
+    if (!len)
+      ra->eof = 1;
+    pthread_cond_broadcast(&ra->cond);
+  }
+  pthread_mutex_unlock(&ra->mutex);
+  return NULL;
+}
+
+static int zsv_read_ahead_start(struct zsv_read_ahead *ra) {
+  ra->stop = 0;
+  ra->eof = 0;
+  if (pthread_create(&ra->thread, NULL, zsv_read_ahead_thread, ra))
+    return 1;
+  ra->running = 1;
+  return 0;
+}
+
+/**
+ * Stop the reader thread, after its current read (if any) completes. Any
+ * blocks that were already filled remain queued
+ */
+static void zsv_read_ahead_join(struct zsv_read_ahead *ra) {
+  if (ra->running) {
+    pthread_mutex_lock(&ra->mutex);
+    ra->stop = 1;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+    pthread_join(ra->thread, NULL);
+    ra->running = 0;
+  }
+}
+
+/**
+ * zsv_generic_read-compatible function that copies data from the filled blocks.
+ * Waits only if no data at all is available
+ */
+static size_t zsv_read_ahead_read(void *restrict buff, size_t n, size_t size, void *restrict ctx) {
+  struct zsv_read_ahead *ra = ctx;
+  size_t want = n * size;
+  size_t got = 0;
+  pthread_mutex_lock(&ra->mutex);
+  while (got < want) {
+    if (!ra->count) {
+      if (got)
+        break;
+      if (!ra->running) { // the reader thread could not be restarted
+        pthread_mutex_unlock(&ra->mutex);
+        return ra->read(buff, n, size, ra->in);
+      }
+      uint64_t start = zsv_read_ahead_now_ns();
+      while (!ra->count)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+      ra->stall_ns += zsv_read_ahead_now_ns() - start;
+      ra->stall_count++;
+    }
+    struct zsv_read_ahead_block *b = &ra->blocks[ra->head];
+    if (!b->len) // end of input
+      break;
+    pthread_mutex_unlock(&ra->mutex);
+
+    size_t len = b->len - ra->offset;
+    if (len > want - got)
+      len = want - got;
+    memcpy((unsigned char *)buff + got, b->data + ra->offset, len);
+    got += len;
+    ra->offset += len;
+
+    pthread_mutex_lock(&ra->mutex);
+    if (ra->offset == b->len) { // release this block to the reader thread
+      ra->offset = 0;
+      ra->head = (ra->head + 1) % ra->depth;
+      ra->count--;
+      pthread_cond_broadcast(&ra->cond);
+    }
+  }
+  pthread_mutex_unlock(&ra->mutex);
+  return got;
+}
+
+static void zsv_read_ahead_delete(struct zsv_read_ahead **rap) {
+  struct zsv_read_ahead *ra = *rap;
+  if (ra) {
+    zsv_read_ahead_join(ra);
+    pthread_mutex_destroy(&ra->mutex);
+    pthread_cond_destroy(&ra->cond);
+    if (ra->blocks)
+      for (unsigned i = 0; i < ra->depth; i++)
+        free(ra->blocks[i].data);
+    free(ra->blocks);
+    free(ra);
+    *rap = NULL;
+  }
+}
+
+/**
+ * Start reading ahead, if opts.read_ahead.queue_depth is set. The scanner's read
+ * function and input must already be set. If read-ahead cannot be set up, the
+ * input is read directly
+ */
+static void zsv_read_ahead_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
+  if (!opts->read_ahead.queue_depth || scanner->mapped.data)
+    return;
+
+  struct zsv_read_ahead *ra = calloc(1, sizeof(*ra));
+  if (!ra) {
+    if (opts->verbose)
+      fprintf(stderr, "Unable to start read-ahead\n");
+    return;
+  }
+  ra->read = scanner->read;
+  ra->in = scanner->in;
+  ra->depth = opts->read_ahead.queue_depth;
+  ra->block_size = opts->read_ahead.buffsize ? opts->read_ahead.buffsize : opts->buffsize;
+  pthread_mutex_init(&ra->mutex, NULL);
+  pthread_cond_init(&ra->cond, NULL);
+  scanner->read_ahead = ra;
+
+  char ok = (ra->blocks = calloc(ra->depth, sizeof(*ra->blocks))) != NULL;
+  for (unsigned i = 0; ok && i < ra->depth; i++)
+    ok = (ra->blocks[i].data = malloc(ra->block_size)) != NULL;
+  if (!ok || zsv_read_ahead_start(ra)) {
+    if (opts->verbose)
+      fprintf(stderr, "Unable to start read-ahead\n");
+    zsv_read_ahead_delete(&scanner->read_ahead);
+    return;
+  }
+  scanner->read = zsv_read_ahead_read;
+  scanner->in = ra;
+}
+
+/**
+ * Change the underlying read function and/or input stream. Data that was
+ * already read from the prior input is still delivered first
+ */
+static void zsv_read_ahead_set_source(struct zsv_scanner *scanner, zsv_generic_read read, void *in) {
+  struct zsv_read_ahead *ra = scanner->read_ahead;
+  zsv_read_ahead_join(ra);
+  if (ra->eof) { // remove the end-of-input block
+    ra->count--;
+    ra->eof = 0;
+  }
+  if (read)
+    ra->read = read;
+  if (in)
+    ra->in = in;
+  if (zsv_read_ahead_start(ra) && scanner->opts.verbose) // read directly, after any remaining blocks
+    fprintf(stderr, "Unable to restart read-ahead\n");
+}
+
+#else
+
+struct zsv_read_ahead {
+  size_t stall_count;
+  uint64_t stall_ns;
+};
+
+static void zsv_read_ahead_init(struct zsv_scanner *scanner, struct zsv_opts *opts) {
+  (void)(scanner);
+  (void)(opts);
+}
+
+static void zsv_read_ahead_delete(struct zsv_read_ahead **rap) {
+  (void)(rap);
+}
+
+static void zsv_read_ahead_set_source(struct zsv_scanner *scanner, zsv_generic_read read, void *in) {
+  (void)(scanner);
+  (void)(read);
+  (void)(in);
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Row-count kernel (see zsv_count_rows())
+ *
+ * Each 64-byte block of a byte range of memory-mapped input is classified as
+ * in the quote-parity kernel (see zsv_scan_delim_qp.c), but only the row ends
+ * outside of quotes are counted, and no cells are processed.
+ *
+ * Because a range may start anywhere in the input, its starting quote state is
+ * not known until all of the prior ranges have been scanned. Every position
+ * that is outside quotes in one starting state is inside quotes in the other,
+ * so the prefix-XOR is only computed once (for a start outside quotes) and its
+ * complement is used for the other state. The row ends, and whether each quote
+ * opens or closes a cell, are then checked for both states
+ *
+ * This file is included once for each prefix-XOR implementation, with:
+ * - ZSV_SCAN_COUNT: name of the kernel function
+ * - ZSV_PREFIX_XOR: name of the prefix-XOR function to use
+ * - ZSV_SCAN_TARGET: function attributes (e.g. target("pclmul")) or empty
+ */
+
+#define ZSV_COUNT_BLOCK 64
+
+ZSV_SCAN_TARGET
+static void ZSV_SCAN_COUNT(const unsigned char *data, size_t data_size, struct zsv_count_range *r,
+                           unsigned char delimiter, unsigned char quote, char no_quotes) {
+  struct {
+    zsv_uc_vector dl;
+    zsv_uc_vector nl;
+    zsv_uc_vector cr;
+    zsv_uc_vector qt;
+  } v;
+  memset(&v.dl, delimiter, sizeof(zsv_uc_vector));
+  memset(&v.nl, '\n', sizeof(zsv_uc_vector));
+  memset(&v.cr, '\r', sizeof(zsv_uc_vector));
+  memset(&v.qt, quote, sizeof(zsv_uc_vector));
+  const uint64_t quote_mask = no_quotes ? 0 : ~(uint64_t)0;
+
+  uint64_t in_quote = 0;        // all ones if the prior block ended inside quotes (for state 0)
+  uint64_t prev_ok[2] = {1, 0}; // 1 if a quote at the start of this block may open a cell
+  uint64_t prev_cr = 0;         // 1 if the prior block ended with \r
+  if (!r->at_row_start) {
+    unsigned char c = data[r->start - 1];
+    prev_ok[0] = c == quote || c == delimiter || c == '\n' || c == '\r';
+    prev_cr = c == '\r';
+  }
+
+  unsigned char tail[ZSV_COUNT_BLOCK];
+  for (size_t i = r->start; i < r->end; i += ZSV_COUNT_BLOCK) {
+    const unsigned char *block = data + i;
+    size_t n = r->end - i;
+    if (n < ZSV_COUNT_BLOCK) { // final partial block: pad with zeros
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, block, n);
+      block = tail;
+    } else
+      n = ZSV_COUNT_BLOCK;
+
+    uint64_t q = 0, s = 0, nl = 0, cr = 0;
+    for (unsigned k = 0; k < ZSV_COUNT_BLOCK / VECTOR_BYTES; k++) {
+      zsv_uc_vector str_simd;
+      memcpy(&str_simd, block + k * VECTOR_BYTES, sizeof(str_simd));
+      zsv_uc_vector vtmp = str_simd == v.nl;
+      nl |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+      vtmp = str_simd == v.cr;
+      cr |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+      vtmp = str_simd == v.dl;
+      s |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+      vtmp = str_simd == v.qt;
+      q |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+    }
+    q &= quote_mask;
+    s |= nl | cr;
+
+    uint64_t px = ZSV_PREFIX_XOR(q) ^ in_quote;
+    uint64_t row_ends = cr | (nl & ~(cr << 1 | prev_cr)); // \r\n is a single row end
+    size_t next_pos = i + n;
+    unsigned char next = next_pos < data_size ? data[next_pos] : '\n'; // end of input closes a cell
+    uint64_t next_ok = next == quote || next == delimiter || next == '\n' || next == '\r';
+    uint64_t may_close = (s | q) >> 1 | next_ok << (n - 1);
+
+    for (unsigned st = 0; st < 2; st++) {
+      uint64_t inside = st ? ~px : px;
+      uint64_t structural = s & ~inside;
+      uint64_t closes = q & ~inside;
+      uint64_t may_open = (structural | closes) << 1 | prev_ok[st];
+      if (VERY_UNLIKELY(((q & inside) & ~may_open) | (closes & ~may_close)))
+        r->invalid[st] = 1;
+      prev_ok[st] = (structural | closes) >> 63;
+
+      uint64_t ends = row_ends & ~inside;
+      if (ends) {
+        size_t first = i + (size_t)__builtin_ctzll(ends);
+        if (r->rows[st]) {
+          if (first - r->last_end[st] > r->max_gap[st])
+            r->max_gap[st] = first - r->last_end[st];
+        } else
+          r->first_end[st] = first;
+        r->last_end[st] = i + 63 - (size_t)__builtin_clzll(ends);
+        r->rows[st] += (size_t)__builtin_popcountll(ends);
+      }
+    }
+    in_quote = (uint64_t)0 - (px >> 63);
+    prev_cr = cr >> 63;
+  }
+  r->quote_parity = in_quote & 1;
+}
+
+#undef ZSV_COUNT_BLOCK
@@ -1,45 +1,20 @@
 #ifdef ZSV_SUPPORT_PULL_PARSER
-
-#define zsv_internal_save_reg(x) scanner->pull.regs->delim.x = x
-#define zsv_internal_save_regs(loc)                                                                                    \
-  do {                                                                                                                 \
-    scanner->pull.regs->delim.location = loc;                                                                          \
-    scanner->pull.buff = buff;                                                                                         \
-    scanner->pull.bytes_read = bytes_read;                                                                             \
-    zsv_internal_save_reg(i);                                                                                          \
-    zsv_internal_save_reg(bytes_chunk_end);                                                                            \
-    zsv_internal_save_reg(bytes_read);                                                                                 \
-    zsv_internal_save_reg(delimiter);                                                                                  \
-    zsv_internal_save_reg(c);                                                                                          \
-    zsv_internal_save_reg(skip_next_delim);                                                                            \
-    zsv_internal_save_reg(quote);                                                                                      \
-    zsv_internal_save_reg(mask_total_offset);                                                                          \
-    zsv_internal_save_reg(mask);                                                                                       \
-    zsv_internal_save_reg(mask_last_start);                                                                            \
-  } while (0)
-
-#define zsv_internal_restore_reg(x) x = scanner->pull.regs->delim.x
-#define zsv_internal_restore_regs()                                                                                    \
+/**
+ * The pull parser's kernel returns each row as soon as it has been scanned.
+ * The buffer that is being scanned is saved once per buffer (in pull.buff and
+ * pull.bytes_read) and, for each row, only the position of the scan is saved
+ * (see struct zsv_pull_cursor). The next call then picks up from there
+ */
+#define zsv_pull_suspend()                                                                                             \
   do {                                                                                                                 \
-    buff = scanner->pull.buff;                                                                                         \
-    bytes_read = scanner->pull.bytes_read;                                                                             \
-    zsv_internal_restore_reg(i);                                                                                       \
-    zsv_internal_restore_reg(bytes_chunk_end);                                                                         \
-    zsv_internal_restore_reg(bytes_read);                                                                              \
-    zsv_internal_restore_reg(delimiter);                                                                               \
-    zsv_internal_restore_reg(c);                                                                                       \
-    zsv_internal_restore_reg(skip_next_delim);                                                                         \
-    zsv_internal_restore_reg(quote);                                                                                   \
-    zsv_internal_restore_reg(mask_total_offset);                                                                       \
-    zsv_internal_restore_reg(mask);                                                                                    \
-    zsv_internal_restore_reg(mask_last_start);                                                                         \
-    memset(&v.dl, scanner->opts.delimiter, sizeof(zsv_uc_vector));                                                     \
-    memset(&v.nl, '\n', sizeof(zsv_uc_vector));                                                                        \
-    memset(&v.cr, '\r', sizeof(zsv_uc_vector));                                                                        \
-    memset(&v.qt, scanner->opts.no_quotes > 0 ? 0 : '"', sizeof(v.qt));                                                \
+    scanner->pull.cursor.i = i;                                                                                        \
+    scanner->pull.cursor.mask = mask;                                                                                  \
+    scanner->pull.cursor.mask_last_start = mask_last_start;                                                            \
+    scanner->pull.resume = 1;                                                                                          \
   } while (0)
 #endif
 
+ZSV_SCAN_TARGET
 static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
   struct {
     zsv_uc_vector dl;
@@ -52,34 +27,47 @@ static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char
   size_t bytes_chunk_end;
   char delimiter;
   unsigned char c;
-  char skip_next_delim;
+  char skip_next_delim = 0;
   int quote;
-  size_t mask_total_offset;
-  zsv_mask_t mask;
-  int mask_last_start;
+  size_t mask_total_offset = 0;
+  zsv_mask_t mask = 0;
+  size_t mask_last_start = 0;
+
+  // to do: move into one-time execution code?
+  // (but, will also locate away from function stack)
+  delimiter = scanner->opts.delimiter;
+  quote = scanner->opts.no_quotes > 0 ? -1 : (unsigned char)scanner->opts.quote_char; // ascii code 34 by default
+  memset(&v.dl, delimiter, sizeof(zsv_uc_vector));                                    // ascii code 44
+  memset(&v.nl, '\n', sizeof(zsv_uc_vector));                                         // ascii code 10
+  memset(&v.cr, '\r', sizeof(zsv_uc_vector));                                         // ascii code 13
+  memset(&v.qt, scanner->opts.no_quotes > 0 ? 0 : scanner->opts.quote_char, sizeof(v.qt));
 
 #ifdef ZSV_SUPPORT_PULL_PARSER
-  if (scanner->pull.regs->delim.location) {
-    zsv_internal_restore_regs();
-    if (scanner->pull.regs->delim.location == 1)
-      goto zsv_cell_and_row_dl_1;
-    goto zsv_cell_and_row_dl_2;
+  if (scanner->pull.resume) {
+    // finish the row that the last call returned, then scan on from its end
+    scanner->pull.resume = 0;
+    buff = scanner->pull.buff;
+    bytes_read = scanner->pull.bytes_read;
+    i = scanner->pull.cursor.i;
+    mask = scanner->pull.cursor.mask;
+    mask_last_start = scanner->pull.cursor.mask_last_start;
+    bytes_chunk_end = bytes_read >= sizeof(zsv_uc_vector) ? bytes_read - sizeof(zsv_uc_vector) + 1 : 0;
+    scanner->row.used = 0;
+    scanner->cell_start = i + 1;
+    scanner->row_start = i + 1;
+    scanner->data_row_count++;
+    i++;
+    goto zsv_scan_delim_loop;
   }
 #endif
   bytes_read += scanner->partial_row_length;
   i = scanner->partial_row_length;
-  skip_next_delim = 0;
   bytes_chunk_end = bytes_read >= sizeof(zsv_uc_vector) ? bytes_read - sizeof(zsv_uc_vector) + 1 : 0;
-  delimiter = scanner->opts.delimiter;
   scanner->partial_row_length = 0;
-
-  // to do: move into one-time execution code?
-  // (but, will also locate away from function stack)
-  quote = scanner->opts.no_quotes > 0 ? -1 : '"';  // ascii code 34
-  memset(&v.dl, delimiter, sizeof(zsv_uc_vector)); // ascii code 44
-  memset(&v.nl, '\n', sizeof(zsv_uc_vector));      // ascii code 10
-  memset(&v.cr, '\r', sizeof(zsv_uc_vector));      // ascii code 13
-  memset(&v.qt, scanner->opts.no_quotes > 0 ? 0 : '"', sizeof(v.qt));
+#ifdef ZSV_SUPPORT_PULL_PARSER
+  scanner->pull.buff = buff;
+  scanner->pull.bytes_read = bytes_read;
+#endif
 
   if (scanner->quoted & ZSV_PARSER_QUOTE_PENDING) {
     // if we're here, then the last chunk we read ended with a lone quote char inside
@@ -102,9 +90,10 @@ static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char
 
 #define scanner_last (i ? buff[i - 1] : scanner->last)
 
-  mask_total_offset = 0;
-  mask = 0;
   scanner->buffer_end = bytes_read;
+#ifdef ZSV_SUPPORT_PULL_PARSER
+zsv_scan_delim_loop:
+#endif
   for (; i < bytes_read; i++) {
     if (UNLIKELY(mask == 0)) {
       mask_last_start = i;
@@ -136,7 +125,12 @@ static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char
     if (LIKELY(c == delimiter)) { // case ',':
       if ((scanner->quoted & ZSV_PARSER_QUOTE_UNCLOSED) == 0) {
         scanner->scanned_length = i;
+#ifdef ZSV_SCAN_TAPE
+        if (VERY_UNLIKELY(zsv_tape_cell(scanner, i)))
+          return zsv_status_memory;
+#else
         cell_dl(scanner, buff + scanner->cell_start, i - scanner->cell_start);
+#endif
         scanner->cell_start = i + 1;
         c = 0;
         continue; // this char is not part of the cell content
@@ -146,23 +140,29 @@ static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char
     } else if (UNLIKELY(c == '\r')) {
       if ((scanner->quoted & ZSV_PARSER_QUOTE_UNCLOSED) == 0) {
         scanner->scanned_length = i;
+#ifdef ZSV_SCAN_TAPE
+        enum zsv_status stat = zsv_tape_cell_and_row(scanner, i);
+        if (VERY_UNLIKELY(stat))
+          return stat;
+#else
         enum zsv_status stat = cell_and_row_dl(scanner, buff + scanner->cell_start, i - scanner->cell_start);
         if (VERY_UNLIKELY(stat))
           return stat;
+#endif
 #ifdef ZSV_SUPPORT_PULL_PARSER
         if (scanner->pull.now) {
           scanner->pull.now = 0;
           scanner->row.used = scanner->pull.row_used;
-          zsv_internal_save_regs(1);
+          zsv_pull_suspend();
           return zsv_status_row;
         }
-      zsv_cell_and_row_dl_1:
         scanner->row.used = 0;
-        scanner->pull.regs->delim.location = 0;
 #endif
         scanner->cell_start = i + 1;
         scanner->row_start = i + 1;
+#ifndef ZSV_SCAN_TAPE
         scanner->data_row_count++;
+#endif
         continue; // this char is not part of the cell content
       } else
         // we are inside an open quote, which is needed to escape this char
@@ -175,23 +175,29 @@ static enum zsv_status ZSV_SCAN_DELIM(struct zsv_scanner *scanner, unsigned char
         } else {
           // this is a row end
           scanner->scanned_length = i;
+#ifdef ZSV_SCAN_TAPE
+          enum zsv_status stat = zsv_tape_cell_and_row(scanner, i);
+          if (VERY_UNLIKELY(stat))
+            return stat;
+#else
           enum zsv_status stat = cell_and_row_dl(scanner, buff + scanner->cell_start, i - scanner->cell_start);
           if (VERY_UNLIKELY(stat))
             return stat;
+#endif
 #ifdef ZSV_SUPPORT_PULL_PARSER
           if (scanner->pull.now) {
             scanner->pull.now = 0;
             scanner->row.used = scanner->pull.row_used;
-            zsv_internal_save_regs(2);
+            zsv_pull_suspend();
             return zsv_status_row;
           }
-        zsv_cell_and_row_dl_2:
           scanner->row.used = 0;
-          scanner->pull.regs->delim.location = 0;
 #endif
           scanner->cell_start = i + 1;
           scanner->row_start = i + 1;
+#ifndef ZSV_SCAN_TAPE
           scanner->data_row_count++;
+#endif
         }
         continue; // this char is not part of the cell content
       } else
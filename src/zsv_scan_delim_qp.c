@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Quote-parity scan kernel
+ *
+ * Instead of visiting every quote, delimiter and newline one at a time (see
+ * zsv_scan_delim.c), each 64-byte block is classified at once:
+ * - q: bitmask of quote chars
+ * - s: bitmask of delimiter, \n and \r chars
+ * - px: prefix-XOR of q (carried across blocks), which has a bit set for
+ *   each position that is inside quotes
+ * Only the structural chars outside of quotes (s & ~px) are then visited.
+ *
+ * This is only valid if each quote either opens a cell or closes it (or is
+ * part of an escaped "" pair). Any other quote (e.g. abc"def or "abc"def) is
+ * detected for the whole block before any of its cells are processed, in which
+ * case the remainder of the buffer is handed to the standard kernel, starting
+ * from the start of the current cell. The standard kernel is also used for
+ * the final (partial) block of each buffer, so the scanner state left
+ * for the next zsv_parse_more() or zsv_finish() is unchanged
+ *
+ * If only some columns are stored (see zsv_set_column_filter()), then once a
+ * row has passed its last stored column, its remaining delimiters are masked
+ * out so that the scan goes straight to the end of the row, and the rest of
+ * the row is handled as a single cell, which is not stored. Likewise, a row
+ * that is skipped (see zsv_skip_rows()) is only scanned for its end, except in
+ * the rest of the block in which the skip was requested
+ *
+ * This file is included once for each prefix-XOR implementation, with:
+ * - ZSV_SCAN_DELIM_QP: name of the kernel function
+ * - ZSV_PREFIX_XOR: name of the prefix-XOR function to use
+ * - ZSV_SCAN_DELIM: name of the standard kernel to hand off to
+ * - ZSV_SCAN_TARGET: function attributes (e.g. target("pclmul")) or empty
+ * - ZSV_SCAN_TAPE: if defined, cells are recorded on the tape (see zsv_tape.c)
+ *   and ZSV_SCAN_DELIM must also be a tape kernel
+ */
+
+#define ZSV_QP_BLOCK 64
+
+ZSV_SCAN_TARGET
+static enum zsv_status ZSV_SCAN_DELIM_QP(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
+  struct {
+    zsv_uc_vector dl;
+    zsv_uc_vector nl;
+    zsv_uc_vector cr;
+    zsv_uc_vector qt;
+  } v;
+
+  if (VERY_UNLIKELY(scanner->buffer_exceeded))
+    return ZSV_SCAN_DELIM(scanner, buff, bytes_read);
+
+  // rescan the current cell, if any, from its start so that its quote state
+  // does not need to be carried over from the prior call
+  bytes_read += scanner->partial_row_length;
+  size_t i = scanner->cell_start;
+  scanner->partial_row_length = 0;
+  scanner->quoted = 0;
+  scanner->quote_close_position = 0;
+
+  const unsigned char delimiter = (unsigned char)scanner->opts.delimiter;
+  const unsigned char quote = (unsigned char)scanner->opts.quote_char;
+  memset(&v.dl, delimiter, sizeof(zsv_uc_vector));
+  memset(&v.nl, '\n', sizeof(zsv_uc_vector));
+  memset(&v.cr, '\r', sizeof(zsv_uc_vector));
+  memset(&v.qt, quote, sizeof(zsv_uc_vector));
+
+#ifdef ZSV_SCAN_TAPE
+  const char filtered = 0; // cells are not processed until they are fetched
+  const char skip_row = 0; // skipped rows are dropped as they are delivered (see zsv_tape.c)
+#else
+  const char filtered = scanner->column_filter.bitmap != NULL;
+  char skip_row = scanner->skip_rows != 0; // 1 if the current row has passed its last stored column, or is skipped
+#endif
+
+  uint64_t in_quote = 0; // all ones if the prior block ended inside quotes
+  uint64_t prev_ok = 1;  // 1 if a quote at the start of this block may open a cell
+  size_t cell_quotes = 0;
+  uint64_t cell_needed = 0;
+
+  for (; i + ZSV_QP_BLOCK < bytes_read; i += ZSV_QP_BLOCK) {
+    uint64_t q = 0, s = 0, e = 0;
+    const char have_e = filtered | skip_row; // 1 if e is set for this block
+    for (unsigned k = 0; k < ZSV_QP_BLOCK / VECTOR_BYTES; k++) {
+      zsv_uc_vector str_simd;
+      memcpy(&str_simd, buff + i + k * VECTOR_BYTES, sizeof(str_simd));
+      zsv_uc_vector row_ends = (str_simd == v.nl) | (str_simd == v.cr);
+      if (have_e)
+        e |= (uint64_t)(zsv_mask_t)movemask_pseudo(row_ends) << (k * VECTOR_BYTES);
+      zsv_uc_vector vtmp = row_ends | (str_simd == v.dl);
+      s |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+      vtmp = str_simd == v.qt;
+      q |= (uint64_t)(zsv_mask_t)movemask_pseudo(vtmp) << (k * VECTOR_BYTES);
+    }
+
+    uint64_t px = ZSV_PREFIX_XOR(q) ^ in_quote;
+    uint64_t structural = s & ~px;
+    uint64_t closes = q & ~px;
+    unsigned char next = buff[i + ZSV_QP_BLOCK];
+    uint64_t next_ok = next == quote || next == delimiter || next == '\n' || next == '\r';
+
+    // an opening quote must be the first char of its cell, or the second char
+    // of an escaped "" pair; a closing quote must be followed by a delimiter,
+    // a row end or the second char of an escaped "" pair
+    uint64_t may_open = (structural | closes) << 1 | prev_ok;
+    uint64_t may_close = (s | q) >> 1 | next_ok << 63;
+    if (VERY_UNLIKELY(((q & px) & ~may_open) | (closes & ~may_close))) {
+      scanner->partial_row_length = scanner->cell_start;
+      return ZSV_SCAN_DELIM(scanner, buff, bytes_read - scanner->cell_start);
+    }
+
+    uint64_t quotes_left = q;
+    uint64_t needed_left = s & px; // delimiters and row ends inside quotes
+#ifndef ZSV_SCAN_TAPE
+    uint64_t block_structural = structural;
+    if (skip_row)
+      structural &= e;
+#endif
+    while (structural) {
+      unsigned bit = (unsigned)__builtin_ctzll(structural);
+#ifndef ZSV_SCAN_TAPE
+      uint64_t lowest = structural & (0 - structural);
+#endif
+      structural &= structural - 1;
+      if (quotes_left | needed_left) {
+        uint64_t before = ((uint64_t)1 << bit) - 1;
+        cell_quotes += (size_t)__builtin_popcountll(quotes_left & before);
+        cell_needed |= needed_left & before;
+        quotes_left &= ~before;
+        needed_left &= ~before;
+      }
+
+      size_t pos = i + bit;
+      unsigned char c = buff[pos];
+      if (c == '\n' && (pos ? buff[pos - 1] : scanner->last) == '\r') {
+        // ignore; we are outside a cell and last char was rowend
+        scanner->cell_start = pos + 1;
+        scanner->row_start = pos + 1;
+        continue;
+      }
+
+      size_t n = pos - scanner->cell_start;
+      if (cell_quotes) {
+        // the cell is enclosed in quotes, with any others being escaped pairs
+        scanner->quoted = ZSV_PARSER_QUOTE_CLOSED;
+        if (cell_quotes > 2)
+          scanner->quoted |= ZSV_PARSER_QUOTE_NEEDED | ZSV_PARSER_QUOTE_EMBEDDED;
+        if (cell_needed)
+          scanner->quoted |= ZSV_PARSER_QUOTE_NEEDED;
+        scanner->quote_close_position = n - 1;
+        cell_quotes = 0;
+        cell_needed = 0;
+      }
+
+      scanner->scanned_length = pos;
+#ifdef ZSV_SCAN_TAPE
+      if (LIKELY(c == delimiter)) {
+        if (VERY_UNLIKELY(zsv_tape_cell(scanner, pos)))
+          return zsv_status_memory;
+        scanner->cell_start = pos + 1;
+      } else {
+        enum zsv_status stat = zsv_tape_cell_and_row(scanner, pos);
+        if (VERY_UNLIKELY(stat))
+          return stat;
+        scanner->cell_start = pos + 1;
+        scanner->row_start = pos + 1;
+      }
+#else
+      if (LIKELY(c == delimiter)) {
+        cell_dl(scanner, buff + scanner->cell_start, n);
+        scanner->cell_start = pos + 1;
+        if (VERY_UNLIKELY(filtered) && scanner->row.used >= scanner->column_filter.count) {
+          skip_row = 1;
+          structural &= e;
+        }
+      } else {
+        enum zsv_status stat = cell_and_row_dl(scanner, buff + scanner->cell_start, n);
+        if (VERY_UNLIKELY(stat))
+          return stat;
+        scanner->cell_start = pos + 1;
+        scanner->row_start = pos + 1;
+        scanner->data_row_count++;
+        if (VERY_UNLIKELY(skip_row)) { // resume with the delimiters after this row end
+          skip_row = 0;
+          structural = block_structural & ~((lowest << 1) - 1);
+        }
+        if (VERY_UNLIKELY(scanner->skip_rows)) { // the next row is skipped: go straight to its end
+          skip_row = 1;
+          if (have_e) // else from the next block
+            structural &= e;
+        }
+      }
+#endif
+    }
+    cell_quotes += (size_t)__builtin_popcountll(quotes_left);
+    cell_needed |= needed_left;
+    in_quote = (uint64_t)0 - (px >> 63);
+    prev_ok = (s & ~px) >> 63 | closes >> 63;
+  }
+
+  // use the standard kernel for the final partial block
+  scanner->partial_row_length = scanner->cell_start;
+  return ZSV_SCAN_DELIM(scanner, buff, bytes_read - scanner->cell_start);
+}
+
+#undef ZSV_QP_BLOCK
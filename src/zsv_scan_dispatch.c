@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Runtime cpu dispatch for the ZSV_MODE_DELIM scan kernels
+ *
+ * The vector width in zsv_internal.c is fixed by the compiler flags (e.g.
+ * -mavx2), so a library built for generic x86 only ever uses 16-byte vectors.
+ * Here, vec_delims(), the standard kernel and the quote-parity kernel are
+ * compiled again for each of SSE2, AVX2 and AVX-512, using function-level
+ * target attributes so that no particular compiler flags are needed. zsv_new()
+ * then selects the widest variant that the cpu supports (see
+ * zsv_scan_delim_select()). The pull parser and the fixed-width scanner always
+ * use the compile-time width
+ */
+
+#include <immintrin.h>
+
+#pragma push_macro("zsv_uc_vector")
+#pragma push_macro("zsv_mask_t")
+#pragma push_macro("VECTOR_BYTES")
+#pragma push_macro("NEXT_BIT")
+#pragma push_macro("movemask_pseudo")
+#pragma push_macro("clear_lowest_bit")
+#pragma push_macro("vec_delims")
+#pragma push_macro("ZSV_SCAN_TARGET")
+
+#undef zsv_uc_vector
+#undef zsv_mask_t
+#undef VECTOR_BYTES
+#undef NEXT_BIT
+#undef movemask_pseudo
+#undef clear_lowest_bit
+#undef vec_delims
+#undef ZSV_SCAN_TARGET
+
+// variants are only selected if the cpu supports their target, so with
+// clear_lowest_bit() defined here, vector_delim.c will not require BMI
+#define clear_lowest_bit(n) (n & (n - 1))
+
+/* SSE2: 16 bytes */
+typedef unsigned char zsv_uc_vector_sse2 __attribute__((vector_size(16)));
+#define zsv_uc_vector zsv_uc_vector_sse2
+#define zsv_mask_t uint16_t
+#define VECTOR_BYTES 16
+#define NEXT_BIT __builtin_ffs
+#define movemask_pseudo(x) _mm_movemask_epi8((__m128i)x)
+#define vec_delims vec_delims_sse2
+#define ZSV_SCAN_TARGET __attribute__((target("sse2")))
+
+#include "vector_delim.c"
+#define ZSV_SCAN_DELIM zsv_scan_delim_sse2
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_sse2
+#define ZSV_PREFIX_XOR zsv_prefix_xor
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#endif
+#undef ZSV_SCAN_DELIM
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape_sse2
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_tape_sse2
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#define ZSV_SCAN_COUNT zsv_scan_count_sse2
+#include "zsv_scan_count.c"
+#undef ZSV_SCAN_COUNT
+#undef ZSV_PREFIX_XOR
+#endif
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+
+#undef zsv_uc_vector
+#undef zsv_mask_t
+#undef VECTOR_BYTES
+#undef NEXT_BIT
+#undef movemask_pseudo
+#undef vec_delims
+#undef ZSV_SCAN_TARGET
+
+/* AVX2: 32 bytes. Every AVX2 cpu also supports PCLMULQDQ */
+typedef unsigned char zsv_uc_vector_avx2 __attribute__((vector_size(32)));
+#define zsv_uc_vector zsv_uc_vector_avx2
+#define zsv_mask_t uint32_t
+#define VECTOR_BYTES 32
+#define NEXT_BIT __builtin_ffs
+#define movemask_pseudo(x) _mm256_movemask_epi8((__m256i)x)
+#define vec_delims vec_delims_avx2
+#define ZSV_SCAN_TARGET __attribute__((target("avx2,pclmul")))
+
+#include "vector_delim.c"
+#define ZSV_SCAN_DELIM zsv_scan_delim_avx2
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_avx2
+#define ZSV_PREFIX_XOR zsv_prefix_xor_clmul
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#endif
+#undef ZSV_SCAN_DELIM
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape_avx2
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_tape_avx2
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#define ZSV_SCAN_COUNT zsv_scan_count_avx2
+#include "zsv_scan_count.c"
+#undef ZSV_SCAN_COUNT
+#undef ZSV_PREFIX_XOR
+#endif
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+
+#undef zsv_uc_vector
+#undef zsv_mask_t
+#undef VECTOR_BYTES
+#undef NEXT_BIT
+#undef movemask_pseudo
+#undef vec_delims
+#undef ZSV_SCAN_TARGET
+
+/* AVX-512 (BW): 64 bytes */
+typedef unsigned char zsv_uc_vector_avx512 __attribute__((vector_size(64)));
+#define zsv_uc_vector zsv_uc_vector_avx512
+#define zsv_mask_t uint64_t
+#define VECTOR_BYTES 64
+#define NEXT_BIT __builtin_ffsll
+#define movemask_pseudo(x) _mm512_movepi8_mask((__m512i)x)
+#define vec_delims vec_delims_avx512
+#define ZSV_SCAN_TARGET __attribute__((target("avx512bw,pclmul")))
+
+#include "vector_delim.c"
+#define ZSV_SCAN_DELIM zsv_scan_delim_avx512
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_avx512
+#define ZSV_PREFIX_XOR zsv_prefix_xor_clmul
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#endif
+#undef ZSV_SCAN_DELIM
+#define ZSV_SCAN_TAPE
+#define ZSV_SCAN_DELIM zsv_scan_delim_tape_avx512
+#include "zsv_scan_delim.c"
+#undef scanner_last
+#ifndef ZSV_NO_QUOTE_PARITY
+#define ZSV_SCAN_DELIM_QP zsv_scan_delim_qp_tape_avx512
+#include "zsv_scan_delim_qp.c"
+#undef ZSV_SCAN_DELIM_QP
+#define ZSV_SCAN_COUNT zsv_scan_count_avx512
+#include "zsv_scan_count.c"
+#undef ZSV_SCAN_COUNT
+#undef ZSV_PREFIX_XOR
+#endif
+#undef ZSV_SCAN_DELIM
+#undef ZSV_SCAN_TAPE
+
+#undef zsv_uc_vector
+#undef zsv_mask_t
+#undef VECTOR_BYTES
+#undef NEXT_BIT
+#undef movemask_pseudo
+#undef clear_lowest_bit
+#undef vec_delims
+#undef ZSV_SCAN_TARGET
+
+#pragma pop_macro("zsv_uc_vector")
+#pragma pop_macro("zsv_mask_t")
+#pragma pop_macro("VECTOR_BYTES")
+#pragma pop_macro("NEXT_BIT")
+#pragma pop_macro("movemask_pseudo")
+#pragma pop_macro("clear_lowest_bit")
+#pragma pop_macro("vec_delims")
+#pragma pop_macro("ZSV_SCAN_TARGET")
+
+/**
+ * Scan kernels for each vector width: standard and quote-parity, each with a
+ * tape mode variant, and the row-count kernel
+ */
+static const struct zsv_scan_kernel {
+  const char *name;
+  unsigned char width; // ZSV_SCAN_KERNEL_XXX
+  zsv_scan_delim_func scan;
+  zsv_scan_delim_func scan_qp;
+  zsv_scan_delim_func scan_tape;
+  zsv_scan_delim_func scan_qp_tape;
+  zsv_scan_count_func scan_count;
+} zsv_scan_kernels[] = {
+#ifndef ZSV_NO_QUOTE_PARITY
+  {"avx512", ZSV_SCAN_KERNEL_AVX512, zsv_scan_delim_avx512, zsv_scan_delim_qp_avx512, zsv_scan_delim_tape_avx512,
+   zsv_scan_delim_qp_tape_avx512, zsv_scan_count_avx512},
+  {"avx2", ZSV_SCAN_KERNEL_AVX2, zsv_scan_delim_avx2, zsv_scan_delim_qp_avx2, zsv_scan_delim_tape_avx2,
+   zsv_scan_delim_qp_tape_avx2, zsv_scan_count_avx2},
+  {"sse2", ZSV_SCAN_KERNEL_SSE2, zsv_scan_delim_sse2, zsv_scan_delim_qp_sse2, zsv_scan_delim_tape_sse2,
+   zsv_scan_delim_qp_tape_sse2, zsv_scan_count_sse2},
+#else
+  {"avx512", ZSV_SCAN_KERNEL_AVX512, zsv_scan_delim_avx512, NULL, zsv_scan_delim_tape_avx512, NULL, NULL},
+  {"avx2", ZSV_SCAN_KERNEL_AVX2, zsv_scan_delim_avx2, NULL, zsv_scan_delim_tape_avx2, NULL, NULL},
+  {"sse2", ZSV_SCAN_KERNEL_SSE2, zsv_scan_delim_sse2, NULL, zsv_scan_delim_tape_sse2, NULL, NULL},
+#endif
+};
+
+static int zsv_scan_kernel_supported(unsigned char width) {
+  __builtin_cpu_init();
+  switch (width) {
+  case ZSV_SCAN_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("pclmul");
+  case ZSV_SCAN_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul");
+  case ZSV_SCAN_KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2");
+  }
+  return 0;
+}
@@ -1,42 +1,89 @@
-static inline char row_fx(struct zsv_scanner *scanner, unsigned char *buff, size_t row_start, size_t row_end) {
-  size_t cell_start = row_start;
-  size_t row_length = row_end - row_start;
-  for (unsigned i = 0; i < scanner->fixed.count; i++) {
-    size_t cell_end = row_start + (scanner->fixed.offsets[i] > row_length ? row_length : scanner->fixed.offsets[i]);
-    size_t cell_length = cell_end - cell_start;
-    unsigned char *s = buff + cell_start;
-    if (UNLIKELY(scanner->opts.cell_handler != NULL))
-      scanner->opts.cell_handler(scanner->opts.ctx, s, cell_length);
-    struct zsv_cell c = {s, cell_length, 1, 0};
-    scanner->row.cells[scanner->row.used++] = c;
-
+/**
+ * Slice the first n fixed-width cells (see zsv_set_fixed_offsets()) of the
+ * row_length bytes at s into out[0], out[stride], ..., out[(n - 1) * stride]
+ */
+static inline void zsv_fixed_cells(const struct zsv_scanner *scanner, unsigned char *s, size_t row_length,
+                                   struct zsv_cell *out, size_t stride, size_t n) {
+  const unsigned *offsets = scanner->fixed.offsets;
+  size_t cell_start = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t cell_end = offsets[i] > row_length ? row_length : offsets[i];
+    struct zsv_cell c = {s + cell_start, cell_end - cell_start, 1, 0};
+    out[i * stride] = c;
     cell_start = cell_end;
   }
-  if (VERY_LIKELY(scanner->opts.row_handler != NULL))
+}
+
+static inline char row_fx(struct zsv_scanner *scanner, unsigned char *buff, size_t row_start, size_t row_end) {
+  if (VERY_UNLIKELY(scanner->skip_rows)) {
+    scanner->skip_rows--;
+    return scanner->abort;
+  }
+  zsv_fixed_cells(scanner, buff + row_start, row_end - row_start, scanner->row.cells, 1, scanner->fixed.count);
+  scanner->row.used = scanner->fixed.count;
+  if (UNLIKELY(scanner->opts.cell_handler != NULL))
+    for (size_t i = 0; i < scanner->row.used; i++) {
+      if (VERY_UNLIKELY(scanner->stats != NULL))
+        zsv_stats_cell_handler(scanner, scanner->row.cells[i].str, scanner->row.cells[i].len);
+      else
+        scanner->opts.cell_handler(scanner->opts.ctx, scanner->row.cells[i].str, scanner->row.cells[i].len);
+    }
+  zsv_row_arena_reset(scanner);
+  if (VERY_UNLIKELY(scanner->stats != NULL))
+    zsv_stats_row_handler(scanner);
+  else if (VERY_LIKELY(scanner->opts.row_handler != NULL))
     scanner->opts.row_handler(scanner->opts.ctx);
   scanner->row.used = 0;
   return scanner->abort;
 }
 
+/**
+ * zsv_scan_fixed() with a fixed record length (see zsv_set_fixed_record_length()):
+ * each row is the next record_length bytes, so rows are sliced without looking
+ * at the data at all. A partial record at the end of the buffer is left for
+ * the next scan, as with a partial row in zsv_scan_fixed()
+ */
+static enum zsv_status zsv_scan_fixed_records(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
+  size_t record_length = scanner->fixed.record_length;
+  bytes_read += scanner->partial_row_length;
+  scanner->partial_row_length = 0;
+  scanner->buffer_end = bytes_read;
+  scanner->scanned_length = bytes_read;
+  scanner->old_bytes_read = bytes_read;
+  if (scanner->fixed.pull) // rows are sliced by zsv_next_batch()
+    return zsv_status_ok;
+
+  for (; scanner->row_start + record_length <= bytes_read; scanner->row_start += record_length)
+    if (VERY_UNLIKELY(row_fx(scanner, buff, scanner->row_start, scanner->row_start + record_length))) {
+      scanner->row_start += record_length;
+      return zsv_status_cancelled;
+    }
+  return zsv_status_ok;
+}
+
 static enum zsv_status zsv_scan_fixed(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
+  if (scanner->fixed.record_length)
+    return zsv_scan_fixed_records(scanner, buff, bytes_read);
+
   bytes_read += scanner->partial_row_length;
   unsigned char c;
   size_t bytes_chunk_end = bytes_read >= sizeof(zsv_uc_vector) ? bytes_read - sizeof(zsv_uc_vector) + 1 : 0;
 
   scanner->partial_row_length = 0;
 
-  // dl_v and qt_v are unused, we just leave them to reuse vec_delims()
+  // dl_v and qt_v are unused, we just leave them to reuse vec_delims(). They
+  // are set to \n rather than to \0 so that NUL bytes are not candidates
   zsv_uc_vector dl_v;
-  memset(&dl_v, 0, sizeof(zsv_uc_vector));
+  memset(&dl_v, '\n', sizeof(zsv_uc_vector));
   zsv_uc_vector nl_v;
   memset(&nl_v, '\n', sizeof(zsv_uc_vector));
   zsv_uc_vector cr_v;
   memset(&cr_v, '\r', sizeof(zsv_uc_vector));
   zsv_uc_vector qt_v;
-  memset(&qt_v, 0, sizeof(zsv_uc_vector));
+  memset(&qt_v, '\n', sizeof(zsv_uc_vector));
   size_t mask_total_offset = 0;
   zsv_mask_t mask = 0;
-  int mask_last_start;
+  size_t mask_last_start;
 
   scanner->buffer_end = bytes_read;
   for (size_t i = scanner->partial_row_length;; i++) {
@@ -48,9 +95,9 @@ static enum zsv_status zsv_scan_fixed(struct zsv_scanner *scanner, unsigned char
         if (mask_total_offset)
           i += mask_total_offset;
       } else { // we only have a few bytes left, so manually parse
-        for (unsigned i2 = i; i2 < bytes_read; i2++)
-          if (strchr("\n\r", buff[i2]))
-            mask += 1 << (i2 - i);
+        for (size_t i2 = i; i2 < bytes_read; i2++)
+          if (buff[i2] == '\n' || buff[i2] == '\r')
+            mask |= (zsv_mask_t)1 << (i2 - i);
       }
       if (UNLIKELY(mask == 0))
         break;
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Scan kernel for a multi-char delimiter, a custom row terminator and/or an
+ * escape char (see zsv_opts.delimiter_string, zsv_opts.row_terminator and
+ * zsv_opts.escape_char)
+ *
+ * As in the standard kernel, each vector of input is compared with each char
+ * that may be significant: here, the first byte of the delimiter, the quote
+ * char, the escape char and either the first byte of the row terminator, or
+ * \n and \r. Only those candidates are then compared with the full delimiter
+ * or row terminator. An escape char marks its cell as ZSV_PARSER_QUOTE_EMBEDDED
+ * so that its value is unescaped when it is fetched, and the char after it is
+ * skipped
+ *
+ * A candidate that is too close to the end of the buffer to tell whether it
+ * is a match (or an escape char that is the last byte in the buffer) ends the
+ * scan; the bytes from the candidate on (delims.rescan) are left as part of
+ * the partial row, and are scanned again along with the next buffer. At the
+ * end of the input, zsv_finish() scans them once more with delims.at_eof set,
+ * so that they are treated as cell content
+ *
+ * This kernel does not support the pull parser's saved state, so the pull
+ * parser always uses its tape mode variant
+ *
+ * This file is included once without and once with ZSV_SCAN_TAPE, with:
+ * - ZSV_SCAN_MULTI: name of the kernel function
+ */
+
+#ifndef ZSV_SCAN_MULTI_MATCH
+#define ZSV_SCAN_MULTI_MATCH
+
+/**
+ * Check whether s, of which n bytes remain in the buffer, starts with match
+ * @return 1 if it does, 0 if it does not, or -1 if the remaining bytes are too
+ *         few to tell (unless at_eof is set)
+ */
+static inline int zsv_scan_multi_match(const unsigned char *s, size_t n, const unsigned char *match, size_t len,
+                                       char at_eof) {
+  if (VERY_LIKELY(n >= len))
+    return !memcmp(s, match, len);
+  if (at_eof || memcmp(s, match, n))
+    return 0;
+  return -1;
+}
+
+struct zsv_scan_multi_chars {
+  zsv_uc_vector dl; // first byte of the delimiter
+  zsv_uc_vector nl; // first byte of the row terminator, or \n
+  zsv_uc_vector cr; // \r, or (with a row terminator) same as dl
+  zsv_uc_vector qt; // quote char
+  zsv_uc_vector es; // escape char, or same as dl
+};
+
+/**
+ * As vec_delims(), with a fifth char to match
+ * @return offset of the first vector that contains a candidate, whose bits
+ *         are set in *maskp; or, if none, of the end of the last whole vector
+ */
+ZSV_SCAN_TARGET
+__attribute__((always_inline)) static inline size_t zsv_scan_multi_candidates(const unsigned char *s, size_t n,
+                                                                              const struct zsv_scan_multi_chars *v,
+                                                                              zsv_mask_t *maskp) {
+  size_t offset = 0;
+  for (; offset + VECTOR_BYTES <= n; offset += VECTOR_BYTES) {
+    zsv_uc_vector str_simd;
+    memcpy(&str_simd, s + offset, sizeof(str_simd));
+    zsv_uc_vector vtmp =
+      (str_simd == v->dl) | (str_simd == v->nl) | (str_simd == v->cr) | (str_simd == v->qt) | (str_simd == v->es);
+    zsv_mask_t mask = movemask_pseudo(vtmp);
+    if (LIKELY(mask != 0)) {
+      *maskp = mask;
+      break;
+    }
+  }
+  return offset;
+}
+
+#endif
+
+ZSV_SCAN_TARGET
+static enum zsv_status ZSV_SCAN_MULTI(struct zsv_scanner *scanner, unsigned char *buff, size_t bytes_read) {
+  struct zsv_scan_multi_chars v;
+  const unsigned char *delim = scanner->delims.delim;
+  const unsigned char *term = scanner->delims.term;
+  size_t delim_len = scanner->delims.delim_len;
+  size_t term_len = scanner->delims.term_len;
+  char at_eof = scanner->delims.at_eof;
+  int quote = scanner->opts.no_quotes > 0 ? -1 : (unsigned char)scanner->opts.quote_char;
+  int escape = scanner->opts.escape_char ? (unsigned char)scanner->opts.escape_char : -1;
+  size_t rescan = scanner->delims.rescan <= scanner->partial_row_length ? scanner->delims.rescan : 0;
+
+  bytes_read += scanner->partial_row_length;
+  size_t i = scanner->partial_row_length - rescan;
+  scanner->partial_row_length = 0;
+  scanner->delims.rescan = 0;
+
+  // with a row terminator, \n and \r are ordinary chars, and v.cr is unused
+  unsigned char nl = term_len ? term[0] : '\n';
+  unsigned char cr = term_len ? delim[0] : '\r';
+  memset(&v.dl, delim[0], sizeof(zsv_uc_vector));
+  memset(&v.nl, nl, sizeof(zsv_uc_vector));
+  memset(&v.cr, cr, sizeof(zsv_uc_vector));
+  memset(&v.qt, scanner->opts.no_quotes > 0 ? 0 : scanner->opts.quote_char, sizeof(v.qt));
+  memset(&v.es, escape >= 0 ? escape : delim[0], sizeof(v.es));
+
+  if (scanner->quoted & ZSV_PARSER_QUOTE_PENDING) {
+    // the last chunk ended with a lone quote char inside a quoted cell (see zsv_scan_delim.c)
+    scanner->quoted -= ZSV_PARSER_QUOTE_PENDING;
+    if (buff[i] != quote) {
+      scanner->quoted |= ZSV_PARSER_QUOTE_CLOSED;
+      scanner->quoted -= ZSV_PARSER_QUOTE_UNCLOSED;
+      scanner->quote_close_position = i - scanner->cell_start - 1;
+    } else {
+      scanner->quoted |= ZSV_PARSER_QUOTE_NEEDED;
+      scanner->quoted |= ZSV_PARSER_QUOTE_EMBEDDED;
+      i++;
+    }
+  }
+
+#define scanner_last (i ? buff[i - 1] : scanner->last)
+
+  size_t skip_to = 0; // candidates before this offset are part of a delimiter, row terminator or escape
+  size_t mask_start = 0;
+  zsv_mask_t mask = 0;
+  unsigned char c;
+  scanner->buffer_end = bytes_read;
+  for (; i < bytes_read; i++) {
+    if (VERY_UNLIKELY(mask == 0)) {
+      if (VERY_LIKELY(i + VECTOR_BYTES <= bytes_read)) {
+        size_t offset = zsv_scan_multi_candidates(buff + i, bytes_read - i, &v, &mask);
+        if (UNLIKELY(mask == 0)) { // no candidates in any whole vector
+          i += offset - 1;
+          continue;
+        }
+        i += offset;
+        mask_start = i;
+      } else {
+        // fewer than VECTOR_BYTES remain: check one char at a time
+        c = buff[i];
+        if (c != delim[0] && c != nl && c != cr && c != quote && c != escape)
+          continue;
+      }
+    }
+    if (VERY_LIKELY(mask)) {
+      i = mask_start + NEXT_BIT(mask) - 1;
+      mask = clear_lowest_bit(mask);
+    }
+    if (VERY_UNLIKELY(i < skip_to))
+      continue;
+
+    c = buff[i];
+    if (VERY_UNLIKELY(c == escape)) {
+      if (VERY_UNLIKELY(i + 1 == bytes_read) && !at_eof) {
+        // the escaped char is in the next buffer: scan both again with the next one
+        scanner->delims.rescan = 1;
+        i = bytes_read;
+        break;
+      }
+      if (!(scanner->quoted & (ZSV_PARSER_QUOTE_UNCLOSED | ZSV_PARSER_QUOTE_CLOSED)))
+        scanner->quote_close_position = 0; // the cell is not quoted
+      scanner->quoted |= ZSV_PARSER_QUOTE_EMBEDDED;
+      skip_to = i + 2;
+      continue;
+    }
+
+    if (LIKELY(c == quote)) { // as in zsv_scan_delim.c
+      if (i == scanner->cell_start && !scanner->buffer_exceeded) {
+        scanner->quoted = ZSV_PARSER_QUOTE_UNCLOSED;
+        scanner->quote_close_position = 0;
+      } else if (scanner->quoted & ZSV_PARSER_QUOTE_UNCLOSED) {
+        if (VERY_LIKELY(i + 1 < bytes_read)) {
+          if (LIKELY(buff[i + 1] != quote)) {
+            // buff[i] is the closing quote
+            scanner->quoted |= ZSV_PARSER_QUOTE_CLOSED;
+            scanner->quoted -= ZSV_PARSER_QUOTE_UNCLOSED;
+            if (LIKELY(scanner->quote_close_position == 0))
+              scanner->quote_close_position = i - scanner->cell_start;
+          } else {
+            // escaped dbl-quote
+            scanner->quoted |= ZSV_PARSER_QUOTE_NEEDED;
+            scanner->quoted |= ZSV_PARSER_QUOTE_EMBEDDED;
+            skip_to = i + 2;
+          }
+        } else // we are at the end of this input chunk
+          scanner->quoted |= ZSV_PARSER_QUOTE_PENDING;
+      } else {
+        // quote in the middle of an unquoted cell
+        scanner->quoted |= ZSV_PARSER_QUOTE_EMBEDDED;
+        scanner->quote_close_position = 0;
+      }
+      continue;
+    }
+
+    if (scanner->quoted & ZSV_PARSER_QUOTE_UNCLOSED) {
+      // we are inside an open quote, which is needed to escape this char
+      scanner->quoted |= ZSV_PARSER_QUOTE_NEEDED;
+      continue;
+    }
+
+    // the row terminator takes precedence over a delimiter that it starts with
+    int is_term = term_len && c == term[0] ? zsv_scan_multi_match(buff + i, bytes_read - i, term, term_len, at_eof) : 0;
+    int is_delim =
+      !is_term && c == delim[0] ? zsv_scan_multi_match(buff + i, bytes_read - i, delim, delim_len, at_eof) : 0;
+    if (VERY_UNLIKELY(is_term < 0 || is_delim < 0)) {
+      // a partial match at the end of the buffer: scan it again with the next one
+      scanner->delims.rescan = (unsigned char)(bytes_read - i);
+      i = bytes_read;
+      break;
+    }
+
+    if (is_delim) {
+      scanner->scanned_length = i;
+#ifdef ZSV_SCAN_TAPE
+      if (VERY_UNLIKELY(zsv_tape_cell(scanner, i)))
+        return zsv_status_memory;
+#else
+      cell_dl(scanner, buff + scanner->cell_start, i - scanner->cell_start);
+#endif
+      scanner->cell_start = i + delim_len;
+      skip_to = i + delim_len;
+      continue;
+    }
+
+    size_t row_end_len = 0;
+    if (is_term)
+      row_end_len = term_len;
+    else if (!term_len && c == '\r')
+      row_end_len = 1;
+    else if (!term_len && c == '\n') {
+      if (scanner_last == '\r') { // ignore; we are outside a cell and last char was rowend
+        scanner->cell_start = i + 1;
+        scanner->row_start = i + 1;
+        continue;
+      }
+      row_end_len = 1;
+    }
+
+    if (row_end_len) {
+      scanner->scanned_length = i;
+#ifdef ZSV_SCAN_TAPE
+      enum zsv_status stat = zsv_tape_cell_and_row(scanner, i);
+#else
+      enum zsv_status stat = cell_and_row_dl(scanner, buff + scanner->cell_start, i - scanner->cell_start);
+#endif
+      if (VERY_UNLIKELY(stat))
+        return stat;
+      scanner->cell_start = i + row_end_len;
+      scanner->row_start = i + row_end_len;
+#ifndef ZSV_SCAN_TAPE
+      scanner->data_row_count++;
+#endif
+      skip_to = i + row_end_len;
+    }
+    // any other candidate is cell content. Whether an unquoted cell needs
+    // quotes in CSV output is checked when its value is fetched (see
+    // zsv_cell_needs_quotes())
+  }
+  scanner->scanned_length = i;
+
+  // as in zsv_scan_delim.c, the remaining partial row is shifted upon the next parse_more()
+  scanner->old_bytes_read = bytes_read;
+
+  return zsv_status_ok;
+}
+
+#undef scanner_last
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Parser statistics (see zsv_opts.stats)
+ *
+ * Row, cell and quote counts are updated as each row is delivered. Time is
+ * measured around the outermost parse call, around each read and around each
+ * row or cell handler call; scan time is the parse time that is left over.
+ * In pull mode, no handler is called, so the time between zsv_next_row() calls
+ * is not counted at all
+ *
+ * On Linux, hardware counters for the parsing thread are opened at the first
+ * parse call, and read when the stats are fetched
+ */
+
+#include <time.h>
+#if defined(__linux__) && !defined(ZSV_NO_PERF_EVENTS)
+#define ZSV_STATS_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define ZSV_STATS_PERF_COUNTERS 3 // cycles, instructions, branch misses
+
+struct zsv_stats_state {
+  struct zsv_stats stats; // counts, read_ns and callback_ns
+  uint64_t parse_ns;
+  uint64_t parse_start;
+  unsigned char timing;       // 1 while in a parse call
+  unsigned char perf_started; // 1 once the hardware counters were opened, or failed to open
+  int perf_fd[ZSV_STATS_PERF_COUNTERS];
+};
+
+static uint64_t zsv_stats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static struct zsv_stats_state *zsv_stats_new(void) {
+  struct zsv_stats_state *st = calloc(1, sizeof(*st));
+  if (st)
+    for (int i = 0; i < ZSV_STATS_PERF_COUNTERS; i++)
+      st->perf_fd[i] = -1;
+  return st;
+}
+
+static void zsv_stats_perf_close(struct zsv_stats_state *st) {
+#ifdef ZSV_STATS_PERF
+  for (int i = ZSV_STATS_PERF_COUNTERS - 1; i >= 0; i--) {
+    if (st->perf_fd[i] >= 0)
+      close(st->perf_fd[i]);
+    st->perf_fd[i] = -1;
+  }
+#else
+  (void)(st);
+#endif
+}
+
+static void zsv_stats_perf_open(struct zsv_stats_state *st) {
+  st->perf_started = 1;
+#ifdef ZSV_STATS_PERF
+  static const uint64_t configs[ZSV_STATS_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                            PERF_COUNT_HW_BRANCH_MISSES};
+  for (int i = 0; i < ZSV_STATS_PERF_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.disabled = i == 0; // the group is enabled through its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    st->perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i ? st->perf_fd[0] : -1, 0);
+    if (st->perf_fd[i] < 0) { // e.g. not permitted, or no PMU in a virtual machine
+      zsv_stats_perf_close(st);
+      return;
+    }
+  }
+  ioctl(st->perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(st->perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void zsv_stats_delete(struct zsv_stats_state *st) {
+  if (st) {
+    zsv_stats_perf_close(st);
+    free(st);
+  }
+}
+
+static void zsv_stats_parse_begin(struct zsv_stats_state *st) {
+  st->timing = 1;
+  if (!st->perf_started)
+    zsv_stats_perf_open(st);
+  st->parse_start = zsv_stats_now_ns();
+}
+
+static void zsv_stats_parse_end(struct zsv_stats_state *st) {
+  st->parse_ns += zsv_stats_now_ns() - st->parse_start;
+  st->timing = 0;
+}
+
+static void zsv_stats_read(struct zsv_stats_state *st, uint64_t start, size_t bytes_read) {
+  st->stats.read_ns += zsv_stats_now_ns() - start;
+  if (bytes_read)
+    st->stats.refills++;
+}
+
+static char zsv_tape_count_quoted(struct zsv_scanner *scanner, size_t *quoted, size_t *escaped);
+
+/**
+ * Count the current row, and call the row handler, if any
+ */
+static void zsv_stats_row_handler(struct zsv_scanner *scanner) {
+  struct zsv_stats *stats = &scanner->stats->stats;
+  stats->rows++;
+  stats->cells += scanner->row.used;
+  if (!scanner->tape || !zsv_tape_count_quoted(scanner, &stats->quoted_cells, &stats->escaped_cells))
+    for (size_t i = 0; i < scanner->row.used; i++) {
+      unsigned char quoted = (unsigned char)scanner->row.cells[i].quoted;
+      if (quoted & ZSV_PARSER_QUOTE_CLOSED)
+        stats->quoted_cells++;
+      if (quoted & (ZSV_PARSER_QUOTE_EMBEDDED | ZSV_PARSER_QUOTE_ESCAPED))
+        stats->escaped_cells++;
+    }
+
+  if (scanner->opts.row_handler) {
+    if (scanner->mode == ZSV_MODE_DELIM_PULL) // the row is returned by zsv_next_row()
+      scanner->opts.row_handler(scanner->opts.ctx);
+    else {
+      uint64_t start = zsv_stats_now_ns();
+      scanner->opts.row_handler(scanner->opts.ctx);
+      stats->callback_ns += zsv_stats_now_ns() - start;
+    }
+  }
+}
+
+static void zsv_stats_cell_handler(struct zsv_scanner *scanner, unsigned char *s, size_t n) {
+  uint64_t start = zsv_stats_now_ns();
+  scanner->opts.cell_handler(scanner->opts.ctx, s, n);
+  scanner->stats->stats.callback_ns += zsv_stats_now_ns() - start;
+}
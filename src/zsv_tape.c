@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Tape mode (see zsv_opts.tape)
+ *
+ * Instead of building a struct zsv_cell for each cell as it is scanned, the
+ * kernel only appends one 32-bit entry per cell to a "tape" that covers the
+ * whole buffer:
+ * - bits 0-26: offset of the cell end (delimiter or row end) in the buffer
+ * - bit 27: ZSV_TAPE_ODD: quote state is stored in the tape's odd list
+ * - bit 28: ZSV_TAPE_STRIP: the cell is enclosed in quotes
+ * - bits 29-31: ZSV_PARSER_QUOTE_CLOSED, _NEEDED and _EMBEDDED
+ * and one zsv_tape_row per row. Once the buffer is scanned, its rows are
+ * delivered to the row handler from the tape. Cell values of data rows are
+ * only materialized (quotes removed, UTF8 handled) when zsv_get_cell() is
+ * called, so columns that are never requested are never touched
+ *
+ * Header rows are handled by the parser's internal row handlers, which
+ * expect all cells to be available, and are materialized eagerly
+ */
+
+#define ZSV_TAPE_OFFSET_MASK 0x07FFFFFFu
+#define ZSV_TAPE_MAX_BUFFSIZE ((size_t)ZSV_TAPE_OFFSET_MASK)
+#define ZSV_TAPE_ODD (1u << 27)
+#define ZSV_TAPE_STRIP (1u << 28)
+#define ZSV_TAPE_QUOTED_SHIFT 28
+#ifndef ZSV_TAPE_FLUSH_CELLS
+#define ZSV_TAPE_FLUSH_CELLS 1024
+#endif
+#define ZSV_TAPE_QUOTED_MASK (ZSV_PARSER_QUOTE_CLOSED | ZSV_PARSER_QUOTE_NEEDED | ZSV_PARSER_QUOTE_EMBEDDED)
+
+struct zsv_tape_row {
+  uint32_t start;      // buffer offset of the row
+  uint32_t first_cell; // index of the row's first cell entry
+};
+
+struct zsv_tape_odd {
+  uint32_t cell; // index of the cell entry
+  uint32_t quote_close_position;
+  unsigned char quoted;
+};
+
+struct zsv_tape {
+  uint32_t *cells;
+  size_t cells_used, cells_allocated;
+
+  struct zsv_tape_row *rows;
+  size_t rows_used, rows_allocated;
+  size_t rows_done; // number of rows whose end has been scanned
+  size_t next_row;  // next row to deliver
+  size_t current;   // row being delivered
+
+  struct zsv_tape_odd *odd; // cells with quote state that does not fit in a cell entry
+  size_t odd_used, odd_allocated;
+
+  uint32_t *cell_gen; // gen at which each cell of the current row was materialized
+  uint32_t gen;
+
+  struct {
+    size_t row_start;
+    size_t scanned_length;
+    unsigned char have_cell;
+  } saved; // scanner state at the end of the scan, while rows are delivered
+
+  unsigned char eager : 1;  // 1 if all cells of the current row were materialized
+  unsigned char pulled : 1; // 1 if zsv_next_row() returned the current row
+  unsigned char delim_len;  // a cell that is not the first in its row starts this far after the prior cell's end
+};
+
+static int zsv_tape_grow(void **p, size_t *allocated, size_t size) {
+  size_t new_allocated = *allocated ? *allocated * 2 : 1024;
+  void *new_p = realloc(*p, new_allocated * size);
+  if (!new_p) {
+    fprintf(stderr, "Out of memory!\n");
+    return 1;
+  }
+  *p = new_p;
+  *allocated = new_allocated;
+  return 0;
+}
+
+static void zsv_tape_delete(struct zsv_tape **tp) {
+  if (*tp) {
+    struct zsv_tape *t = *tp;
+    free(t->cells);
+    free(t->rows);
+    free(t->odd);
+    free(t->cell_gen);
+    free(t);
+    *tp = NULL;
+  }
+}
+
+/**
+ * Record the end of the current cell, which ends at buff offset `end`
+ * @return non-zero on out-of-memory
+ */
+__attribute__((always_inline)) static inline int zsv_tape_cell(struct zsv_scanner *scanner, size_t end) {
+  struct zsv_tape *t = scanner->tape;
+  if (VERY_UNLIKELY(t->rows_used == t->rows_done)) { // first cell of a row
+    if (VERY_UNLIKELY(t->rows_used == t->rows_allocated) &&
+        zsv_tape_grow((void **)&t->rows, &t->rows_allocated, sizeof(*t->rows)))
+      return 1;
+    t->rows[t->rows_used].start = (uint32_t)scanner->row_start;
+    t->rows[t->rows_used].first_cell = (uint32_t)t->cells_used;
+    t->rows_used++;
+  }
+  if (VERY_UNLIKELY(t->cells_used == t->cells_allocated) &&
+      zsv_tape_grow((void **)&t->cells, &t->cells_allocated, sizeof(*t->cells)))
+    return 1;
+
+  uint32_t e = (uint32_t)end;
+  unsigned char quoted = scanner->quoted;
+  if (UNLIKELY(quoted)) {
+    if ((quoted & ~ZSV_TAPE_QUOTED_MASK) == 0 && scanner->quote_close_position + 1 == end - scanner->cell_start)
+      e |= ZSV_TAPE_STRIP | ((uint32_t)quoted << ZSV_TAPE_QUOTED_SHIFT);
+    else if ((quoted & ~ZSV_TAPE_QUOTED_MASK) == 0 && scanner->quote_close_position == 0)
+      e |= (uint32_t)quoted << ZSV_TAPE_QUOTED_SHIFT;
+    else {
+      if (VERY_UNLIKELY(t->odd_used == t->odd_allocated) &&
+          zsv_tape_grow((void **)&t->odd, &t->odd_allocated, sizeof(*t->odd)))
+        return 1;
+      struct zsv_tape_odd *odd = &t->odd[t->odd_used++];
+      odd->cell = (uint32_t)t->cells_used;
+      odd->quote_close_position = (uint32_t)scanner->quote_close_position;
+      odd->quoted = quoted;
+      e |= ZSV_TAPE_ODD;
+    }
+  }
+  t->cells[t->cells_used++] = e;
+  scanner->have_cell = 1;
+  zsv_clear_cell(scanner);
+  return 0;
+}
+
+static enum zsv_status zsv_tape_deliver(struct zsv_scanner *scanner, char eager);
+
+/**
+ * Record the end of the current cell and of the current row. In push mode,
+ * once ZSV_TAPE_FLUSH_CELLS cells have been recorded, the rows on the tape
+ * are delivered and the tape is cleared, so that it stays in cache
+ */
+__attribute__((always_inline)) static inline enum zsv_status zsv_tape_cell_and_row(struct zsv_scanner *scanner,
+                                                                                   size_t end) {
+  struct zsv_tape *t = scanner->tape;
+  if (VERY_UNLIKELY(zsv_tape_cell(scanner, end)))
+    return zsv_status_memory;
+  t->rows_done++;
+  scanner->have_cell = 0;
+  // the row end that zsv_throwaway_row() will be called for has been found
+  scanner->buffer_exceeded = 0;
+  if (t->cells_used >= ZSV_TAPE_FLUSH_CELLS && scanner->mode != ZSV_MODE_DELIM_PULL) {
+    enum zsv_status stat = zsv_tape_deliver(scanner, 0);
+    t->cells_used = t->rows_used = t->rows_done = t->next_row = t->odd_used = 0;
+    return stat;
+  }
+  return zsv_status_ok;
+}
+
+/**
+ * Find the odd list entry of a cell entry that has ZSV_TAPE_ODD set
+ */
+static const struct zsv_tape_odd *zsv_tape_odd_find(const struct zsv_tape *t, size_t cell) {
+  size_t lo = 0, hi = t->odd_used;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (t->odd[mid].cell < cell)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return &t->odd[lo];
+}
+
+/**
+ * Add the number of quoted and escaped cells of the current row to *quoted
+ * and *escaped, as recorded on the tape (see zsv_stats.c)
+ * @return 0 if the row's cells were materialized, in which case their quote
+ *         state is in scanner->row.cells instead
+ */
+static char zsv_tape_count_quoted(struct zsv_scanner *scanner, size_t *quoted, size_t *escaped) {
+  struct zsv_tape *t = scanner->tape;
+  if (t->eager)
+    return 0;
+  size_t first = t->rows[t->current].first_cell;
+  for (size_t cell = first; cell < first + scanner->row.used; cell++) {
+    uint32_t e = t->cells[cell];
+    unsigned char q = (e >> ZSV_TAPE_QUOTED_SHIFT) & ZSV_TAPE_QUOTED_MASK;
+    if (VERY_UNLIKELY(e & ZSV_TAPE_ODD))
+      q = zsv_tape_odd_find(t, cell)->quoted;
+    if (q & ZSV_PARSER_QUOTE_CLOSED)
+      (*quoted)++;
+    if (q & ZSV_PARSER_QUOTE_EMBEDDED)
+      (*escaped)++;
+  }
+  return 1;
+}
+
+/**
+ * Materialize cell `ix` of the current row from the tape
+ */
+static struct zsv_cell zsv_tape_cell_value(struct zsv_scanner *scanner, size_t ix) {
+  struct zsv_tape *t = scanner->tape;
+  const struct zsv_tape_row *r = &t->rows[t->current];
+  size_t cell = r->first_cell + ix;
+  uint32_t e = t->cells[cell];
+  size_t start = ix ? (t->cells[cell - 1] & ZSV_TAPE_OFFSET_MASK) + t->delim_len : r->start;
+  size_t n = (e & ZSV_TAPE_OFFSET_MASK) - start;
+  unsigned char quoted = (e >> ZSV_TAPE_QUOTED_SHIFT) & ZSV_TAPE_QUOTED_MASK;
+  size_t quote_close_position = e & ZSV_TAPE_STRIP ? n - 1 : 0;
+  if (VERY_UNLIKELY(e & ZSV_TAPE_ODD)) {
+    const struct zsv_tape_odd *odd = zsv_tape_odd_find(t, cell);
+    quoted = odd->quoted;
+    quote_close_position = odd->quote_close_position;
+  }
+  unsigned char *s = zsv_cell_value(scanner, scanner->buff.buff + start, &n, &quoted, quote_close_position);
+  struct zsv_cell c = {s, n, scanner->opts.no_quotes ? 1 : quoted, 0};
+  return c;
+}
+
+static struct zsv_cell zsv_get_cell_tape(zsv_parser parser, size_t ix) {
+  if (VERY_LIKELY(ix < parser->row.used)) {
+    struct zsv_tape *t = parser->tape;
+    if (t->eager || t->cell_gen[ix] == t->gen)
+      return parser->row.cells[ix];
+
+    const uint32_t *cells = t->cells + t->rows[t->current].first_cell;
+    uint32_t e = cells[ix];
+    if (LIKELY((e & (ZSV_TAPE_ODD | ((uint32_t)ZSV_PARSER_QUOTE_EMBEDDED << ZSV_TAPE_QUOTED_SHIFT))) == 0 &&
+               (!parser->opts.malformed_utf8_replace ||
+                parser->buff.buff + (e & ZSV_TAPE_OFFSET_MASK) <= parser->utf8_clean_end))) {
+      // the cell value can be derived without modifying the buffer, so there
+      // is no need to save it for subsequent calls
+      size_t start = ix ? (cells[ix - 1] & ZSV_TAPE_OFFSET_MASK) + t->delim_len : t->rows[t->current].start;
+      struct zsv_cell c = {parser->buff.buff + start, (e & ZSV_TAPE_OFFSET_MASK) - start,
+                           (e >> ZSV_TAPE_QUOTED_SHIFT) & ZSV_TAPE_QUOTED_MASK, 0};
+      if (e & ZSV_TAPE_STRIP) {
+        c.str++;
+        c.len -= 2;
+      } else if (!c.quoted && UNLIKELY(zsv_cell_check_quotes(parser)) && zsv_cell_needs_quotes(parser, c.str, c.len))
+        c.quoted = ZSV_PARSER_QUOTE_NEEDED;
+      if (parser->opts.no_quotes)
+        c.quoted = 1;
+      return c;
+    }
+    parser->row.cells[ix] = zsv_tape_cell_value(parser, ix);
+    t->cell_gen[ix] = t->gen;
+    return parser->row.cells[ix];
+  }
+  struct zsv_cell c = {0, 0, 0, 0};
+  return c;
+}
+
+/**
+ * Fetch the first n cells of the current row (see zsv_next_batch()), where n
+ * does not exceed the row's cell count
+ * @param out    cell i is written to out[i * stride]
+ */
+static void zsv_tape_get_cells(struct zsv_scanner *scanner, struct zsv_cell *out, size_t stride, size_t n) {
+  struct zsv_tape *t = scanner->tape;
+  if (t->eager || scanner->opts.malformed_utf8_replace || scanner->opts.no_quotes || zsv_cell_check_quotes(scanner)) {
+    for (size_t i = 0; i < n; i++)
+      out[i * stride] = zsv_get_cell_tape(scanner, i);
+    return;
+  }
+  const uint32_t *cells = t->cells + t->rows[t->current].first_cell;
+  size_t start = t->rows[t->current].start;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t e = cells[i];
+    if (LIKELY((e & (ZSV_TAPE_ODD | ((uint32_t)ZSV_PARSER_QUOTE_EMBEDDED << ZSV_TAPE_QUOTED_SHIFT))) == 0)) {
+      // same as the fast path in zsv_get_cell_tape()
+      struct zsv_cell c = {scanner->buff.buff + start, (e & ZSV_TAPE_OFFSET_MASK) - start,
+                           (e >> ZSV_TAPE_QUOTED_SHIFT) & ZSV_TAPE_QUOTED_MASK, 0};
+      if (e & ZSV_TAPE_STRIP) {
+        c.str++;
+        c.len -= 2;
+      }
+      out[i * stride] = c;
+    } else
+      out[i * stride] = zsv_get_cell_tape(scanner, i);
+    start = (e & ZSV_TAPE_OFFSET_MASK) + t->delim_len;
+  }
+}
+
+/**
+ * Deliver the rows whose end has been scanned. In pull mode, stop after the
+ * row that zsv_next_row() will return
+ * @param eager if non-zero, materialize all cells of each row
+ */
+static enum zsv_status zsv_tape_deliver(struct zsv_scanner *scanner, char eager) {
+  struct zsv_tape *t = scanner->tape;
+  enum zsv_status stat = zsv_status_ok;
+
+  if (t->pulled) {
+    t->pulled = 0;
+    scanner->data_row_count++;
+  } else {
+    t->saved.row_start = scanner->row_start;
+    t->saved.scanned_length = scanner->scanned_length;
+    t->saved.have_cell = scanner->have_cell;
+  }
+  while (t->next_row < t->rows_done && !scanner->pull.now) {
+    const struct zsv_tape_row *r = &t->rows[t->next_row];
+    size_t cell_end = t->next_row + 1 < t->rows_used ? r[1].first_cell : t->cells_used;
+    size_t count = cell_end - r->first_cell;
+    t->current = t->next_row++;
+
+    // set the row-level state used by e.g. zsv_row_length_raw_bytes()
+    scanner->row_start = r->start;
+    scanner->scanned_length = t->cells[cell_end - 1] & ZSV_TAPE_OFFSET_MASK;
+    if (VERY_LIKELY(count <= scanner->row.allocated))
+      scanner->row.used = count;
+    else {
+      scanner->row.used = scanner->row.allocated;
+      scanner->row.overflow = count - scanner->row.allocated;
+    }
+    if (VERY_UNLIKELY(++t->gen == 0)) {
+      memset(t->cell_gen, 0, scanner->row.allocated * sizeof(*t->cell_gen));
+      t->gen = 1;
+    }
+
+    // header rows are processed by internal handlers which use all cells
+    t->eager = eager || scanner->opts.row_handler != scanner->opts_orig.row_handler;
+    if (t->eager)
+      for (size_t i = 0; i < scanner->row.used; i++)
+        scanner->row.cells[i] = zsv_tape_cell_value(scanner, i);
+
+    if (VERY_UNLIKELY((stat = row_dl(scanner))))
+      break;
+    if (!scanner->pull.now)
+      scanner->data_row_count++;
+  }
+
+  if (scanner->pull.now && !eager)
+    // keep the row-level state until the next zsv_next_row() call
+    t->pulled = 1;
+  else {
+    scanner->row_start = t->saved.row_start;
+    scanner->scanned_length = t->saved.scanned_length;
+    scanner->have_cell = t->saved.have_cell;
+  }
+  return stat;
+}
+
+/**
+ * Called by scanner_pre_parse() before the partial row at the end of the
+ * buffer, if any, is moved to the start of the buffer
+ */
+static void zsv_tape_shift(struct zsv_tape *t, size_t row_start) {
+  size_t first = t->rows_used > t->rows_done ? t->rows[t->rows_done].first_cell : t->cells_used;
+  size_t n = t->cells_used - first;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t e = t->cells[first + i];
+    t->cells[i] = (e & ~ZSV_TAPE_OFFSET_MASK) | ((e & ZSV_TAPE_OFFSET_MASK) - (uint32_t)row_start);
+  }
+  size_t odd_used = 0;
+  for (size_t i = 0; i < t->odd_used; i++) {
+    if (t->odd[i].cell >= first) {
+      t->odd[odd_used] = t->odd[i];
+      t->odd[odd_used++].cell -= (uint32_t)first;
+    }
+  }
+  t->odd_used = odd_used;
+  t->cells_used = n;
+  if (t->rows_used > t->rows_done) {
+    t->rows[0].start = 0;
+    t->rows[0].first_cell = 0;
+    t->rows_used = 1;
+  } else
+    t->rows_used = 0;
+  t->rows_done = t->next_row = 0;
+}
+
+/**
+ * Discard all rows, e.g. because the input was repositioned (see zsv_seek_row())
+ */
+static void zsv_tape_clear(struct zsv_tape *t) {
+  t->cells_used = t->rows_used = t->rows_done = t->next_row = t->odd_used = 0;
+  t->pulled = 0;
+}
+
+/**
+ * Allocate the tape if opts.tape is set and is compatible with the other
+ * options
+ * @return non-zero on error
+ */
+static int zsv_tape_init(struct zsv_scanner *scanner) {
+  if (!scanner->opts.tape || scanner->opts.cell_handler || scanner->buff.size > ZSV_TAPE_MAX_BUFFSIZE)
+    return 0;
+#ifdef ZSV_EXTRAS
+  if (scanner->overwrite.have)
+    return 0;
+#endif
+  if (!(scanner->tape = calloc(1, sizeof(*scanner->tape))) ||
+      !(scanner->tape->cell_gen = calloc(scanner->row.allocated, sizeof(*scanner->tape->cell_gen)))) {
+    zsv_tape_delete(&scanner->tape);
+    return 1;
+  }
+  scanner->tape->delim_len = scanner->delims.delim_len ? scanner->delims.delim_len : 1;
+  return 0;
+}
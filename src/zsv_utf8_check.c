@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 Tai Chi Minh Ralph Eastwood (self), Matt Wong (Guarnerix Inc dba Liquidaty)
+ * All rights reserved
+ *
+ * This file is part of zsv/lib, distributed under the license defined at
+ * https://opensource.org/licenses/MIT
+ */
+
+/*
+ * Buffer-level UTF8 validation (see zsv_opts.malformed_utf8_replace)
+ *
+ * Instead of passing every cell through zsv_strencode(), each chunk of input
+ * is validated once, right after it is read. Cells that end before the first
+ * malformed byte of the chunk are left as-is, and only the remaining cells are
+ * checked (and, if needed, repaired) one at a time. Because delimiters, row
+ * ends and dbl-quotes are all ASCII, a well-formed chunk can only contain
+ * well-formed cells, and unescaping a cell cannot make it malformed
+ *
+ * A char is well-formed under the same rules as in zsv_strencode(): its
+ * length is determined by its first byte (see ZSV_UTF8_CHARLEN), and each
+ * subsequent byte must be 10xxxxxx
+ */
+
+#define ZSV_UTF8_X16(x) x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x
+
+/**
+ * Char length by first byte, or -1 if the byte cannot start a char
+ */
+static const signed char zsv_utf8_char_len[256] = {
+  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  // 0xxxxxxx
+  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  ZSV_UTF8_X16(1),  //
+  ZSV_UTF8_X16(-1), ZSV_UTF8_X16(-1), ZSV_UTF8_X16(-1), ZSV_UTF8_X16(-1), // 10xxxxxx
+  ZSV_UTF8_X16(2),  ZSV_UTF8_X16(2),                                      // 110xxxxx
+  ZSV_UTF8_X16(3),                                                        // 1110xxxx
+  4,                4,                4,                4,                // 11110xxx
+  4,                4,                4,                4,                //
+  5,                5,                5,                5,                // 111110xx
+  6,                6,                                                    // 1111110x
+  -1,               -1                                                    // 11111110, 11111111
+};
+
+#undef ZSV_UTF8_X16
+
+/**
+ * Find the end of the well-formed UTF8 at the start of s
+ *
+ * Blocks of ASCII are skipped several vectors at a time; the (rare) blocks
+ * that contain multi-byte chars are checked a char at a time
+ *
+ * @return length of the longest prefix of s that consists of whole,
+ *         well-formed chars; n if all of s is well-formed
+ */
+static size_t zsv_utf8_valid_len(const unsigned char *s, size_t n) {
+#define ZSV_UTF8_BLOCK (4 * VECTOR_BYTES)
+  zsv_uc_vector high;
+  memset(&high, 0x80, sizeof(high));
+  size_t i = 0;
+  while (i < n) {
+    for (; i + ZSV_UTF8_BLOCK <= n; i += ZSV_UTF8_BLOCK) {
+      zsv_uc_vector a, b, c, d;
+      memcpy(&a, s + i, sizeof(a));
+      memcpy(&b, s + i + VECTOR_BYTES, sizeof(b));
+      memcpy(&c, s + i + 2 * VECTOR_BYTES, sizeof(c));
+      memcpy(&d, s + i + 3 * VECTOR_BYTES, sizeof(d));
+      zsv_uc_vector vtmp = (a | b | c | d) & high;
+      if (movemask_pseudo(vtmp))
+        break;
+    }
+
+    // check the rest of this block (or of the input) one char at a time
+    size_t block_end = i + ZSV_UTF8_BLOCK < n ? i + ZSV_UTF8_BLOCK : n;
+    while (i < block_end) {
+      if (s[i] < 128) {
+        i++;
+        continue;
+      }
+      int clen = zsv_utf8_char_len[s[i]];
+      if (clen < 0 || i + (size_t)clen > n)
+        return i;
+      for (int k = 1; k < clen; k++)
+        if (!ZSV_UTF8_SUBSEQUENT_CHAR_OK(s[i + k]))
+          return i;
+      i += (size_t)clen;
+    }
+  }
+  return n;
+#undef ZSV_UTF8_BLOCK
+}
+
+/**
+ * Validate the first n bytes of the buffer, which are about to be scanned. A
+ * cell [s, s + len) in the buffer is well-formed if s + len <= utf8_clean_end
+ */
+static inline void zsv_utf8_check(struct zsv_scanner *scanner, size_t n) {
+  if (scanner->opts.malformed_utf8_replace)
+    scanner->utf8_clean_end = scanner->buff.buff + zsv_utf8_valid_len(scanner->buff.buff, n);
+}
+